@@ -207,14 +207,13 @@ static float getRulesParamFloatValueByName(
 	float defaultValue
 ) {
 	float value = defaultValue;
-	const std::string key(rulesParamName);
-	const auto it = params.find(key);
+	const LuaRulesParams::Param* param = params.Find(rulesParamName);
 
-	if (it == params.end())
+	if (param == nullptr)
 		return value;
 
-	if (modParamIsVisible(it->second, losMask))
-		value = it->second.valueInt;
+	if (modParamIsVisible(*param, losMask))
+		value = param->valueInt;
 
 	return value;
 }
@@ -226,14 +225,13 @@ static const char* getRulesParamStringValueByName(
 	const char* defaultValue
 ) {
 	const char* value = defaultValue;
-	const std::string key(rulesParamName);
-	const auto it = params.find(key);
+	const LuaRulesParams::Param* param = params.Find(rulesParamName);
 
-	if (it == params.end())
+	if (param == nullptr)
 		return value;
 
-	if (modParamIsVisible(it->second, losMask))
-		value = it->second.valueString.c_str();
+	if (modParamIsVisible(*param, losMask))
+		value = param->valueString.c_str();
 
 	return value;
 }
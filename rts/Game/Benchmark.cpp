@@ -0,0 +1,185 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Benchmark.h"
+#include "System/TimeProfiler.h"
+#include "System/Log/ILog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#ifdef _WIN32
+	#include <windows.h>
+	// resolves to K32GetProcessMemoryInfo, no need to link psapi
+	#define PSAPI_VERSION 2
+	#include <psapi.h>
+#else
+	#include <sys/resource.h>
+#endif
+
+
+static uint64_t GetPeakResidentSetSize()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return 0;
+
+	return pmc.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+	#ifdef __APPLE__
+	return usage.ru_maxrss;
+	#else
+	// KiB on Linux and the BSDs
+	return (usage.ru_maxrss * uint64_t(1024));
+	#endif
+#endif
+}
+
+static std::string EscapeString(const std::string& str)
+{
+	std::string ret;
+	ret.reserve(str.size());
+
+	for (const char c: str) {
+		if (c == '"' || c == '\\')
+			ret += '\\';
+
+		ret += c;
+	}
+
+	return ret;
+}
+
+// nearest-rank percentile of an ascending sequence
+static float GetPercentile(const std::vector<float>& sortedTimes, float p)
+{
+	const size_t rank = std::ceil(p * sortedTimes.size());
+	return sortedTimes[std::max(rank, size_t(1)) - 1];
+}
+
+
+
+CBenchmark& CBenchmark::GetInstance()
+{
+	static CBenchmark benchmark;
+	return benchmark;
+}
+
+
+void CBenchmark::SimFrame(int frameNum, spring_time frameStartTime, spring_time frameEndTime)
+{
+	// timers which already ran during loading have no per-frame baseline yet,
+	// so the first sim-frame only provides one and is not itself recorded
+	const bool haveBaseline = (firstFrameNum >= 0);
+
+	CTimeProfiler::GetInstance().GetTimeTotals("Sim", timerTotals);
+
+	if (!haveBaseline) {
+		firstFrameNum = frameNum;
+
+		for (const auto& p: timerTotals) {
+			timerSamples.emplace_back();
+			timerSamples.back().name = p.first;
+			timerSamples.back().prevTotal = p.second;
+		}
+
+		return;
+	}
+
+	if ((numFrames++) == 0)
+		firstFrameStartTime = frameStartTime;
+
+	lastFrameEndTime = frameEndTime;
+
+	for (const auto& p: timerTotals) {
+		const auto pred = [&](const TimerSamples& s) { return (s.name == p.first); };
+		const size_t index = std::find_if(timerSamples.begin(), timerSamples.end(), pred) - timerSamples.begin();
+
+		if (index == timerSamples.size()) {
+			// ran for the first time during this frame
+			timerSamples.emplace_back();
+			timerSamples.back().name = p.first;
+			timerSamples.back().prevTotal = spring_notime;
+		}
+
+		TimerSamples& samples = timerSamples[index];
+
+		// zero for all earlier frames in which it did not run
+		samples.frameTimes.resize(numFrames - 1, 0.0f);
+		samples.frameTimes.push_back((p.second - samples.prevTotal).toMilliSecsf());
+		samples.prevTotal = p.second;
+	}
+}
+
+
+bool CBenchmark::WriteResults(const std::string& fileName) const
+{
+	if (numFrames == 0) {
+		LOG_L(L_WARNING, "[Benchmark::%s] no sim-frames were recorded", __func__);
+		return false;
+	}
+
+	FILE* file = fopen(fileName.c_str(), "w");
+
+	if (file == nullptr)
+		return false;
+
+	const float wallTime = (lastFrameEndTime - firstFrameStartTime).toSecsf();
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"demo\": \"%s\",\n", EscapeString(demoName).c_str());
+	fprintf(file, "\t\"firstFrame\": %d,\n", firstFrameNum + 1);
+	fprintf(file, "\t\"frames\": %d,\n", numFrames);
+	fprintf(file, "\t\"wallTimeSecs\": %.3f,\n", wallTime);
+	fprintf(file, "\t\"framesPerSecond\": %.2f,\n", numFrames / std::max(wallTime, 0.001f));
+	fprintf(file, "\t\"peakRSSBytes\": %llu,\n", static_cast<unsigned long long>(GetPeakResidentSetSize()));
+	fprintf(file, "\t\"timers\": {");
+
+	std::vector<const TimerSamples*> sortedSamples;
+	std::vector<float> sortedTimes;
+
+	sortedSamples.reserve(timerSamples.size());
+
+	for (const TimerSamples& samples: timerSamples) {
+		sortedSamples.push_back(&samples);
+	}
+
+	// stable output order, so results can also be diffed directly
+	std::sort(sortedSamples.begin(), sortedSamples.end(), [](const TimerSamples* a, const TimerSamples* b) { return (a->name < b->name); });
+
+	const char* sep = "";
+
+	for (const TimerSamples* samples: sortedSamples) {
+		// timers that stopped running (or never ran) in some frames took no time there
+		sortedTimes.assign(numFrames, 0.0f);
+		std::copy(samples->frameTimes.begin(), samples->frameTimes.end(), sortedTimes.begin());
+		std::sort(sortedTimes.begin(), sortedTimes.end());
+
+		float sumTime = 0.0f;
+
+		for (const float t: sortedTimes) {
+			sumTime += t;
+		}
+
+		fprintf(file, "%s\n\t\t\"%s\": {", sep, EscapeString(samples->name).c_str());
+		fprintf(file, "\"mean\": %.4f, ", sumTime / numFrames);
+		fprintf(file, "\"p50\": %.4f, ", GetPercentile(sortedTimes, 0.50f));
+		fprintf(file, "\"p90\": %.4f, ", GetPercentile(sortedTimes, 0.90f));
+		fprintf(file, "\"p99\": %.4f, ", GetPercentile(sortedTimes, 0.99f));
+		fprintf(file, "\"max\": %.4f}", sortedTimes.back());
+
+		sep = ",";
+	}
+
+	fprintf(file, "\n\t}\n}\n");
+	fclose(file);
+	return true;
+}
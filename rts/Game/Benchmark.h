@@ -0,0 +1,62 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+#include "System/Misc/SpringTime.h"
+
+
+/**
+ * @brief Records sim-performance of a demo replayed through --benchmark
+ *
+ * After every sim-frame the time each "Sim*" profiler timer accumulated during
+ * it is sampled; once the demo has ended their percentiles, the peak resident
+ * set size and the overall sim-rate are written out as JSON for comparison
+ * against a stored baseline (see tools/benchmark/compare_benchmark.py).
+ */
+class CBenchmark
+{
+public:
+	static CBenchmark& GetInstance();
+
+	void SetEnabled(bool b) { enabled = b; }
+	bool IsEnabled() const { return enabled; }
+
+	void SetDemoName(const std::string& name) { demoName = name; }
+
+	void SimFrame(int frameNum, spring_time frameStartTime, spring_time frameEndTime);
+
+	// returns false if the results could not be written
+	bool WriteResults(const std::string& fileName) const;
+
+	int GetNumFrames() const { return numFrames; }
+
+	static constexpr const char* RESULTS_FILE_NAME = "benchmark.json";
+
+private:
+	struct TimerSamples {
+		std::string name;
+		// accumulated time up to the previous sim-frame
+		spring_time prevTotal;
+		// msecs spent per sim-frame, one entry for each since the first
+		std::vector<float> frameTimes;
+	};
+
+	std::vector<TimerSamples> timerSamples;
+	std::vector< std::pair<std::string, spring_time> > timerTotals;
+
+	std::string demoName;
+
+	spring_time firstFrameStartTime;
+	spring_time lastFrameEndTime;
+
+	int firstFrameNum = -1;
+	int numFrames = 0;
+
+	bool enabled = false;
+};
+
+#endif // BENCHMARK_H
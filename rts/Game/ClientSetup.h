@@ -28,6 +28,9 @@ public:
 	int hostPort;
 
 	bool isHost;
+
+	//! if true, the demo being replayed is fed to the client as fast as it can simulate
+	bool benchmarkMode;
 };
 
 #endif // CLIENT_SETUP_H
@@ -3,6 +3,7 @@
 #include "Rendering/GL/myGL.h"
 
 #include "Game.h"
+#include "Benchmark.h"
 #include "Camera.h"
 #include "CameraHandler.h"
 #include "ChatMessage.h"
@@ -579,7 +580,7 @@ void CGame::PreLoadSimulation(LuaParser* defsParser)
 
 	loadscreen->SetLoadMessage("Creating QuadField & CEGs");
 	moveDefHandler.Init(defsParser);
-	quadField.Init(int2(mapDims.mapx, mapDims.mapy), CQuadField::BASE_QUAD_SIZE);
+	quadField.Init(int2(mapDims.mapx, mapDims.mapy), CQuadField::BASE_QUAD_SIZE, modInfo.quadFieldUnitSoA);
 	damageArrayHandler.Init(defsParser);
 	explGenHandler.Init();
 }
@@ -1123,6 +1124,22 @@ bool CGame::Update()
 
 	LEAVE_SYNCED_CODE();
 
+	if (CBenchmark::GetInstance().IsEnabled() && !gu->globalQuit) {
+		// the server drops its demo-reader after sending the last of the demo
+		if (gameServer != nullptr && gameServer->GetDemoReader() == nullptr && GetNumQueuedSimFrameMessages(1) == 0) {
+			const CBenchmark& benchmark = CBenchmark::GetInstance();
+
+			if (benchmark.WriteResults(CBenchmark::RESULTS_FILE_NAME)) {
+				LOG("[Game::%s] wrote benchmark results of %d sim-frames to \"%s\"", __func__, benchmark.GetNumFrames(), CBenchmark::RESULTS_FILE_NAME);
+			} else {
+				LOG_L(L_ERROR, "[Game::%s] could not write benchmark results to \"%s\"", __func__, CBenchmark::RESULTS_FILE_NAME);
+				spring::exitCode = spring::EXIT_CODE_FAILURE;
+			}
+
+			gu->globalQuit = true;
+		}
+	}
+
 	{
 		SLuaAllocError error = {};
 
@@ -1694,9 +1711,14 @@ void CGame::SimFrame() {
 	gu->avgSimFrameTime = std::max(gu->avgSimFrameTime, 0.01f);
 
 	eventHandler.DbgTimingInfo(TIMING_SIM, lastFrameTime, lastSimFrameTime);
+	CTimeTracer::GetInstance().CheckSimFrame(gs->frameNum, lastFrameTime, lastSimFrameTime);
+
+	if (CBenchmark::GetInstance().IsEnabled())
+		CBenchmark::GetInstance().SimFrame(gs->frameNum, lastFrameTime, lastSimFrameTime);
 
 	#ifdef HEADLESS
-	{
+	// benchmarks replay at maximum speed
+	if (!CBenchmark::GetInstance().IsEnabled()) {
 		const float msecMaxSimFrameTime = 1000.0f / (GAME_SPEED * gs->wantedSpeedFactor);
 		const float msecDifSimFrameTime = (lastSimFrameTime - lastFrameTime).toMilliSecsf();
 		// multiply by 0.5 to give unsynced code some execution time (50% of our sleep-budget)
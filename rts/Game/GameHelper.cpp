@@ -36,8 +36,10 @@
 #include "Sim/Weapons/WeaponDefHandler.h"
 #include "Sim/Weapons/Weapon.h"
 #include "System/EventHandler.h"
+#include "System/Log/ILog.h"
 #include "System/SpringMath.h"
 #include "System/Sound/ISoundChannels.h"
+#include "System/Threading/ThreadPool.h"
 
 
 static CGameHelper gGameHelper;
@@ -632,10 +634,70 @@ namespace {
 
 
 
-size_t CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<std::pair<float, CUnit*>>& targets)
+static float GetWeaponTargetScanRadius(const CWeapon* weapon)
 {
-	const CUnit*  weaponOwner = weapon->owner;
-	const CUnit* lastAttacker = ((weaponOwner->lastAttackFrame + 200) <= gs->frameNum) ? weaponOwner->lastAttacker : nullptr;
+	const float aimPosHeight = weapon->aimFromPos.y;
+	const float minMapHeight = std::max(0.0f, readMap->GetCurrMinHeight());
+
+	// find theoretical maximum range based on height above lowest point on map
+	// return (weapon->GetRange2D(weapon->autoTargetRangeBoost, (minMapHeight - aimPosHeight) * weapon->weaponDef->heightmod));
+	return (weapon->range + weapon->autoTargetRangeBoost + (aimPosHeight - minMapHeight) * weapon->weaponDef->heightmod);
+}
+
+static const CUnit* GetWeaponAvoidUnit(const CWeapon* weapon)
+{
+	return ((weapon->avoidTarget && weapon->HaveUnitTarget())? weapon->GetCurrentTarget().unit: nullptr);
+}
+
+
+struct WeaponTargetQueryBuffers {
+	std::vector<int> weaponQuads;
+
+	// per-thread replacement for CUnit::tempNum
+	std::vector<int> unitStamps;
+	int curStamp = 0;
+};
+
+static std::array<WeaponTargetQueryBuffers, ThreadPool::MAX_THREADS> weaponTargetQueryBuffers;
+
+
+// collects the enemies in <quads> in the order both the serial and the
+// batched path must see them; <visited> replaces the CUnit::tempNum test
+template<typename VisitedFunc>
+static void GatherWeaponTargetUnits(
+	const CWeapon* weapon,
+	const std::vector<int>& quads,
+	std::vector<CUnit*>& targetUnits,
+	VisitedFunc visited
+) {
+	targetUnits.clear();
+
+	for (int t = 0; t < teamHandler.ActiveAllyTeams(); ++t) {
+		if (teamHandler.Ally(weapon->owner->allyteam, t))
+			continue;
+
+		for (const int qi: quads) {
+			for (CUnit* targetUnit: quadField.GetQuad(qi).teamUnits[t]) {
+				if (visited(targetUnit))
+					continue;
+
+				targetUnits.push_back(targetUnit);
+			}
+		}
+	}
+}
+
+
+// [0] := default, [1,2,3,4,5,6] := target is {avoidee, in bad category, crashing, last attacker, paralyzed, outside unboosted range}
+static constexpr float tgtPriorityMults[] = {1.0f, 10.0f, 100.0f, 1000.0f, 0.5f, 4.0f, 100000.0f};
+
+void CGameHelper::ScoreWeaponTargets(
+	const CWeapon* weapon,
+	const CUnit* avoidUnit,
+	const std::vector<CUnit*>& targetUnits,
+	std::vector<WeaponTargetCandidate>& candidates
+) {
+	const CUnit* weaponOwner = weapon->owner;
 
 	const      WeaponDef* weaponDef = weapon->weaponDef;
 	const DynDamageArray* weaponDmg = weapon->damages;
@@ -644,7 +706,6 @@ size_t CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* av
 	const float3 testPos;
 
 	const float aimPosHeight = weapon->aimFromPos.y;
-	const float minMapHeight = std::max(0.0f, readMap->GetCurrMinHeight());
 
 	// how much damage the weapon deals over 1 second
 	const float secDamage = weaponDmg->GetDefault() * weapon->salvoSize / weapon->reloadTime * GAME_SPEED;
@@ -652,102 +713,244 @@ size_t CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* av
 
 	const float  baseRange = weapon->range;
 	const float rangeBoost = weapon->autoTargetRangeBoost;
-	// find theoretical maximum range based on height above lowest point on map
-	// const float scanRadius = weapon->GetRange2D(rangeBoost, (minMapHeight - aimPosHeight) * heightMod);
-	const float scanRadius = baseRange + rangeBoost + (aimPosHeight - minMapHeight) * heightMod;
-
-	// [0] := default, [1,2,3,4,5,6] := target is {avoidee, in bad category, crashing, last attacker, paralyzed, outside unboosted range}
-	constexpr float tgtPriorityMults[] = {1.0f, 10.0f, 100.0f, 1000.0f, 0.5f, 4.0f, 100000.0f};
 
 	const bool paralyzer = (weaponDmg->paralyzeDamageTime != 0);
 
-	// copy on purpose since the below calls lua
-	QuadFieldQuery qfQuery;
-	quadField.GetQuads(qfQuery, ownerPos, scanRadius);
+	candidates.clear();
+	candidates.reserve(32);
 
-	targets.clear();
-	targets.reserve(32);
+	for (CUnit* targetUnit: targetUnits) {
+		if (!weapon->TestTarget(testPos, SWeaponTarget(targetUnit)))
+			continue;
 
-	const int tempNum = gs->GetTempNum();
+		const unsigned short targetLOSState = targetUnit->losStatus[weaponOwner->allyteam];
 
-	for (int t = 0; t < teamHandler.ActiveAllyTeams(); ++t) {
-		if (teamHandler.Ally(weaponOwner->allyteam, t))
+		float targetPriority = tgtPriorityMults[(targetUnit == avoidUnit) * 1];
+		float3 targetPos;
+
+		if (targetLOSState & LOS_INLOS) {
+			targetPos = targetUnit->aimPos;
+		} else if (targetLOSState & LOS_INRADAR) {
+			targetPos = weapon->GetUnitPositionWithError(targetUnit);
+			targetPriority *= tgtPriorityMults[1];
+		} else {
 			continue;
+		}
 
-		for (const int qi: *qfQuery.quads) {
-			const std::vector<CUnit*>& allyTeamUnits = quadField.GetQuad(qi).teamUnits[t];
+		const float modRange = weapon->GetRange2D(rangeBoost, (targetPos.y - aimPosHeight) * heightMod);
+		const float sqDist2D = ownerPos.SqDistance2D(targetPos);
 
-			for (CUnit* targetUnit: allyTeamUnits) {
-				if (targetUnit->tempNum == tempNum)
-					continue;
+		if (sqDist2D > Square(modRange))
+			continue;
 
-				targetUnit->tempNum = tempNum;
+		const float dist2D = math::sqrt(sqDist2D);
+		const float rangeMul = (dist2D * weaponDef->proximityPriority + modRange * 0.4f + 100.0f);
 
-				if (!weapon->TestTarget(testPos, SWeaponTarget(targetUnit)))
-					continue;
+		targetPriority *= rangeMul;
+		targetPriority *= tgtPriorityMults[(dist2D > baseRange) * 6];
 
-				const unsigned short targetLOSState = targetUnit->losStatus[weaponOwner->allyteam];
+		if (targetLOSState & LOS_INLOS) {
+			targetPriority *= (secDamage + targetUnit->health);
 
-				float targetPriority = tgtPriorityMults[(targetUnit == avoidUnit) * 1];
-				float3 targetPos;
+			if (paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health))
+				targetPriority *= tgtPriorityMults[5];
+		} else {
+			targetPriority *= (secDamage + 10000.0f);
+		}
 
-				if (targetLOSState & LOS_INLOS) {
-					targetPos = targetUnit->aimPos;
-				} else if (targetLOSState & LOS_INRADAR) {
-					targetPos = weapon->GetUnitPositionWithError(targetUnit);
-					targetPriority *= tgtPriorityMults[1];
-				} else {
-					continue;
-				}
+		candidates.push_back({targetUnit, targetPriority, targetLOSState});
+	}
+}
 
-				const float modRange = weapon->GetRange2D(rangeBoost, (targetPos.y - aimPosHeight) * heightMod);
-				const float sqDist2D = ownerPos.SqDistance2D(targetPos);
+size_t CGameHelper::FinishWeaponTargets(
+	const CWeapon* weapon,
+	const std::vector<WeaponTargetCandidate>& candidates,
+	std::vector<std::pair<float, CUnit*>>& targets
+) {
+	const CUnit*  weaponOwner = weapon->owner;
+	const CUnit* lastAttacker = ((weaponOwner->lastAttackFrame + 200) <= gs->frameNum) ? weaponOwner->lastAttacker : nullptr;
 
-				if (sqDist2D > Square(modRange))
-					continue;
+	const      WeaponDef* weaponDef = weapon->weaponDef;
+	const DynDamageArray* weaponDmg = weapon->damages;
 
-				const float dist2D = math::sqrt(sqDist2D);
-				const float rangeMul = (dist2D * weaponDef->proximityPriority + modRange * 0.4f + 100.0f);
-				const float damageMul = weaponDmg->Get(targetUnit->armorType) * targetUnit->curArmorMultiple;
+	targets.clear();
+	targets.reserve(candidates.size());
 
-				targetPriority *= rangeMul;
-				targetPriority *= tgtPriorityMults[(dist2D > baseRange) * 6];
+	// consumes gsRNG and calls into scripts and Lua, so must run on the
+	// main thread in a fixed order; the arithmetic is applied in the same
+	// sequence as it was before ScoreWeaponTargets was split off
+	for (const WeaponTargetCandidate& candidate: candidates) {
+		CUnit* targetUnit = candidate.unit;
 
-				if (targetLOSState & LOS_INLOS) {
-					targetPriority *= (secDamage + targetUnit->health);
+		float targetPriority = candidate.priority;
 
-					if (paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health))
-						targetPriority *= tgtPriorityMults[5];
+		if ((candidate.losState & LOS_INLOS) && weapon->hasTargetWeight)
+			targetPriority *= weapon->TargetWeight(targetUnit);
 
-					if (weapon->hasTargetWeight)
-						targetPriority *= weapon->TargetWeight(targetUnit);
+		if (candidate.losState & LOS_PREVLOS) {
+			const float damageMul = weaponDmg->Get(targetUnit->armorType) * targetUnit->curArmorMultiple;
 
-				} else {
-					targetPriority *= (secDamage + 10000.0f);
-				}
+			targetPriority /= (damageMul * targetUnit->power * (0.7f + gsRNG.NextFloat() * 0.6f));
+			targetPriority *= tgtPriorityMults[((targetUnit->category & weapon->badTargetCategory) != 0) * 2];
+			targetPriority *= tgtPriorityMults[(targetUnit->IsCrashing()) * 3];
+			targetPriority *= tgtPriorityMults[(targetUnit == lastAttacker) * 4];
+		}
 
-				if (targetLOSState & LOS_PREVLOS) {
-					targetPriority /= (damageMul * targetUnit->power * (0.7f + gsRNG.NextFloat() * 0.6f));
-					targetPriority *= tgtPriorityMults[((targetUnit->category & weapon->badTargetCategory) != 0) * 2];
-					targetPriority *= tgtPriorityMults[(targetUnit->IsCrashing()) * 3];
-					targetPriority *= tgtPriorityMults[(targetUnit == lastAttacker) * 4];
-				}
+		if (!eventHandler.AllowWeaponTarget(weaponOwner->id, targetUnit->id, weapon->weaponNum, weaponDef->id, &targetPriority))
+			continue;
 
-				const bool allowTarget = eventHandler.AllowWeaponTarget(weaponOwner->id, targetUnit->id, weapon->weaponNum, weaponDef->id, &targetPriority);
+		targets.emplace_back(targetPriority, targetUnit);
+	}
 
-				// Lua call may have changed tempNum, so needs to be set again
-				targetUnit->tempNum = tempNum;
+	std::stable_sort(targets.begin(), targets.end(), [](const std::pair<float, CUnit*>& a, const std::pair<float, CUnit*>& b) { return (a.first < b.first); });
+	return (targets.size());
+}
 
-				if (!allowTarget)
-					continue;
 
-				targets.emplace_back(targetPriority, targetUnit);
+size_t CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<std::pair<float, CUnit*>>& targets)
+{
+	const auto iter = helper->weaponTargetBatchIndices.find(weapon);
+
+	// use the candidates pre-scored by GenerateWeaponTargetsBatch if there are any
+	if (helper->weaponTargetBatchFrame == gs->frameNum && iter != helper->weaponTargetBatchIndices.end()) {
+		const WeaponTargetBatchEntry& entry = helper->weaponTargetBatch[iter->second];
+
+		// each batch result is only valid for a single call
+		helper->weaponTargetBatchIndices.erase(iter);
+
+		// AutoTarget might pass a different avoidee if the weapon's target
+		// changed (or was dropped) since the batch was scored, and SlowUpdate
+		// can move the weapon's aim-from point (UpdateWeaponVectors)
+		if (entry.IsValid(weapon, avoidUnit)) {
+			#ifdef DEBUG
+			// compare against the unbatched search this result stands in for;
+			// the two can still differ if an earlier unit's SlowUpdate in this
+			// slice changed a candidate (health, paralysis, LOS state)
+			auto& candidates = helper->weaponTargetCandidates;
+
+			helper->ScoreWeaponTargetsSerial(weapon, avoidUnit, candidates);
+
+			const auto SameCandidate = [](const WeaponTargetCandidate& a, const WeaponTargetCandidate& b) {
+				return (a.unit == b.unit && a.priority == b.priority && a.losState == b.losState);
+			};
+
+			if (!std::equal(entry.candidates.begin(), entry.candidates.end(), candidates.begin(), candidates.end(), SameCandidate)) {
+				LOG_L(L_DEBUG, "[%s] batched candidates of weapon %d of unit %d differ from the serial search (%u vs. %u)",
+					__func__, weapon->weaponNum, weapon->owner->id, uint32_t(entry.candidates.size()), uint32_t(candidates.size()));
 			}
+			#endif
+
+			return (FinishWeaponTargets(weapon, entry.candidates, targets));
 		}
 	}
 
-	std::stable_sort(targets.begin(), targets.end(), [](const std::pair<float, CUnit*>& a, const std::pair<float, CUnit*>& b) { return (a.first < b.first); });
-	return (targets.size());
+	auto& candidates = helper->weaponTargetCandidates;
+
+	helper->ScoreWeaponTargetsSerial(weapon, avoidUnit, candidates);
+	return (FinishWeaponTargets(weapon, candidates, targets));
+}
+
+
+void CGameHelper::ScoreWeaponTargetsSerial(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<WeaponTargetCandidate>& candidates)
+{
+	// copy on purpose since the below calls lua
+	QuadFieldQuery qfQuery;
+	quadField.GetQuads(qfQuery, weapon->owner->pos, GetWeaponTargetScanRadius(weapon));
+
+	const int tempNum = gs->GetTempNum();
+
+	GatherWeaponTargetUnits(weapon, *qfQuery.quads, weaponTargetUnits, [&](CUnit* u) {
+		if (u->tempNum == tempNum)
+			return true;
+
+		u->tempNum = tempNum;
+		return false;
+	});
+
+	ScoreWeaponTargets(weapon, avoidUnit, weaponTargetUnits, candidates);
+}
+
+
+bool CGameHelper::WeaponTargetBatchEntry::IsValid(const CWeapon* w, const CUnit* u) const
+{
+	return (avoidUnit == u && ownerPos.same(w->owner->pos) && aimFromPos.same(w->aimFromPos));
+}
+
+
+void CGameHelper::GenerateWeaponTargetsBatch(const std::vector<CUnit*>& units, size_t idxBeg, size_t idxEnd, bool useThreads)
+{
+	size_t numEntries = 0;
+
+	weaponTargetBatchIndices.clear();
+	weaponTargetBatchFrame = gs->frameNum;
+
+	// gather every weapon that may want a new target during this SlowUpdate,
+	// in the order SlowUpdateWeapons will visit them
+	for (size_t i = idxBeg; i < idxEnd; i++) {
+		const CUnit* unit = units[i];
+
+		if (!unit->CanUpdateWeapons())
+			continue;
+
+		for (const CWeapon* weapon: unit->weapons) {
+			// same rules as CWeapon::AutoTarget, minus the Lua override which
+			// would run twice per weapon; weapons it enables take the serial
+			// path, and batch results of weapons it disables go unused
+			if (!weapon->AllowWeaponAutoTargetDefault())
+				continue;
+
+			if (numEntries >= weaponTargetBatch.size())
+				weaponTargetBatch.emplace_back();
+
+			WeaponTargetBatchEntry& entry = weaponTargetBatch[numEntries];
+
+			entry.weapon = weapon;
+			entry.avoidUnit = GetWeaponAvoidUnit(weapon);
+			entry.ownerPos = unit->pos;
+			entry.aimFromPos = weapon->aimFromPos;
+			entry.candidates.clear();
+
+			weaponTargetBatchIndices[weapon] = numEntries++;
+		}
+	}
+
+	if (numEntries == 0)
+		return;
+
+	for (WeaponTargetQueryBuffers& buffers: weaponTargetQueryBuffers) {
+		buffers.unitStamps.resize(unitHandler.MaxUnits(), 0);
+	}
+
+	const auto scoreEntry = [this](const int entryIdx) {
+		WeaponTargetQueryBuffers& threadBuffers = weaponTargetQueryBuffers[ThreadPool::GetThreadNum()];
+		WeaponTargetBatchEntry& entry = weaponTargetBatch[entryIdx];
+
+		// same quads as ScoreWeaponTargetsSerial, so the candidates are
+		// identical to those of the serial path (and in the same order)
+		quadField.GetQuadsMt(threadBuffers.weaponQuads, entry.ownerPos, GetWeaponTargetScanRadius(entry.weapon));
+
+		// CUnit::tempNum is shared between threads, so can not be used here
+		const int stamp = ++threadBuffers.curStamp;
+
+		GatherWeaponTargetUnits(entry.weapon, threadBuffers.weaponQuads, entry.targetUnits, [&](CUnit* u) {
+			if (threadBuffers.unitStamps[u->id] == stamp)
+				return true;
+
+			threadBuffers.unitStamps[u->id] = stamp;
+			return false;
+		});
+
+		ScoreWeaponTargets(entry.weapon, entry.avoidUnit, entry.targetUnits, entry.candidates);
+	};
+
+	if (useThreads) {
+		CQuadField::ReadOnlyScope qfScope;
+		for_mt(0, numEntries, scoreEntry);
+	} else {
+		for (size_t i = 0; i < numEntries; i++) {
+			scoreEntry(i);
+		}
+	}
 }
 
 
@@ -8,6 +8,7 @@
 #include "Sim/Units/CommandAI/Command.h"
 #include "System/float3.h"
 #include "System/type2.h"
+#include "System/UnorderedMap.hpp"
 
 #include <array>
 #include <vector>
@@ -139,6 +140,14 @@ public:
 	);
 
 	static size_t GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<std::pair<float, CUnit*>>& targets);
+	/**
+	 * Pre-scores auto-target candidates for the weapons of units[idxBeg, idxEnd)
+	 * which GenerateWeaponTargets will pick up during this frame. Only the parts
+	 * that do not touch Lua, scripts or gsRNG are done here (optionally in parallel);
+	 * a result is discarded if the weapon's avoidee, owner position or aim-from
+	 * point changed by the time it is needed.
+	 */
+	void GenerateWeaponTargetsBatch(const std::vector<CUnit*>& units, size_t idxBeg, size_t idxEnd, bool useThreads);
 
 	void Init();
 	void Update();
@@ -172,6 +181,46 @@ public:
 	void Explosion(const CExplosionParams& params);
 
 private:
+	struct WeaponTargetCandidate {
+		CUnit* unit;
+		float priority;
+		unsigned short losState;
+	};
+
+	struct WeaponTargetBatchEntry {
+		// true if the candidates were scored from the weapon's current state
+		bool IsValid(const CWeapon* w, const CUnit* u) const;
+
+		const CWeapon* weapon = nullptr;
+		const CUnit* avoidUnit = nullptr;
+
+		float3 ownerPos;
+		float3 aimFromPos;
+
+		std::vector<CUnit*> targetUnits;
+		std::vector<WeaponTargetCandidate> candidates;
+	};
+
+	// thread-safe part of GenerateWeaponTargets
+	static void ScoreWeaponTargets(
+		const CWeapon* weapon,
+		const CUnit* avoidUnit,
+		const std::vector<CUnit*>& targetUnits,
+		std::vector<WeaponTargetCandidate>& candidates
+	);
+	// gathers and scores candidates on the main thread
+	void ScoreWeaponTargetsSerial(
+		const CWeapon* weapon,
+		const CUnit* avoidUnit,
+		std::vector<WeaponTargetCandidate>& candidates
+	);
+	// main-thread part of GenerateWeaponTargets
+	static size_t FinishWeaponTargets(
+		const CWeapon* weapon,
+		const std::vector<WeaponTargetCandidate>& candidates,
+		std::vector<std::pair<float, CUnit*>>& targets
+	);
+
 	struct WaitingDamage {
 		WaitingDamage(const DamageArray& _damage, const float3& _impulse, int _attackerID, int _targetID, int _weaponID, int _projectileID)
 		: attackerID(_attackerID)
@@ -194,6 +243,15 @@ private:
 	// note: size must be a power of two
 	std::array<std::vector<WaitingDamage>, 128> waitingDamages;
 
+	// GenerateWeaponTargetsBatch state, only valid during <weaponTargetBatchFrame>
+	std::vector<WeaponTargetBatchEntry> weaponTargetBatch;
+	spring::unordered_map<const CWeapon*, unsigned int> weaponTargetBatchIndices;
+
+	std::vector<CUnit*> weaponTargetUnits;
+	std::vector<WeaponTargetCandidate> weaponTargetCandidates;
+
+	int weaponTargetBatchFrame = -1;
+
 public:
 	std::vector<int> targetUnitIDs; // GetEnemyUnits{NoLosTest}
 	std::vector<std::pair<float, CUnit*>> targetPairs; // GenerateWeaponTargets
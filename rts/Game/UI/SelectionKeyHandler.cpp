@@ -191,9 +191,9 @@ namespace {
 	#define STRTOF strtof
 #endif
 
-	DECLARE_FILTER_EX(RulesParamEquals, 2, unit->modParams.find(param) != unit->modParams.end() &&
-			((wantedValueStr.empty()) ? unit->modParams.find(param)->second.valueInt == wantedValue
-			: unit->modParams.find(param)->second.valueString == wantedValueStr),
+	DECLARE_FILTER_EX(RulesParamEquals, 2, unit->modParams.Find(param) != nullptr &&
+			((wantedValueStr.empty()) ? unit->modParams.Find(param)->valueInt == wantedValue
+			: unit->modParams.Find(param)->valueString == wantedValueStr),
 		std::string param;
 		std::string wantedValueStr;
 
@@ -3384,6 +3384,62 @@ public:
 
 
 
+/// /profile start|stop|dump [<file>]|lag <msecs>
+class ProfileActionExecutor : public IUnsyncedActionExecutor {
+public:
+	ProfileActionExecutor() : IUnsyncedActionExecutor(
+		"Profile",
+		"Record nested timer scopes of all threads and write them as Chrome trace JSON: "
+		"start, stop, dump [<file>], or lag <msecs> to dump every sim-frame slower than that (0 disables)"
+	) {
+	}
+
+	bool Execute(const UnsyncedAction& action) const final {
+		const std::vector<std::string> args = CSimpleParser::Tokenize(action.GetArgs());
+
+		CTimeTracer& tracer = CTimeTracer::GetInstance();
+
+		if (args.empty()) {
+			LOG("[ProfileAction::%s] tracing %s, lag-threshold %dms", __func__, tracer.IsEnabled()? "enabled": "disabled", tracer.GetLagThreshold());
+			return true;
+		}
+
+		switch (hashString(args[0].c_str())) {
+			case hashString("start"): {
+				tracer.SetEnabled(true);
+			} break;
+			case hashString("stop"): {
+				tracer.SetEnabled(false);
+			} break;
+			case hashString("dump"): {
+				const std::string fileName = (args.size() > 1)? args[1]: ("profile-" + std::to_string(gs->frameNum) + ".json");
+				const int numEvents = tracer.WriteTrace(fileName);
+
+				if (numEvents < 0) {
+					LOG_L(L_WARNING, "[ProfileAction::%s] could not write \"%s\"", __func__, fileName.c_str());
+				} else {
+					LOG("[ProfileAction::%s] wrote %d events to \"%s\"", __func__, numEvents, fileName.c_str());
+				}
+			} break;
+			case hashString("lag"): {
+				if (args.size() < 2)
+					return false;
+
+				// a threshold is useless without recording
+				tracer.SetLagThreshold(StringToInt(args[1]));
+				tracer.SetEnabled(tracer.IsEnabled() || tracer.GetLagThreshold() > 0);
+			} break;
+			default: {
+				LOG_L(L_WARNING, "[ProfileAction::%s] unknown argument \"%s\" (use \"start\", \"stop\", \"dump\", or \"lag\")", __func__, args[0].c_str());
+			} break;
+		}
+
+		return true;
+	}
+};
+
+
+
 class RedirectToSyncedActionExecutor : public IUnsyncedActionExecutor {
 public:
 	RedirectToSyncedActionExecutor(const std::string& command): IUnsyncedActionExecutor(
@@ -3745,6 +3801,7 @@ void UnsyncedGameCommands::AddDefaultActionExecutors()
 	AddActionExecutor(AllocActionExecutor<ReloadShadersActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<ReloadTexturesActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<DebugInfoActionExecutor>());
+	AddActionExecutor(AllocActionExecutor<ProfileActionExecutor>());
 
 	// XXX are these redirects really required?
 	AddActionExecutor(AllocActionExecutor<RedirectToSyncedActionExecutor>("ATM"));
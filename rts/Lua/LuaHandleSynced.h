@@ -268,7 +268,10 @@ class CSplitLuaHandle
 		CUnsyncedLuaHandle unsyncedLuaHandle;
 
 	public:
-		static void ClearGameParams() { spring::clear_unordered_map(gameParams); }
+		static void ClearGameParams() {
+			gameParams.Clear();
+			LuaRulesParams::keyTable.Clear();
+		}
 		static const LuaRulesParams::Params& GetGameParams() { return gameParams; }
 
 	private:
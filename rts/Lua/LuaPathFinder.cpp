@@ -69,6 +69,7 @@ bool LuaPathFinder::PushEntries(lua_State* L)
 	REGISTER_LUA_CFUNC(GetPathNodeCosts);
 	REGISTER_LUA_CFUNC(SetPathNodeCost);
 	REGISTER_LUA_CFUNC(GetPathNodeCost);
+	REGISTER_LUA_CFUNC(GetPathUpdateBacklog);
 
 	return true;
 }
@@ -410,5 +411,15 @@ int LuaPathFinder::GetPathNodeCost(lua_State* L)
 	return 1;
 }
 
+int LuaPathFinder::GetPathUpdateBacklog(lua_State* L)
+{
+	// number of {med,low}-res estimator blocks still waiting for new costs
+	const int2 numQueuedUpdates = pathManager->GetNumQueuedUpdates();
+
+	lua_pushnumber(L, numQueuedUpdates.x);
+	lua_pushnumber(L, numQueuedUpdates.y);
+	return 2;
+}
+
 /******************************************************************************/
 /******************************************************************************/
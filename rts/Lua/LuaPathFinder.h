@@ -18,6 +18,7 @@ private:
 	static int GetPathNodeCosts(lua_State* L);
 	static int SetPathNodeCost(lua_State* L);
 	static int GetPathNodeCost(lua_State* L);
+	static int GetPathUpdateBacklog(lua_State* L);
 };
 
 
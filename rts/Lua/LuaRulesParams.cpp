@@ -1,6 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "LuaRulesParams.h"
+#include "System/creg/ISerializer.h"
 
 using namespace LuaRulesParams;
 
@@ -10,3 +11,71 @@ CR_REG_METADATA(Param, (
 	CR_MEMBER(valueInt),
 	CR_MEMBER(valueString)
 ))
+
+CR_BIND(Params,)
+CR_REG_METADATA(Params, (
+	CR_MEMBER(keys),
+	CR_MEMBER(values)
+))
+
+
+KeyTable LuaRulesParams::keyTable;
+
+
+int KeyTable::AddKey(const std::string& name)
+{
+	const auto it = keys.find(name);
+
+	if (it != keys.end())
+		return (it->second);
+
+	names.push_back(name);
+	keys.insert(name, int(names.size()) - 1);
+	return (int(names.size()) - 1);
+}
+
+void KeyTable::Clear()
+{
+	names.clear();
+	keys.clear();
+}
+
+void KeyTable::Serialize(creg::ISerializer* s)
+{
+	std::unique_ptr<creg::IType> namesType = creg::DeduceType<decltype(names)>::Get();
+	namesType->Serialize(s, &names);
+
+	if (s->IsWriting())
+		return;
+
+	keys.clear();
+
+	for (size_t i = 0; i < names.size(); i++) {
+		keys.insert(names[i], int(i));
+	}
+}
+
+
+Param& Params::Get(int key)
+{
+	const auto it = std::lower_bound(keys.begin(), keys.end(), key);
+	const size_t idx = it - keys.begin();
+
+	if (it == keys.end() || *it != key) {
+		keys.insert(it, key);
+		values.insert(values.begin() + idx, Param());
+	}
+
+	return values[idx];
+}
+
+void Params::Erase(int key)
+{
+	const auto it = std::lower_bound(keys.begin(), keys.end(), key);
+
+	if (it == keys.end() || *it != key)
+		return;
+
+	values.erase(values.begin() + (it - keys.begin()));
+	keys.erase(it);
+}
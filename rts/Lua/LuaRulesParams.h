@@ -3,11 +3,17 @@
 #ifndef LUA_RULESPARAMS_H
 #define LUA_RULESPARAMS_H
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "System/UnorderedMap.hpp"
 #include "System/creg/creg_cond.h"
 
+namespace creg {
+	class ISerializer;
+};
+
 namespace LuaRulesParams
 {
 	enum {
@@ -35,7 +41,83 @@ namespace LuaRulesParams
 		std::string valueString;
 	};
 
-	typedef spring::unordered_map<std::string, Param> Params;
+
+	/**
+	 * Interned rules-param names. Each name maps to a small integer key that
+	 * stays valid until the game ends, so Lua can resolve names once and the
+	 * per-object params are keyed by plain ints. Keys are only ever added by
+	 * synced code, which keeps them identical on all clients.
+	 */
+	class KeyTable {
+	public:
+		static constexpr int INVALID_KEY = -1;
+
+		// returns INVALID_KEY for names that were never interned
+		int GetKey(const std::string& name) const {
+			const auto it = keys.find(name);
+
+			if (it == keys.end())
+				return INVALID_KEY;
+
+			return (it->second);
+		}
+
+		int AddKey(const std::string& name);
+
+		const std::string& GetName(int key) const { return names[key]; }
+
+		bool IsValidKey(int key) const { return (key >= 0 && key < int(names.size())); }
+
+		void Clear();
+		void Serialize(creg::ISerializer* s);
+
+	private:
+		// indexed by key
+		std::vector<std::string> names;
+		spring::unordered_map<std::string, int> keys;
+	};
+
+	extern KeyTable keyTable;
+
+
+	/**
+	 * The params of one object (unit, feature, team or the game), sorted by
+	 * key; a binary search over a few densely packed ints beats hashing the
+	 * name on every access
+	 */
+	class Params {
+		CR_DECLARE_STRUCT(Params)
+
+	public:
+		const Param* Find(int key) const {
+			const auto it = std::lower_bound(keys.begin(), keys.end(), key);
+
+			if (it == keys.end() || *it != key)
+				return nullptr;
+
+			return &values[it - keys.begin()];
+		}
+
+		const Param* Find(const std::string& name) const { return (Find(keyTable.GetKey(name))); }
+
+		// inserts a default param if none exists for <key>
+		Param& Get(int key);
+
+		void Erase(int key);
+		void Clear() {
+			keys.clear();
+			values.clear();
+		}
+
+		size_t GetSize() const { return keys.size(); }
+
+		int GetKey(size_t i) const { return keys[i]; }
+		const Param& GetParam(size_t i) const { return values[i]; }
+
+	private:
+		std::vector<int> keys;
+		std::vector<Param> values;
+	};
 }
 
 #endif // LUA_RULESPARAMS_H
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <cctype>
+#include <cstdint>
 
 #include "LuaSyncedCtrl.h"
 
@@ -1033,21 +1034,34 @@ void SetRulesParam(lua_State* L, const char* caller, int offset,
 	const int valIndex = offset + 2;
 	const int losIndex = offset + 3; // table
 
-	const std::string& key = luaL_checkstring(L, index);
+	// keys are either names (numbers stand for their string form)
+	// or the light userdata handles returned by GetRulesParamKey
+	int key = LuaRulesParams::KeyTable::INVALID_KEY;
 
-	LuaRulesParams::Param& param = params[key];
+	if (lua_islightuserdata(L, index)) {
+		key = static_cast<int>(reinterpret_cast<std::intptr_t>(lua_touserdata(L, index)));
+
+		if (!LuaRulesParams::keyTable.IsValidKey(key))
+			luaL_error(L, "Invalid rules-param key %d passed to %s()", key, caller);
+	} else {
+		key = LuaRulesParams::keyTable.AddKey(luaL_checksstring(L, index));
+	}
+
+	if (lua_isnoneornil(L, valIndex)) {
+		params.Erase(key);
+		return; //no need to set los if param was erased
+	}
+	if (!lua_isstring(L, valIndex))
+		luaL_error(L, "Incorrect arguments to %s()", caller);
+
+	LuaRulesParams::Param& param = params.Get(key);
 
 	// set the value of the parameter
 	if (lua_israwnumber(L, valIndex)) {
 		param.valueInt = lua_tofloat(L, valIndex);
 		param.valueString.resize(0);
-	} else if (lua_isstring(L, valIndex)) {
-		param.valueString = lua_tostring(L, valIndex);
-	} else if (lua_isnoneornil(L, valIndex)) {
-		params.erase(key);
-		return; //no need to set los if param was erased
 	} else {
-		luaL_error(L, "Incorrect arguments to %s()", caller);
+		param.valueString = lua_tostring(L, valIndex);
 	}
 
 	// set the los checking of the parameter
@@ -76,6 +76,8 @@
 #include "System/StringUtil.h"
 
 #include <cctype>
+#include <cstdint>
+#include <limits>
 
 
 using std::min;
@@ -112,6 +114,7 @@ bool LuaSyncedRead::PushEntries(lua_State* L)
 	REGISTER_LUA_CFUNC(GetGameFrame);
 	REGISTER_LUA_CFUNC(GetGameSeconds);
 
+	REGISTER_LUA_CFUNC(GetRulesParamKey);
 	REGISTER_LUA_CFUNC(GetGameRulesParam);
 	REGISTER_LUA_CFUNC(GetGameRulesParams);
 
@@ -168,6 +171,7 @@ bool LuaSyncedRead::PushEntries(lua_State* L)
 	REGISTER_LUA_CFUNC(GetUnitsInPlanes);
 	REGISTER_LUA_CFUNC(GetUnitsInSphere);
 	REGISTER_LUA_CFUNC(GetUnitsInCylinder);
+	REGISTER_LUA_CFUNC(GetUnitsInCylinders);
 
 	REGISTER_LUA_CFUNC(GetFeaturesInRectangle);
 	REGISTER_LUA_CFUNC(GetFeaturesInSphere);
@@ -201,6 +205,7 @@ bool LuaSyncedRead::PushEntries(lua_State* L)
 	REGISTER_LUA_CFUNC(GetUnitRadius);
 	REGISTER_LUA_CFUNC(GetUnitMass);
 	REGISTER_LUA_CFUNC(GetUnitPosition);
+	REGISTER_LUA_CFUNC(GetUnitsPositions);
 	REGISTER_LUA_CFUNC(GetUnitBasePosition);
 	REGISTER_LUA_CFUNC(GetUnitVectors);
 	REGISTER_LUA_CFUNC(GetUnitRotation);
@@ -655,13 +660,27 @@ static inline const CTeam* ParseTeam(lua_State* L, const char* caller, int index
 
 static int PushRulesParams(lua_State* L, const char* caller,
                           const LuaRulesParams::Params& params,
-                          const int losStatus)
-{
-	lua_createtable(L, 0, params.size());
+                          const int losStatus,
+                          const int tableIndex)
+{
+	if (lua_istable(L, tableIndex)) {
+		// refill a table owned by the caller, saves creating one per call
+		for (lua_pushnil(L); lua_next(L, tableIndex) != 0; ) {
+			lua_pop(L, 1);
+			lua_pushvalue(L, -1);
+			lua_pushnil(L);
+			lua_rawset(L, tableIndex);
+		}
+
+		lua_pushvalue(L, tableIndex);
+	} else {
+		lua_createtable(L, 0, params.GetSize());
+	}
+
+	for (size_t i = 0, n = params.GetSize(); i < n; i++) {
+		const std::string& name = LuaRulesParams::keyTable.GetName(params.GetKey(i));
+		const LuaRulesParams::Param& param = params.GetParam(i);
 
-	for (auto& it: params) {
-		const std::string& name = it.first;
-		const LuaRulesParams::Param& param = it.second;
 		if (!(param.los & losStatus))
 			continue;
 
@@ -680,18 +699,24 @@ static int GetRulesParam(lua_State* L, const char* caller, int index,
                           const LuaRulesParams::Params& params,
                           const int& losStatus)
 {
-	const std::string& key = luaL_checkstring(L, index);
-	const auto it = params.find(key);
-	if (it == params.end())
-		return 0;
+	// keys are either names (numbers stand for their string form)
+	// or the light userdata handles returned by GetRulesParamKey
+	const LuaRulesParams::Param* param = nullptr;
 
-	const LuaRulesParams::Param& param = it->second;
+	if (lua_islightuserdata(L, index)) {
+		param = params.Find(static_cast<int>(reinterpret_cast<std::intptr_t>(lua_touserdata(L, index))));
+	} else {
+		param = params.Find(luaL_checksstring(L, index));
+	}
 
-	if (param.los & losStatus) {
-		if (!param.valueString.empty()) {
-			lua_pushsstring(L, param.valueString);
+	if (param == nullptr)
+		return 0;
+
+	if (param->los & losStatus) {
+		if (!param->valueString.empty()) {
+			lua_pushsstring(L, param->valueString);
 		} else {
-			lua_pushnumber(L, param.valueInt);
+			lua_pushnumber(L, param->valueInt);
 		}
 		return 1;
 	}
@@ -825,10 +850,31 @@ int LuaSyncedRead::GetWind(lua_State* L)
 
 /******************************************************************************/
 
+int LuaSyncedRead::GetRulesParamKey(lua_State* L)
+{
+	const std::string& name = luaL_checksstring(L, 1);
+
+	// only synced code may intern new names, unsynced
+	// lookups would otherwise make keys differ per client
+	int key = LuaRulesParams::keyTable.GetKey(name);
+
+	if (key == LuaRulesParams::KeyTable::INVALID_KEY) {
+		if (!CLuaHandle::GetHandleSynced(L))
+			return 0;
+
+		key = LuaRulesParams::keyTable.AddKey(name);
+	}
+
+	// not a number, those keep meaning their string form
+	lua_pushlightuserdata(L, reinterpret_cast<void*>(static_cast<std::intptr_t>(key)));
+	return 1;
+}
+
+
 int LuaSyncedRead::GetGameRulesParams(lua_State* L)
 {
 	// always readable for all
-	return PushRulesParams(L, __func__, CSplitLuaHandle::GetGameParams(), LuaRulesParams::RULESPARAMLOS_PRIVATE_MASK);
+	return PushRulesParams(L, __func__, CSplitLuaHandle::GetGameParams(), LuaRulesParams::RULESPARAMLOS_PRIVATE_MASK, 1);
 }
 
 
@@ -1257,7 +1303,7 @@ int LuaSyncedRead::GetTeamRulesParams(lua_State* L)
 		losMask |= LuaRulesParams::RULESPARAMLOS_ALLIED_MASK;
 	}
 
-	return PushRulesParams(L, __func__, team->modParams, losMask);
+	return PushRulesParams(L, __func__, team->modParams, losMask, 2);
 }
 
 
@@ -2023,15 +2069,59 @@ int LuaSyncedRead::GetTeamUnitCount(lua_State* L)
 //  Spatial Unit Queries
 //
 
+// returns the stack index of the optional output table, or 0 if there is none
+static inline int ParseOutputTable(lua_State* L, int index)
+{
+	if (!lua_istable(L, index))
+		return 0;
+
+	return index;
+}
+
+// pushes the caller-supplied table at <tableIndex> so it gets refilled,
+// or a new one if no table was passed
+static inline void PushOutputTable(lua_State* L, int tableIndex, size_t sizeHint)
+{
+	if (tableIndex == 0) {
+		lua_createtable(L, sizeHint, 0);
+		return;
+	}
+
+	lua_pushvalue(L, tableIndex);
+}
+
+// drops the entries a reused table (on top of the stack) still holds
+// beyond <count> from an earlier, larger result; stops at the first nil,
+// so results must not contain holes
+static inline void ClearOutputTableTail(lua_State* L, unsigned int count)
+{
+	for (unsigned int i = count + 1; ; i++) {
+		lua_rawgeti(L, -1, i);
+
+		const bool isNil = lua_isnil(L, -1);
+
+		lua_pop(L, 1);
+
+		if (isNil)
+			break;
+
+		lua_pushnil(L);
+		lua_rawseti(L, -2, i);
+	}
+}
+
+
 // Macro Requirements:
 //   L, units
+// OUTTABLE is the output table's stack index for NEWTABLE (see
+// ParseOutputTable), otherwise the results go into the table on top
 
-#define LOOP_UNIT_CONTAINER(ALLEGIANCE_TEST, CUSTOM_TEST, NEWTABLE) \
+#define LOOP_UNIT_CONTAINER(ALLEGIANCE_TEST, CUSTOM_TEST, NEWTABLE, OUTTABLE) \
 	{                                                               \
 		unsigned int count = 0;                                     \
                                                                     \
 		if (NEWTABLE)                                               \
-			lua_createtable(L, units.size(), 0);                    \
+			PushOutputTable(L, OUTTABLE, units.size());             \
                                                                     \
 		for (const CUnit* unit: units) {                            \
 			ALLEGIANCE_TEST;                                        \
@@ -2040,6 +2130,9 @@ int LuaSyncedRead::GetTeamUnitCount(lua_State* L)
 			lua_pushnumber(L, unit->id);                            \
 			lua_rawseti(L, -2, ++count);                            \
 		}                                                           \
+                                                                    \
+		if (NEWTABLE)                                               \
+			ClearOutputTableTail(L, count);                         \
 	}
 
 // Macro Requirements:
@@ -2081,6 +2174,7 @@ int LuaSyncedRead::GetUnitsInRectangle(lua_State* L)
 	const float3 maxs(xmax, 0.0f, zmax);
 
 	const int allegiance = LuaUtils::ParseAllegiance(L, __func__, 5);
+	const int outTable = ParseOutputTable(L, 6);
 
 #define RECTANGLE_TEST ; // no test, GetUnitsExact is sufficient
 
@@ -2090,23 +2184,23 @@ int LuaSyncedRead::GetUnitsInRectangle(lua_State* L)
 
 	if (allegiance >= 0) {
 		if (LuaUtils::IsAlliedTeam(L, allegiance)) {
-			LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, RECTANGLE_TEST, true);
+			LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, RECTANGLE_TEST, true, outTable);
 		} else {
-			LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, RECTANGLE_TEST, true);
+			LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, RECTANGLE_TEST, true, outTable);
 		}
 	}
 	else if (allegiance == LuaUtils::MyUnits) {
 		const int readTeam = CLuaHandle::GetHandleReadTeam(L);
-		LOOP_UNIT_CONTAINER(MY_UNIT_TEST, RECTANGLE_TEST, true);
+		LOOP_UNIT_CONTAINER(MY_UNIT_TEST, RECTANGLE_TEST, true, outTable);
 	}
 	else if (allegiance == LuaUtils::AllyUnits) {
-		LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, RECTANGLE_TEST, true);
+		LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, RECTANGLE_TEST, true, outTable);
 	}
 	else if (allegiance == LuaUtils::EnemyUnits) {
-		LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, RECTANGLE_TEST, true);
+		LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, RECTANGLE_TEST, true, outTable);
 	}
 	else { // AllUnits
-		LOOP_UNIT_CONTAINER(VISIBLE_TEST, RECTANGLE_TEST, true);
+		LOOP_UNIT_CONTAINER(VISIBLE_TEST, RECTANGLE_TEST, true, outTable);
 	}
 
 	return 1;
@@ -2126,6 +2220,7 @@ int LuaSyncedRead::GetUnitsInBox(lua_State* L)
 	const float3 maxs(xmax, 0.0f, zmax);
 
 	const int allegiance = LuaUtils::ParseAllegiance(L, __func__, 7);
+	const int outTable = ParseOutputTable(L, 8);
 
 #define BOX_TEST                  \
 	const float y = unit->midPos.y; \
@@ -2139,23 +2234,23 @@ int LuaSyncedRead::GetUnitsInBox(lua_State* L)
 
 	if (allegiance >= 0) {
 		if (LuaUtils::IsAlliedTeam(L, allegiance)) {
-			LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, BOX_TEST, true);
+			LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, BOX_TEST, true, outTable);
 		} else {
-			LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, BOX_TEST, true);
+			LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, BOX_TEST, true, outTable);
 		}
 	}
 	else if (allegiance == LuaUtils::MyUnits) {
 		const int readTeam = CLuaHandle::GetHandleReadTeam(L);
-		LOOP_UNIT_CONTAINER(MY_UNIT_TEST, BOX_TEST, true);
+		LOOP_UNIT_CONTAINER(MY_UNIT_TEST, BOX_TEST, true, outTable);
 	}
 	else if (allegiance == LuaUtils::AllyUnits) {
-		LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, BOX_TEST, true);
+		LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, BOX_TEST, true, outTable);
 	}
 	else if (allegiance == LuaUtils::EnemyUnits) {
-		LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, BOX_TEST, true);
+		LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, BOX_TEST, true, outTable);
 	}
 	else { // AllUnits
-		LOOP_UNIT_CONTAINER(VISIBLE_TEST, BOX_TEST, true);
+		LOOP_UNIT_CONTAINER(VISIBLE_TEST, BOX_TEST, true, outTable);
 	}
 
 	return 1;
@@ -2173,6 +2268,7 @@ int LuaSyncedRead::GetUnitsInCylinder(lua_State* L)
 	const float3 maxs(x + radius, 0.0f, z + radius);
 
 	const int allegiance = LuaUtils::ParseAllegiance(L, __func__, 4);
+	const int outTable = ParseOutputTable(L, 5);
 
 #define CYLINDER_TEST                         \
 	const float3& p = unit->midPos;             \
@@ -2189,23 +2285,23 @@ int LuaSyncedRead::GetUnitsInCylinder(lua_State* L)
 
 	if (allegiance >= 0) {
 		if (LuaUtils::IsAlliedTeam(L, allegiance)) {
-			LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, CYLINDER_TEST, true);
+			LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, CYLINDER_TEST, true, outTable);
 		} else {
-			LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, CYLINDER_TEST, true);
+			LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, CYLINDER_TEST, true, outTable);
 		}
 	}
 	else if (allegiance == LuaUtils::MyUnits) {
 		const int readTeam = CLuaHandle::GetHandleReadTeam(L);
-		LOOP_UNIT_CONTAINER(MY_UNIT_TEST, CYLINDER_TEST, true);
+		LOOP_UNIT_CONTAINER(MY_UNIT_TEST, CYLINDER_TEST, true, outTable);
 	}
 	else if (allegiance == LuaUtils::AllyUnits) {
-		LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, CYLINDER_TEST, true);
+		LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, CYLINDER_TEST, true, outTable);
 	}
 	else if (allegiance == LuaUtils::EnemyUnits) {
-		LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, CYLINDER_TEST, true);
+		LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, CYLINDER_TEST, true, outTable);
 	}
 	else { // AllUnits
-		LOOP_UNIT_CONTAINER(VISIBLE_TEST, CYLINDER_TEST, true);
+		LOOP_UNIT_CONTAINER(VISIBLE_TEST, CYLINDER_TEST, true, outTable);
 	}
 
 	return 1;
@@ -2225,6 +2321,7 @@ int LuaSyncedRead::GetUnitsInSphere(lua_State* L)
 	const float3 maxs(x + radius, 0.0f, z + radius);
 
 	const int allegiance = LuaUtils::ParseAllegiance(L, __func__, 5);
+	const int outTable = ParseOutputTable(L, 6);
 
 #define SPHERE_TEST                           \
 	const float3& p = unit->midPos;             \
@@ -2243,29 +2340,134 @@ int LuaSyncedRead::GetUnitsInSphere(lua_State* L)
 
 	if (allegiance >= 0) {
 		if (LuaUtils::IsAlliedTeam(L, allegiance)) {
-			LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, SPHERE_TEST, true);
+			LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, SPHERE_TEST, true, outTable);
 		} else {
-			LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, SPHERE_TEST, true);
+			LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, SPHERE_TEST, true, outTable);
 		}
 	}
 	else if (allegiance == LuaUtils::MyUnits) {
 		const int readTeam = CLuaHandle::GetHandleReadTeam(L);
-		LOOP_UNIT_CONTAINER(MY_UNIT_TEST, SPHERE_TEST, true);
+		LOOP_UNIT_CONTAINER(MY_UNIT_TEST, SPHERE_TEST, true, outTable);
 	}
 	else if (allegiance == LuaUtils::AllyUnits) {
-		LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, SPHERE_TEST, true);
+		LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, SPHERE_TEST, true, outTable);
 	}
 	else if (allegiance == LuaUtils::EnemyUnits) {
-		LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, SPHERE_TEST, true);
+		LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, SPHERE_TEST, true, outTable);
 	}
 	else { // AllUnits
-		LOOP_UNIT_CONTAINER(VISIBLE_TEST, SPHERE_TEST, true);
+		LOOP_UNIT_CONTAINER(VISIBLE_TEST, SPHERE_TEST, true, outTable);
 	}
 
 	return 1;
 }
 
 
+int LuaSyncedRead::GetUnitsInCylinders(lua_State* L)
+{
+	luaL_checktype(L, 1, LUA_TTABLE);
+
+	// flat {x1, z1, radius1, x2, z2, radius2, ...}
+	const int numCircles = lua_objlen(L, 1) / 3;
+
+	const int allegiance = LuaUtils::ParseAllegiance(L, __func__, 2);
+	const int readTeam = CLuaHandle::GetHandleReadTeam(L);
+
+	float3 mins = { std::numeric_limits<float>::max(), 0.0f, std::numeric_limits<float>::max()};
+	float3 maxs = {-std::numeric_limits<float>::max(), 0.0f, -std::numeric_limits<float>::max()};
+
+	const auto ParseCircle = [&](int i, float& x, float& z, float& radius) {
+		lua_rawgeti(L, 1, i * 3 + 1);
+		lua_rawgeti(L, 1, i * 3 + 2);
+		lua_rawgeti(L, 1, i * 3 + 3);
+		x      = luaL_checkfloat(L, -3);
+		z      = luaL_checkfloat(L, -2);
+		radius = luaL_checkfloat(L, -1);
+		lua_pop(L, 3);
+	};
+
+	float circlesArea = 0.0f;
+
+	for (int i = 0; i < numCircles; i++) {
+		float x, z, radius;
+		ParseCircle(i, x, z, radius);
+
+		mins.x = std::min(mins.x, x - radius);
+		mins.z = std::min(mins.z, z - radius);
+		maxs.x = std::max(maxs.x, x + radius);
+		maxs.z = std::max(maxs.z, z + radius);
+
+		circlesArea += (4.0f * radius * radius);
+	}
+
+	// circles close together share a single quadfield query over their bounding
+	// box; every circle tests every unit in it, so spread out circles (whose box
+	// is mostly empty space) are better served by one query each
+	const bool sharedQuery = (numCircles > 0 && ((maxs.x - mins.x) * (maxs.z - mins.z)) <= (circlesArea * 2.0f));
+
+	QuadFieldQuery qfQuery;
+
+	if (sharedQuery)
+		quadField.GetUnitsExact(qfQuery, mins, maxs);
+
+	// one table of unitIDs per circle; those of a reused table are refilled
+	PushOutputTable(L, ParseOutputTable(L, 3), numCircles);
+
+	const int resultTable = lua_gettop(L);
+
+	for (int i = 0; i < numCircles; i++) {
+		float x, z, radius;
+		ParseCircle(i, x, z, radius);
+
+		const float radSqr = (radius * radius);
+
+		lua_rawgeti(L, resultTable, i + 1);
+
+		if (!lua_istable(L, -1)) {
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_pushvalue(L, -1);
+			lua_rawseti(L, resultTable, i + 1);
+		}
+
+		const int outTable = lua_gettop(L);
+
+		QuadFieldQuery circleQuery;
+
+		if (!sharedQuery)
+			quadField.GetUnitsExact(circleQuery, float3(x - radius, 0.0f, z - radius), float3(x + radius, 0.0f, z + radius));
+
+		const auto& units = sharedQuery? (*qfQuery.units): (*circleQuery.units);
+
+		if (allegiance >= 0) {
+			if (LuaUtils::IsAlliedTeam(L, allegiance)) {
+				LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, CYLINDER_TEST, true, outTable);
+			} else {
+				LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, CYLINDER_TEST, true, outTable);
+			}
+		}
+		else if (allegiance == LuaUtils::MyUnits) {
+			LOOP_UNIT_CONTAINER(MY_UNIT_TEST, CYLINDER_TEST, true, outTable);
+		}
+		else if (allegiance == LuaUtils::AllyUnits) {
+			LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, CYLINDER_TEST, true, outTable);
+		}
+		else if (allegiance == LuaUtils::EnemyUnits) {
+			LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, CYLINDER_TEST, true, outTable);
+		}
+		else { // AllUnits
+			LOOP_UNIT_CONTAINER(VISIBLE_TEST, CYLINDER_TEST, true, outTable);
+		}
+
+		// the refilled table and its copy
+		lua_pop(L, 2);
+	}
+
+	ClearOutputTableTail(L, numCircles);
+	return 1;
+}
+
+
 struct Plane {
 	float x, y, z, d;  // ax + by + cz + d = 0
 };
@@ -2328,6 +2530,7 @@ int LuaSyncedRead::GetUnitsInPlanes(lua_State* L)
 
 	const int readTeam = CLuaHandle::GetHandleReadTeam(L);
 
+	// the result table is created here, not per team by the loops
 	lua_newtable(L);
 
 	for (int team = startTeam; team <= endTeam; team++) {
@@ -2336,32 +2539,32 @@ int LuaSyncedRead::GetUnitsInPlanes(lua_State* L)
 		if (allegiance >= 0) {
 			if (allegiance == team) {
 				if (LuaUtils::IsAlliedTeam(L, allegiance)) {
-					LOOP_UNIT_CONTAINER(NULL_TEST, PLANES_TEST, false);
+					LOOP_UNIT_CONTAINER(NULL_TEST, PLANES_TEST, false, 0);
 				} else {
-					LOOP_UNIT_CONTAINER(VISIBLE_TEST, PLANES_TEST, false);
+					LOOP_UNIT_CONTAINER(VISIBLE_TEST, PLANES_TEST, false, 0);
 				}
 			}
 		}
 		else if (allegiance == LuaUtils::MyUnits) {
 			if (readTeam == team) {
-				LOOP_UNIT_CONTAINER(NULL_TEST, PLANES_TEST, false);
+				LOOP_UNIT_CONTAINER(NULL_TEST, PLANES_TEST, false, 0);
 			}
 		}
 		else if (allegiance == LuaUtils::AllyUnits) {
 			if (CLuaHandle::GetHandleReadAllyTeam(L) == teamHandler.AllyTeam(team)) {
-				LOOP_UNIT_CONTAINER(NULL_TEST, PLANES_TEST, false);
+				LOOP_UNIT_CONTAINER(NULL_TEST, PLANES_TEST, false, 0);
 			}
 		}
 		else if (allegiance == LuaUtils::EnemyUnits) {
 			if (CLuaHandle::GetHandleReadAllyTeam(L) != teamHandler.AllyTeam(team)) {
-				LOOP_UNIT_CONTAINER(VISIBLE_TEST, PLANES_TEST, false);
+				LOOP_UNIT_CONTAINER(VISIBLE_TEST, PLANES_TEST, false, 0);
 			}
 		}
 		else { // AllUnits
 			if (LuaUtils::IsAlliedTeam(L, team)) {
-				LOOP_UNIT_CONTAINER(NULL_TEST, PLANES_TEST, false);
+				LOOP_UNIT_CONTAINER(NULL_TEST, PLANES_TEST, false, 0);
 			} else {
-				LOOP_UNIT_CONTAINER(VISIBLE_TEST, PLANES_TEST, false);
+				LOOP_UNIT_CONTAINER(VISIBLE_TEST, PLANES_TEST, false, 0);
 			}
 		}
 	}
@@ -2989,6 +3192,49 @@ int LuaSyncedRead::GetUnitBasePosition(lua_State* L)
 	return (GetUnitPosition(L));
 }
 
+int LuaSyncedRead::GetUnitsPositions(lua_State* L)
+{
+	luaL_checktype(L, 1, LUA_TTABLE);
+
+	const int numUnits = lua_objlen(L, 1);
+	const int readAllyTeam = CLuaHandle::GetHandleReadAllyTeam(L);
+	const bool fullRead = CLuaHandle::GetHandleFullRead(L);
+
+	// flat {x1, y1, z1, x2, y2, z2, ...} in the order of the given unitIDs;
+	// the entries of dead or invisible units are false (not nil, so neither
+	// the length operator nor ClearOutputTableTail stop at them)
+	PushOutputTable(L, ParseOutputTable(L, 2), numUnits * 3);
+
+	for (int i = 0; i < numUnits; i++) {
+		lua_rawgeti(L, 1, i + 1);
+
+		const CUnit* unit = lua_isnumber(L, -1)? unitHandler.GetUnit(lua_toint(L, -1)): nullptr;
+
+		lua_pop(L, 1);
+
+		if (unit == nullptr || !LuaUtils::IsUnitVisible(L, unit)) {
+			for (int j = 1; j <= 3; j++) {
+				lua_pushboolean(L, false);
+				lua_rawseti(L, -2, i * 3 + j);
+			}
+
+			continue;
+		}
+
+		float3 errorVec;
+
+		if (!LuaUtils::IsAllyUnit(L, unit))
+			errorVec = unit->GetLuaErrorVector(readAllyTeam, fullRead);
+
+		lua_pushnumber(L, unit->pos.x + errorVec.x); lua_rawseti(L, -2, i * 3 + 1);
+		lua_pushnumber(L, unit->pos.y + errorVec.y); lua_rawseti(L, -2, i * 3 + 2);
+		lua_pushnumber(L, unit->pos.z + errorVec.z); lua_rawseti(L, -2, i * 3 + 3);
+	}
+
+	ClearOutputTableTail(L, numUnits * 3);
+	return 1;
+}
+
 int LuaSyncedRead::GetUnitVectors(lua_State* L)
 {
 	const CUnit* unit = ParseInLosUnit(L, __func__, 1);
@@ -4467,7 +4713,7 @@ int LuaSyncedRead::GetUnitRulesParams(lua_State* L)
 	if (unit == nullptr || game == nullptr)
 		return 0;
 
-	return PushRulesParams(L, __func__, unit->modParams, GetUnitRulesParamLosMask(L, unit));
+	return PushRulesParams(L, __func__, unit->modParams, GetUnitRulesParamLosMask(L, unit), 2);
 }
 
 
@@ -4814,7 +5060,7 @@ int LuaSyncedRead::GetFeatureRulesParams(lua_State* L)
 
 	const LuaRulesParams::Params&  params = feature->modParams;
 
-	return PushRulesParams(L, __func__, params, losMask);
+	return PushRulesParams(L, __func__, params, losMask, 2);
 }
 
 
@@ -35,6 +35,7 @@ class LuaSyncedRead {
 		static int GetGameFrame(lua_State* L);
 		static int GetGameSeconds(lua_State* L);
 
+		static int GetRulesParamKey(lua_State* L);
 		static int GetGameRulesParam(lua_State* L);
 		static int GetGameRulesParams(lua_State* L);
 
@@ -84,6 +85,7 @@ class LuaSyncedRead {
 		static int GetUnitsInPlanes(lua_State* L);
 		static int GetUnitsInSphere(lua_State* L);
 		static int GetUnitsInCylinder(lua_State* L);
+		static int GetUnitsInCylinders(lua_State* L);
 
 		static int GetUnitNearestAlly(lua_State* L);
 		static int GetUnitNearestEnemy(lua_State* L);
@@ -117,6 +119,7 @@ class LuaSyncedRead {
 		static int GetUnitRadius(lua_State* L);
 		static int GetUnitMass(lua_State* L);
 		static int GetUnitPosition(lua_State* L);
+		static int GetUnitsPositions(lua_State* L);
 		static int GetUnitBasePosition(lua_State* L);
 		static int GetUnitVectors(lua_State* L);
 		static int GetUnitRotation(lua_State* L);
@@ -2,6 +2,7 @@
 
 
 #include "Ground.h"
+#include "HeightBoundsPyramid.h"
 #include "ReadMap.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/GlobalSynced.h"
@@ -187,9 +188,135 @@ void CGround::CheckColSquare(CProjectile* p, int x, int y)
 }
 */
 
-inline static bool ClampInMapHeight(float3& from, float3& to)
+/**
+ * Tells LineGroundCol which heightmap squares it can pass over without testing
+ * their faces, because the (infinite) line clears every cell of the bounds-pyramid
+ * containing them by more than LineGroundSquareCol's rounding could ever make up
+ * for; it visits the same squares in the same order, so results are unchanged
+ */
+struct GroundSquareSkipper {
+public:
+	GroundSquareSkipper(const CHeightBoundsPyramid* _hbp, const float3& from, const float3& to)
+		: hbp(_hbp)
+		, pos(from)
+		, dir(to - from)
+	{
+		if (hbp == nullptr || hbp->IsEmpty() || (dir.x == 0.0f && dir.z == 0.0f)) {
+			hbp = nullptr;
+			return;
+		}
+
+		invDirX = (dir.x != 0.0f)? (1.0f / dir.x): 0.0f;
+		invDirZ = (dir.z != 0.0f)? (1.0f / dir.z): 0.0f;
+	}
+
+	bool CanSkip(int x, int z) {
+		if (hbp == nullptr)
+			return false;
+
+		if (skipRect.Inside({x, z}))
+			return true;
+		if (testRect.Inside({x, z}))
+			return false;
+
+		if (x < 0 || z < 0)
+			return false;
+
+		int level = 0;
+		int cx = x >> CHeightBoundsPyramid::BASE_LEVEL;
+		int cz = z >> CHeightBoundsPyramid::BASE_LEVEL;
+
+		if (cx >= hbp->GetLevelSize(0).x || cz >= hbp->GetLevelSize(0).y)
+			return false;
+
+		if (!IsCellClear(level, cx, cz)) {
+			testRect = GetCellRect(level, cx, cz);
+			return false;
+		}
+
+		// take the largest cell that is still clear
+		while ((level + 1) < hbp->GetNumLevels() && IsCellClear(level + 1, cx >> 1, cz >> 1)) {
+			level += 1;
+			cx >>= 1;
+			cz >>= 1;
+		}
+
+		skipRect = GetCellRect(level, cx, cz);
+		return true;
+	}
+
+private:
+	SRectangle GetCellRect(int level, int cx, int cz) const {
+		const int cellSize = hbp->GetCellSize(level);
+		return {cx * cellSize, cz * cellSize, (cx + 1) * cellSize, (cz + 1) * cellSize};
+	}
+
+	bool IsCellClear(int level, int cx, int cz) const {
+		// clearance over the cell's highest corner, in elmos; rounding in the
+		// face-tests grows as normals flatten (cliffs), this covers even those
+		constexpr float CLEARANCE = SQUARE_SIZE;
+		// cell-borders are widened a bit, the traversal can touch squares the
+		// exact line only grazes
+		constexpr float BORDER = 1.0f;
+
+		const float cellSize = hbp->GetCellSize(level) * SQUARE_SIZE;
+
+		const float x1 = cx * cellSize - BORDER;
+		const float z1 = cz * cellSize - BORDER;
+		const float x2 = x1 + cellSize + BORDER * 2.0f;
+		const float z2 = z1 + cellSize + BORDER * 2.0f;
+
+		// parameter-range of the line over the cell
+		float t1 = std::numeric_limits<float>::lowest();
+		float t2 = std::numeric_limits<float>::max();
+
+		if (dir.x != 0.0f) {
+			const float ta = (x1 - pos.x) * invDirX;
+			const float tb = (x2 - pos.x) * invDirX;
+
+			t1 = std::max(t1, std::min(ta, tb));
+			t2 = std::min(t2, std::max(ta, tb));
+		} else if (pos.x < x1 || pos.x > x2) {
+			return false;
+		}
+
+		if (dir.z != 0.0f) {
+			const float ta = (z1 - pos.z) * invDirZ;
+			const float tb = (z2 - pos.z) * invDirZ;
+
+			t1 = std::max(t1, std::min(ta, tb));
+			t2 = std::min(t2, std::max(ta, tb));
+		} else if (pos.z < z1 || pos.z > z2) {
+			return false;
+		}
+
+		if (t1 > t2)
+			return false;
+
+		const float minLineHeight = std::min(pos.y + dir.y * t1, pos.y + dir.y * t2);
+		const float maxCellHeight = hbp->GetBounds(level, cx, cz).y;
+
+		return (minLineHeight > (maxCellHeight + CLEARANCE));
+	}
+
+private:
+	const CHeightBoundsPyramid* hbp = nullptr;
+
+	float3 pos;
+	float3 dir;
+
+	float invDirX = 0.0f;
+	float invDirZ = 0.0f;
+
+	// squares (half-open) known to be clear resp. not
+	SRectangle skipRect;
+	SRectangle testRect;
+};
+
+
+inline static bool ClampInMapHeight(float3& from, float3& to, float maxHeight)
 {
-	const float heightAboveMapMax = from.y - readMap->GetCurrMaxHeight();
+	const float heightAboveMapMax = from.y - maxHeight;
 
 	if (heightAboveMapMax <= 0.0f)
 		return false;
@@ -213,11 +340,19 @@ float CGround::LineGroundCol(float3 from, float3 to, bool synced)
 	const float* hm  = readMap->GetSharedCornerHeightMap(synced);
 	const float3* nm = readMap->GetSharedFaceNormals(synced);
 
+	// the pyramid follows the synced heightmap only
+	const CHeightBoundsPyramid* hbp = synced? &readMap->GetHeightBoundsPyramidSynced(): nullptr;
+
+	return (LineGroundCol(from, to, hm, nm, hbp, readMap->GetCurrMaxHeight(), synced));
+}
+
+float CGround::LineGroundCol(float3 from, float3 to, const float* hm, const float3* nm, const CHeightBoundsPyramid* hbp, float maxHeight, bool synced)
+{
 	const float3 pfrom = from;
 
 	// only for performance -> skip part that can impossibly collide
 	// with the terrain, cause it is above map's current max height
-	ClampInMapHeight(from, to);
+	ClampInMapHeight(from, to, maxHeight);
 
 	// handle special cases where the ray origin is out of bounds:
 	// need to move <from> to the closest map-edge along the ray
@@ -261,6 +396,8 @@ float CGround::LineGroundCol(float3 from, float3 to, bool synced)
 
 	bool stopTrace = false;
 
+	GroundSquareSkipper squareSkipper(hbp, from, to);
+
 	if ((fsx == tsx) && (fsz == tsz)) {
 		// <from> and <to> are the same
 		const float ret = LineGroundSquareCol(hm, nm,  from, to,  fsx, fsz);
@@ -276,10 +413,12 @@ float CGround::LineGroundCol(float3 from, float3 to, bool synced)
 		int zp = fsz;
 
 		for (unsigned int i = 0, n = Square(mapDims.mapyp1); (Square(i) <= n && zp != tsz); i++) {
-			const float ret = LineGroundSquareCol(hm, nm,  from, to,  fsx, zp);
+			if (!squareSkipper.CanSkip(fsx, zp)) {
+				const float ret = LineGroundSquareCol(hm, nm,  from, to,  fsx, zp);
 
-			if (ret >= 0.0f)
-				return (ret + skippedDist);
+				if (ret >= 0.0f)
+					return (ret + skippedDist);
+			}
 
 			zp += dirz;
 		}
@@ -292,10 +431,12 @@ float CGround::LineGroundCol(float3 from, float3 to, bool synced)
 		int xp = fsx;
 
 		for (unsigned int i = 0, n = Square(mapDims.mapxp1); (Square(i) <= n && xp != tsx); i++) {
-			const float ret = LineGroundSquareCol(hm, nm,  from, to,  xp, fsz);
+			if (!squareSkipper.CanSkip(xp, fsz)) {
+				const float ret = LineGroundSquareCol(hm, nm,  from, to,  xp, fsz);
 
-			if (ret >= 0.0f)
-				return (ret + skippedDist);
+				if (ret >= 0.0f)
+					return (ret + skippedDist);
+			}
 
 			xp += dirx;
 		}
@@ -330,10 +471,12 @@ float CGround::LineGroundCol(float3 from, float3 to, bool synced)
 
 		for (unsigned int i = 0, n = Square(mapDims.mapxp1) + Square(mapDims.mapyp1); !stopTrace; i++) {
 			// test for collision with the ground-square triangles
-			const float ret = LineGroundSquareCol(hm, nm,  from, to,  curx, curz);
+			if (!squareSkipper.CanSkip(curx, curz)) {
+				const float ret = LineGroundSquareCol(hm, nm,  from, to,  curx, curz);
 
-			if (ret >= 0.0f)
-				return (ret + skippedDist);
+				if (ret >= 0.0f)
+					return (ret + skippedDist);
+			}
 
 			// check if we reached the end already and need to stop the loop
 			const bool endReached = ((curx == tsx && curz == tsz) || (Square(i) > n));
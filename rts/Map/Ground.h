@@ -6,6 +6,7 @@
 #include "System/float3.h"
 #include "System/type2.h"
 
+class CHeightBoundsPyramid;
 
 class CGround
 {
@@ -36,6 +37,8 @@ public:
 
 
 	static float LineGroundCol(float3 from, float3 to, bool synced = true);
+	/// as above, on explicit heightmap data; <hbp> is optional and must match <hm>
+	static float LineGroundCol(float3 from, float3 to, const float* hm, const float3* nm, const CHeightBoundsPyramid* hbp, float maxHeight, bool synced);
 	static float LineGroundCol(const float3 pos, const float3 dir, float len, bool synced = true);
 	static float LinePlaneCol(const float3 pos, const float3 dir, float len, float hgt);
 	static float LineGroundWaterCol(const float3 pos, const float3 dir, float len, bool testWater, bool synced = true);
@@ -0,0 +1,116 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "HeightBoundsPyramid.h"
+
+#include <algorithm>
+#include <limits>
+
+
+void CHeightBoundsPyramid::Init(const int2 _mapSize)
+{
+	mapSize = _mapSize;
+
+	levelSizes.clear();
+	levelBounds.clear();
+
+	for (int level = 0; ; level++) {
+		const int cellSize = GetCellSize(level);
+		const int2 levelSize = {(mapSize.x + cellSize - 1) / cellSize, (mapSize.y + cellSize - 1) / cellSize};
+
+		levelSizes.push_back(levelSize);
+		// unbounded until the first Update, so a cell that is never updated is never skipped
+		levelBounds.emplace_back(levelSize.x * levelSize.y, float2(-std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity()));
+
+		if (levelSize.x <= 1 && levelSize.y <= 1)
+			break;
+	}
+}
+
+void CHeightBoundsPyramid::Kill()
+{
+	levelSizes.clear();
+	levelBounds.clear();
+}
+
+
+void CHeightBoundsPyramid::Update(const float* cornerHeightMap, const SRectangle& rect)
+{
+	if (IsEmpty())
+		return;
+
+	SRectangle cellRect = {
+		std::max(rect.x1, 0) >> BASE_LEVEL,
+		std::max(rect.z1, 0) >> BASE_LEVEL,
+		std::min(rect.x2, mapSize.x - 1) >> BASE_LEVEL,
+		std::min(rect.z2, mapSize.y - 1) >> BASE_LEVEL,
+	};
+
+	UpdateBaseLevel(cornerHeightMap, cellRect);
+
+	for (int level = 1; level < GetNumLevels(); level++) {
+		cellRect.x1 >>= 1;
+		cellRect.z1 >>= 1;
+		cellRect.x2 >>= 1;
+		cellRect.z2 >>= 1;
+
+		UpdateLevel(level, cellRect);
+	}
+}
+
+
+void CHeightBoundsPyramid::UpdateBaseLevel(const float* cornerHeightMap, const SRectangle& cellRect)
+{
+	const int cellSize = GetCellSize(0);
+	const int cornerMapX = mapSize.x + 1;
+
+	std::vector<float2>& bounds = levelBounds[0];
+
+	for (int cz = cellRect.z1; cz <= cellRect.z2; cz++) {
+		for (int cx = cellRect.x1; cx <= cellRect.x2; cx++) {
+			// corners of all squares in this cell, including the far edges
+			const int x1 = cx * cellSize;
+			const int z1 = cz * cellSize;
+			const int x2 = std::min(x1 + cellSize, mapSize.x);
+			const int z2 = std::min(z1 + cellSize, mapSize.y);
+
+			float2 cellBounds = {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+
+			for (int z = z1; z <= z2; z++) {
+				for (int x = x1; x <= x2; x++) {
+					const float h = cornerHeightMap[z * cornerMapX + x];
+
+					cellBounds.x = std::min(cellBounds.x, h);
+					cellBounds.y = std::max(cellBounds.y, h);
+				}
+			}
+
+			bounds[cz * levelSizes[0].x + cx] = cellBounds;
+		}
+	}
+}
+
+void CHeightBoundsPyramid::UpdateLevel(int level, const SRectangle& cellRect)
+{
+	const int2& subSize = levelSizes[level - 1];
+	const int2& curSize = levelSizes[level];
+
+	const std::vector<float2>& subBounds = levelBounds[level - 1];
+	      std::vector<float2>& curBounds = levelBounds[level    ];
+
+	for (int cz = cellRect.z1; cz <= cellRect.z2; cz++) {
+		for (int cx = cellRect.x1; cx <= cellRect.x2; cx++) {
+			float2 cellBounds = {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+
+			for (int z = cz * 2, ez = std::min(z + 2, subSize.y); z < ez; z++) {
+				for (int x = cx * 2, ex = std::min(x + 2, subSize.x); x < ex; x++) {
+					const float2& b = subBounds[z * subSize.x + x];
+
+					cellBounds.x = std::min(cellBounds.x, b.x);
+					cellBounds.y = std::max(cellBounds.y, b.y);
+				}
+			}
+
+			curBounds[cz * curSize.x + cx] = cellBounds;
+		}
+	}
+}
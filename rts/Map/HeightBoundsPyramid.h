@@ -0,0 +1,52 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef HEIGHT_BOUNDS_PYRAMID_H
+#define HEIGHT_BOUNDS_PYRAMID_H
+
+#include <vector>
+
+#include "System/type2.h"
+#include "System/Rectangle.h"
+
+
+/**
+ * Min/max heights of the corner heightmap over square blocks of
+ * heightmap squares, at successively halved resolutions.
+ *
+ * Level 0 holds the bounds of (1 << BASE_LEVEL)^2 squares per cell,
+ * every next level those of 2x2 cells of the one below it, up to a
+ * single cell for the whole map. Used to let ray-ground tests skip
+ * parts of the map a ray passes over at a safe distance.
+ */
+class CHeightBoundsPyramid
+{
+public:
+	static constexpr int BASE_LEVEL = 2;
+
+	void Init(const int2 mapSize);
+	void Kill();
+
+	/// recomputes all cells overlapping the (inclusive) square-rectangle <rect>
+	void Update(const float* cornerHeightMap, const SRectangle& rect);
+
+	int GetNumLevels() const { return (levelSizes.size()); }
+	int GetCellSize(int level) const { return (1 << (BASE_LEVEL + level)); }
+
+	const int2& GetLevelSize(int level) const { return levelSizes[level]; }
+	const float2& GetBounds(int level, int x, int z) const { return levelBounds[level][z * levelSizes[level].x + x]; }
+
+	bool IsEmpty() const { return levelSizes.empty(); }
+
+private:
+	void UpdateBaseLevel(const float* cornerHeightMap, const SRectangle& cellRect);
+	void UpdateLevel(int level, const SRectangle& cellRect);
+
+private:
+	int2 mapSize;
+
+	std::vector<int2> levelSizes;
+	/// x := min, y := max
+	std::vector< std::vector<float2> > levelBounds;
+};
+
+#endif
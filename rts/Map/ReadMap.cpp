@@ -83,6 +83,7 @@ CR_REG_METADATA(CReadMap, (
 	CR_IGNORED(centerNormalsSynced),
 	CR_IGNORED(centerNormalsUnsynced),
 	CR_IGNORED(centerNormals2D),
+	CR_IGNORED(heightBoundsPyramid),
 	CR_IGNORED(slopeMap),
 	CR_IGNORED(typeMap),
 	*/
@@ -128,6 +129,8 @@ std::vector<float> CReadMap::slopeMap;
 std::vector<uint8_t> CReadMap::typeMap;
 std::vector<float3> CReadMap::centerNormals2D;
 
+CHeightBoundsPyramid CReadMap::heightBoundsPyramid;
+
 #ifdef USE_UNSYNCED_HEIGHTMAP
 std::vector<uint8_t> CReadMap::  syncedHeightMapDigests;
 std::vector<uint8_t> CReadMap::unsyncedHeightMapDigests;
@@ -287,6 +290,8 @@ void CReadMap::PostLoad()
 		mipPointerHeightMaps[i] = &mipCenterHeightMaps[i - 1][0];
 	}
 
+	heightBoundsPyramid.Init({mapDims.mapx, mapDims.mapy});
+
 	hmUpdated = true;
 
 	mapDamage->RecalcArea(0, mapDims.mapx, 0, mapDims.mapy);
@@ -366,6 +371,8 @@ void CReadMap::Initialize()
 	slopeMap.clear();
 	slopeMap.resize(mapDims.hmapx * mapDims.hmapy);
 
+	heightBoundsPyramid.Init({mapDims.mapx, mapDims.mapy});
+
 	// by default, all squares are set to terrain-type 0
 	typeMap.clear();
 	typeMap.resize(mapDims.hmapx * mapDims.hmapy, 0);
@@ -524,6 +531,8 @@ void CReadMap::UpdateHeightMapSynced(const SRectangle& hgtMapRect, bool initiali
 	UpdateFaceNormals(centerRect, initialize);
 	UpdateSlopemap(centerRect, initialize); // must happen after UpdateFaceNormals()!
 
+	heightBoundsPyramid.Update(GetCornerHeightMapSynced(), centerRect);
+
 	#ifdef USE_UNSYNCED_HEIGHTMAP
 	// push the unsynced update; initial one without LOS check
 	if (initialize) {
@@ -6,6 +6,7 @@
 #include <array>
 #include <vector>
 
+#include "HeightBoundsPyramid.h"
 #include "MapTexture.h"
 #include "MapDimensions.h"
 #include "Sim/Misc/GlobalConstants.h"
@@ -172,6 +173,7 @@ public:
 	const uint8_t* GetTypeMapSynced() const { return &typeMap[0]; }
 	      uint8_t* GetTypeMapSynced()       { return &typeMap[0]; }
 	const float3* GetCenterNormals2DSynced()  const { return &centerNormals2D[0]; }
+	const CHeightBoundsPyramid& GetHeightBoundsPyramidSynced() const { return heightBoundsPyramid; }
 
 	/// unsynced only
 	const float3* GetVisVertexNormalsUnsynced() const { return &visVertexNormals[0]; }
@@ -274,6 +276,8 @@ protected:
 	static std::vector<uint8_t> typeMap;
 	static std::vector<float3> centerNormals2D;
 
+	static CHeightBoundsPyramid heightBoundsPyramid;  //< min/max corner-heights over blocks of squares [SYNCED, updates on terrain deformation]
+
 
 	CRectangleOverlapHandler unsyncedHeightMapUpdates;
 private:
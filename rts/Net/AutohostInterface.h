@@ -56,6 +56,8 @@ public:
 	 */
 	std::string GetChatMessage();
 
+	asio::ip::udp::socket* GetSocket() { return &autohost; }
+
 private:
 	void Send(asio::mutable_buffers_1 sendBuffer);
 
@@ -61,6 +61,8 @@ void GameParticipant::Kill(const std::string& reason, const bool flush)
 	syncResponse.clear();
 #endif
 
+	cacheSegment = -1;
+
 	myState = (disconnected) ? DISCONNECTED : DISCONNECTING;
 }
 
@@ -48,6 +48,9 @@ public:
 	bool isReconn = false;
 	bool isMidgameJoin = false;
 
+	/// next packet-cache segment to send while catching up after joining, -1 if not catching up
+	int cacheSegment = -1;
+
 	PlayerStatistics lastStats;
 
 	spring_time disconnectDelay;
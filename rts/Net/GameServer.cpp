@@ -1,6 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "System/Net/UDPListener.h"
+#include "System/Net/EventWaiter.h"
 #include "System/Net/UDPConnection.h"
 
 #include <functional>
@@ -67,7 +68,10 @@ using netcode::RawPacket;
 
 
 CONFIG(int, AutohostPort).defaultValue(0);
-CONFIG(int, ServerSleepTime).defaultValue(5).description("number of milliseconds to sleep per tick");
+CONFIG(int, ServerSleepTime).defaultValue(5).description("number of milliseconds to sleep per tick, if ServerEventDrivenLoop is disabled");
+CONFIG(bool, ServerSpillPacketCache).defaultValue(false).description("Keep the compressed packets replayed to rejoining players in a temporary file instead of memory.");
+CONFIG(int, ServerPacketCacheQueueSize).defaultValue(2048).minimumValue(1).description("Number of packets kept queued per player while replaying the packet cache to it after a (re)join; higher values replay faster at the cost of memory.");
+CONFIG(bool, ServerEventDrivenLoop).defaultValue(true).description("Server thread sleeps until a packet arrives or a new frame is due, instead of polling every ServerSleepTime milliseconds.");
 CONFIG(int, SpeedControl).defaultValue(1).minimumValue(1).maximumValue(2)
 	.description("Sets how server adjusts speed according to player's load (CPU), 1: use average, 2: use highest");
 CONFIG(bool, AllowSpectatorJoin).defaultValue(true).dedicatedValue(false).description("allow any unauthenticated clients to join as spectator with any name, name will be prefixed with ~");
@@ -120,7 +124,7 @@ decltype(CGameServer::commandBlacklist) CGameServer::commandBlacklist{
 	"nopause", "nohelp", "cheat", "godmode", "globallos",
 	"nocost", "forcestart", "nospectatorchat", "nospecdraw",
 	"skip", "reloadcob", "reloadcegs", "devlua", "editdefs",
-	"singlestep", "spec", "specbynum"
+	"singlestep", "spec", "specbynum", "netlatency"
 };
 
 
@@ -145,10 +149,13 @@ CGameServer::CGameServer(
 CGameServer::~CGameServer()
 {
 	quitServer = true;
+	WakeUpdateLoop();
 
 	LOG_L(L_INFO, "[%s][1]", __func__);
 	thread.join();
 	LOG_L(L_INFO, "[%s][2]", __func__);
+	LOG_L(L_INFO, "[%s] relay latency: %s", __func__, relayLatency.ToString().c_str());
+	LOG_L(L_INFO, "[%s] packet cache: %u packets, %.2fMB raw, %.2fMB stored", __func__, uint32_t(packetCache.NumPackets()), packetCache.GetRawSize() / (1024.0f * 1024.0f), packetCache.GetStoredSize() / (1024.0f * 1024.0f));
 
 	// after this, demoRecorder goes out of scope and its dtor is called
 	WriteDemoData();
@@ -166,11 +173,23 @@ void CGameServer::Initialize()
 
 	rng.Seed((myGameData->GetSetupText()).length());
 
+	packetCache.Init(configHandler->GetBool("ServerSpillPacketCache"));
+	packetCacheQueueSize = configHandler->GetInt("ServerPacketCacheQueueSize");
+
 	// start network
 	if (!myGameSetup->onlyLocal)
 		udpListener.reset(new netcode::UDPListener(myClientSetup->hostPort, myClientSetup->hostIP));
 
 	AddAutohostInterface(StringToLower(configHandler->GetString("AutohostIP")), configHandler->GetInt("AutohostPort"));
+
+	if (configHandler->GetBool("ServerEventDrivenLoop")) {
+		eventWaiter = std::make_shared<netcode::EventWaiter>();
+
+		if (udpListener != nullptr)
+			eventWaiter->AddSocket(udpListener->GetSocket());
+		if (hostif != nullptr)
+			eventWaiter->AddSocket(hostif->GetSocket());
+	}
 	Message(spring::format(ServerStart, myClientSetup->hostPort), false);
 
 	// start script
@@ -358,7 +377,13 @@ void CGameServer::AddLocalClient(const std::string& myName, const std::string& m
 	std::lock_guard<spring::recursive_mutex> scoped_lock(gameServerMutex);
 	assert(!HasLocalClient());
 
-	localClientNumber = BindConnection(std::shared_ptr<netcode::CConnection>(new netcode::CLocalConnection()), myName, "", myVersion, myPlatform, true);
+	std::shared_ptr<netcode::CLocalConnection> localLink(new netcode::CLocalConnection());
+
+	// packets from the local client do not go through any socket, have them wake the server thread directly
+	if (eventWaiter != nullptr)
+		localLink->SetIncomingDataCallback([waiter = std::weak_ptr<netcode::EventWaiter>(eventWaiter)]() { if (const auto w = waiter.lock()) w->Wake(); });
+
+	localClientNumber = BindConnection(localLink, myName, "", myVersion, myPlatform, true);
 }
 
 void CGameServer::AddAutohostInterface(const std::string& autohostIP, const int autohostPort)
@@ -543,12 +568,18 @@ bool CGameServer::SendDemoData(int targetFrameNum)
 
 void CGameServer::Broadcast(std::shared_ptr<const netcode::RawPacket> packet)
 {
+	const bool cachePacket = (canReconnect || allowSpecJoin || !gameHasStarted);
+
 	for (GameParticipant& p: players) {
+		// players still catching up get this from the cache, after everything before it
+		if (cachePacket && p.cacheSegment >= 0)
+			continue;
+
 		p.SendData(packet);
 	}
 
-	if (canReconnect || allowSpecJoin || !gameHasStarted)
-		packetCache.push_back(packet);
+	if (cachePacket)
+		packetCache.Append(*packet);
 
 	if (demoRecorder != nullptr)
 		demoRecorder->SaveToDemo(packet->data, packet->length, GetDemoTime());
@@ -789,9 +820,10 @@ void CGameServer::Update()
 	if (!isPaused && gameHasStarted) {
 		// if we are not playing a demo, or have no local client, or the
 		// local client is less than <GAME_SPEED> frames behind, advance
-		// <modGameTime>
+		// <modGameTime>; when benchmarking a demo it advances by a full second
+		// each time, so frames are released as fast as the client consumes them
 		if (demoReader == nullptr || !HasLocalClient() || (serverFrameNum - players[localClientNumber].lastFrameResponse) < GAME_SPEED)
-			modGameTime += (tdif * internalSpeed);
+			modGameTime += ((demoReader != nullptr && myClientSetup->benchmarkMode)? 1.0f: (tdif * internalSpeed));
 	}
 
 	if (lastPlayerInfo < (spring_gettime() - playerInfoTime)) {
@@ -830,6 +862,8 @@ void CGameServer::Update()
 	else if (!PreSimFrame() || demoReader != nullptr)
 		CreateNewFrame(true, false);
 
+	UpdateCacheReplays(false);
+
 	if (hostif != nullptr) {
 		const std::string msg = hostif->GetChatMessage();
 
@@ -1914,6 +1948,43 @@ void CGameServer::HandleConnectionAttempts()
 }
 
 
+void CGameServer::UpdateCacheReplays(bool finish)
+{
+	std::vector<uint8_t> buffer;
+
+	for (GameParticipant& p: players) {
+		if (p.cacheSegment < 0)
+			continue;
+
+		if (p.clientLink == nullptr) {
+			p.cacheSegment = -1;
+			continue;
+		}
+
+		// keep at most a segment's worth of packets queued beyond the
+		// configured limit, the link sends them as fast as it is allowed
+		while (finish || p.clientLink->GetOutgoingQueueSize() < packetCacheQueueSize) {
+			const size_t segmentIdx = p.cacheSegment;
+			const std::vector<uint8_t>* segment = packetCache.GetSegment(segmentIdx, buffer);
+
+			if (segment == nullptr) {
+				p.Kill("Failed to read packet cache");
+				break;
+			}
+
+			CPacketCache::ForEachPacket(*segment, [&](std::shared_ptr<const RawPacket> packet) { p.SendData(packet); });
+
+			// the tail is the last segment; from now on Broadcast reaches this player directly
+			if (segmentIdx == packetCache.NumSegments()) {
+				p.cacheSegment = -1;
+				break;
+			}
+
+			p.cacheSegment += 1;
+		}
+	}
+}
+
 void CGameServer::ServerReadNet()
 {
 	// handle new connections
@@ -2024,6 +2095,8 @@ void CGameServer::ServerReadNet()
 				// non-droppable packets may be processed more than once, but this does no harm
 				ProcessPacket(player.id, aiPacket);
 
+				numRelayedPackets += 1;
+
 				if (globalConfig.linkIncomingPeakBandwidth > 0 && droppablePacket) {
 					bandwidthUsage += std::max((unsigned)linkMinPacketSize, aiPacket->length);
 
@@ -2150,8 +2223,10 @@ void CGameServer::StartGame(bool forced)
 	gameHasStarted = true;
 	startTime = gameTime;
 
-	if (!canReconnect && !allowSpecJoin)
-		packetCache.clear(); // free memory
+	if (!canReconnect && !allowSpecJoin) {
+		UpdateCacheReplays(true);
+		packetCache.Clear(); // free memory
+	}
 
 	if (udpListener && !canReconnect && !allowSpecJoin)
 		udpListener->SetAcceptingConnections(false); // do not accept new connections
@@ -2264,6 +2339,10 @@ void CGameServer::PushAction(const Action& action, bool fromAutoHost)
 		} break;
 
 
+		case hashString("netlatency"): {
+			Message("Relay latency: " + relayLatency.ToString(), false);
+		} break;
+
 		case hashString("mute"): {
 			if (action.extra.empty()) {
 				LOG_L(L_WARNING, "[%s] missing argument, usage: /%s <player-name> [chatmute] [drawmute]", __func__, action.command.c_str());
@@ -2677,6 +2756,85 @@ std::string CGameServer::SpeedControlToString(int speedCtrl)
 }
 
 
+spring_time CGameServer::GetLoopDeadline() const
+{
+	std::lock_guard<spring::recursive_mutex> scoped_lock(gameServerMutex);
+
+	const spring_time curTime = spring_gettime();
+
+	const auto pred = [](const GameParticipant& p) { return (p.clientLink != nullptr && !p.isLocal); };
+	const bool hasRemoteLinks = (std::find_if(players.begin(), players.end(), pred) != players.end());
+
+	// UDP links need regular flushes, acks and keep-alives; without any
+	// only timeouts and the game-start countdown remain to be checked
+	spring_time deadline = curTime + spring_msecs(hasRemoteLinks? (1000 / GAME_SPEED): 250);
+
+	if (!gameHasStarted || isPaused || internalSpeed <= 0.0f)
+		return deadline;
+
+	if (demoReader != nullptr) {
+		// poll for the local client's frame-responses instead of pacing the demo
+		if (myClientSetup->benchmarkMode)
+			return (curTime + spring_msecs(1));
+
+		return (std::min(deadline, curTime + spring_time::fromMicroSecs(1000000 / GAME_SPEED / internalSpeed)));
+	}
+
+	if (PreSimFrame())
+		return deadline;
+
+	// CreateNewFrame emits the next frame once frameTimeLeft turns positive
+	const float framesPerMicroSec = GAME_SPEED * 0.000001f * internalSpeed;
+	const spring_time frameTime = lastNewFrameTick + spring_time::fromMicroSecs(std::max(-frameTimeLeft, 0.0f) / framesPerMicroSec);
+
+	return (std::min(deadline, frameTime));
+}
+
+void CGameServer::WakeUpdateLoop()
+{
+	if (eventWaiter == nullptr)
+		return;
+
+	eventWaiter->Wake();
+}
+
+
+CGameServer::LatencyHistogram CGameServer::GetRelayLatencyHistogram() const
+{
+	std::lock_guard<spring::recursive_mutex> scoped_lock(gameServerMutex);
+	return relayLatency;
+}
+
+void CGameServer::LatencyHistogram::AddSamples(spring_time dt, uint32_t count)
+{
+	unsigned int bucket = 0;
+
+	for (int64_t us = dt.toMicroSecsi() >> 6; us > 0 && bucket < (NUM_BUCKETS - 1); us >>= 1) {
+		bucket++;
+	}
+
+	counts[bucket] += count;
+}
+
+std::string CGameServer::LatencyHistogram::ToString() const
+{
+	std::string str;
+
+	for (unsigned int i = 0; i < NUM_BUCKETS; i++) {
+		if (counts[i] == 0)
+			continue;
+
+		if (i < (NUM_BUCKETS - 1)) {
+			str += spring::format("<%uus:%u ", 64u << i, counts[i]);
+		} else {
+			str += spring::format(">=%uus:%u ", 64u << (i - 1), counts[i]);
+		}
+	}
+
+	return (str.empty()? "no samples": str);
+}
+
+
 __FORCE_ALIGN_STACK__
 void CGameServer::UpdateLoop()
 {
@@ -2684,17 +2842,48 @@ void CGameServer::UpdateLoop()
 		Threading::SetThreadName("netcode");
 		Threading::SetAffinity(~0);
 
+		spring_time readTime = spring_gettime();
+
 		while (!quitServer) {
-			spring_msecs(loopSleepTime).sleep(true);
+			// packets read in this iteration arrived after the previous one read the sockets
+			spring_time recvTime = readTime;
+
+			if (eventWaiter != nullptr) {
+				const spring_time wakeTime = eventWaiter->Wait(GetLoopDeadline());
+
+				// if nothing was pending when the wait began, the first arrival woke us
+				if (wakeTime.isTime())
+					recvTime = wakeTime;
+			} else {
+				spring_msecs(loopSleepTime).sleep(true);
+			}
+
+			readTime = spring_gettime();
 
 			if (udpListener != nullptr)
 				udpListener->Update();
 
-			std::lock_guard<spring::recursive_mutex> scoped_lock(gameServerMutex);
-			ServerReadNet();
-			Update();
+			{
+				std::lock_guard<spring::recursive_mutex> scoped_lock(gameServerMutex);
+				ServerReadNet();
+				Update();
+			}
+
+			if (numRelayedPackets == 0)
+				continue;
+
+			// flush whatever the packets caused us to send now, rather than next iteration
+			if (udpListener != nullptr)
+				udpListener->Update();
+
+			relayLatency.AddSamples(spring_gettime() - recvTime, numRelayedPackets);
+			numRelayedPackets = 0;
 		}
 
+		// the autohost socket is gone by the time eventWaiter dies
+		if (eventWaiter != nullptr)
+			eventWaiter->RemoveSockets();
+
 		if (hostif != nullptr)
 			hostif->SendQuit();
 
@@ -3003,9 +3192,10 @@ unsigned CGameServer::BindConnection(
 		}
 	}
 
-	// finally send player all packets he missed until now
-	for (const std::shared_ptr<const netcode::RawPacket>& p: packetCache)
-		newPlayer.SendData(p);
+	// finally send player all packets he missed until now; this
+	// continues in UpdateCacheReplays as the link drains its queue
+	newPlayer.cacheSegment = 0;
+	UpdateCacheReplays(false);
 
 	// new connection established
 	Message(spring::format(" -> Connection established (given id %i)", newPlayerNumber));
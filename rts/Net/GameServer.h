@@ -15,6 +15,7 @@
 #include <vector>
 
 #include "Game/GameData.h"
+#include "Net/PacketCache.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/TeamBase.h"
 #include "System/float3.h"
@@ -32,6 +33,7 @@ namespace netcode
 	class RawPacket;
 	class CConnection;
 	class UDPListener;
+	class EventWaiter;
 }
 class CDemoReader;
 class Action;
@@ -117,6 +119,25 @@ public:
 	const std::unique_ptr<CDemoReader>& GetDemoReader() const { return demoReader; }
 	const std::unique_ptr<CDemoRecorder>& GetDemoRecorder() const { return demoRecorder; }
 
+	/**
+	 * Time from client packets arriving (as far as the server thread can
+	 * tell) until it has processed them and flushed what it sent in response.
+	 * Packets that arrived while the thread was busy are counted from the
+	 * previous iteration's read, so each sample is an upper bound.
+	 * Bucket 0 counts samples below 64us, bucket i below (64us << i),
+	 * the last one everything else (1s or more).
+	 */
+	struct LatencyHistogram {
+		static constexpr unsigned int NUM_BUCKETS = 16;
+
+		void AddSamples(spring_time dt, uint32_t count);
+		std::string ToString() const;
+
+		std::array<uint32_t, NUM_BUCKETS> counts = {};
+	};
+
+	LatencyHistogram GetRelayLatencyHistogram() const;
+
 private:
 	/**
 	 * @brief relay chat messages to players / autohost
@@ -163,6 +184,11 @@ private:
 	void CheckSync();
 	void HandleConnectionAttempts();
 	void ServerReadNet();
+	/// sends cached packets to players catching up after joining, all at once if <finish>
+	void UpdateCacheReplays(bool finish);
+	/// when the server thread next has to run even if no packets arrive
+	spring_time GetLoopDeadline() const;
+	void WakeUpdateLoop();
 
 	void LagProtection();
 
@@ -221,7 +247,8 @@ private:
 
 	std::pair<std::string, std::string> refClientVersion;
 
-	std::deque< std::shared_ptr<const netcode::RawPacket> > packetCache;
+	/// everything broadcast so far, replayed to (re)joining players
+	CPacketCache packetCache;
 
 	/////////////////// sync stuff ///////////////////
 #ifdef SYNCCHECK
@@ -258,6 +285,8 @@ private:
 
 	int linkMinPacketSize = 1;
 
+	unsigned int packetCacheQueueSize = 0;
+
 	unsigned localClientNumber = -1u;
 
 
@@ -282,12 +311,18 @@ private:
 
 
 	/// If the server receives a command, it will forward it to clients if it is not in this set
-	static std::array<std::string, 25> commandBlacklist;
+	static std::array<std::string, 26> commandBlacklist;
+
+	LatencyHistogram relayLatency;
+	/// number of client packets processed during the current UpdateLoop iteration
+	uint32_t numRelayedPackets = 0;
 
 	std::unique_ptr<netcode::UDPListener> udpListener;
 	std::unique_ptr<CDemoReader> demoReader;
 	std::unique_ptr<CDemoRecorder> demoRecorder;
 	std::unique_ptr<AutohostInterface> hostif;
+	/// null if the server thread polls after a fixed sleep instead
+	std::shared_ptr<netcode::EventWaiter> eventWaiter;
 
 	CGlobalUnsyncedRNG rng;
 	spring::thread thread;
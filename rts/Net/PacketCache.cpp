@@ -0,0 +1,151 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "PacketCache.h"
+#include "System/Log/ILog.h"
+
+#include <zlib.h>
+
+
+void CPacketCache::Init(bool spillToFile)
+{
+	Kill();
+
+	if (!spillToFile)
+		return;
+
+	// removed by the OS once closed, even if we crash
+	if ((spillFile = std::tmpfile()) == nullptr)
+		LOG_L(L_WARNING, "[PacketCache::%s] could not create a temporary file, keeping packets in memory", __func__);
+}
+
+void CPacketCache::Kill()
+{
+	Clear();
+
+	if (spillFile == nullptr)
+		return;
+
+	std::fclose(spillFile);
+	spillFile = nullptr;
+}
+
+void CPacketCache::Clear()
+{
+	segments.clear();
+	segmentData.clear();
+	tail.clear();
+	tail.shrink_to_fit();
+
+	numPackets = 0;
+
+	rawSize = 0;
+	storedSize = 0;
+}
+
+
+void CPacketCache::Append(const netcode::RawPacket& packet)
+{
+	const uint32_t length = packet.length;
+	const size_t pos = tail.size();
+
+	tail.resize(pos + sizeof(length) + length);
+
+	std::memcpy(&tail[pos], &length, sizeof(length));
+	std::memcpy(&tail[pos + sizeof(length)], packet.data, length);
+
+	numPackets += 1;
+
+	if (tail.size() < SEGMENT_SIZE)
+		return;
+
+	SealTail();
+}
+
+void CPacketCache::SealTail()
+{
+	// the tail is always sealed, even if it has to be stored as-is, so
+	// appends never degrade to re-attempting an ever-growing compression
+	std::vector<uint8_t> buffer(compressBound(tail.size()));
+	uLongf bufferSize = buffer.size();
+
+	Segment segment;
+	segment.offset = storedSize;
+	segment.rawSize = tail.size();
+	// favor speed, broadcast traffic is highly redundant anyway
+	segment.deflated = (compress2(buffer.data(), &bufferSize, tail.data(), tail.size(), Z_BEST_SPEED) == Z_OK);
+	segment.spilled = false;
+
+	if (!segment.deflated) {
+		LOG_L(L_ERROR, "[PacketCache::%s] failed to compress %u bytes, storing them uncompressed", __func__, segment.rawSize);
+
+		buffer.swap(tail);
+		bufferSize = buffer.size();
+	}
+
+	segment.storedSize = bufferSize;
+
+	if (spillFile != nullptr) {
+		segment.spilled = (std::fseek(spillFile, segment.offset, SEEK_SET) == 0 && std::fwrite(buffer.data(), 1, bufferSize, spillFile) == bufferSize);
+
+		if (!segment.spilled)
+			LOG_L(L_ERROR, "[PacketCache::%s] failed to write to temporary file, keeping segment %u in memory", __func__, uint32_t(segments.size()));
+	}
+
+	if (segment.spilled) {
+		segmentData.emplace_back();
+	} else {
+		buffer.resize(bufferSize);
+		buffer.shrink_to_fit();
+		segmentData.emplace_back(std::move(buffer));
+	}
+
+	segments.push_back(segment);
+
+	rawSize += segment.rawSize;
+	storedSize += segment.storedSize;
+
+	tail.clear();
+}
+
+
+const std::vector<uint8_t>* CPacketCache::GetSegment(size_t idx, std::vector<uint8_t>& buffer) const
+{
+	if (idx == segments.size())
+		return &tail;
+	if (idx > segments.size())
+		return nullptr;
+
+	const Segment& segment = segments[idx];
+
+	const uint8_t* storedData = nullptr;
+	std::vector<uint8_t> storedBuffer;
+
+	if (segment.spilled) {
+		storedBuffer.resize(segment.storedSize);
+
+		if (std::fseek(spillFile, segment.offset, SEEK_SET) != 0 || std::fread(storedBuffer.data(), 1, segment.storedSize, spillFile) != segment.storedSize) {
+			LOG_L(L_ERROR, "[PacketCache::%s] failed to read segment %u from temporary file", __func__, uint32_t(idx));
+			return nullptr;
+		}
+
+		storedData = storedBuffer.data();
+	} else {
+		storedData = segmentData[idx].data();
+	}
+
+	if (!segment.deflated) {
+		buffer.assign(storedData, storedData + segment.storedSize);
+		return &buffer;
+	}
+
+	uLongf rawLength = segment.rawSize;
+
+	buffer.resize(segment.rawSize);
+
+	if (uncompress(buffer.data(), &rawLength, storedData, segment.storedSize) != Z_OK || rawLength != segment.rawSize) {
+		LOG_L(L_ERROR, "[PacketCache::%s] failed to decompress segment %u", __func__, uint32_t(idx));
+		return nullptr;
+	}
+
+	return &buffer;
+}
@@ -0,0 +1,92 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _PACKET_CACHE_H
+#define _PACKET_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "System/Misc/NonCopyable.h"
+#include "System/Net/RawPacket.h"
+
+/**
+ * @brief Broadcast packets kept for players that join or reconnect later
+ * Packets are appended to an uncompressed tail which is deflated into a
+ * sealed segment once it reaches SEGMENT_SIZE bytes. Sealed segments are
+ * kept in memory or, optionally, in an anonymous temporary file. Readers
+ * inflate one segment at a time, so replaying a long game never needs
+ * more than a segment's worth of raw packets in memory.
+ */
+class CPacketCache : spring::noncopyable
+{
+public:
+	static constexpr uint32_t SEGMENT_SIZE = 256 * 1024;
+
+	~CPacketCache() { Kill(); }
+
+	void Init(bool spillToFile);
+	void Kill();
+	void Clear();
+
+	void Append(const netcode::RawPacket& packet);
+
+	/// number of sealed segments; the tail comes after these
+	size_t NumSegments() const { return segments.size(); }
+	size_t NumPackets() const { return numPackets; }
+
+	uint64_t GetRawSize() const { return (rawSize + tail.size()); }
+	uint64_t GetStoredSize() const { return (storedSize + tail.size()); }
+
+	/**
+	 * @brief Get the raw packet data of segment <idx>
+	 * Inflates sealed segments into <buffer>; idx == NumSegments() refers
+	 * to the tail, which is returned as-is. Returns nullptr on failure.
+	 */
+	const std::vector<uint8_t>* GetSegment(size_t idx, std::vector<uint8_t>& buffer) const;
+
+	/// calls <func> with each packet in raw segment data returned by GetSegment
+	template<typename F> static void ForEachPacket(const std::vector<uint8_t>& data, F&& func) {
+		for (size_t pos = 0; (pos + sizeof(uint32_t)) <= data.size(); ) {
+			uint32_t length = 0;
+
+			std::memcpy(&length, &data[pos], sizeof(length));
+			pos += sizeof(length);
+
+			func(std::make_shared<const netcode::RawPacket>(data.data() + pos, length));
+			pos += length;
+		}
+	}
+
+private:
+	void SealTail();
+
+private:
+	struct Segment {
+		uint64_t offset;
+		uint32_t storedSize;
+		uint32_t rawSize;
+
+		/// false if compression failed and the raw packets were stored
+		bool deflated;
+		/// false if kept in segmentData, also when writing to the file failed
+		bool spilled;
+	};
+
+	std::vector<Segment> segments;
+	/// stored segment data, one (empty if spilled) per segment
+	std::vector< std::vector<uint8_t> > segmentData;
+	/// length-prefixed packets not yet sealed into a segment
+	std::vector<uint8_t> tail;
+
+	FILE* spillFile = nullptr;
+
+	size_t numPackets = 0;
+
+	uint64_t rawSize = 0;
+	uint64_t storedSize = 0;
+};
+
+#endif // _PACKET_CACHE_H
@@ -12,12 +12,14 @@
 #include "System/Sync/HsiehHash.h"
 #include "System/creg/STL_Deque.h"
 #include "System/EventHandler.h"
+#include "System/Config/ConfigHandler.h"
 #include "System/SafeUtil.h"
 #include "System/TimeProfiler.h"
 #include "System/Threading/ThreadPool.h"
 
 #define USE_STAGGERED_UPDATES 0
 
+CONFIG(bool, IncrementalLosRaycast).defaultValue(true).description("Keep per-instance raycast data so terrain changes only re-trace the LOS and radar rays crossing them. Same results, more memory.");
 
 
 CR_BIND(CLosHandler, )
@@ -94,8 +96,10 @@ void ILosType::Init(const int mipLevel_, LosType type_)
 	const float* ctrHeightMap = readMap->GetCenterHeightMapSynced();
 	const float* mipHeightMap = readMap->GetMIPHeightMapSynced(mipLevel_);
 
+	const bool incrementalRaycast = (algoType == LOS_ALGO_RAYCAST && configHandler->GetBool("IncrementalLosRaycast"));
+
 	for (CLosMap& losMap: losMaps) {
-		losMap.Init(size, int2(mapDims.mapx, mapDims.mapy), ctrHeightMap, mipHeightMap, type == LOS_TYPE_LOS);
+		losMap.Init(size, int2(mapDims.mapx, mapDims.mapy), ctrHeightMap, mipHeightMap, type == LOS_TYPE_LOS, incrementalRaycast);
 	}
 }
 
@@ -338,6 +342,7 @@ inline void ILosType::AddInstanceToCache(SLosInstance* li)
 	}
 
 	li->isCached = true;
+	li->ClearRaycastData();
 	losCache.push_back(li);
 }
 
@@ -384,6 +389,7 @@ inline void ILosType::DeleteInstance(SLosInstance* li)
 	}
 
 	li->squares.clear();
+	li->ClearRaycastData();
 	freeIDs.push_back(li->id);
 }
 
@@ -629,9 +635,27 @@ void ILosType::UpdateHeightMapSynced(SRectangle rect)
 		DeleteInstance(li);
 	}
 
+	// LOS-map squares whose (mip-)height may have changed
+	const SRectangle losRect(
+		(rect.x1 >> mipLevel) - 1,
+		(rect.y1 >> mipLevel) - 1,
+		(rect.x2 >> mipLevel) + 2,
+		(rect.y2 >> mipLevel) + 2
+	);
+
 	// relos used instances
 	for (auto& p: instanceHashes) {
 		for (SLosInstance* li: p.second) {
+			// incremental raycasts must learn about every change within
+			// their square, even one CheckOverlap does not consider worth
+			// a relos (it will be picked up by the next one)
+			if (!li->rayOcclusions.empty()) {
+				const SRectangle losBox(li->basePos.x - li->radius, li->basePos.y - li->radius, li->basePos.x + li->radius + 1, li->basePos.y + li->radius + 1);
+
+				if (losBox.CheckOverlap(losRect))
+					li->AddDirtyRect(losRect);
+			}
+
 			if (li->status & SLosInstance::TLosStatus::RECALC)
 				continue;
 			if (!CheckOverlap(li, rect))
@@ -4,14 +4,15 @@
 #include <array>
 
 #include "LosMap.h"
-#include "LosHandler.h"
+#include "Sim/Misc/GlobalConstants.h"
 #include "Map/ReadMap.h"
 #include "System/SpringMath.h"
 #include "System/float3.h"
 #include "System/Log/ILog.h"
 #include "System/StringUtil.h"
 #include "System/Threading/ThreadPool.h"
-#ifdef USE_UNSYNCED_HEIGHTMAP
+#include "xsimd/xsimd.hpp"
+#if (defined(USE_UNSYNCED_HEIGHTMAP) && !defined(UNIT_TEST))
 	#include "Game/GlobalUnsynced.h" // for myAllyTeam
 #endif
 
@@ -23,6 +24,32 @@ static std::array<std::vector<float>, ThreadPool::MAX_THREADS> RADIUS_ISQRT_TABL
 
 static std::array<std::vector<float>, ThreadPool::MAX_THREADS> RAYCAST_ANGLE_TABLES;
 static std::array<std::vector< char>, ThreadPool::MAX_THREADS> LOSRAY_SQUARE_TABLES; // visible squares per instance
+static std::array<std::vector<  int>, ThreadPool::MAX_THREADS> CIRCLE_WIDTH_TABLES; // half-width per line of the circle
+static std::array<std::vector<  int>, ThreadPool::MAX_THREADS> RETRACE_RAY_TABLES; // (ray << 2) | direction
+static std::array<std::vector<SRectangle>, ThreadPool::MAX_THREADS> DIRTY_RECT_TABLES;
+static std::array<std::vector<std::array<int2, 8>>, ThreadPool::MAX_THREADS> LOCAL_RECT_TABLES; // {min,max} per direction
+
+
+// NOTE:
+//   counters wrap modulo 2^16 exactly as the scalar "+= amount" does,
+//   so removing an instance always restores the previous values
+static void AddToSpan(unsigned short* span, int length, int amount)
+{
+	using SIMDVushort = xsimd::simd_type<uint16_t>;
+
+	constexpr int simdSize = SIMDVushort::size;
+
+	const int vecSize = length - length % simdSize;
+	const SIMDVushort vamount(static_cast<uint16_t>(amount));
+
+	for (int i = 0; i < vecSize; i += simdSize) {
+		xsimd::store_unaligned(&span[i], xsimd::load_unaligned(&span[i]) + vamount);
+	}
+
+	for (int i = vecSize; i < length; ++i) {
+		span[i] += amount;
+	}
+}
 
 
 static float isqrtTableLookup(unsigned r, int threadNum)
@@ -417,9 +444,7 @@ void CLosMap::AddCircle(SLosInstance* instance, int amount)
 			const unsigned sx = Clamp(instance->basePos.x - width,     0, size.x);
 			const unsigned ex = Clamp(instance->basePos.x + width + 1, 0, size.x);
 
-			for (unsigned x_ = sx; x_ < ex; ++x_) {
-				losmap[(y_ * size.x) + x_] += amount;
-			}
+			AddToSpan(losmap.data() + (y_ * size.x) + sx, ex - sx, amount);
 		}
 	});
 }
@@ -432,16 +457,16 @@ void CLosMap::AddRaycast(SLosInstance* instance, int amount)
 	if (losSquares.empty() || losSquares[0].length == SLosInstance::EMPTY_RLE.length)
 		return;
 
-#ifdef USE_UNSYNCED_HEIGHTMAP
+#if (defined(USE_UNSYNCED_HEIGHTMAP) && !defined(UNIT_TEST))
 	// inform ReadMap when squares enter LoS
 	const bool visibleInstanceSquares = (instance->allyteam >= 0 && (instance->allyteam == gu->myAllyTeam || gu->spectatingFullView));
 	const bool updateUnsyncedHeightMap = sendReadmapEvents && visibleInstanceSquares;
 
 	if ((amount > 0) && updateUnsyncedHeightMap) {
 		for (const SLosInstance::RLE rle: losSquares) {
-			for (int idx = rle.start, len = rle.length; len > 0; --len, ++idx) {
-				losmap[idx] += amount;
+			AddToSpan(&losmap[rle.start], rle.length, amount);
 
+			for (int idx = rle.start, len = rle.length; len > 0; --len, ++idx) {
 				// skip if this los-square did not *enter* LOS
 				if (losmap[idx] != amount)
 					continue;
@@ -460,9 +485,7 @@ void CLosMap::AddRaycast(SLosInstance* instance, int amount)
 #endif
 
 	for (const SLosInstance::RLE rle: losSquares) {
-		for (int idx = rle.start, len = rle.length; len > 0; --len, ++idx) {
-			losmap[idx] += amount;
-		}
+		AddToSpan(&losmap[rle.start], rle.length, amount);
 	}
 }
 
@@ -498,8 +521,15 @@ void CLosMap::LosAdd(SLosInstance* li) const
 	const SRectangle fullRect(0, 0, size.x, size.y);
 	const SRectangle safeRect(li->radius, li->radius, size.x - li->radius, size.y - li->radius);
 
-	if (fullRect.Inside(li->basePos) && li->baseHeight <= ctrHeightMap[MAP_SQUARE_FULLRES(li->basePos)])
+	if (fullRect.Inside(li->basePos) && li->baseHeight <= ctrHeightMap[MAP_SQUARE_FULLRES(li->basePos)]) {
+		li->ClearRaycastData();
 		return;
+	}
+
+	if (incrementalRaycast) {
+		IncrementalLosAdd(li);
+		return;
+	}
 
 	// add all squares within the instance's sight radius
 	if (safeRect.Inside(li->basePos)) {
@@ -550,6 +580,38 @@ inline void CastLos(
 }
 
 
+// same as CastLos, but adds <delta> to the occlusion count of hidden squares
+inline void CastLosCounted(
+	float* prvAngle,
+	float* maxAngle,
+	const int2& off,
+	unsigned short* rayOcclusions,
+	const float* raycastAngles,
+	int losRadius,
+	int threadNum,
+	int delta
+) {
+	const size_t oidx = ToAngleMapIdx(off, losRadius);
+
+	if (raycastAngles[oidx] < *maxAngle) {
+		rayOcclusions[oidx] += delta;
+		return;
+	}
+
+	if (raycastAngles[oidx] < *prvAngle) {
+		const float invR = isqrtTableLookup(off.x * off.x + off.y * off.y, threadNum);
+		const float angle = *prvAngle - LOS_BONUS_HEIGHT * invR;
+
+		if (raycastAngles[oidx] < (*maxAngle = angle)) {
+			rayOcclusions[oidx] += delta;
+			return;
+		}
+	}
+
+	*prvAngle = raycastAngles[oidx];
+}
+
+
 void CLosMap::AddSquaresToInstance(SLosInstance* li, const std::vector<char>& losRaySquares) const
 {
 	const int2 pos   = li->basePos;
@@ -812,3 +874,221 @@ void CLosMap::SafeLosAdd(SLosInstance* li) const
 	// translate visible square indices to map square idx + RLE
 	AddSquaresToInstance(li, losRaySquares);
 }
+
+
+/**
+ * Casts the same rays as {Unsafe,Safe}LosAdd and yields the same squares, but
+ * keeps the angle table plus per-square occlusion counts (rather than visible
+ * flags) in the instance. On a re-cast after terrain changes, only the rays
+ * crossing li->dirtyRects are taken back out (against the old angles) and cast
+ * again (against the new ones); all other rays' contributions are reused.
+ * Does not handle basePos changes, moving units get a new instance anyway.
+ */
+void CLosMap::IncrementalLosAdd(SLosInstance* li) const
+{
+	const int threadNum = ThreadPool::GetThreadNum();
+
+	const int2 pos   = li->basePos;
+	const int radius = li->radius;
+	const int diameter = (2 * radius) + 1;
+	const float losHeight = li->baseHeight;
+
+	// see SafeLosAdd; the checks are only needed when the circle crosses a map edge
+	enum { TRACE_NOCHECK, TRACE_BREAK, TRACE_SKIP };
+
+	const SRectangle mapRect(0, 0, size.x, size.y);
+	const SRectangle safeRect(radius, radius, size.x - radius, size.y - radius);
+	const int traceMode = safeRect.Inside(pos)? TRACE_NOCHECK: (mapRect.Inside(pos)? TRACE_BREAK: TRACE_SKIP);
+
+	CLosTableHelper& helper = losTableHelpers[threadNum];
+
+	std::vector<char>& losRaySquares = LOSRAY_SQUARE_TABLES[threadNum];
+	std::vector<int>& circleWidths = CIRCLE_WIDTH_TABLES[threadNum];
+	std::vector<int>& retraceRays = RETRACE_RAY_TABLES[threadNum];
+
+	std::vector<float>& rayAngles = li->rayAngles;
+	std::vector<unsigned short>& rayOcclusions = li->rayOcclusions;
+
+	helper.GenerateForLosSize(radius);
+	isqrtTableExpand((radius + 1) * (radius + 1), threadNum);
+
+	circleWidths.clear();
+	circleWidths.resize(diameter, -1);
+
+	MidpointCircleAlgoPerLine(radius, [&](int width, int y) { circleWidths[y + radius] = width; });
+
+	// (re)calculate the angles of all in-map squares of the circle within <rect> (offsets from pos)
+	const auto CalcAngles = [&](const SRectangle& rect, bool initOcclusions) {
+		for (int y = std::max(rect.y1, -radius), ey = std::min(rect.y2, radius + 1); y < ey; ++y) {
+			const unsigned y_ = pos.y + y;
+
+			if (y_ >= size.y)
+				continue;
+
+			const int width = circleWidths[y + radius];
+			const int sx = std::max(std::max(rect.x1, -width), -pos.x);
+			const int ex = std::min(std::min(rect.x2, width + 1), size.x - pos.x);
+
+			for (int x = sx; x < ex; ++x) {
+				const int2 off(x, y);
+
+				if (off == int2(0, 0))
+					continue;
+
+				const size_t oidx = ToAngleMapIdx(off, radius);
+
+				const float invR = isqrtTableLookup(off.x*off.x + off.y*off.y, threadNum);
+				const float dh = std::max(0.0f, mipHeightMap[MAP_SQUARE(pos + off)]) - losHeight;
+
+				rayAngles[oidx] = (dh + LOS_BONUS_HEIGHT) * invR;
+
+				if (initOcclusions)
+					rayOcclusions[oidx] = 0;
+			}
+		}
+	};
+
+	const auto MirrorSquare = [](const int2 square, int dir) {
+		switch (dir) {
+			case 0: return ( square);
+			case 1: return (-square);
+			case 2: return int2( square.y, -square.x);
+			case 3: return int2(-square.y,  square.x);
+		}
+		return square;
+	};
+
+	const auto UnmirrorSquare = [](const int2 square, int dir) {
+		switch (dir) {
+			case 0: return ( square);
+			case 1: return (-square);
+			case 2: return int2(-square.y,  square.x);
+			case 3: return int2( square.y, -square.x);
+		}
+		return square;
+	};
+
+	const auto TraceRay = [&](size_t rayIdx, int dir, int delta) {
+		float maxAngle = -1e7;
+		float prvAngle = -1e7;
+
+		for (size_t n = 0, numSquares = helper.GetLosTableRaySize(radius, rayIdx); n < numSquares; n++) {
+			const int2 square = MirrorSquare(helper.GetLosTableRaySquare(radius, rayIdx, n), dir);
+
+			if (traceMode != TRACE_NOCHECK && !mapRect.Inside(pos + square)) {
+				if (traceMode == TRACE_BREAK)
+					break;
+
+				continue;
+			}
+
+			CastLosCounted(&prvAngle, &maxAngle, square, &rayOcclusions[0], &rayAngles[0], radius, threadNum, delta);
+		}
+	};
+
+	const size_t numRays = helper.GetLosTableSize(radius);
+
+	if (rayOcclusions.size() != Square(diameter)) {
+		// first cast; squares outside the circle or map start (and stay) occluded
+		rayAngles.clear();
+		rayAngles.resize(Square(diameter), -1e8);
+		rayOcclusions.clear();
+		rayOcclusions.resize(Square(diameter), 1);
+		rayOcclusions[ToAngleMapIdx(int2(0, 0), radius)] = !mapRect.Inside(pos);
+
+		CalcAngles(SRectangle(-radius, -radius, radius + 1, radius + 1), true);
+
+		for (size_t i = 0; i < numRays; ++i) {
+			for (int dir = 0; dir < 4; dir++) {
+				TraceRay(i, dir, 1);
+			}
+		}
+	} else if (!li->dirtyRects.empty()) {
+		// dirty squares relative to pos, and as seen from each direction's
+		// unmirrored ray table (inclusive bounds)
+		std::vector<SRectangle>& dirtyRects = DIRTY_RECT_TABLES[threadNum];
+		std::vector<std::array<int2, 8>>& localRects = LOCAL_RECT_TABLES[threadNum];
+
+		dirtyRects.clear();
+		localRects.clear();
+
+		for (const SRectangle& dr: li->dirtyRects) {
+			const SRectangle rect(dr.x1 - pos.x, dr.y1 - pos.y, dr.x2 - pos.x, dr.y2 - pos.y);
+
+			// skip changes outside the instance's square
+			if (!rect.CheckOverlap(SRectangle(-radius, -radius, radius + 1, radius + 1)))
+				continue;
+
+			dirtyRects.push_back(rect);
+			localRects.emplace_back();
+
+			for (int dir = 0; dir < 4; dir++) {
+				const int2 c0 = UnmirrorSquare(int2(rect.x1    , rect.y1    ), dir);
+				const int2 c1 = UnmirrorSquare(int2(rect.x2 - 1, rect.y2 - 1), dir);
+
+				localRects.back()[dir * 2 + 0] = int2(std::min(c0.x, c1.x), std::min(c0.y, c1.y));
+				localRects.back()[dir * 2 + 1] = int2(std::max(c0.x, c1.x), std::max(c0.y, c1.y));
+			}
+		}
+
+		// GetRay emits one square per step along the major axis (starting at 1),
+		// with the minor coordinate never decreasing; so a ray crosses the rect
+		// iff it is within the minor range somewhere along the rect's major range
+		const auto RayCrossesRect = [&](size_t rayIdx, const int2 rmin, const int2 rmax) {
+			const int numSquares = helper.GetLosTableRaySize(radius, rayIdx);
+			const int2 endSquare = helper.GetLosTableRaySquare(radius, rayIdx, numSquares - 1);
+			const bool xMajor = (endSquare.x > endSquare.y);
+
+			const int lo = std::max(xMajor? rmin.x: rmin.y, 1);
+			const int hi = std::min(xMajor? rmax.x: rmax.y, numSquares);
+
+			if (lo > hi)
+				return false;
+
+			const int2 sq0 = helper.GetLosTableRaySquare(radius, rayIdx, lo - 1);
+			const int2 sq1 = helper.GetLosTableRaySquare(radius, rayIdx, hi - 1);
+
+			if (xMajor)
+				return (sq0.y <= rmax.y && sq1.y >= rmin.y);
+
+			return (sq0.x <= rmax.x && sq1.x >= rmin.x);
+		};
+
+		retraceRays.clear();
+
+		for (size_t i = 0; i < numRays; ++i) {
+			for (int dir = 0; dir < 4; dir++) {
+				const auto pred = [&](const std::array<int2, 8>& lr) { return RayCrossesRect(i, lr[dir * 2 + 0], lr[dir * 2 + 1]); };
+
+				if (std::find_if(localRects.begin(), localRects.end(), pred) == localRects.end())
+					continue;
+
+				retraceRays.push_back((i << 2) | dir);
+			}
+		}
+
+		for (const int ray: retraceRays) {
+			TraceRay(ray >> 2, ray & 3, -1);
+		}
+
+		for (const SRectangle& rect: dirtyRects) {
+			CalcAngles(rect, false);
+		}
+
+		for (const int ray: retraceRays) {
+			TraceRay(ray >> 2, ray & 3, 1);
+		}
+	}
+
+	li->dirtyRects.clear();
+
+	losRaySquares.clear();
+	losRaySquares.resize(Square(diameter), false);
+
+	for (size_t i = 0, n = rayOcclusions.size(); i < n; i++) {
+		losRaySquares[i] = (rayOcclusions[i] == 0);
+	}
+
+	// translate visible square indices to map square idx + RLE
+	AddSquaresToInstance(li, losRaySquares);
+}
@@ -7,17 +7,123 @@
 
 #include <vector>
 #include "System/type2.h"
+#include "System/Rectangle.h"
 #include "System/SpringMath.h"
 
 
-struct SLosInstance;
+/**
+ * LoS Instance
+ *
+ * The main goal of this object is to store the squares on the LOS map that
+ * have been incremented (CLosHandler::LosAdd) when the unit last moved.
+ * (CLosHandler::MoveUnit)
+ *
+ * These squares must be remembered because 1) ray-casting against the terrain
+ * is not particularly fast and more importantly 2) the terrain may have changed
+ * between the LosAdd and the moment we want to undo the LosAdd.
+ *
+ * LosInstances may be shared between multiple units. Reference counting is
+ * used to track how many units currently use one instance.
+ *
+ * An instance will be shared iff the other unit is in the same square
+ * (basePos, baseSquare) on the LOS map, has the same radius, is in the
+ * same ally-team and has the same height.
+ */
+struct SLosInstance
+{
+	SLosInstance(int id)
+		: id(id)
+		, allyteam(-1)
+		, radius(-1)
+		, basePos()
+		, baseHeight(-1)
+		, refCount(0)
+		, hashNum(-1)
+		, status(NONE)
+		, isCached(false)
+		, isQueuedForUpdate(false)
+		, isQueuedForTerraform(false)
+	{}
+	void Init(int radius, int allyteam, int2 basePos, float baseHeight, int hashNum);
+
+public:
+	// hash properties
+	int id;
+	int allyteam;
+	int radius;
+	int2 basePos;
+	float baseHeight;
+
+	// working data
+	int refCount;
+	struct RLE { int start; unsigned length; };
+	static constexpr RLE EMPTY_RLE = RLE{0,0};
+	std::vector<RLE> squares;
+
+	// incremental raycasting data (see CLosMap::IncrementalLosAdd), both
+	// sized (2 * radius + 1)^2 and empty if not (yet) raycast that way:
+	// the angles the rays were last cast against, and for each square the
+	// number of rays that found it occluded (non-zero means not visible)
+	std::vector<float> rayAngles;
+	std::vector<unsigned short> rayOcclusions;
+	// LOS-map squares whose height changed since the last raycast; kept
+	// apart (up to a point) since one bounding box over distant changes
+	// would make most rays look dirty
+	std::vector<SRectangle> dirtyRects;
+
+	static constexpr size_t MAX_DIRTY_RECTS = 8;
+
+	void AddDirtyRect(const SRectangle& r) {
+		if (dirtyRects.size() < MAX_DIRTY_RECTS) {
+			dirtyRects.push_back(r);
+			return;
+		}
+
+		// merge with the rect whose bounds grow the least
+		const auto MergeRects = [](const SRectangle& a, const SRectangle& b) {
+			return SRectangle(std::min(a.x1, b.x1), std::min(a.y1, b.y1), std::max(a.x2, b.x2), std::max(a.y2, b.y2));
+		};
+
+		SRectangle* best = &dirtyRects[0];
+
+		for (SRectangle& dr: dirtyRects) {
+			if ((MergeRects(dr, r).GetArea() - dr.GetArea()) < (MergeRects(*best, r).GetArea() - best->GetArea()))
+				best = &dr;
+		}
+
+		*best = MergeRects(*best, r);
+	}
+	void ClearRaycastData() {
+		rayAngles.clear();
+		rayAngles.shrink_to_fit();
+		rayOcclusions.clear();
+		rayOcclusions.shrink_to_fit();
+		dirtyRects.clear();
+	}
+
+	// helpers
+	int hashNum;
+	enum TLosStatus {
+		NONE       =  0,
+		NEW        =  1,
+		REACTIVATE =  2,
+		RECALC     =  4,
+		REMOVE     =  8,
+	};
+	int status;
+
+	bool isCached;
+	bool isQueuedForUpdate;
+	bool isQueuedForTerraform;
+};
+
 
 
 /// map containing counts of how many units have Line Of Sight (LOS) to each square
 class CLosMap
 {
 public:
-	void Init(const int2 size_, const int2 mapDims, const float* ctrHeightMap_, const float* mipHeightMap_, bool sendReadmapEvents_)
+	void Init(const int2 size_, const int2 mapDims, const float* ctrHeightMap_, const float* mipHeightMap_, bool sendReadmapEvents_, bool incrementalRaycast_ = false)
 	{
 		size = size_;
 		LOS2HEIGHT = mapDims / size;
@@ -29,6 +135,7 @@ public:
 		mipHeightMap = mipHeightMap_;
 
 		sendReadmapEvents = sendReadmapEvents_;
+		incrementalRaycast = incrementalRaycast_;
 	}
 
 	void Kill() {}
@@ -57,6 +164,7 @@ private:
 	void LosAdd(SLosInstance* instance) const;
 	void UnsafeLosAdd(SLosInstance* instance) const;
 	void SafeLosAdd(SLosInstance* instance) const;
+	void IncrementalLosAdd(SLosInstance* instance) const;
 
 	void AddSquaresToInstance(SLosInstance* li, const std::vector<char>& losRaySquares) const;
 
@@ -64,12 +172,14 @@ protected:
 	int2 size;
 	int2 LOS2HEIGHT;
 
+	/// 16-bit counters; CLosTexture uploads them as-is (two GL_RG8 channels)
 	std::vector<unsigned short> losmap;
 
 	const float* ctrHeightMap = nullptr;
 	const float* mipHeightMap = nullptr;
 
 	bool sendReadmapEvents = false;
+	bool incrementalRaycast = false;
 };
 
 #endif // LOS_MAP_H
@@ -101,6 +101,8 @@ void CModInfo::ResetState()
 		enableSmoothMesh = true;
 
 		allowTake = true;
+
+		quadFieldUnitSoA = false;
 	}
 }
 
@@ -142,6 +144,8 @@ void CModInfo::Init(const std::string& modFileName)
 		enableSmoothMesh = system.GetBool("enableSmoothMesh", enableSmoothMesh);
 
 		allowTake = system.GetBool("allowTake", allowTake);
+
+		quadFieldUnitSoA = system.GetBool("quadFieldUnitSoA", quadFieldUnitSoA);
 	}
 
 	{
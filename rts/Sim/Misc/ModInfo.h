@@ -171,6 +171,9 @@ public:
 	bool enableSmoothMesh;
 
 	bool allowTake;
+
+	/// whether QuadField keeps packed (SIMD-filterable) copies of unit positions per quad
+	bool quadFieldUnitSoA;
 };
 
 extern CModInfo modInfo;
@@ -9,6 +9,8 @@
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/TeamHandler.h"
 #include "System/ContainerUtil.h"
+#include "System/bitops.h"
+#include "System/Threading/ThreadPool.h"
 
 #ifndef UNIT_TEST
 	#include "Sim/Features/Feature.h"
@@ -26,16 +28,16 @@ CR_REG_METADATA(CQuadField, (
 	CR_MEMBER(quadSizeZ),
 	CR_MEMBER(invQuadSize),
 
-	CR_IGNORED(tempUnits),
-	CR_IGNORED(tempFeatures),
-	CR_IGNORED(tempProjectiles),
-	CR_IGNORED(tempSolids),
-	CR_IGNORED(tempQuads)
+	CR_IGNORED(queryCaches),
+	CR_IGNORED(useUnitSoA),
+	CR_IGNORED(readOnlyScopes),
+	CR_IGNORED(numSolidChanges)
 ))
 
 CR_BIND(CQuadField::Quad, )
 CR_REG_METADATA_SUB(CQuadField, Quad, (
 	CR_MEMBER(units),
+	CR_IGNORED(unitData),
 	CR_IGNORED(teamUnits),
 	CR_MEMBER(features),
 	CR_MEMBER(projectiles),
@@ -103,11 +105,22 @@ void CQuadField::Quad::PostLoad()
 	for (CUnit* unit: units) {
 		spring::VectorInsertUnique(teamUnits[unit->allyteam], unit, false);
 	}
+
+	if (!quadField.UseUnitSoA())
+		return;
+
+	unitData.Clear();
+
+	for (const CUnit* unit: units) {
+		unitData.PushBack(unit->pos, unit->radius);
+	}
 #endif
 }
 
-void CQuadField::Init(int2 mapDims, int quadSize)
+void CQuadField::Init(int2 mapDims, int quadSize, bool _useUnitSoA)
 {
+	useUnitSoA = _useUnitSoA;
+
 	quadSizeX = quadSize;
 	quadSizeZ = quadSize;
 	numQuadsX = (mapDims.x * SQUARE_SIZE) / quadSize;
@@ -121,8 +134,11 @@ void CQuadField::Init(int2 mapDims, int quadSize)
 	invQuadSize = {1.0f / quadSizeX, 1.0f / quadSizeZ};
 
 	baseQuads.resize(numQuadsX * numQuadsZ);
-	tempQuads.ReserveAll(numQuadsX * numQuadsZ);
-	tempQuads.ReleaseAll();
+	queryCaches.resize(ThreadPool::MAX_THREADS);
+
+	// worker threads grow theirs on demand
+	queryCaches[0].tempQuads.ReserveAll(numQuadsX * numQuadsZ);
+	queryCaches[0].tempQuads.ReleaseAll();
 
 #ifndef UNIT_TEST
 	for (Quad& quad: baseQuads) {
@@ -139,14 +155,30 @@ void CQuadField::Kill()
 		quad.Clear();
 	}
 
-	tempUnits.ReleaseAll();
-	tempFeatures.ReleaseAll();
-	tempProjectiles.ReleaseAll();
-	tempSolids.ReleaseAll();
-	tempQuads.ReleaseAll();
+	for (QueryCaches& caches: queryCaches) {
+		caches.tempUnits.ReleaseAll();
+		caches.tempFeatures.ReleaseAll();
+		caches.tempProjectiles.ReleaseAll();
+		caches.tempSolids.ReleaseAll();
+		caches.tempQuads.ReleaseAll();
+	}
+
+	assert(readOnlyScopes == 0);
 }
 
 
+int CQuadField::GetThreadNum() { return ThreadPool::GetThreadNum(); }
+
+CQuadField::QueryCaches& CQuadField::GetQueryCaches(const QuadFieldQuery& qfq)
+{
+	assert(size_t(qfq.threadNum) < queryCaches.size());
+	return queryCaches[qfq.threadNum];
+}
+
+CQuadField::ReadOnlyScope::ReadOnlyScope() { quadField.readOnlyScopes += 1; }
+CQuadField::ReadOnlyScope::~ReadOnlyScope() { quadField.readOnlyScopes -= 1; }
+
+
 int2 CQuadField::WorldPosToQuadField(const float3 p) const
 {
 	return int2(
@@ -162,12 +194,18 @@ int CQuadField::WorldPosToQuadFieldIdx(const float3 p) const
 }
 
 
-#ifndef UNIT_TEST
 void CQuadField::GetQuads(QuadFieldQuery& qfq, float3 pos, float radius)
+{
+	qfq.quads = GetQueryCaches(qfq).tempQuads.ReserveVector();
+
+	GetQuadsMt(*qfq.quads, pos, radius);
+}
+
+void CQuadField::GetQuadsMt(std::vector<int>& quads, float3 pos, float radius) const
 {
 	pos.AssertNaNs();
 	pos.ClampInBounds();
-	qfq.quads = tempQuads.ReserveVector();
+	quads.clear();
 
 	const int2 min = WorldPosToQuadField(pos - radius);
 	const int2 max = WorldPosToQuadField(pos + radius);
@@ -184,7 +222,7 @@ void CQuadField::GetQuads(QuadFieldQuery& qfq, float3 pos, float radius)
 			assert(z < numQuadsZ);
 			const float3 quadPos = float3(x * quadSizeX + quadSizeX * 0.5f, 0, z * quadSizeZ + quadSizeZ * 0.5f);
 			if (pos.SqDistance2D(quadPos) < maxSqLength) {
-				qfq.quads->push_back(z * numQuadsX + x);
+				quads.push_back(z * numQuadsX + x);
 			}
 		}
 	}
@@ -197,7 +235,7 @@ void CQuadField::GetQuadsRectangle(QuadFieldQuery& qfq, const float3& mins, cons
 {
 	mins.AssertNaNs();
 	maxs.AssertNaNs();
-	qfq.quads = tempQuads.ReserveVector();
+	qfq.quads = GetQueryCaches(qfq).tempQuads.ReserveVector();
 
 	const int2 min = WorldPosToQuadField(mins);
 	const int2 max = WorldPosToQuadField(maxs);
@@ -215,7 +253,6 @@ void CQuadField::GetQuadsRectangle(QuadFieldQuery& qfq, const float3& mins, cons
 
 	return;
 }
-#endif // UNIT_TEST
 
 
 /// note: this function got an UnitTest, check the tests/ folder!
@@ -224,7 +261,7 @@ void CQuadField::GetQuadsOnRay(QuadFieldQuery& qfq, const float3& start, const f
 	dir.AssertNaNs();
 	start.AssertNaNs();
 
-	auto& queryQuads = *(qfq.quads = tempQuads.ReserveVector());
+	auto& queryQuads = *(qfq.quads = GetQueryCaches(qfq).tempQuads.ReserveVector());
 
 	const float3 to = start + (dir * length);
 
@@ -307,6 +344,87 @@ void CQuadField::GetQuadsOnRay(QuadFieldQuery& qfq, const float3& start, const f
 
 
 #ifndef UNIT_TEST
+// skips objects overlapping several quads which the current query has
+// already looked at; marks them via the shared CWorldObject::tempNum,
+// or via stamps owned by the calling thread in read-only mode
+struct CQuadField::QueryVisitor {
+public:
+	QueryVisitor(CQuadField& qf, const QuadFieldQuery& qfq)
+		: caches(qf.GetQueryCaches(qfq))
+		, readOnly(qf.InReadOnlyMode())
+		, tempNum(readOnly? ++caches.curStamp: gs->GetTempNum())
+	{}
+
+	bool Visited(CUnit* u) { return (Visited(u, caches.unitStamps)); }
+	bool Visited(CFeature* f) { return (Visited(f, caches.featureStamps)); }
+	bool Visited(CProjectile* p) { return (Visited(p, caches.projectileStamps)); }
+
+	// repulsers have no id, but there are few enough to just search the results
+	bool Visited(CPlasmaRepulser* r, const std::vector<CPlasmaRepulser*>& found, size_t foundBeg) {
+		if (readOnly)
+			return (std::find(found.begin() + foundBeg, found.end(), r) != found.end());
+
+		if (r->tempNum == tempNum)
+			return true;
+
+		r->tempNum = tempNum;
+		return false;
+	}
+
+private:
+	bool Visited(CWorldObject* o, QueryObjectStamps& stamps) {
+		if (readOnly)
+			return (stamps.Visited(o->id, tempNum));
+
+		if (o->tempNum == tempNum)
+			return true;
+
+		o->tempNum = tempNum;
+		return false;
+	}
+
+private:
+	QueryCaches& caches;
+
+	const bool readOnly;
+	const int tempNum;
+};
+
+
+void CQuadField::InsertQuadUnit(Quad& quad, CUnit* unit)
+{
+	assert(!InReadOnlyMode());
+	numSolidChanges += 1;
+
+	spring::VectorInsertUnique(quad.units, unit, false);
+	spring::VectorInsertUnique(quad.teamUnits[unit->allyteam], unit, false);
+
+	if (!useUnitSoA)
+		return;
+
+	quad.unitData.PushBack(unit->pos, unit->radius);
+}
+
+void CQuadField::EraseQuadUnit(Quad& quad, CUnit* unit)
+{
+	assert(!InReadOnlyMode());
+	numSolidChanges += 1;
+
+	const auto iter = std::find(quad.units.begin(), quad.units.end(), unit);
+
+	if (iter == quad.units.end())
+		return;
+
+	if (useUnitSoA)
+		quad.unitData.Erase(iter - quad.units.begin());
+
+	*iter = quad.units.back();
+	quad.units.pop_back();
+
+	spring::VectorErase(quad.teamUnits[unit->allyteam], unit);
+}
+
+
 bool CQuadField::InsertUnitIf(CUnit* unit, const float3& wpos)
 {
 	assert(unit != nullptr);
@@ -322,8 +440,7 @@ bool CQuadField::InsertUnitIf(CUnit* unit, const float3& wpos)
 	if (!spring::VectorInsertUnique(unit->quads, wposQuadIdx, true))
 		return false;
 
-	spring::VectorInsertUnique(baseQuads[wposQuadIdx].units, unit, false);
-	spring::VectorInsertUnique(baseQuads[wposQuadIdx].teamUnits[unit->allyteam], unit, false);
+	InsertQuadUnit(baseQuads[wposQuadIdx], unit);
 	return true;
 }
 
@@ -352,8 +469,7 @@ bool CQuadField::RemoveUnitIf(CUnit* unit, const float3& wpos)
 	if (!spring::VectorErase(unit->quads, wposQuadIdx))
 		return false;
 
-	spring::VectorErase(baseQuads[wposQuadIdx].units, unit);
-	spring::VectorErase(baseQuads[wposQuadIdx].teamUnits[unit->allyteam], unit);
+	EraseQuadUnit(baseQuads[wposQuadIdx], unit);
 	return true;
 }
 #endif
@@ -363,33 +479,51 @@ bool CQuadField::RemoveUnitIf(CUnit* unit, const float3& wpos)
 #ifndef UNIT_TEST
 void CQuadField::MovedUnit(CUnit* unit)
 {
+	assert(!InReadOnlyMode());
+	numSolidChanges += 1;
+
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, unit->pos, unit->radius);
 
 	// compare if the quads have changed, if not stop here
 	if (qfQuery.quads->size() == unit->quads.size()) {
-		if (std::equal(qfQuery.quads->begin(), qfQuery.quads->end(), unit->quads.begin()))
+		if (std::equal(qfQuery.quads->begin(), qfQuery.quads->end(), unit->quads.begin())) {
+			// membership is unchanged, but the packed copy might not be
+			MovedUnitData(unit);
 			return;
+		}
 	}
 
 	for (const int qi: unit->quads) {
-		spring::VectorErase(baseQuads[qi].units, unit);
-		spring::VectorErase(baseQuads[qi].teamUnits[unit->allyteam], unit);
+		EraseQuadUnit(baseQuads[qi], unit);
 	}
 
 	for (const int qi: *qfQuery.quads) {
-		spring::VectorInsertUnique(baseQuads[qi].units, unit, false);
-		spring::VectorInsertUnique(baseQuads[qi].teamUnits[unit->allyteam], unit, false);
+		InsertQuadUnit(baseQuads[qi], unit);
 	}
 
 	unit->quads = std::move(*qfQuery.quads);
 }
 
+void CQuadField::MovedUnitData(const CUnit* unit)
+{
+	if (!useUnitSoA)
+		return;
+
+	for (const int qi: unit->quads) {
+		Quad& quad = baseQuads[qi];
+
+		const bool found = quad.unitData.Refresh(quad.units, unit);
+
+		assert(found);
+		(void) found;
+	}
+}
+
 void CQuadField::RemoveUnit(CUnit* unit)
 {
 	for (const int qi: unit->quads) {
-		spring::VectorErase(baseQuads[qi].units, unit);
-		spring::VectorErase(baseQuads[qi].teamUnits[unit->allyteam], unit);
+		EraseQuadUnit(baseQuads[qi], unit);
 	}
 
 	unit->quads.clear();
@@ -408,6 +542,9 @@ void CQuadField::RemoveUnit(CUnit* unit)
 
 void CQuadField::MovedRepulser(CPlasmaRepulser* repulser)
 {
+	assert(!InReadOnlyMode());
+	numSolidChanges += 1;
+
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, repulser->weaponMuzzlePos, repulser->GetRadius());
 
@@ -432,6 +569,9 @@ void CQuadField::MovedRepulser(CPlasmaRepulser* repulser)
 
 void CQuadField::RemoveRepulser(CPlasmaRepulser* repulser)
 {
+	assert(!InReadOnlyMode());
+	numSolidChanges += 1;
+
 	for (const int qi: repulser->GetQuads()) {
 		spring::VectorErase(baseQuads[qi].repulsers, repulser);
 	}
@@ -450,6 +590,9 @@ void CQuadField::RemoveRepulser(CPlasmaRepulser* repulser)
 
 void CQuadField::AddFeature(CFeature* feature)
 {
+	assert(!InReadOnlyMode());
+	numSolidChanges += 1;
+
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, feature->pos, feature->radius);
 
@@ -460,6 +603,9 @@ void CQuadField::AddFeature(CFeature* feature)
 
 void CQuadField::RemoveFeature(CFeature* feature)
 {
+	assert(!InReadOnlyMode());
+	numSolidChanges += 1;
+
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, feature->pos, feature->radius);
 
@@ -480,6 +626,8 @@ void CQuadField::RemoveFeature(CFeature* feature)
 
 void CQuadField::MovedProjectile(CProjectile* p)
 {
+	assert(!InReadOnlyMode());
+
 	if (!p->synced)
 		return;
 	// hit-scan projectiles do NOT move!
@@ -495,6 +643,8 @@ void CQuadField::MovedProjectile(CProjectile* p)
 
 void CQuadField::AddProjectile(CProjectile* p)
 {
+	assert(!InReadOnlyMode());
+
 	assert(p->synced);
 
 	if (p->hitscan) {
@@ -516,6 +666,8 @@ void CQuadField::AddProjectile(CProjectile* p)
 
 void CQuadField::RemoveProjectile(CProjectile* p)
 {
+	assert(!InReadOnlyMode());
+
 	assert(p->synced);
 
 	for (const int qi: p->quads) {
@@ -533,15 +685,13 @@ void CQuadField::GetUnits(QuadFieldQuery& qfq, const float3& pos, float radius)
 {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.units = tempUnits.ReserveVector();
+	QueryVisitor visitor(*this, qfq);
+	qfq.units = GetQueryCaches(qfq).tempUnits.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
+			if (visitor.Visited(u))
 				continue;
-
-			u->tempNum = tempNum;
 			qfq.units->push_back(u);
 		}
 	}
@@ -553,26 +703,25 @@ void CQuadField::GetUnitsExact(QuadFieldQuery& qfq, const float3& pos, float rad
 {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.units = tempUnits.ReserveVector();
+	QueryVisitor visitor(*this, qfq);
+	qfq.units = GetQueryCaches(qfq).tempUnits.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
-		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
-				continue;
-
-			u->tempNum = tempNum;
-
-			const float totRad       = radius + u->radius;
-			const float totRadSq     = totRad * totRad;
-			const float posUnitDstSq = spherical?
-				pos.SqDistance(u->pos):
-				pos.SqDistance2D(u->pos);
+		const Quad& quad = baseQuads[qi];
 
-			if (posUnitDstSq >= totRadSq)
-				continue;
+		// a unit that fails the test in one quad fails it in all, so
+		// only the hits need to be marked as visited
+		const auto AddUnit = [&](CUnit* u) {
+			if (visitor.Visited(u))
+				return;
 
 			qfq.units->push_back(u);
+		};
+
+		if (useUnitSoA) {
+			quad.unitData.ForEachInSphere(quad.units, pos, radius, spherical, AddUnit);
+		} else {
+			QuadFieldSoA::ForEachInSphereScalar(quad.units, pos, radius, spherical, AddUnit);
 		}
 	}
 
@@ -583,24 +732,23 @@ void CQuadField::GetUnitsExact(QuadFieldQuery& qfq, const float3& mins, const fl
 {
 	QuadFieldQuery qfQuery;
 	GetQuadsRectangle(qfQuery, mins, maxs);
-	const int tempNum = gs->GetTempNum();
-	qfq.units = tempUnits.ReserveVector();
+	QueryVisitor visitor(*this, qfq);
+	qfq.units = GetQueryCaches(qfq).tempUnits.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
-		for (CUnit* unit: baseQuads[qi].units) {
-
-			if (unit->tempNum == tempNum)
-				continue;
+		const Quad& quad = baseQuads[qi];
 
-			unit->tempNum = tempNum;
-
-			const float3& pos = unit->pos;
-			if (pos.x < mins.x || pos.x > maxs.x)
-				continue;
-			if (pos.z < mins.z || pos.z > maxs.z)
-				continue;
+		const auto AddUnit = [&](CUnit* unit) {
+			if (visitor.Visited(unit))
+				return;
 
 			qfq.units->push_back(unit);
+		};
+
+		if (useUnitSoA) {
+			quad.unitData.ForEachInRect(quad.units, mins, maxs, AddUnit);
+		} else {
+			QuadFieldSoA::ForEachInRectScalar(quad.units, mins, maxs, AddUnit);
 		}
 	}
 
@@ -612,16 +760,14 @@ void CQuadField::GetFeaturesExact(QuadFieldQuery& qfq, const float3& pos, float
 {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.features = tempFeatures.ReserveVector();
+	QueryVisitor visitor(*this, qfq);
+	qfq.features = GetQueryCaches(qfq).tempFeatures.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CFeature* f: baseQuads[qi].features) {
-			if (f->tempNum == tempNum)
+			if (visitor.Visited(f))
 				continue;
 
-			f->tempNum = tempNum;
-
 			const float totRad       = radius + f->radius;
 			const float totRadSq     = totRad * totRad;
 			const float posDstSq = spherical?
@@ -642,16 +788,14 @@ void CQuadField::GetFeaturesExact(QuadFieldQuery& qfq, const float3& mins, const
 {
 	QuadFieldQuery qfQuery;
 	GetQuadsRectangle(qfQuery, mins, maxs);
-	const int tempNum = gs->GetTempNum();
-	qfq.features = tempFeatures.ReserveVector();
+	QueryVisitor visitor(*this, qfq);
+	qfq.features = GetQueryCaches(qfq).tempFeatures.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CFeature* feature: baseQuads[qi].features) {
-			if (feature->tempNum == tempNum)
+			if (visitor.Visited(feature))
 				continue;
 
-			feature->tempNum = tempNum;
-
 			const float3& pos = feature->pos;
 			if (pos.x < mins.x || pos.x > maxs.x)
 				continue;
@@ -671,16 +815,14 @@ void CQuadField::GetProjectilesExact(QuadFieldQuery& qfq, const float3& pos, flo
 {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.projectiles = tempProjectiles.ReserveVector();
+	QueryVisitor visitor(*this, qfq);
+	qfq.projectiles = GetQueryCaches(qfq).tempProjectiles.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CProjectile* p: baseQuads[qi].projectiles) {
-			if (p->tempNum == tempNum)
+			if (visitor.Visited(p))
 				continue;
 
-			p->tempNum = tempNum;
-
 			if (pos.SqDistance(p->pos) >= Square(radius + p->radius))
 				continue;
 
@@ -695,16 +837,14 @@ void CQuadField::GetProjectilesExact(QuadFieldQuery& qfq, const float3& mins, co
 {
 	QuadFieldQuery qfQuery;
 	GetQuadsRectangle(qfQuery, mins, maxs);
-	const int tempNum = gs->GetTempNum();
-	qfq.projectiles = tempProjectiles.ReserveVector();
+	QueryVisitor visitor(*this, qfq);
+	qfq.projectiles = GetQueryCaches(qfq).tempProjectiles.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CProjectile* p: baseQuads[qi].projectiles) {
-			if (p->tempNum == tempNum)
+			if (visitor.Visited(p))
 				continue;
 
-			p->tempNum = tempNum;
-
 			const float3& pos = p->pos;
 			if (pos.x < mins.x || pos.x > maxs.x)
 				continue;
@@ -729,16 +869,14 @@ void CQuadField::GetSolidsExact(
 ) {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.solids = tempSolids.ReserveVector();
+	QueryVisitor visitor(*this, qfq);
+	qfq.solids = GetQueryCaches(qfq).tempSolids.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
+			if (visitor.Visited(u))
 				continue;
 
-			u->tempNum = tempNum;
-
 			if (!u->HasPhysicalStateBit(physicalStateBits))
 				continue;
 			if (!u->HasCollidableStateBit(collisionStateBits))
@@ -750,11 +888,9 @@ void CQuadField::GetSolidsExact(
 		}
 
 		for (CFeature* f: baseQuads[qi].features) {
-			if (f->tempNum == tempNum)
+			if (visitor.Visited(f))
 				continue;
 
-			f->tempNum = tempNum;
-
 			if (!f->HasPhysicalStateBit(physicalStateBits))
 				continue;
 			if (!f->HasCollidableStateBit(collisionStateBits))
@@ -778,15 +914,13 @@ bool CQuadField::NoSolidsExact(
 ) {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
+	QueryVisitor visitor(*this, qfQuery);
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
+			if (visitor.Visited(u))
 				continue;
 
-			u->tempNum = tempNum;
-
 			if (!u->HasPhysicalStateBit(physicalStateBits))
 				continue;
 			if (!u->HasCollidableStateBit(collisionStateBits))
@@ -798,11 +932,9 @@ bool CQuadField::NoSolidsExact(
 		}
 
 		for (CFeature* f: baseQuads[qi].features) {
-			if (f->tempNum == tempNum)
+			if (visitor.Visited(f))
 				continue;
 
-			f->tempNum = tempNum;
-
 			if (!f->HasPhysicalStateBit(physicalStateBits))
 				continue;
 			if (!f->HasCollidableStateBit(collisionStateBits))
@@ -818,6 +950,83 @@ bool CQuadField::NoSolidsExact(
 }
 
 
+void CQuadField::GetUnitsExactMt(
+	std::vector<CUnit*>& units,
+	std::vector<int>& quads,
+	const float3& pos,
+	float radius,
+	bool spherical
+) {
+	QueryCaches& caches = queryCaches[GetThreadNum()];
+
+	const int stamp = ++caches.curStamp;
+
+	GetQuadsMt(quads, pos, radius);
+	units.clear();
+
+	for (const int qi: quads) {
+		const Quad& quad = baseQuads[qi];
+
+		const auto AddUnit = [&](CUnit* u) {
+			if (caches.unitStamps.Visited(u->id, stamp))
+				return;
+
+			units.push_back(u);
+		};
+
+		if (useUnitSoA) {
+			quad.unitData.ForEachInSphere(quad.units, pos, radius, spherical, AddUnit);
+		} else {
+			QuadFieldSoA::ForEachInSphereScalar(quad.units, pos, radius, spherical, AddUnit);
+		}
+	}
+}
+
+void CQuadField::GetSolidsExactMt(
+	std::vector<CSolidObject*>& solids,
+	std::vector<int>& quads,
+	const float3& pos,
+	const float radius,
+	const unsigned int physicalStateBits,
+	const unsigned int collisionStateBits
+) {
+	QueryCaches& caches = queryCaches[GetThreadNum()];
+
+	const int stamp = ++caches.curStamp;
+
+	GetQuadsMt(quads, pos, radius);
+	solids.clear();
+
+	for (const int qi: quads) {
+		for (CUnit* u: baseQuads[qi].units) {
+			if (!u->HasPhysicalStateBit(physicalStateBits))
+				continue;
+			if (!u->HasCollidableStateBit(collisionStateBits))
+				continue;
+			if ((pos - u->pos).SqLength() >= Square(radius + u->radius))
+				continue;
+			if (caches.unitStamps.Visited(u->id, stamp))
+				continue;
+
+			solids.push_back(u);
+		}
+
+		for (CFeature* f: baseQuads[qi].features) {
+			if (!f->HasPhysicalStateBit(physicalStateBits))
+				continue;
+			if (!f->HasCollidableStateBit(collisionStateBits))
+				continue;
+			if ((pos - f->pos).SqLength() >= Square(radius + f->radius))
+				continue;
+			if (caches.featureStamps.Visited(f->id, stamp))
+				continue;
+
+			solids.push_back(f);
+		}
+	}
+}
+
+
 // optimization specifically for projectile collisions
 void CQuadField::GetUnitsAndFeaturesColVol(
 	const float3& pos,
@@ -826,22 +1035,21 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 	std::vector<CFeature*>& features,
 	std::vector<CPlasmaRepulser*>* repulsers
 ) {
-	const int tempNum = gs->GetTempNum();
-
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
+	QueryVisitor visitor(*this, qfQuery);
 	// start counting from the previous object-cache sizes
 
+	const size_t numRepulsers = (repulsers != nullptr)? repulsers->size(): 0;
+
 	for (const int qi: *qfQuery.quads) {
 		const Quad& quad = baseQuads[qi];
 
 		for (CUnit* u: quad.units) {
 			// prevent double adding
-			if (u->tempNum == tempNum)
+			if (visitor.Visited(u))
 				continue;
 
-			u->tempNum = tempNum;
-
 			const auto* colvol = &u->collisionVolume;
 			const float totRad = radius + colvol->GetBoundingRadius();
 
@@ -853,11 +1061,9 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 
 		for (CFeature* f: quad.features) {
 			// prevent double adding
-			if (f->tempNum == tempNum)
+			if (visitor.Visited(f))
 				continue;
 
-			f->tempNum = tempNum;
-
 			const auto* colvol = &f->collisionVolume;
 			const float totRad = radius + colvol->GetBoundingRadius();
 
@@ -869,11 +1075,9 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 		if (repulsers != nullptr) {
 			for (CPlasmaRepulser* r: quad.repulsers) {
 				// prevent double adding
-				if (r->tempNum == tempNum)
+				if (visitor.Visited(r, *repulsers, numRepulsers))
 					continue;
 
-				r->tempNum = tempNum;
-
 				const auto* colvol = &r->collisionVolume;
 				const float totRad = radius + colvol->GetBoundingRadius();
 
@@ -5,10 +5,13 @@
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 #include <vector>
 
+#include "QuadFieldSoA.h"
 #include "System/Misc/NonCopyable.h"
 #include "System/creg/creg_cond.h"
+#include "System/bitops.h"
 #include "System/float3.h"
 #include "System/type2.h"
 
@@ -22,21 +25,21 @@ struct QuadFieldQuery;
 template<typename T>
 class QueryVectorCache {
 public:
-	typedef std::pair<bool, std::vector<T>> PairType;
-
 	std::vector<T>* ReserveVector(size_t base = 0, size_t capa = 1024) {
-		const auto pred = [](const PairType& p) { return (!p.first); };
-		const auto iter = std::find_if(vectors.begin() + base, vectors.end(), pred);
-
-		if (iter != vectors.end()) {
-			iter->first = true;
-			iter->second.clear();
-			iter->second.reserve(capa);
-			return &iter->second;
+		// lowest unused slot at or after <base>
+		const uint32_t freeSlots = ~usedSlots & (ALL_SLOTS << base) & ALL_SLOTS;
+
+		if (freeSlots == 0) {
+			assert(false);
+			return nullptr;
 		}
 
-		assert(false);
-		return nullptr;
+		const unsigned int idx = bits_ffs(freeSlots) - 1;
+
+		usedSlots |= (1u << idx);
+		vectors[idx].clear();
+		vectors[idx].reserve(capa);
+		return &vectors[idx];
 	}
 
 	void ReserveAll(size_t capa) {
@@ -49,26 +52,52 @@ public:
 		if (released == nullptr)
 			return;
 
-		const auto pred = [&](const PairType& p) { return (&p.second == released); };
-		const auto iter = std::find_if(vectors.begin(), vectors.end(), pred);
+		for (size_t i = 0; i < vectors.size(); ++i) {
+			if (&vectors[i] != released)
+				continue;
 
-		if (iter == vectors.end()) {
-			assert(false);
+			usedSlots &= ~(1u << i);
 			return;
 		}
 
-		iter->first = false;
-	}
-	void ReleaseAll() {
-		for (auto& pair: vectors) {
-			ReleaseVector(&pair.second);
-		}
+		assert(false);
 	}
+	void ReleaseAll() { usedSlots = 0; }
+
 private:
 	// There should at most be 2 concurrent users of each vector type
-	// using 3 to be safe, increase this number if the assertions below
-	// fail
-	std::array<PairType, 3> vectors = {{{false, {}}, {false, {}}, {false, {}}}};
+	// (per thread) using 3 to be safe, increase this number if the
+	// assertions above fail
+	static constexpr size_t NUM_SLOTS = 3;
+	static constexpr uint32_t ALL_SLOTS = (1u << NUM_SLOTS) - 1;
+
+	std::array<std::vector<T>, NUM_SLOTS> vectors;
+
+	uint32_t usedSlots = 0;
+};
+
+
+// per-thread replacement for CWorldObject::tempNum, marks the objects a
+// query already visited by stamps indexed by object id, which keeps queries
+// on different threads from writing to shared objects
+class QueryObjectStamps {
+public:
+	// returns true if <id> was marked with <stamp> before, marks it otherwise
+	bool Visited(int id, int stamp) {
+		assert(id >= 0);
+
+		if (size_t(id) >= stamps.size())
+			stamps.resize(std::max(stamps.size() * 2, size_t(id) + 1), 0);
+
+		if (stamps[id] == stamp)
+			return true;
+
+		stamps[id] = stamp;
+		return false;
+	}
+
+private:
+	std::vector<int> stamps;
 };
 
 
@@ -89,7 +118,13 @@ public:
 	static void Resize(int quadSize);
 	*/
 
-	void Init(int2 mapDims, int quadSize);
+	/**
+	 * @param useUnitSoA if true, each quad also keeps a packed copy of the
+	 *   positions and radii of its units which the exact unit queries filter
+	 *   on; CUnit::Move and MovedUnit keep it current, so both backends give
+	 *   the same results (it is still a synced choice, like all of Init)
+	 */
+	void Init(int2 mapDims, int quadSize, bool useUnitSoA = false);
 	void Kill();
 
 	void GetQuads(QuadFieldQuery& qfq, float3 pos, float radius);
@@ -150,11 +185,40 @@ public:
 		const unsigned int collisionStateBits = 0xFFFFFFFF
 	);
 
+	/**
+	 * Variants of GetQuads, GetUnitsExact and GetSolidsExact which can be
+	 * called from worker threads (e.g. in for_mt bodies) without opening a
+	 * ReadOnlyScope, as long as no object is added to, moved within or
+	 * removed from the field concurrently. Results are written into
+	 * caller-owned vectors rather than the per-thread caches, and
+	 * duplicates are filtered through the calling thread's stamps rather
+	 * than object tempNum's; objects appear in the same order as for the
+	 * regular queries.
+	 */
+	void GetQuadsMt(std::vector<int>& quads, float3 pos, float radius) const;
+	void GetUnitsExactMt(
+		std::vector<CUnit*>& units,
+		std::vector<int>& quads,
+		const float3& pos,
+		float radius,
+		bool spherical = true
+	);
+	void GetSolidsExactMt(
+		std::vector<CSolidObject*>& solids,
+		std::vector<int>& quads,
+		const float3& pos,
+		const float radius,
+		const unsigned int physicalStateBits = 0xFFFFFFFF,
+		const unsigned int collisionStateBits = 0xFFFFFFFF
+	);
+
 
 	bool InsertUnitIf(CUnit* unit, const float3& wpos);
 	bool RemoveUnitIf(CUnit* unit, const float3& wpos);
 
 	void MovedUnit(CUnit* unit);
+	/// refreshes the packed position and radius of <unit> without changing its quads
+	void MovedUnitData(const CUnit* unit);
 	void RemoveUnit(CUnit* unit);
 
 	void AddFeature(CFeature* feature);
@@ -167,11 +231,40 @@ public:
 	void MovedRepulser(CPlasmaRepulser* repulser);
 	void RemoveRepulser(CPlasmaRepulser* repulser);
 
-	void ReleaseVector(std::vector<CUnit*>* v       ) { tempUnits.ReleaseVector(v); }
-	void ReleaseVector(std::vector<CFeature*>* v    ) { tempFeatures.ReleaseVector(v); }
-	void ReleaseVector(std::vector<CProjectile*>* v ) { tempProjectiles.ReleaseVector(v); }
-	void ReleaseVector(std::vector<CSolidObject*>* v) { tempSolids.ReleaseVector(v); }
-	void ReleaseVector(std::vector<int>* v          ) { tempQuads.ReleaseVector(v); }
+	void ReleaseVector(std::vector<CUnit*>* v       , int threadNum) { queryCaches[threadNum].tempUnits.ReleaseVector(v); }
+	void ReleaseVector(std::vector<CFeature*>* v    , int threadNum) { queryCaches[threadNum].tempFeatures.ReleaseVector(v); }
+	void ReleaseVector(std::vector<CProjectile*>* v , int threadNum) { queryCaches[threadNum].tempProjectiles.ReleaseVector(v); }
+	void ReleaseVector(std::vector<CSolidObject*>* v, int threadNum) { queryCaches[threadNum].tempSolids.ReleaseVector(v); }
+	void ReleaseVector(std::vector<int>* v          , int threadNum) { queryCaches[threadNum].tempQuads.ReleaseVector(v); }
+
+	static int GetThreadNum();
+
+	/**
+	 * Read-only query mode. While at least one ReadOnlyScope is alive, every
+	 * Get* query (and NoSolidsExact) may run concurrently on any thread, e.g.
+	 * from for_mt bodies during parallel sim phases:
+	 *  - QuadFieldQuery's draw their vectors from pools owned by the calling
+	 *    thread (as they always do)
+	 *  - objects overlapping several quads are de-duplicated through stamps
+	 *    owned by the calling thread instead of CWorldObject::tempNum, and
+	 *    gs->GetTempNum is not called, so nothing shared is written to
+	 * Results are identical (same objects, same order) to those outside the
+	 * scope. Adding, moving or removing objects is not allowed meanwhile
+	 * (asserted); scopes must be opened and closed on the main thread.
+	 */
+	struct ReadOnlyScope {
+		ReadOnlyScope();
+		~ReadOnlyScope();
+	};
+
+	bool InReadOnlyMode() const { return (readOnlyScopes > 0); }
+
+	/**
+	 * Bumped whenever a unit, feature or repulser is added, moved or removed;
+	 * callers that cache query results across other sim code can compare it
+	 * to detect when their results may have gone stale.
+	 */
+	unsigned int GetNumSolidChanges() const { return numSolidChanges; }
 
 	struct Quad {
 	public:
@@ -184,6 +277,7 @@ public:
 		Quad& operator = (const Quad& q) = delete;
 		Quad& operator = (Quad&& q) {
 			units = std::move(q.units);
+			unitData = std::move(q.unitData);
 			teamUnits = std::move(q.teamUnits);
 			features = std::move(q.features);
 			projectiles = std::move(q.projectiles);
@@ -195,6 +289,7 @@ public:
 		void Resize(int numAllyTeams) { teamUnits.resize(numAllyTeams); }
 		void Clear() {
 			units.clear();
+			unitData.Clear();
 			// reuse inner vectors when reloading
 			// teamUnits.clear();
 			for (auto& v: teamUnits) {
@@ -207,6 +302,8 @@ public:
 
 	public:
 		std::vector<CUnit*> units;
+		// index-parallel to <units>, only maintained if CQuadField::UseUnitSoA()
+		QuadFieldSoA unitData;
 		std::vector< std::vector<CUnit*> > teamUnits;
 		std::vector<CFeature*> features;
 		std::vector<CProjectile*> projectiles;
@@ -229,21 +326,42 @@ public:
 	int GetQuadSizeX() const { return quadSizeX; }
 	int GetQuadSizeZ() const { return quadSizeZ; }
 
+	bool UseUnitSoA() const { return useUnitSoA; }
+
 	constexpr static unsigned int BASE_QUAD_SIZE = 128;
 
 private:
 	int2 WorldPosToQuadField(const float3 p) const;
 	int WorldPosToQuadFieldIdx(const float3 p) const;
 
+	void InsertQuadUnit(Quad& quad, CUnit* unit);
+	void EraseQuadUnit(Quad& quad, CUnit* unit);
+
+	struct QueryVisitor;
+
 private:
-	std::vector<Quad> baseQuads;
+	// per-thread scratch for queries
+	struct QueryCaches {
+		// preallocated vectors for Get*Exact functions
+		QueryVectorCache<CUnit*> tempUnits;
+		QueryVectorCache<CFeature*> tempFeatures;
+		QueryVectorCache<CProjectile*> tempProjectiles;
+		QueryVectorCache<CSolidObject*> tempSolids;
+		QueryVectorCache<int> tempQuads;
+
+		// read-only mode (and *Mt query) replacements for CWorldObject::tempNum
+		QueryObjectStamps unitStamps;
+		QueryObjectStamps featureStamps;
+		QueryObjectStamps projectileStamps;
+
+		int curStamp = 0;
+	};
+
+	QueryCaches& GetQueryCaches(const QuadFieldQuery& qfq);
 
-	// preallocated vectors for Get*Exact functions
-	QueryVectorCache<CUnit*> tempUnits;
-	QueryVectorCache<CFeature*> tempFeatures;
-	QueryVectorCache<CProjectile*> tempProjectiles;
-	QueryVectorCache<CSolidObject*> tempSolids;
-	QueryVectorCache<int> tempQuads;
+private:
+	std::vector<Quad> baseQuads;
+	std::vector<QueryCaches> queryCaches;
 
 	float2 invQuadSize;
 
@@ -252,18 +370,24 @@ private:
 
 	int quadSizeX;
 	int quadSizeZ;
+
+	bool useUnitSoA = false;
+
+	int readOnlyScopes = 0;
+	unsigned int numSolidChanges = 0;
 };
 
 extern CQuadField quadField;
 
 
 struct QuadFieldQuery {
+	QuadFieldQuery(): threadNum(CQuadField::GetThreadNum()) {}
 	~QuadFieldQuery() {
-		quadField.ReleaseVector(units);
-		quadField.ReleaseVector(features);
-		quadField.ReleaseVector(projectiles);
-		quadField.ReleaseVector(solids);
-		quadField.ReleaseVector(quads);
+		quadField.ReleaseVector(units, threadNum);
+		quadField.ReleaseVector(features, threadNum);
+		quadField.ReleaseVector(projectiles, threadNum);
+		quadField.ReleaseVector(solids, threadNum);
+		quadField.ReleaseVector(quads, threadNum);
 	}
 
 	std::vector<CUnit*>* units = nullptr;
@@ -271,6 +395,9 @@ struct QuadFieldQuery {
 	std::vector<CProjectile*>* projectiles = nullptr;
 	std::vector<CSolidObject*>* solids = nullptr;
 	std::vector<int>* quads = nullptr;
+
+	// vectors are always returned to the pool of the thread that reserved them
+	const int threadNum;
 };
 
 
@@ -0,0 +1,116 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+
+#include "xsimd/xsimd.hpp"
+#include "QuadFieldSoA.h"
+
+using SIMDVfloat = xsimd::simd_type<float>;
+
+// size is adjusted based on SIMD extensions supported
+static constexpr size_t simdSize = SIMDVfloat::size;
+
+static_assert((QuadFieldSoA::BLOCK_SIZE % simdSize) == 0, "");
+
+
+static inline uint32_t GetLaneMask(const xsimd::batch_bool<float, simdSize>& b)
+{
+#if (XSIMD_X86_INSTR_SET >= XSIMD_X86_AVX_VERSION && XSIMD_X86_INSTR_SET < XSIMD_X86_AVX512_VERSION)
+	return _mm256_movemask_ps(b);
+#elif (XSIMD_X86_INSTR_SET >= XSIMD_X86_SSE_VERSION && XSIMD_X86_INSTR_SET < XSIMD_X86_AVX_VERSION)
+	return _mm_movemask_ps(b);
+#else
+	uint32_t mask = 0;
+
+	for (size_t j = 0; j < simdSize; j++) {
+		mask |= (uint32_t(b[j]) << j);
+	}
+
+	return mask;
+#endif
+}
+
+
+// NOTE:
+//   the arithmetic below must happen in the same order as in the
+//   scalar code (float3::SqDistance{2D}) so both backends give the
+//   same answers; do not introduce fma's or reassociate the sums
+uint32_t QuadFieldSoA::TestSphereBlock(size_t blockIdx, const float3& pos, float radius, bool spherical) const
+{
+	const size_t idxBeg = blockIdx * BLOCK_SIZE;
+	const size_t idxEnd = std::min(idxBeg + BLOCK_SIZE, Size());
+
+	// size for which the vectorization is possible
+	const size_t vecEnd = idxEnd - (idxEnd - idxBeg) % simdSize;
+
+	uint32_t mask = 0;
+
+	const SIMDVfloat qx(pos.x);
+	const SIMDVfloat qy(pos.y);
+	const SIMDVfloat qz(pos.z);
+	const SIMDVfloat qr(radius);
+
+	// SIMD vectorized loop
+	if (spherical) {
+		for (size_t i = idxBeg; i < vecEnd; i += simdSize) {
+			const SIMDVfloat dx = qx - xsimd::load_unaligned(&posX[i]);
+			const SIMDVfloat dy = qy - xsimd::load_unaligned(&posY[i]);
+			const SIMDVfloat dz = qz - xsimd::load_unaligned(&posZ[i]);
+			const SIMDVfloat tr = qr + xsimd::load_unaligned(&radii[i]);
+
+			mask |= (GetLaneMask((dx * dx + dy * dy + dz * dz) < (tr * tr)) << (i - idxBeg));
+		}
+	} else {
+		for (size_t i = idxBeg; i < vecEnd; i += simdSize) {
+			const SIMDVfloat dx = qx - xsimd::load_unaligned(&posX[i]);
+			const SIMDVfloat dz = qz - xsimd::load_unaligned(&posZ[i]);
+			const SIMDVfloat tr = qr + xsimd::load_unaligned(&radii[i]);
+
+			mask |= (GetLaneMask((dx * dx + dz * dz) < (tr * tr)) << (i - idxBeg));
+		}
+	}
+
+	// remaining part that cannot be vectorized
+	for (size_t i = vecEnd; i < idxEnd; i++) {
+		const float3 p = {posX[i], posY[i], posZ[i]};
+		const float totRad = radius + radii[i];
+		const float dstSq = spherical? pos.SqDistance(p): pos.SqDistance2D(p);
+
+		mask |= (uint32_t(dstSq < (totRad * totRad)) << (i - idxBeg));
+	}
+
+	return mask;
+}
+
+uint32_t QuadFieldSoA::TestRectBlock(size_t blockIdx, const float3& mins, const float3& maxs) const
+{
+	const size_t idxBeg = blockIdx * BLOCK_SIZE;
+	const size_t idxEnd = std::min(idxBeg + BLOCK_SIZE, Size());
+	const size_t vecEnd = idxEnd - (idxEnd - idxBeg) % simdSize;
+
+	uint32_t mask = 0;
+
+	const SIMDVfloat minX(mins.x);
+	const SIMDVfloat minZ(mins.z);
+	const SIMDVfloat maxX(maxs.x);
+	const SIMDVfloat maxZ(maxs.z);
+
+	for (size_t i = idxBeg; i < vecEnd; i += simdSize) {
+		const SIMDVfloat px = xsimd::load_unaligned(&posX[i]);
+		const SIMDVfloat pz = xsimd::load_unaligned(&posZ[i]);
+
+		// written as a rejection test to match GetUnitsExact(mins, maxs)
+		const auto miss = (px < minX) | (px > maxX) | (pz < minZ) | (pz > maxZ);
+
+		mask |= ((~GetLaneMask(miss) & ((1u << simdSize) - 1)) << (i - idxBeg));
+	}
+
+	for (size_t i = vecEnd; i < idxEnd; i++) {
+		const bool missX = (posX[i] < mins.x || posX[i] > maxs.x);
+		const bool missZ = (posZ[i] < mins.z || posZ[i] > maxs.z);
+
+		mask |= (uint32_t(!missX && !missZ) << (i - idxBeg));
+	}
+
+	return mask;
+}
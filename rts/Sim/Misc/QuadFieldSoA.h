@@ -0,0 +1,129 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef QUAD_FIELD_SOA_H
+#define QUAD_FIELD_SOA_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "System/float3.h"
+#include "System/bitops.h"
+
+/**
+ * Structure-of-arrays copy of the positions and radii of the objects in one
+ * CQuadField quad, kept index-parallel with the quad's object-pointer vector.
+ * Lets the exact-distance filters run (vectorized) over tightly packed floats
+ * and only dereference the objects that pass.
+ *
+ * The Test*Block functions return a mask with bit <i> set iff the object at
+ * index (blockIdx * BLOCK_SIZE + i) passes; results are bit-identical to the
+ * scalar ForEachIn*Scalar tests. The owner has to Refresh the copy whenever
+ * an object's position or radius changes, or both will disagree.
+ */
+class QuadFieldSoA {
+public:
+	static constexpr size_t BLOCK_SIZE = 32;
+
+	void Clear() {
+		posX.clear();
+		posY.clear();
+		posZ.clear();
+		radii.clear();
+	}
+
+	void PushBack(const float3& pos, float radius) {
+		posX.push_back(pos.x);
+		posY.push_back(pos.y);
+		posZ.push_back(pos.z);
+		radii.push_back(radius);
+	}
+
+	// same swap-with-back erasure as spring::VectorErase
+	void Erase(size_t idx) {
+		posX[idx] = posX.back(); posX.pop_back();
+		posY[idx] = posY.back(); posY.pop_back();
+		posZ[idx] = posZ.back(); posZ.pop_back();
+		radii[idx] = radii.back(); radii.pop_back();
+	}
+
+	void Set(size_t idx, const float3& pos, float radius) {
+		posX[idx] = pos.x;
+		posY[idx] = pos.y;
+		posZ[idx] = pos.z;
+		radii[idx] = radius;
+	}
+
+	// re-reads the position and radius of <object> from itself
+	template<typename T> bool Refresh(const std::vector<T*>& objects, const T* object) {
+		const auto iter = std::find(objects.begin(), objects.end(), object);
+
+		if (iter == objects.end())
+			return false;
+
+		Set(iter - objects.begin(), object->pos, object->radius);
+		return true;
+	}
+
+	size_t Size() const { return (radii.size()); }
+	size_t NumBlocks() const { return ((Size() + BLOCK_SIZE - 1) / BLOCK_SIZE); }
+
+	/**
+	 * Calls <hit> for each object in <objects> (index-parallel to the packed
+	 * data) whose sphere overlaps the sphere (or infinite cylinder) around
+	 * <pos>; the packed and the scalar variant give the same hits in the
+	 * same order as long as the packed data is current (see Refresh).
+	 */
+	template<typename T, typename F> void ForEachInSphere(const std::vector<T*>& objects, const float3& pos, float radius, bool spherical, F&& hit) const {
+		for (size_t b = 0, n = NumBlocks(); b < n; b++) {
+			for (uint32_t mask = TestSphereBlock(b, pos, radius, spherical); mask != 0; mask &= (mask - 1)) {
+				hit(objects[b * BLOCK_SIZE + (bits_ffs(mask) - 1)]);
+			}
+		}
+	}
+	template<typename T, typename F> static void ForEachInSphereScalar(const std::vector<T*>& objects, const float3& pos, float radius, bool spherical, F&& hit) {
+		for (T* object: objects) {
+			const float totRad = radius + object->radius;
+			const float dstSq  = spherical? pos.SqDistance(object->pos): pos.SqDistance2D(object->pos);
+
+			if (dstSq >= (totRad * totRad))
+				continue;
+
+			hit(object);
+		}
+	}
+
+	/// same for objects whose center lies within the xz-rectangle spanned by <mins> and <maxs>
+	template<typename T, typename F> void ForEachInRect(const std::vector<T*>& objects, const float3& mins, const float3& maxs, F&& hit) const {
+		for (size_t b = 0, n = NumBlocks(); b < n; b++) {
+			for (uint32_t mask = TestRectBlock(b, mins, maxs); mask != 0; mask &= (mask - 1)) {
+				hit(objects[b * BLOCK_SIZE + (bits_ffs(mask) - 1)]);
+			}
+		}
+	}
+	template<typename T, typename F> static void ForEachInRectScalar(const std::vector<T*>& objects, const float3& mins, const float3& maxs, F&& hit) {
+		for (T* object: objects) {
+			const float3& pos = object->pos;
+
+			if (pos.x < mins.x || pos.x > maxs.x)
+				continue;
+			if (pos.z < mins.z || pos.z > maxs.z)
+				continue;
+
+			hit(object);
+		}
+	}
+
+	/// objects whose sphere overlaps the sphere (or infinite cylinder) around <pos>
+	uint32_t TestSphereBlock(size_t blockIdx, const float3& pos, float radius, bool spherical) const;
+	/// objects whose center lies within the xz-rectangle spanned by <mins> and <maxs>
+	uint32_t TestRectBlock(size_t blockIdx, const float3& mins, const float3& maxs) const;
+
+private:
+	std::vector<float> posX;
+	std::vector<float> posY;
+	std::vector<float> posZ;
+	std::vector<float> radii;
+};
+
+#endif /* QUAD_FIELD_SOA_H */
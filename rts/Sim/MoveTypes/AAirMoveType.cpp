@@ -6,6 +6,7 @@
 #include "Map/Ground.h"
 #include "Map/MapInfo.h"
 #include "Rendering/Env/Particles/Classes/SmokeProjectile.h"
+#include "Sim/Misc/GlobalSynced.h"
 #include "Sim/Misc/QuadField.h"
 #include "Sim/Misc/SmoothHeightMesh.h"
 #include "Sim/Projectiles/ExplosionGenerator.h"
@@ -14,6 +15,7 @@
 #include "Sim/Units/UnitDef.h"
 #include "Sim/Units/CommandAI/CommandAI.h"
 #include "System/SpringMath.h"
+#include "System/Threading/ThreadPool.h"
 
 CR_BIND_DERIVED_INTERFACE(AAirMoveType, AMoveType)
 
@@ -40,12 +42,16 @@ CR_REG_METADATA(AAirMoveType, (
 	CR_MEMBER(floatOnWater),
 
 	CR_MEMBER(lastCollidee),
+	CR_IGNORED(collideeCache),
 
 	CR_MEMBER(crashExpGenID)
 ))
 
 
 
+// per-thread scratch buffers for FindCollidee queries
+static std::array<std::pair<std::vector<CUnit*>, std::vector<int>>, ThreadPool::MAX_THREADS> collideeQueryBuffers;
+
 static inline float AAMTGetGroundHeightAW(float x, float z) { return CGround::GetHeightAboveWater(x, z); }
 static inline float AAMTGetGroundHeight  (float x, float z) { return CGround::GetHeightReal      (x, z); }
 static inline float AAMTGetSmoothGroundHeightAW(float x, float z) { return smoothGround.GetHeightAboveWater(x, z); }
@@ -220,18 +226,38 @@ void AAirMoveType::UpdateLanding()
 }
 
 
+void AAirMoveType::UpdatePreCollisionsMt()
+{
+	collideeCache.frameNum = -1;
+
+	// same stagger as used by the CheckForCollision call-sites
+	if (!collide || ((gs->frameNum + owner->id) & 3) != 0)
+		return;
+
+	auto& buffers = collideeQueryBuffers[ThreadPool::GetThreadNum()];
+
+	collideeCache.midPos = owner->midPos;
+	collideeCache.frontDir = owner->frontdir;
+	collideeCache.collidee = FindCollidee(collideeCache.state, buffers.first, buffers.second);
+	collideeCache.frameNum = gs->frameNum;
+}
+
+
 void AAirMoveType::CheckForCollision()
 {
 	if (!collide)
 		return;
 
-	const SyncedFloat3& pos = owner->midPos;
-	const SyncedFloat3& forward = owner->frontdir;
-
-	float dist = 200.0f;
+	CUnit* collidee = nullptr;
+	CollisionState state = COLLISION_NOUNIT;
 
-	QuadFieldQuery qfQuery;
-	quadField.GetUnitsExact(qfQuery, pos + forward * 121.0f, dist);
+	if (collideeCache.frameNum == gs->frameNum && collideeCache.midPos.same(owner->midPos) && collideeCache.frontDir.same(owner->frontdir)) {
+		collidee = collideeCache.collidee;
+		state = collideeCache.state;
+	} else {
+		auto& buffers = collideeQueryBuffers[ThreadPool::GetThreadNum()];
+		collidee = FindCollidee(state, buffers.first, buffers.second);
+	}
 
 	if (lastCollidee != nullptr) {
 		DeleteDeathDependence(lastCollidee, DEPENDENCE_LASTCOLWARN);
@@ -240,8 +266,27 @@ void AAirMoveType::CheckForCollision()
 		collisionState = COLLISION_NOUNIT;
 	}
 
+	if ((lastCollidee = collidee) == nullptr)
+		return;
+
+	collisionState = state;
+	AddDeathDependence(lastCollidee, DEPENDENCE_LASTCOLWARN);
+}
+
+CUnit* AAirMoveType::FindCollidee(CollisionState& state, std::vector<CUnit*>& units, std::vector<int>& quads) const
+{
+	const float3& pos = owner->midPos;
+	const float3& forward = owner->frontdir;
+
+	float dist = 200.0f;
+
+	CUnit* collidee = nullptr;
+
+	// NOTE: may run on a worker thread, so only the read-only query is allowed
+	quadField.GetUnitsExactMt(units, quads, pos + forward * 121.0f, dist);
+
 	// find closest potential collidee
-	for (CUnit* unit: *qfQuery.units) {
+	for (CUnit* unit: units) {
 		if (unit == owner || !unit->unitDef->canfly)
 			continue;
 
@@ -259,29 +304,25 @@ void AAirMoveType::CheckForCollision()
 
 		if (ortoDif.SqLength() < (minOrtoDif * minOrtoDif)) {
 			dist = frontLength;
-			lastCollidee = const_cast<CUnit*>(unit);
+			collidee = unit;
 		}
 	}
 
-	if (lastCollidee != nullptr) {
-		collisionState = COLLISION_DIRECT;
-		AddDeathDependence(lastCollidee, DEPENDENCE_LASTCOLWARN);
-		return;
+	if (collidee != nullptr) {
+		state = COLLISION_DIRECT;
+		return collidee;
 	}
 
-	for (CUnit* u: *qfQuery.units) {
+	for (CUnit* u: units) {
 		if (u == owner)
 			continue;
 
 		if ((u->midPos - pos).SqLength() > Square((owner->radius + u->radius) * 2.0f))
 			continue;
 
-		lastCollidee = u;
+		collidee = u;
 	}
 
-	if (lastCollidee != nullptr) {
-		collisionState = COLLISION_NEARBY;
-		AddDeathDependence(lastCollidee, DEPENDENCE_LASTCOLWARN);
-		return;
-	}
+	state = (collidee != nullptr)? COLLISION_NEARBY: COLLISION_NOUNIT;
+	return collidee;
 }
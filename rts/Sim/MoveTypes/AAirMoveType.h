@@ -35,6 +35,7 @@ public:
 	AAirMoveType(CUnit* unit);
 	virtual ~AAirMoveType() {}
 
+	virtual void UpdatePreCollisionsMt();
 	virtual bool Update();
 	virtual void UpdateLanded();
 	virtual void Takeoff() {}
@@ -62,6 +63,7 @@ public:
 
 protected:
 	void CheckForCollision();
+	CUnit* FindCollidee(CollisionState& state, std::vector<CUnit*>& units, std::vector<int>& quads) const;
 
 public:
 	AircraftState aircraftState = AIRCRAFT_LANDED;
@@ -93,6 +95,17 @@ protected:
 	/// unit found to be dangerously close to our path
 	CUnit* lastCollidee = nullptr;
 
+	/// FindCollidee result precomputed by UpdatePreCollisionsMt
+	struct CollideeCache {
+		float3 midPos;
+		float3 frontDir;
+
+		CUnit* collidee = nullptr;
+		CollisionState state = COLLISION_NOUNIT;
+
+		int frameNum = -1;
+	} collideeCache;
+
 	unsigned int crashExpGenID = -1u;
 };
 
@@ -34,12 +34,12 @@
 #include "System/type2.h"
 #include "System/Sound/ISoundChannels.h"
 #include "System/Sync/HsiehHash.h"
+#include "System/Threading/ThreadPool.h"
 
 // #define PATHING_DEBUG
 
 #ifdef PATHING_DEBUG
 #include <sim/Path/TKPFS/PathGlobal.h>
-#include "System/Threading/ThreadPool.h"
 #endif
 
 #if 1
@@ -127,6 +127,7 @@ CR_REG_METADATA(CGroundMoveType, (
 
 	CR_MEMBER(pathID),
 	CR_MEMBER(nextObstacleAvoidanceFrame),
+	CR_IGNORED(avoidanceCache),
 
 	CR_MEMBER(numIdlingUpdates),
 	CR_MEMBER(numIdlingSlowUpdates),
@@ -149,6 +150,9 @@ CR_REG_METADATA(CGroundMoveType, (
 
 
 
+// per-thread scratch buffers for UpdatePreCollisionsMt queries
+static std::array<std::pair<std::vector<CSolidObject*>, std::vector<int>>, ThreadPool::MAX_THREADS> avoidanceQueryBuffers;
+
 static CGroundMoveType::MemberData gmtMemberData = {
 	{{
 		std::pair<unsigned int,  bool*>{MEMBER_LITERAL_HASH(       "atGoal"), nullptr},
@@ -480,6 +484,56 @@ bool CGroundMoveType::OwnerMoved(const short oldHeading, const float3& posDif, c
 	return true;
 }
 
+void CGroundMoveType::UpdatePreCollisionsMt()
+{
+	avoidanceCache.frameNum = -1;
+	avoidanceCache.avoideePositions.clear();
+
+	// mirror the early-outs of Update, FollowPath and GetObstacleAvoidanceDir;
+	// these are only a filter, GetObstacleAvoidanceDir validates the cached
+	// result against the owner's state at the time it actually needs it
+	if (owner->GetTransporter() != nullptr)
+		return;
+	if (owner->IsSkidding() || owner->IsFalling())
+		return;
+	if (owner->IsStunned() || owner->beingBuilt)
+		return;
+	if (owner->UnderFirstPersonControl())
+		return;
+	if (WantToStop())
+		return;
+	if (gs->frameNum < nextObstacleAvoidanceFrame)
+		return;
+
+	const float3& opos = owner->pos;
+	const float3& ffd = flatFrontDir;
+
+	const bool curAtGoal = IsAtGoal(opos, owner->speed);
+
+	// FollowPath will call Arrived, which stops the engine
+	if (curAtGoal && (atEndOfPath || useRawMovement))
+		return;
+
+	const float3 wpDir = CalcWaypointDir(currWayPoint, opos);
+	const bool wantReverse = WantReverse(wpDir, ffd, currWayPoint.distance2D(opos));
+	const float3 desiredDir = mix(ffd, wpDir * Sign(int(!wantReverse)), !curAtGoal);
+
+	if (owner->frontdir.dot(desiredDir) < 0.0f)
+		return;
+
+	auto& buffers = avoidanceQueryBuffers[ThreadPool::GetThreadNum()];
+
+	avoidanceCache.ownerPos = opos;
+	avoidanceCache.ownerSpeed = owner->speed;
+	avoidanceCache.ownerFrontDir = owner->frontdir;
+	avoidanceCache.desiredDir = desiredDir;
+	// recording the avoidees for the serial pass to draw does not alter the result
+	std::vector<float3>* avoideePositions = DEBUG_DRAWING_ENABLED? &avoidanceCache.avoideePositions: nullptr;
+
+	avoidanceCache.avoidanceDir = CalcObstacleAvoidanceDir(desiredDir, avoidanceCache.avoidanceVec, buffers.first, buffers.second, avoideePositions);
+	avoidanceCache.frameNum = gs->frameNum;
+}
+
 bool CGroundMoveType::Update()
 {
 	ASSERT_SYNCED(owner->pos);
@@ -745,54 +799,33 @@ bool CGroundMoveType::FollowPath()
 		prevWayPointDist = currWayPointDist;
 		currWayPointDist = currWayPoint.distance2D(opos);
 
-		{
-			// NOTE:
-			//   uses owner->pos instead of currWayPoint (ie. not the same as atEndOfPath)
-			//
-			//   if our first command is a build-order, then goal-radius is set to our build-range
-			//   and we cannot increase tolerance safely (otherwise the unit might stop when still
-			//   outside its range and fail to start construction)
-			//
-			//   units moving faster than <minGoalDist> elmos per frame might overshoot their goal
-			//   the last two atGoal conditions will just cause flatFrontDir to be selected as the
-			//   "wanted" direction when this happens
-			const float curGoalDistSq = (opos - goalPos).SqLength2D();
-			const float minGoalDistSq = (UNIT_HAS_MOVE_CMD(owner))?
-				Square((goalRadius + extraRadius) * (numIdlingSlowUpdates + 1)):
-				Square((goalRadius + extraRadius)                             );
-			const float spdGoalDistSq = Square(currentSpeed * 1.05f);
-
-			atGoal |= (curGoalDistSq <= minGoalDistSq);
-			atGoal |= ((curGoalDistSq <= spdGoalDistSq) && !reversing && (ffd.dot(goalPos - opos) > 0.0f && ffd.dot(goalPos - (opos + ovel)) <= 0.0f));
-			atGoal |= ((curGoalDistSq <= spdGoalDistSq) &&  reversing && (ffd.dot(goalPos - opos) < 0.0f && ffd.dot(goalPos - (opos + ovel)) >= 0.0f));
+		atGoal = IsAtGoal(opos, ovel);
 
-			#ifdef PATHING_DEBUG
-			if (DEBUG_DRAWING_ENABLED) {
-				bool printMoveInfo = (selectedUnitsHandler.selectedUnits.size() == 1)
-					&& (selectedUnitsHandler.selectedUnits.find(owner->id) != selectedUnitsHandler.selectedUnits.end());
-				if (printMoveInfo) {
-					LOG("%s opos (%f,%f,%f)", __func__
-						, static_cast<float>(opos.x)
-						, static_cast<float>(opos.y)
-						, static_cast<float>(opos.z));
-
-					LOG("%s cwp (%f,%f,%f)", __func__
-						, static_cast<float>(cwp.x)
-						, static_cast<float>(cwp.y)
-						, static_cast<float>(cwp.z));
-
-					LOG("%s goalpos (%f,%f,%f)", __func__
-						, static_cast<float>(goalPos.x)
-						, static_cast<float>(goalPos.y)
-						, static_cast<float>(goalPos.z));
-
-					LOG("%s curGoalDistSq(%f) <= minGoalDistSq(%f)", __func__, curGoalDistSq, minGoalDistSq);
-					LOG("%s (ffd.dot(goalPos - opos)(%f) ffd.dot(goalPos - (opos + ovel))(%f)", __func__, ffd.dot(goalPos - opos), ffd.dot(goalPos - (opos + ovel)));
-					LOG("%s atGoal(%d?) reversing(%d?)", __func__, (int)atGoal, (int)reversing);
-				}
+		#ifdef PATHING_DEBUG
+		if (DEBUG_DRAWING_ENABLED) {
+			bool printMoveInfo = (selectedUnitsHandler.selectedUnits.size() == 1)
+				&& (selectedUnitsHandler.selectedUnits.find(owner->id) != selectedUnitsHandler.selectedUnits.end());
+			if (printMoveInfo) {
+				LOG("%s opos (%f,%f,%f)", __func__
+					, static_cast<float>(opos.x)
+					, static_cast<float>(opos.y)
+					, static_cast<float>(opos.z));
+
+				LOG("%s cwp (%f,%f,%f)", __func__
+					, static_cast<float>(cwp.x)
+					, static_cast<float>(cwp.y)
+					, static_cast<float>(cwp.z));
+
+				LOG("%s goalpos (%f,%f,%f)", __func__
+					, static_cast<float>(goalPos.x)
+					, static_cast<float>(goalPos.y)
+					, static_cast<float>(goalPos.z));
+
+				LOG("%s (ffd.dot(goalPos - opos)(%f) ffd.dot(goalPos - (opos + ovel))(%f)", __func__, ffd.dot(goalPos - opos), ffd.dot(goalPos - (opos + ovel)));
+				LOG("%s atGoal(%d?) reversing(%d?)", __func__, (int)atGoal, (int)reversing);
 			}
-			#endif
 		}
+		#endif
 
 		if (!atGoal) {
 			numIdlingUpdates -= ((numIdlingUpdates >                  0) * (1 - idling));
@@ -830,21 +863,12 @@ bool CGroundMoveType::FollowPath()
 			}
 		}
 
-		// set direction to waypoint AFTER requesting it; should not be a null-vector
-		// do not compare y-components since these usually differ and only x&z matter
-		float3 waypointVec;
-		// float3 wpProjDists;
+		// set direction to waypoint AFTER requesting it
+		waypointDir = CalcWaypointDir(cwp, opos);
 
-		if (!epscmp(cwp.x, opos.x, float3::cmp_eps()) || !epscmp(cwp.z, opos.z, float3::cmp_eps())) {
-			waypointVec = (cwp - opos) * XZVector;
-			waypointDir = waypointVec / waypointVec.Length();
-			// wpProjDists = {math::fabs(waypointVec.dot(ffd)), 1.0f, math::fabs(waypointDir.dot(ffd))};
-		}
-
-		ASSERT_SYNCED(waypointVec);
 		ASSERT_SYNCED(waypointDir);
 
-		wantReverse = WantReverse(waypointDir, ffd);
+		wantReverse = WantReverse(waypointDir, ffd, currWayPointDist);
 
 		// apply obstacle avoidance (steering), prevent unit from chasing its own tail if already at goal
 		const float3  rawWantedDir = waypointDir * Sign(int(!wantReverse));
@@ -860,11 +884,6 @@ bool CGroundMoveType::FollowPath()
 				&& (selectedUnitsHandler.selectedUnits.find(owner->id) != selectedUnitsHandler.selectedUnits.end());
 			if (printMoveInfo) {
 
-				LOG("%s waypointVec (%f,%f,%f)", __func__
-					, static_cast<float>(waypointVec.x)
-					, static_cast<float>(waypointVec.y)
-					, static_cast<float>(waypointVec.z));
-
 				LOG("%s waypointDir (%f,%f,%f)", __func__
 					, static_cast<float>(waypointDir.x)
 					, static_cast<float>(waypointDir.y)
@@ -897,6 +916,47 @@ bool CGroundMoveType::FollowPath()
 	return wantReverse;
 }
 
+bool CGroundMoveType::IsAtGoal(const float3& opos, const float3& ovel) const
+{
+	// NOTE:
+	//   uses owner->pos instead of currWayPoint (ie. not the same as atEndOfPath)
+	//
+	//   if our first command is a build-order, then goal-radius is set to our build-range
+	//   and we cannot increase tolerance safely (otherwise the unit might stop when still
+	//   outside its range and fail to start construction)
+	//
+	//   units moving faster than <minGoalDist> elmos per frame might overshoot their goal
+	//   the last two atGoal conditions will just cause flatFrontDir to be selected as the
+	//   "wanted" direction when this happens
+	const float3& ffd = flatFrontDir;
+
+	const float curGoalDistSq = (opos - goalPos).SqLength2D();
+	const float minGoalDistSq = (UNIT_HAS_MOVE_CMD(owner))?
+		Square((goalRadius + extraRadius) * (numIdlingSlowUpdates + 1)):
+		Square((goalRadius + extraRadius)                             );
+	const float spdGoalDistSq = Square(currentSpeed * 1.05f);
+
+	bool ret = atGoal;
+
+	ret |= (curGoalDistSq <= minGoalDistSq);
+	ret |= ((curGoalDistSq <= spdGoalDistSq) && !reversing && (ffd.dot(goalPos - opos) > 0.0f && ffd.dot(goalPos - (opos + ovel)) <= 0.0f));
+	ret |= ((curGoalDistSq <= spdGoalDistSq) &&  reversing && (ffd.dot(goalPos - opos) < 0.0f && ffd.dot(goalPos - (opos + ovel)) >= 0.0f));
+
+	return ret;
+}
+
+float3 CGroundMoveType::CalcWaypointDir(const float3& cwp, const float3& opos) const
+{
+	// should not be a null-vector; do not compare y-components
+	// since these usually differ and only x&z matter
+	if (epscmp(cwp.x, opos.x, float3::cmp_eps()) && epscmp(cwp.z, opos.z, float3::cmp_eps()))
+		return waypointDir;
+
+	const float3 waypointVec = (cwp - opos) * XZVector;
+
+	return (waypointVec / waypointVec.Length());
+}
+
 void CGroundMoveType::ChangeSpeed(float newWantedSpeed, bool wantReverse, bool fpsMode)
 {
 	// round low speeds to zero
@@ -1413,23 +1473,74 @@ float3 CGroundMoveType::GetObstacleAvoidanceDir(const float3& desiredDir) {
 	if (gs->frameNum < nextObstacleAvoidanceFrame)
 		return lastAvoidanceDir;
 
-	float3 avoidanceVec = ZeroVector;
-	float3 avoidanceDir = desiredDir;
-
-	lastAvoidanceDir = desiredDir;
 	nextObstacleAvoidanceFrame = gs->frameNum + 1;
 
-	CUnit* avoider = owner;
-
-	// const UnitDef* avoiderUD = avoider->unitDef;
-	const MoveDef* avoiderMD = avoider->moveDef;
-
 	// degenerate case: if facing anti-parallel to desired direction,
 	// do not actively avoid obstacles since that can interfere with
 	// normal waypoint steering (if the final avoidanceDir demands a
 	// turn in the opposite direction of desiredDir)
-	if (avoider->frontdir.dot(desiredDir) < 0.0f)
-		return lastAvoidanceDir;
+	if (owner->frontdir.dot(desiredDir) < 0.0f)
+		return (lastAvoidanceDir = desiredDir);
+
+	float3 avoidanceVec;
+	float3 avoidanceDir;
+
+	const bool drawAvoidance = DEBUG_DRAWING_ENABLED && (selectedUnitsHandler.selectedUnits.find(owner->id) != selectedUnitsHandler.selectedUnits.end());
+
+	// use the result of UpdatePreCollisionsMt if it was calculated
+	// from the same inputs, otherwise (e.g. if a collision pushed us
+	// or Arrived() issued a new goal) redo the work inline
+	// NOTE:
+	//   which of the two produces the (synced) result must only depend
+	//   on synced state, never on whether this client draws debug-lines
+	if (avoidanceCache.IsValid(gs->frameNum, owner, desiredDir)) {
+		avoidanceVec = avoidanceCache.avoidanceVec;
+		avoidanceDir = avoidanceCache.avoidanceDir;
+	} else {
+		auto& buffers = avoidanceQueryBuffers[ThreadPool::GetThreadNum()];
+		avoidanceDir = CalcObstacleAvoidanceDir(desiredDir, avoidanceVec, buffers.first, buffers.second, drawAvoidance? &avoidanceCache.avoideePositions: nullptr);
+	}
+
+	if (drawAvoidance) {
+		// geometricObjects is not thread-safe, so UpdatePreCollisionsMt (or the
+		// inline fallback above) only records the avoidees and they are drawn here
+		for (const float3& avoideePos: avoidanceCache.avoideePositions) {
+			geometricObjects->AddLine(owner->pos + (UpVector * 20.0f), avoideePos + (UpVector * 20.0f), 3, 1, 4);
+		}
+
+		const float3 p0 = owner->pos + (    UpVector * 20.0f);
+		const float3 p1 =         p0 + (avoidanceVec * 40.0f);
+		const float3 p2 =         p0 + (avoidanceDir * 40.0f);
+
+		const int avFigGroupID = geometricObjects->AddLine(p0, p1, 8.0f, 1, 4);
+		const int adFigGroupID = geometricObjects->AddLine(p0, p2, 8.0f, 1, 4);
+
+		geometricObjects->SetColor(avFigGroupID, 1, 0.3f, 0.3f, 0.6f);
+		geometricObjects->SetColor(adFigGroupID, 1, 0.3f, 0.3f, 0.6f);
+	}
+
+	return (lastAvoidanceDir = avoidanceDir);
+}
+
+bool CGroundMoveType::ObstacleAvoidanceCache::IsValid(int frame, const CUnit* o, const float3& dir) const
+{
+	if (frameNum != frame)
+		return false;
+
+	return (ownerPos.same(o->pos) && ownerSpeed.same(o->speed) && ownerFrontDir.same(o->frontdir) && desiredDir.same(dir));
+}
+
+float3 CGroundMoveType::CalcObstacleAvoidanceDir(
+	const float3& desiredDir,
+	float3& avoidanceVec,
+	std::vector<CSolidObject*>& solids,
+	std::vector<int>& quads,
+	std::vector<float3>* avoideePositions
+) const {
+	const CUnit* avoider = owner;
+
+	// const UnitDef* avoiderUD = avoider->unitDef;
+	const MoveDef* avoiderMD = avoider->moveDef;
 
 	static constexpr float AVOIDER_DIR_WEIGHT = 1.0f;
 	static constexpr float DESIRED_DIR_WEIGHT = 0.5f;
@@ -1442,10 +1553,15 @@ float3 CGroundMoveType::GetObstacleAvoidanceDir(const float3& desiredDir) {
 	const float avoidanceRadius = std::max(currentSpeed, 1.0f) * (avoider->radius * 2.0f);
 	const float avoiderRadius = avoiderMD->CalcFootPrintMinExteriorRadius();
 
-	QuadFieldQuery qfQuery;
-	quadField.GetSolidsExact(qfQuery, avoider->pos, avoidanceRadius, 0xFFFFFFFF, CSolidObject::CSTATE_BIT_SOLIDOBJECTS);
+	// NOTE: may run on a worker thread, so only the read-only query is allowed
+	quadField.GetSolidsExactMt(solids, quads, avoider->pos, avoidanceRadius, 0xFFFFFFFF, CSolidObject::CSTATE_BIT_SOLIDOBJECTS);
+
+	avoidanceVec = ZeroVector;
 
-	for (const CSolidObject* avoidee: *qfQuery.solids) {
+	if (avoideePositions != nullptr)
+		avoideePositions->clear();
+
+	for (const CSolidObject* avoidee: solids) {
 		const MoveDef* avoideeMD = avoidee->moveDef;
 		const UnitDef* avoideeUD = dynamic_cast<const UnitDef*>(avoidee->GetDef());
 
@@ -1503,10 +1619,8 @@ float3 CGroundMoveType::GetObstacleAvoidanceDir(const float3& desiredDir) {
 		// if object and unit in relative motion are closing in on one another
 		// (or not yet fully apart), then the object is on the path of the unit
 		// and they are not collided
-		if (DEBUG_DRAWING_ENABLED) {
-			if (selectedUnitsHandler.selectedUnits.find(owner->id) != selectedUnitsHandler.selectedUnits.end())
-				geometricObjects->AddLine(avoider->pos + (UpVector * 20.0f), avoidee->pos + (UpVector * 20.0f), 3, 1, 4);
-		}
+		if (avoideePositions != nullptr)
+			avoideePositions->push_back(avoidee->pos);
 
 		float avoiderTurnSign = -Sign(avoidee->pos.dot(avoider->rightdir) - avoider->pos.dot(avoider->rightdir));
 		float avoideeTurnSign = -Sign(avoider->pos.dot(avoidee->rightdir) - avoidee->pos.dot(avoidee->rightdir));
@@ -1529,31 +1643,18 @@ float3 CGroundMoveType::GetObstacleAvoidanceDir(const float3& desiredDir) {
 		if (avoidanceCosAngle < 0.0f)
 			avoiderTurnSign = std::max(avoiderTurnSign, avoideeTurnSign);
 
-		avoidanceDir = avoider->rightdir * AVOIDER_DIR_WEIGHT * avoiderTurnSign;
+		const float3 avoidanceDir = avoider->rightdir * AVOIDER_DIR_WEIGHT * avoiderTurnSign;
+
 		avoidanceVec += (avoidanceDir * avoidanceResponse * avoidanceFallOff * avoideeMassScale);
 	}
 
 
 	// use a weighted combination of the desired- and the avoidance-directions
-	// also linearly smooth it using the vector calculated the previous frame
-	avoidanceDir = (mix(desiredDir, avoidanceVec, DESIRED_DIR_WEIGHT)).SafeNormalize();
-	avoidanceDir = (mix(avoidanceDir, lastAvoidanceDir, LAST_DIR_MIX_ALPHA)).SafeNormalize();
+	// also linearly smooth it using the desired direction (which is what the
+	// previous frame's vector is always reset to before avoidance kicks in)
+	const float3 avoidanceDir = (mix(desiredDir, avoidanceVec, DESIRED_DIR_WEIGHT)).SafeNormalize();
 
-	if (DEBUG_DRAWING_ENABLED) {
-		if (selectedUnitsHandler.selectedUnits.find(owner->id) != selectedUnitsHandler.selectedUnits.end()) {
-			const float3 p0 = owner->pos + (    UpVector * 20.0f);
-			const float3 p1 =         p0 + (avoidanceVec * 40.0f);
-			const float3 p2 =         p0 + (avoidanceDir * 40.0f);
-
-			const int avFigGroupID = geometricObjects->AddLine(p0, p1, 8.0f, 1, 4);
-			const int adFigGroupID = geometricObjects->AddLine(p0, p2, 8.0f, 1, 4);
-
-			geometricObjects->SetColor(avFigGroupID, 1, 0.3f, 0.3f, 0.6f);
-			geometricObjects->SetColor(adFigGroupID, 1, 0.3f, 0.3f, 0.6f);
-		}
-	}
-
-	return (lastAvoidanceDir = avoidanceDir);
+	return ((mix(avoidanceDir, desiredDir, LAST_DIR_MIX_ALPHA)).SafeNormalize());
 }
 
 
@@ -2883,7 +2984,7 @@ bool CGroundMoveType::UpdateOwnerSpeed(float oldSpeedAbs, float newSpeedAbs, flo
 }
 
 
-bool CGroundMoveType::WantReverse(const float3& wpDir, const float3& ffDir) const
+bool CGroundMoveType::WantReverse(const float3& wpDir, const float3& ffDir, float wpDist) const
 {
 	if (!canReverse)
 		return false;
@@ -2916,7 +3017,7 @@ bool CGroundMoveType::WantReverse(const float3& wpDir, const float3& ffDir) cons
 
 	// values <= 0 preserve default behavior
 	if (maxReverseDist > 0.0f && minReverseAngle > 0.0f)
-		return (currWayPointDist <= maxReverseDist && turnAngleDeg >= minReverseAngle);
+		return (wpDist <= maxReverseDist && turnAngleDeg >= minReverseAngle);
 
 	// units start accelerating before finishing the turn, so subtract something
 	const float turnTimeMod      = 5.0f;
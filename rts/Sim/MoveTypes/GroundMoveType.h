@@ -29,6 +29,7 @@ public:
 
 	void PostLoad();
 
+	void UpdatePreCollisionsMt() override;
 	bool Update() override;
 	void SlowUpdate() override;
 
@@ -111,6 +112,14 @@ public:
 
 private:
 	float3 GetObstacleAvoidanceDir(const float3& desiredDir);
+	float3 CalcObstacleAvoidanceDir(
+		const float3& desiredDir,
+		float3& avoidanceVec,
+		std::vector<CSolidObject*>& solids,
+		std::vector<int>& quads,
+		std::vector<float3>* avoideePositions = nullptr
+	) const;
+	float3 CalcWaypointDir(const float3& cwp, const float3& opos) const;
 	float3 Here() const;
 
 	#define SQUARE(x) ((x) * (x))
@@ -178,10 +187,32 @@ private:
 	bool UpdateOwnerSpeed(float oldSpeedAbs, float newSpeedAbs, float newSpeedRaw);
 	bool OwnerMoved(const short, const float3&, const float3&);
 	bool FollowPath();
-	bool WantReverse(const float3& wpDir, const float3& ffDir) const;
+	bool IsAtGoal(const float3& opos, const float3& ovel) const;
+	bool WantReverse(const float3& wpDir, const float3& ffDir, float wpDist) const;
+
+private:
+	// obstacle-avoidance result precomputed by UpdatePreCollisionsMt;
+	// only used if the inputs are unchanged by the time Update runs
+	struct ObstacleAvoidanceCache {
+		bool IsValid(int frame, const CUnit* o, const float3& dir) const;
+
+		float3 ownerPos;
+		float3 ownerSpeed;
+		float3 ownerFrontDir;
+		float3 desiredDir;
+		float3 avoidanceVec;
+		float3 avoidanceDir;
+
+		// positions of the objects avoided by the last calculation, only
+		// recorded for debug-drawing (never read by the synced code)
+		std::vector<float3> avoideePositions;
+
+		int frameNum = -1;
+	};
 
 private:
 	GMTDefaultPathController pathController;
+	ObstacleAvoidanceCache avoidanceCache;
 
 	SyncedFloat3 currWayPoint;
 	SyncedFloat3 nextWayPoint;
@@ -60,6 +60,13 @@ public:
 	virtual void SetManeuverLeash(float leashLength) { maneuverLeash = leashLength; }
 	virtual void SetWaterline(float depth) { waterline = depth; }
 
+	// NOTE:
+	//   called for every active unit before any Update(), possibly from
+	//   worker threads; implementations may only read shared sim state
+	//   and write to their own (unsynced-checked) scratch members, never
+	//   to the owner or other objects, CSyncChecker or gsRNG
+	//   the results must be consumed (or discarded) by Update()
+	virtual void UpdatePreCollisionsMt() {}
 	virtual bool Update() = 0;
 	virtual void SlowUpdate() {};
 	void UpdateCollisionMap();
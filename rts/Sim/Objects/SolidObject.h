@@ -129,7 +129,8 @@ public:
 
 	virtual void UpdatePhysicalState(float eps);
 
-	void Move(const float3& v, bool relative) {
+	// CUnit also refreshes the copy of its position kept by the quadfield
+	virtual void Move(const float3& v, bool relative) {
 		const float3& dv = relative? v: (v - pos);
 
 		pos += dv;
@@ -0,0 +1,287 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "PathCostsFile.h"
+#include "System/CRC.h"
+#include "System/FileSystem/FileSystem.h"
+#include "System/FileSystem/MemoryMappedFile.h"
+#include "System/Log/ILog.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+static constexpr char FILE_MAGIC[8] = {'S', 'P', 'R', 'P', 'E', 'R', 'A', 'W'};
+
+
+CPathCostsFile::CPathCostsFile(
+	const std::string& _filePath,
+	std::uint32_t hashCode,
+	std::uint32_t numBlocks,
+	std::uint32_t numPathTypes,
+	std::uint32_t numVertexCosts
+): filePath(_filePath) {
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+
+	header.version = FILE_VERSION;
+	header.hashCode = hashCode;
+	header.numBlocks = numBlocks;
+	header.numPathTypes = numPathTypes;
+	header.numVertexCosts = numVertexCosts;
+
+	verticesPerBlock = numVertexCosts / std::max(numBlocks * numPathTypes, 1u);
+	flushInterval = std::max(numBlocks / 32, 1u);
+}
+
+
+size_t CPathCostsFile::GetOffsetsPos(std::uint32_t pathType, std::uint32_t blockIdx) const
+{
+	return (sizeof(FileHeader) + (size_t(pathType) * header.numBlocks + blockIdx) * sizeof(short2));
+}
+
+size_t CPathCostsFile::GetCostsPos(std::uint32_t pathType, std::uint32_t blockIdx) const
+{
+	const size_t offsetsEnd = GetOffsetsPos(header.numPathTypes, 0);
+	const size_t vertexIdx = (size_t(pathType) * header.numBlocks + blockIdx) * verticesPerBlock;
+
+	return (offsetsEnd + vertexIdx * sizeof(float));
+}
+
+
+bool CPathCostsFile::IsValidHeader(const FileHeader& fileHeader) const
+{
+	if (std::memcmp(fileHeader.magic, header.magic, sizeof(header.magic)) != 0)
+		return false;
+	if (fileHeader.version != header.version || fileHeader.hashCode != header.hashCode)
+		return false;
+	if (fileHeader.numBlocks != header.numBlocks || fileHeader.numPathTypes != header.numPathTypes)
+		return false;
+	if (fileHeader.numVertexCosts != header.numVertexCosts)
+		return false;
+	if (fileHeader.numOffsetBlocks > header.numBlocks || fileHeader.numCostBlocks > header.numBlocks)
+		return false;
+
+	// costs are only generated once all offsets exist
+	return (fileHeader.numCostBlocks == 0 || fileHeader.numOffsetBlocks == header.numBlocks);
+}
+
+
+int2 CPathCostsFile::Read(std::vector< std::vector<short2> >& offsets, std::vector<float>& costs)
+{
+	assert(offsets.size() == header.numPathTypes);
+	assert(costs.size() == header.numVertexCosts);
+
+	if (!FileSystem::FileExists(filePath))
+		return {0, 0};
+
+	const CMemoryMappedFile mappedFile(filePath);
+
+	if (!mappedFile.IsOpen() || mappedFile.GetSize() != GetFileSize()) {
+		LOG_L(L_WARNING, "[PathCostsFile::%s] could not map \"%s\" (size=%u)", __func__, filePath.c_str(), unsigned(mappedFile.GetSize()));
+		return {0, 0};
+	}
+
+	const std::uint8_t* data = mappedFile.GetData();
+
+	FileHeader fileHeader;
+	std::memcpy(&fileHeader, data, sizeof(fileHeader));
+
+	if (!IsValidHeader(fileHeader))
+		return {0, 0};
+
+	const bool isComplete = (fileHeader.numCostBlocks == header.numBlocks);
+
+	if (isComplete && fileHeader.checksum != CRC::CalcDigest(data + sizeof(FileHeader), GetFileSize() - sizeof(FileHeader))) {
+		LOG_L(L_WARNING, "[PathCostsFile::%s] checksum mismatch for \"%s\"", __func__, filePath.c_str());
+		return {0, 0};
+	}
+
+	for (std::uint32_t pathType = 0; pathType < header.numPathTypes; pathType++) {
+		std::memcpy(offsets[pathType].data(), data + GetOffsetsPos(pathType, 0), fileHeader.numOffsetBlocks * sizeof(short2));
+	}
+
+	if (isComplete) {
+		std::memcpy(costs.data(), data + GetCostsPos(0, 0), header.numVertexCosts * sizeof(float));
+	} else {
+		for (std::uint32_t pathType = 0; pathType < header.numPathTypes; pathType++) {
+			const size_t costsIdx = size_t(pathType) * header.numBlocks * verticesPerBlock;
+			std::memcpy(costs.data() + costsIdx, data + GetCostsPos(pathType, 0), fileHeader.numCostBlocks * verticesPerBlock * sizeof(float));
+		}
+	}
+
+	header.numOffsetBlocks = fileHeader.numOffsetBlocks;
+	header.numCostBlocks = fileHeader.numCostBlocks;
+	header.checksum = fileHeader.checksum;
+
+	return {int(header.numOffsetBlocks), int(header.numCostBlocks)};
+}
+
+
+bool CPathCostsFile::WriteHeader()
+{
+	if (std::fseek(file, 0, SEEK_SET) != 0)
+		return false;
+	if (std::fwrite(&header, sizeof(header), 1, file) != 1)
+		return false;
+
+	return (std::fflush(file) == 0);
+}
+
+bool CPathCostsFile::WriteData(size_t pos, const void* data, size_t size, size_t count)
+{
+	if (std::fseek(file, pos, SEEK_SET) != 0)
+		return false;
+
+	return (std::fwrite(data, size, count, file) == count);
+}
+
+void CPathCostsFile::AbortWriter(const char* caller)
+{
+	// the header still describes the data written before this failure
+	LOG_L(L_WARNING, "[PathCostsFile::%s] could not write \"%s\" (%s), stopped caching", caller, filePath.c_str(), std::strerror(errno));
+	CloseWriter();
+}
+
+bool CPathCostsFile::OpenWriter(const int2 numDoneBlocks)
+{
+	const bool resume = (numDoneBlocks.x > 0);
+
+	header.numOffsetBlocks = numDoneBlocks.x;
+	header.numCostBlocks = numDoneBlocks.y;
+	header.checksum = 0;
+
+	doneBlocks.reset(new std::atomic<std::uint8_t>[header.numBlocks]);
+
+	for (std::uint32_t blockIdx = 0; blockIdx < header.numBlocks; blockIdx++) {
+		doneBlocks[blockIdx] = (BLOCK_OFFSETS_DONE * (blockIdx < header.numOffsetBlocks)) | (BLOCK_COSTS_DONE * (blockIdx < header.numCostBlocks));
+	}
+
+	if ((file = std::fopen(filePath.c_str(), resume? "r+b": "w+b")) == nullptr)
+		return false;
+
+	// reserve the full size upfront, Read rejects anything else
+	if (!resume && (std::fseek(file, GetFileSize() - 1, SEEK_SET) != 0 || std::fputc(0, file) == EOF)) {
+		CloseWriter();
+		return false;
+	}
+
+	if (!WriteHeader()) {
+		CloseWriter();
+		return false;
+	}
+
+	return true;
+}
+
+
+void CPathCostsFile::FlushOffsets(const std::vector< std::vector<short2> >& offsets, bool force)
+{
+	if (file == nullptr)
+		return;
+
+	std::uint32_t endBlockIdx = header.numOffsetBlocks;
+
+	while (endBlockIdx < header.numBlocks && (doneBlocks[endBlockIdx].load(std::memory_order_acquire) & BLOCK_OFFSETS_DONE) != 0)
+		endBlockIdx++;
+
+	if (endBlockIdx == header.numOffsetBlocks || (!force && (endBlockIdx - header.numOffsetBlocks) < flushInterval))
+		return;
+
+	const std::uint32_t numBlocks = endBlockIdx - header.numOffsetBlocks;
+
+	for (std::uint32_t pathType = 0; pathType < header.numPathTypes; pathType++) {
+		if (!WriteData(GetOffsetsPos(pathType, header.numOffsetBlocks), &offsets[pathType][header.numOffsetBlocks], sizeof(short2), numBlocks)) {
+			AbortWriter(__func__);
+			return;
+		}
+	}
+
+	// data has to reach the OS before the header claims it; there is no
+	// fsync, so a system crash can still lose either (only complete files
+	// are checksummed)
+	if (std::fflush(file) != 0) {
+		AbortWriter(__func__);
+		return;
+	}
+
+	header.numOffsetBlocks = endBlockIdx;
+
+	if (!WriteHeader())
+		AbortWriter(__func__);
+}
+
+void CPathCostsFile::FlushCosts(const std::vector<float>& costs, bool force)
+{
+	if (file == nullptr)
+		return;
+
+	std::uint32_t endBlockIdx = header.numCostBlocks;
+
+	while (endBlockIdx < header.numBlocks && (doneBlocks[endBlockIdx].load(std::memory_order_acquire) & BLOCK_COSTS_DONE) != 0)
+		endBlockIdx++;
+
+	if (endBlockIdx == header.numCostBlocks || (!force && (endBlockIdx - header.numCostBlocks) < flushInterval))
+		return;
+
+	const std::uint32_t numBlocks = endBlockIdx - header.numCostBlocks;
+
+	for (std::uint32_t pathType = 0; pathType < header.numPathTypes; pathType++) {
+		const size_t costsIdx = (size_t(pathType) * header.numBlocks + header.numCostBlocks) * verticesPerBlock;
+
+		if (!WriteData(GetCostsPos(pathType, header.numCostBlocks), &costs[costsIdx], sizeof(float), numBlocks * verticesPerBlock)) {
+			AbortWriter(__func__);
+			return;
+		}
+	}
+
+	if (std::fflush(file) != 0) {
+		AbortWriter(__func__);
+		return;
+	}
+
+	header.numCostBlocks = endBlockIdx;
+
+	if (!WriteHeader())
+		AbortWriter(__func__);
+}
+
+
+bool CPathCostsFile::CloseWriter(const std::vector< std::vector<short2> >& offsets, const std::vector<float>& costs)
+{
+	if (file == nullptr)
+		return false;
+
+	FlushOffsets(offsets, true);
+	FlushCosts(costs, true);
+
+	if (header.numOffsetBlocks != header.numBlocks || header.numCostBlocks != header.numBlocks) {
+		CloseWriter();
+		return false;
+	}
+
+	// same byte layout as the file, no need to read it back
+	CRC crc;
+
+	for (std::uint32_t pathType = 0; pathType < header.numPathTypes; pathType++) {
+		crc.Update(offsets[pathType].data(), offsets[pathType].size() * sizeof(short2));
+	}
+
+	crc.Update(costs.data(), costs.size() * sizeof(float));
+
+	header.checksum = crc.GetDigest();
+
+	const bool ret = WriteHeader();
+
+	CloseWriter();
+	return ret;
+}
+
+void CPathCostsFile::CloseWriter()
+{
+	if (file != nullptr)
+		std::fclose(file);
+
+	file = nullptr;
+	doneBlocks.reset();
+}
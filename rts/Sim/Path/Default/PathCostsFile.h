@@ -0,0 +1,107 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef PATH_COSTS_FILE_H
+#define PATH_COSTS_FILE_H
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "System/type2.h"
+
+/**
+ * Uncompressed cache-file for the block-offsets and vertex-costs of a path
+ * estimator, laid out exactly like the estimator's own arrays so a cached
+ * load is a memory-map and one copy per array.
+ *
+ * During cold generation finished blocks are streamed into the file in
+ * order of their index; the header records how far each array got, and
+ * a later load continues from there instead of starting over. Complete
+ * files carry a checksum over all data.
+ */
+class CPathCostsFile {
+public:
+	static constexpr std::uint32_t FILE_VERSION = 1;
+
+	struct FileHeader {
+		char magic[8];
+
+		std::uint32_t version;
+		std::uint32_t hashCode;
+
+		std::uint32_t numBlocks;
+		std::uint32_t numPathTypes;
+		std::uint32_t numVertexCosts;
+
+		// number of leading blocks whose offsets resp. costs are final
+		std::uint32_t numOffsetBlocks;
+		std::uint32_t numCostBlocks;
+
+		// CRC over everything after the header, zero until complete
+		std::uint32_t checksum;
+	};
+
+public:
+	CPathCostsFile(const std::string& filePath, std::uint32_t hashCode, std::uint32_t numBlocks, std::uint32_t numPathTypes, std::uint32_t numVertexCosts);
+	~CPathCostsFile() { CloseWriter(); }
+
+	/**
+	 * Copies the usable part of the file into <offsets> and <costs> and
+	 * returns the number of leading blocks whose {offsets, costs} it had;
+	 * (0, 0) if the file is missing, was made for other data or is corrupt
+	 */
+	int2 Read(std::vector< std::vector<short2> >& offsets, std::vector<float>& costs);
+
+	/**
+	 * Prepares streaming the remaining blocks after <numDoneBlocks> (as
+	 * returned by Read) into the file, which is recreated if those are 0.
+	 */
+	bool OpenWriter(const int2 numDoneBlocks);
+
+	// can be called by any thread, in any block order
+	void SetOffsetsDone(unsigned int blockIdx) { doneBlocks[blockIdx].fetch_or(BLOCK_OFFSETS_DONE, std::memory_order_release); }
+	void SetCostsDone(unsigned int blockIdx) { doneBlocks[blockIdx].fetch_or(BLOCK_COSTS_DONE, std::memory_order_release); }
+
+	// writer-thread only; write out the leading finished blocks once enough accumulated,
+	// the first failed write closes the file and leaves its header at the last good flush
+	void FlushOffsets(const std::vector< std::vector<short2> >& offsets, bool force);
+	void FlushCosts(const std::vector<float>& costs, bool force);
+
+	/**
+	 * Writes the checksum once all blocks are flushed and closes the file;
+	 * must only be called after every generating thread is done.
+	 */
+	bool CloseWriter(const std::vector< std::vector<short2> >& offsets, const std::vector<float>& costs);
+	void CloseWriter();
+
+private:
+	size_t GetOffsetsPos(std::uint32_t pathType, std::uint32_t blockIdx) const;
+	size_t GetCostsPos(std::uint32_t pathType, std::uint32_t blockIdx) const;
+	size_t GetFileSize() const { return (GetCostsPos(header.numPathTypes, 0)); }
+
+	bool IsValidHeader(const FileHeader& fileHeader) const;
+	bool WriteHeader();
+	bool WriteData(size_t pos, const void* data, size_t size, size_t count);
+	void AbortWriter(const char* caller);
+
+private:
+	enum {
+		BLOCK_OFFSETS_DONE = 1,
+		BLOCK_COSTS_DONE   = 2,
+	};
+
+	std::string filePath;
+
+	FileHeader header;
+	std::FILE* file = nullptr;
+
+	std::unique_ptr<std::atomic<std::uint8_t>[]> doneBlocks;
+
+	std::uint32_t verticesPerBlock = 0;
+	std::uint32_t flushInterval = 1;
+};
+
+#endif
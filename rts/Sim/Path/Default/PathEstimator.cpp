@@ -2,10 +2,8 @@
 
 #include "System/Platform/Win/win32.h"
 
-#include "zlib.h"
-#include "minizip/zip.h"
-
 #include "PathEstimator.h"
+#include "PathCostsFile.h"
 #include "PathFinder.h"
 #include "PathFinderDef.h"
 // #include "PathFlowMap.hpp"
@@ -21,8 +19,6 @@
 #include "System/Threading/ThreadPool.h" // for_mt
 #include "System/TimeProfiler.h"
 #include "System/Config/ConfigHandler.h"
-#include "System/FileSystem/Archives/IArchive.h"
-#include "System/FileSystem/ArchiveLoader.h"
 #include "System/FileSystem/DataDirsAccess.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/FileQueryFlags.h"
@@ -45,7 +41,7 @@ static const std::string GetPathCacheDir() {
 }
 
 static const std::string GetCacheFileName(const std::string& fileHashCode, const std::string& peFileName, const std::string& mapFileName) {
-	return (GetPathCacheDir() + mapFileName + "." + peFileName + "-" + fileHashCode + ".zip");
+	return (GetPathCacheDir() + mapFileName + "." + peFileName + "-" + fileHashCode + ".raw");
 }
 
 
@@ -162,7 +158,12 @@ void CPathEstimator::InitEstimator(const std::string& peFileName, const std::str
 	// Not much point in multithreading these...
 	InitBlocks();
 
-	if (!ReadFile(peFileName, mapFileName)) {
+	CPathCostsFile costsFile(GetCacheFilePath(peFileName, mapFileName), fileHashCode, blockStates.GetSize(), moveDefHandler.GetNumMoveDefs(), vertexCosts.size());
+
+	// a partial file (from an interrupted earlier run) is continued
+	const int2 numCachedBlocks = ReadFile(costsFile);
+
+	if (numCachedBlocks.y < int(blockStates.GetSize())) {
 		// start extra threads if applicable, but always keep the total
 		// memory-footprint made by CPathFinder instances within bounds
 		const unsigned int minMemFootPrint = sizeof(CPathFinder) + parentPathFinder->GetMemFootPrint();
@@ -174,7 +175,7 @@ void CPathEstimator::InitEstimator(const std::string& peFileName, const std::str
 		const char* fmtStrs[4] = {
 			"[%s] creating PE%u cache with %u PF threads (%u MB)",
 			"[%s] creating PE%u cache with %u PF thread (%u MB)",
-			"[%s] writing PE%u cache-file %s-%x",
+			"[%s] resuming PE%u cache-file %s-%x at block %d",
 			"[%s] written PE%u cache-file %s-%x",
 		};
 
@@ -183,6 +184,18 @@ void CPathEstimator::InitEstimator(const std::string& peFileName, const std::str
 			loadscreen->SetLoadMessage(calcMsg);
 		}
 
+		if (numCachedBlocks.x > 0) {
+			sprintf(calcMsg, fmtStrs[2], __func__, BLOCK_SIZE, peFileName.c_str(), fileHashCode, std::min(numCachedBlocks.x, numCachedBlocks.y + 1));
+			loadscreen->SetLoadMessage(calcMsg);
+		}
+
+		// skip whatever the file already had
+		offsetBlockNum = blockStates.GetSize() - numCachedBlocks.x;
+		costBlockNum = blockStates.GetSize() - numCachedBlocks.y;
+
+		// finished blocks are streamed into the file as they come
+		if (FileSystem::CreateDirectory(GetPathCacheDir()) && costsFile.OpenWriter(numCachedBlocks))
+			pathCostsFile = &costsFile;
 
 		// note: only really needed if numExtraThreads > 0
 		spring::barrier pathBarrier(numExtraThreads + 1);
@@ -200,14 +213,12 @@ void CPathEstimator::InitEstimator(const std::string& peFileName, const std::str
 			pfMemPool.free(pathFinders[i]);
 		}
 
+		if (pathCostsFile != nullptr && pathCostsFile->CloseWriter(blockStates.peNodeOffsets, vertexCosts)) {
+			sprintf(calcMsg, fmtStrs[3], __func__, BLOCK_SIZE, peFileName.c_str(), fileHashCode);
+			loadscreen->SetLoadMessage(calcMsg, true);
+		}
 
-		sprintf(calcMsg, fmtStrs[2], __func__, BLOCK_SIZE, peFileName.c_str(), fileHashCode);
-		loadscreen->SetLoadMessage(calcMsg, true);
-
-		WriteFile(peFileName, mapFileName);
-
-		sprintf(calcMsg, fmtStrs[3], __func__, BLOCK_SIZE, peFileName.c_str(), fileHashCode);
-		loadscreen->SetLoadMessage(calcMsg, true);
+		pathCostsFile = nullptr;
 	}
 
 	// calculate checksum over block-offsets and vertex-costs
@@ -246,16 +257,40 @@ void CPathEstimator::CalcOffsetsAndPathCosts(unsigned int threadNum, spring::bar
 	// A must be completely finished before B_i can be safely called. This means we cannot
 	// let thread i execute (A_i, B_i), but instead have to split the work such that every
 	// thread finishes its part of A before any starts B_i.
+	//
+	// thread zero also streams the finished blocks (of both) into the cache-file
 	const unsigned int maxBlockIdx = blockStates.GetSize() - 1;
 	int i;
 
-	while ((i = --offsetBlockNum) >= 0)
+	while ((i = --offsetBlockNum) >= 0) {
 		CalculateBlockOffsets(maxBlockIdx - i, threadNum);
 
+		if (pathCostsFile == nullptr)
+			continue;
+
+		pathCostsFile->SetOffsetsDone(maxBlockIdx - i);
+
+		if (threadNum == 0)
+			pathCostsFile->FlushOffsets(blockStates.peNodeOffsets, false);
+	}
+
 	pathBarrier->wait();
 
-	while ((i = --costBlockNum) >= 0)
+	// all offsets exist now; the file must say so before it records any costs
+	if (threadNum == 0 && pathCostsFile != nullptr)
+		pathCostsFile->FlushOffsets(blockStates.peNodeOffsets, true);
+
+	while ((i = --costBlockNum) >= 0) {
 		EstimatePathCosts(maxBlockIdx - i, threadNum);
+
+		if (pathCostsFile == nullptr)
+			continue;
+
+		pathCostsFile->SetCostsDone(maxBlockIdx - i);
+
+		if (threadNum == 0)
+			pathCostsFile->FlushCosts(vertexCosts, false);
+	}
 }
 
 
@@ -951,121 +986,25 @@ bool CPathEstimator::RemoveCacheFile(const std::string& peFileName, const std::s
 	return (FileSystem::Remove(GetCacheFileName(IntToString(fileHashCode, "%x"), peFileName, mapFileName)));
 }
 
-/**
- * Try to read offset and vertices data from file, return false on failure
- */
-bool CPathEstimator::ReadFile(const std::string& peFileName, const std::string& mapFileName)
+std::string CPathEstimator::GetCacheFilePath(const std::string& peFileName, const std::string& mapFileName) const
 {
-	const std::string hashHexString = IntToString(fileHashCode, "%x");
-	const std::string cacheFileName = GetCacheFileName(hashHexString, peFileName, mapFileName);
-
-	LOG("[PathEstimator::%s] hash=%s file=\"%s\" (exists=%d)", __func__, hashHexString.c_str(), cacheFileName.c_str(), FileSystem::FileExists(cacheFileName));
-
-	if (!FileSystem::FileExists(cacheFileName))
-		return false;
-
-	std::unique_ptr<IArchive> upfile(archiveLoader.OpenArchive(dataDirsAccess.LocateFile(cacheFileName), "sdz"));
-
-	if (upfile == nullptr || !upfile->IsOpen()) {
-		FileSystem::Remove(cacheFileName);
-		return false;
-	}
-
-	char calcMsg[512];
-	sprintf(calcMsg, "Reading Estimate PathCosts [%d]", BLOCK_SIZE);
-	loadscreen->SetLoadMessage(calcMsg);
-
-	const unsigned fid = upfile->FindFile("pathinfo");
-	if (fid >= upfile->NumFiles()) {
-		FileSystem::Remove(cacheFileName);
-		return false;
-	}
-
-	std::vector<std::uint8_t> buffer;
-
-	if (!upfile->GetFile(fid, buffer) || buffer.size() < 4) {
-		FileSystem::Remove(cacheFileName);
-		return false;
-	}
-
-	const unsigned int filehash = *(reinterpret_cast<unsigned int*>(&buffer[0]));
-	const unsigned int blockSize = blockStates.GetSize() * sizeof(short2);
-	unsigned int pos = sizeof(unsigned);
-
-	if (filehash != fileHashCode) {
-		FileSystem::Remove(cacheFileName);
-		return false;
-	}
-
-	if (buffer.size() < (pos + blockSize * moveDefHandler.GetNumMoveDefs())) {
-		FileSystem::Remove(cacheFileName);
-		return false;
-	}
-
-	// read center-offset data
-	for (int pathType = 0; pathType < moveDefHandler.GetNumMoveDefs(); ++pathType) {
-		std::memcpy(&blockStates.peNodeOffsets[pathType][0], &buffer[pos], blockSize);
-		pos += blockSize;
-	}
-
-	// read vertex-cost data
-	if (buffer.size() < (pos + vertexCosts.size() * sizeof(float))) {
-		FileSystem::Remove(cacheFileName);
-		return false;
-	}
-
-	std::memcpy(&vertexCosts[0], &buffer[pos], vertexCosts.size() * sizeof(float));
-	return true;
+	return (dataDirsAccess.LocateFile(GetCacheFileName(IntToString(fileHashCode, "%x"), peFileName, mapFileName), FileQueryFlags::WRITE));
 }
 
-
 /**
- * Try to write offset and vertex data to file.
+ * Try to read offset and vertices data from file, returns the number of
+ * leading blocks (offsets, costs) that could be taken from it
  */
-bool CPathEstimator::WriteFile(const std::string& peFileName, const std::string& mapFileName)
+int2 CPathEstimator::ReadFile(CPathCostsFile& costsFile)
 {
-	// we need this directory to exist
-	if (!FileSystem::CreateDirectory(GetPathCacheDir()))
-		return false;
-
-	const std::string hashHexString = IntToString(fileHashCode, "%x");
-	const std::string cacheFileName = GetCacheFileName(hashHexString, peFileName, mapFileName);
-
-	LOG("[PathEstimator::%s] hash=%s file=\"%s\" (exists=%d)", __func__, hashHexString.c_str(), cacheFileName.c_str(), FileSystem::FileExists(cacheFileName));
-
-	// open file for writing in a suitable location
-	zipFile file = zipOpen(dataDirsAccess.LocateFile(cacheFileName, FileQueryFlags::WRITE).c_str(), APPEND_STATUS_CREATE);
-
-	if (file == nullptr)
-		return false;
-
-	zipOpenNewFileInZip(file, "pathinfo", nullptr, nullptr, 0, nullptr, 0, nullptr, Z_DEFLATED, Z_BEST_COMPRESSION);
-
-	// write hash-code (NOTE: this also affects the CRC!)
-	zipWriteInFileInZip(file, (const void*) &fileHashCode, 4);
-
-	// write center-offsets
-	for (int pathType = 0; pathType < moveDefHandler.GetNumMoveDefs(); ++pathType) {
-		zipWriteInFileInZip(file, (const void*) &blockStates.peNodeOffsets[pathType][0], blockStates.peNodeOffsets[pathType].size() * sizeof(short2));
-	}
-
-	// write vertex-costs
-	zipWriteInFileInZip(file, vertexCosts.data(), vertexCosts.size() * sizeof(float));
-
-	zipCloseFileInZip(file);
-	zipClose(file, nullptr);
-
-
-	// get the CRC over the written path data
-	std::unique_ptr<IArchive> upfile(archiveLoader.OpenArchive(dataDirsAccess.LocateFile(cacheFileName), "sdz"));
+	char calcMsg[512];
+	sprintf(calcMsg, "Reading Estimate PathCosts [%d]", BLOCK_SIZE);
+	loadscreen->SetLoadMessage(calcMsg);
 
-	if (upfile == nullptr || !upfile->IsOpen()) {
-		FileSystem::Remove(cacheFileName);
-		return false;
-	}
+	const int2 numCachedBlocks = costsFile.Read(blockStates.peNodeOffsets, vertexCosts);
 
-	assert(upfile->FindFile("pathinfo") < upfile->NumFiles());
-  return true;
+	LOG("[PathEstimator::%s] hash=%x cached {offset,cost} blocks={%d,%d} of %u", __func__, fileHashCode, numCachedBlocks.x, numCachedBlocks.y, blockStates.GetSize());
+	return numCachedBlocks;
 }
 
 
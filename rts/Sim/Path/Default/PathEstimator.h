@@ -22,6 +22,7 @@ class CPathFinder;
 class CPathEstimatorDef;
 class CPathFinderDef;
 class CPathCache;
+class CPathCostsFile;
 class CSolidObject;
 
 class CPathEstimator: public IPathFinder {
@@ -119,8 +120,8 @@ private:
 	void CalcVertexPathCosts(const MoveDef&, int2, unsigned int threadNum = 0);
 	void CalcVertexPathCost(const MoveDef&, int2, unsigned int pathDir, unsigned int threadNum = 0);
 
-	bool ReadFile(const std::string& peFileName, const std::string& mapFileName);
-	bool WriteFile(const std::string& peFileName, const std::string& mapFileName);
+	std::string GetCacheFilePath(const std::string& peFileName, const std::string& mapFileName) const;
+	int2 ReadFile(CPathCostsFile& costsFile);
 
 	std::uint32_t CalcChecksum() const;
 	std::uint32_t CalcHash(const char* caller) const;
@@ -145,6 +146,7 @@ private:
 	IPathFinder* parentPathFinder; // parent (PF if BLOCK_SIZE is 16, PE[16] if 32)
 	CPathEstimator* nextPathEstimator; // next lower-resolution estimator
 	CPathCache* pathCache[2]; // [0] = !synced, [1] = synced
+	CPathCostsFile* pathCostsFile = nullptr; // only set while InitEstimator runs
 
 	std::vector<IPathFinder*> pathFinders; // InitEstimator helpers
 	std::vector<spring::thread> threads;
@@ -363,6 +363,93 @@ IPath::SearchResult CPathManager::ArrangePath(
 }
 
 
+
+// returns the low-res block of <startPos> if the request is far enough for
+// ArrangePath to only run the estimators (i.e. its result can be shared),
+// otherwise (-1, -1)
+int2 CPathManager::GetCoarseStartBlock(const MultiPath& path, const float3& startPos, const float3& goalPos) const
+{
+	const CPathFinderDef& pfDef = path.peDef;
+	const float heurGoalDist2D = pfDef.Heuristic(startPos.x / SQUARE_SIZE, startPos.z / SQUARE_SIZE, 1) + math::fabs(goalPos.y - startPos.y) / SQUARE_SIZE;
+
+	if (heurGoalDist2D <= std::max(MEDRES_SEARCH_DISTANCE, MAXRES_SEARCH_DISTANCE * modInfo.pfRawDistMult))
+		return {-1, -1};
+
+	const unsigned int blockPixelSize = lowResPE->GetBlockSize() * SQUARE_SIZE;
+
+	return {int(startPos.x / blockPixelSize), int(startPos.z / blockPixelSize)};
+}
+
+std::uint64_t CPathManager::GetCoarsePathHash(const MultiPath& path, const int2 strtBlock) const
+{
+	const CPathFinderDef& pfDef = path.peDef;
+	const int2 numBlocks = lowResPE->GetNumBlocks();
+
+	// exact goal, goal-radius and any collisions are checked by FindCoarsePath
+	std::uint64_t hash = pfDef.goalSquareZ * mapDims.mapx + pfDef.goalSquareX;
+
+	hash *= (numBlocks.x * numBlocks.y);
+	hash += lowResPE->BlockPosToIdx(strtBlock);
+	hash *= moveDefHandler.GetNumMoveDefs();
+	hash += path.moveDef->pathType;
+
+	return ((hash << 1) | pfDef.synced);
+}
+
+bool CPathManager::FindCoarsePath(MultiPath& path, const int2 strtBlock, IPath::SearchResult& result) const
+{
+	if (strtBlock.x < 0)
+		return false;
+
+	const auto iter = coarsePaths.find(GetCoarsePathHash(path, strtBlock));
+
+	if (iter == coarsePaths.end())
+		return false;
+
+	const CoarsePath& cp = iter->second;
+	const CPathFinderDef& pfDef = path.peDef;
+
+	if (cp.strtBlock != strtBlock || cp.goalPos != path.finalGoal)
+		return false;
+	if (cp.sqGoalRadius != pfDef.sqGoalRadius || cp.pathType != path.moveDef->pathType || cp.synced != pfDef.synced)
+		return false;
+
+	path.lowResPath = cp.lowResPath;
+	path.medResPath = cp.medResPath;
+
+	// leave the definition as ArrangePath would have for refinement
+	path.peDef.DisableConstraint(true);
+	path.peDef.AllowRawPathSearch(false);
+
+	result = cp.searchResult;
+	return true;
+}
+
+void CPathManager::AddCoarsePath(const MultiPath& path, const int2 strtBlock, IPath::SearchResult result)
+{
+	if (strtBlock.x < 0 || !path.maxResPath.path.empty())
+		return;
+
+	const std::uint64_t hash = GetCoarsePathHash(path, strtBlock);
+	const CPathFinderDef& pfDef = path.peDef;
+
+	// first request wins, as with the estimator caches
+	if (coarsePaths.find(hash) != coarsePaths.end())
+		return;
+
+	coarsePaths[hash] = CoarsePath{
+		path.lowResPath,
+		path.medResPath,
+		result,
+		strtBlock,
+		path.finalGoal,
+		pfDef.sqGoalRadius,
+		path.moveDef->pathType,
+		pfDef.synced,
+	};
+}
+
+
 /*
 Request a new multipath, store the result and return a handle-id to it.
 */
@@ -394,7 +481,16 @@ unsigned int CPathManager::RequestPath(
 	if (caller != nullptr)
 		caller->UnBlock();
 
-	const IPath::SearchResult result = ArrangePath(&newPath, moveDef, startPos, goalPos, caller);
+	// requests of a group moving to the same goal share their estimator
+	// paths and differ only in the local refinement below
+	const int2 coarseBlock = GetCoarseStartBlock(newPath, startPos, goalPos);
+
+	IPath::SearchResult result = IPath::Error;
+
+	if (!FindCoarsePath(newPath, coarseBlock, result)) {
+		result = ArrangePath(&newPath, moveDef, startPos, goalPos, caller);
+		AddCoarsePath(newPath, coarseBlock, result);
+	}
 
 	unsigned int pathID = 0;
 
@@ -618,6 +714,7 @@ void CPathManager::TerrainChange(unsigned int x1, unsigned int z1, unsigned int
 	if (!IsFinalized())
 		return;
 
+	coarsePaths.clear();
 	medResPE->MapChanged(x1, z1, x2, z2);
 
 	// low-res PE will be informed via (medRes)PE::Update
@@ -637,6 +734,8 @@ void CPathManager::Update()
 	pathFlowMap->Update();
 	pathHeatMap->Update();
 
+	coarsePaths.clear();
+
 	medResPE->Update();
 	lowResPE->Update();
 }
@@ -72,6 +72,27 @@ public:
 		CSolidObject* caller;
 	};
 
+	/**
+	 * Estimator part of a long-distance request, shared for the rest of
+	 * the frame with requests of the same path-type that start in the
+	 * same low-res block and have the same goal (e.g. a group given one
+	 * move order); these only do their own local med- and max-res work.
+	 */
+	struct CoarsePath {
+		IPath::Path lowResPath;
+		IPath::Path medResPath;
+
+		IPath::SearchResult searchResult;
+
+		int2 strtBlock;
+		float3 goalPos;
+
+		float sqGoalRadius;
+
+		int pathType;
+		bool synced;
+	};
+
 public:
 	CPathManager();
 	~CPathManager();
@@ -165,6 +186,12 @@ private:
 		CSolidObject* caller
 	) const;
 
+	int2 GetCoarseStartBlock(const MultiPath& path, const float3& startPos, const float3& goalPos) const;
+	std::uint64_t GetCoarsePathHash(const MultiPath& path, const int2 strtBlock) const;
+
+	bool FindCoarsePath(MultiPath& path, const int2 strtBlock, IPath::SearchResult& result) const;
+	void AddCoarsePath(const MultiPath& path, const int2 strtBlock, IPath::SearchResult result);
+
 	MultiPath* GetMultiPath(int pathID) { return (const_cast<MultiPath*>(GetMultiPathConst(pathID))); }
 
 	const MultiPath* GetMultiPathConst(int pathID) const {
@@ -196,6 +223,8 @@ private:
 	PathHeatMap* pathHeatMap;
 
 	spring::unordered_map<unsigned int, MultiPath> pathMap;
+	// cleared every frame and on terrain changes
+	spring::unordered_map<std::uint64_t, CoarsePath> coarsePaths;
 
 	unsigned int nextPathID;
 };
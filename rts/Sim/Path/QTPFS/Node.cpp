@@ -20,43 +20,6 @@ unsigned int QTPFS::QTNode::MAX_DEPTH;
 
 
 
-void QTPFS::INode::SetPathCost(unsigned int type, float cost) {
-	#ifndef QTPFS_ENABLE_MICRO_OPTIMIZATION_HACKS
-	switch (type) {
-		case NODE_PATH_COST_F: { fCost = cost; return; } break;
-		case NODE_PATH_COST_G: { gCost = cost; return; } break;
-		case NODE_PATH_COST_H: { hCost = cost; return; } break;
-	}
-
-	assert(false);
-	#else
-	assert(&gCost == &fCost + 1);
-	assert(&hCost == &gCost + 1);
-	assert(type <= NODE_PATH_COST_H);
-
-	*(&fCost + type) = cost;
-	#endif
-}
-
-float QTPFS::INode::GetPathCost(unsigned int type) const {
-	#ifndef QTPFS_ENABLE_MICRO_OPTIMIZATION_HACKS
-	switch (type) {
-		case NODE_PATH_COST_F: { return fCost; } break;
-		case NODE_PATH_COST_G: { return gCost; } break;
-		case NODE_PATH_COST_H: { return hCost; } break;
-	}
-
-	assert(false);
-	return 0.0f;
-	#else
-	assert(&gCost == &fCost + 1);
-	assert(&hCost == &gCost + 1);
-	assert(type <= NODE_PATH_COST_H);
-
-	return *(&fCost + type);
-	#endif
-}
-
 float QTPFS::INode::GetDistance(const INode* n, unsigned int type) const {
 	const float dx = float(xmid() * SQUARE_SIZE) - float(n->xmid() * SQUARE_SIZE);
 	const float dz = float(zmid() * SQUARE_SIZE) - float(n->zmid() * SQUARE_SIZE);
@@ -198,9 +161,7 @@ void QTPFS::QTNode::Init(
 	assert(MIN_SIZE_Z > 0);
 
 	nodeNumber = nn;
-	heapIndex = -1u;
 
-	searchState  =   0;
 	currMagicNum =   0;
 	prevMagicNum = -1u;
 
@@ -215,18 +176,14 @@ void QTPFS::QTNode::Init(
 	assert(xsize() != 0);
 	assert(zsize() != 0);
 
-	fCost = 0.0f;
-	gCost = 0.0f;
-	hCost = 0.0f;
-
 	speedModSum =  0.0f;
 	speedModAvg =  0.0f;
 	moveCostAvg = -1.0f;
 
-	prevNode = nullptr;
-
-	neighbors.clear();
-	netpoints.clear();
+	// any range was released by FreeNeighborCache
+	ngbRange = -1u;
+	ngbRangeClass = 0;
+	numNeighbors = 0;
 }
 
 
@@ -234,10 +191,8 @@ void QTPFS::QTNode::Init(
 std::uint64_t QTPFS::QTNode::GetMemFootPrint(const NodeLayer& nl) const {
 	std::uint64_t memFootPrint = sizeof(QTNode);
 
-	if (IsLeaf()) {
-		memFootPrint += (neighbors.size() * sizeof(decltype(neighbors)::value_type));
-		memFootPrint += (netpoints.size() * sizeof(decltype(netpoints)::value_type));
-	} else {
+	// neighbor-caches are accounted for by NodeLayer
+	if (!IsLeaf()) {
 		for (unsigned int i = 0; i < QTNODE_CHILD_COUNT; i++) {
 			memFootPrint += (nl.GetPoolNode(childBaseIndex + i)->GetMemFootPrint(nl));
 		}
@@ -251,7 +206,7 @@ std::uint64_t QTPFS::QTNode::GetCheckSum(const NodeLayer& nl) const {
 
 	{
 		const unsigned char* minByte = reinterpret_cast<const unsigned char*>(&nodeNumber);
-		const unsigned char* maxByte = reinterpret_cast<const unsigned char*>(&hCost) + sizeof(hCost);
+		const unsigned char* maxByte = reinterpret_cast<const unsigned char*>(&nodeIndex) + sizeof(nodeIndex);
 
 		assert(minByte < maxByte);
 
@@ -330,8 +285,7 @@ bool QTPFS::QTNode::Split(NodeLayer& nl, unsigned int depth, bool forced) {
 
 	childBaseIndex = childIndices[0];
 
-	neighbors.clear();
-	netpoints.clear();
+	FreeNeighborCache(nl);
 
 	nl.SetNumLeafNodes(nl.GetNumLeafNodes() + (4 - 1));
 	assert(!IsLeaf());
@@ -342,12 +296,10 @@ bool QTPFS::QTNode::Merge(NodeLayer& nl) {
 	if (IsLeaf())
 		return false;
 
-	neighbors.clear();
-	// netpoints.clear();
-
 	// get rid of our children completely
 	for (unsigned int i = 0; i < QTNODE_CHILD_COUNT; i++) {
 		nl.GetPoolNode(childBaseIndex + i)->Merge(nl);
+		nl.GetPoolNode(childBaseIndex + i)->FreeNeighborCache(nl);
 	}
 
 	// NOTE: return indices in reverse order (BL, BR, TR, TL) of allocation by Split
@@ -679,32 +631,26 @@ void QTPFS::QTNode::Serialize(std::fstream& fStream, NodeLayer& nodeLayer, unsig
 	}
 }
 
-unsigned int QTPFS::QTNode::GetNeighbors(const std::vector<INode*>& nodes, std::vector<INode*>& ngbs) {
+unsigned int QTPFS::QTNode::GetNeighbors(NodeLayer& nl) {
 	#ifdef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
-	UpdateNeighborCache(nodes);
+	UpdateNeighborCache(nl);
 	#endif
-
-	if (!neighbors.empty()) {
-		ngbs.clear();
-		ngbs.resize(neighbors.size());
-
-		std::copy(neighbors.begin(), neighbors.end(), ngbs.begin());
-	}
-
-	return (neighbors.size());
+	return numNeighbors;
 }
 
-const std::vector<QTPFS::INode*>& QTPFS::QTNode::GetNeighbors(const std::vector<INode*>& nodes) {
-	#ifdef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
-	UpdateNeighborCache(nodes);
-	#endif
-	return neighbors;
+void QTPFS::QTNode::FreeNeighborCache(NodeLayer& nl) {
+	nl.FreeNeighborRange(ngbRange, ngbRangeClass);
+
+	ngbRange = -1u;
+	numNeighbors = 0;
 }
 
 // this is *either* called from ::GetNeighbors when the conservative
 // update-scheme is enabled, *or* from PM::ExecQueuedNodeLayerUpdates
 // (never both)
-bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
+bool QTPFS::QTNode::UpdateNeighborCache(NodeLayer& nl) {
+	const std::vector<INode*>& nodes = nl.GetNodes();
+
 	assert(IsLeaf());
 	assert(!nodes.empty());
 
@@ -714,17 +660,16 @@ bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
 		unsigned int ngbRels = 0;
 		unsigned int maxNgbs = GetMaxNumNeighbors();
 
+		// collected here first, then packed into the layer's arrays
+		std::vector<INode*>& neighbors = nl.GetTempNeighbors();
+		std::vector<float2>& netpoints = nl.GetTempNetpoints();
+
+		neighbors.clear();
+		netpoints.clear();
+
 		// regenerate our neighbor cache
 		if (maxNgbs > 0) {
-			neighbors.clear();
-			neighbors.reserve(maxNgbs + 4);
-
-			netpoints.clear();
-			netpoints.reserve(1 + maxNgbs * QTPFS_MAX_NETPOINTS_PER_NODE_EDGE + 4);
 			// NOTE: caching ETP's breaks QTPFS_ORTHOPROJECTED_EDGE_TRANSITIONS
-			// NOTE: [0] is a reserved index and must always be valid
-			netpoints.emplace_back();
-
 			INode* ngb = nullptr;
 
 			if (xmin() > 0) {
@@ -872,6 +817,8 @@ bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
 			#endif
 		}
 
+		ngbRange = nl.StoreNeighbors(ngbRange, ngbRangeClass, neighbors, netpoints);
+		numNeighbors = neighbors.size();
 		return true;
 	}
 
@@ -25,25 +25,16 @@ namespace QTPFS {
 	struct INode {
 	public:
 		void SetNodeNumber(unsigned int n) { nodeNumber = n; }
-		void SetHeapIndex(unsigned int n) { heapIndex = n; }
+		void SetNodeIndex(unsigned int i) { nodeIndex = i; }
 		unsigned int GetNodeNumber() const { return nodeNumber; }
-		unsigned int GetHeapIndex() const { return heapIndex; }
-		float GetHeapPriority() const { return GetPathCost(NODE_PATH_COST_F); }
-
-		bool operator <  (const INode* n) const { return (fCost <  n->fCost); }
-		bool operator >  (const INode* n) const { return (fCost >  n->fCost); }
-		bool operator == (const INode* n) const { return (fCost == n->fCost); }
-		bool operator <= (const INode* n) const { return (fCost <= n->fCost); }
-		bool operator >= (const INode* n) const { return (fCost >= n->fCost); }
+		// dense per-layer index (see NodeLayer::GetNumNodeIndices)
+		unsigned int GetNodeIndex() const { return nodeIndex; }
 
 		#ifdef QTPFS_VIRTUAL_NODE_FUNCTIONS
 		virtual void Serialize(std::fstream&, NodeLayer&, unsigned int*, unsigned int, bool) = 0;
-		virtual unsigned int GetNeighbors(const std::vector<INode*>&, std::vector<INode*>&) = 0;
-		virtual const std::vector<INode*>& GetNeighbors(const std::vector<INode*>& v) = 0;
-		virtual bool UpdateNeighborCache(const std::vector<INode*>& nodes) = 0;
-
-		virtual void SetNeighborEdgeTransitionPoint(unsigned int ngbIdx, const float2& point) = 0;
-		virtual const float2& GetNeighborEdgeTransitionPoint(unsigned int ngbIdx) const = 0;
+		virtual unsigned int GetNeighbors(NodeLayer& nl) = 0;
+		virtual unsigned int GetNeighborRange() const = 0;
+		virtual bool UpdateNeighborCache(NodeLayer& nl) = 0;
 		#endif
 
 		unsigned int GetNeighborRelation(const INode* ngb) const;
@@ -70,34 +61,17 @@ namespace QTPFS {
 		virtual float GetMoveCost() const = 0;
 
 		virtual void SetMoveCost(float cost) = 0;
-		virtual void SetSearchState(unsigned int) = 0;
 		virtual void SetMagicNumber(unsigned int) = 0;
 
-		virtual unsigned int GetSearchState() const = 0;
 		virtual unsigned int GetMagicNumber() const = 0;
 		#endif
 
-		void SetPathCosts(float g, float h) { fCost = g + h; gCost = g; hCost = h; }
-		void SetPathCost(unsigned int type, float cost);
-		const float* GetPathCosts() const { return &fCost; }
-		float GetPathCost(unsigned int type) const;
-
-		void SetPrevNode(INode* n) { prevNode = n; }
-		INode* GetPrevNode() { return prevNode; }
-
 	protected:
-		// NOTE:
-		//     storing the heap-index is an *UGLY* break of abstraction,
-		//     but the only way to keep the cost of resorting acceptable
+		// per-search state (costs, back-pointer, heap-index) is not kept
+		// here but in the executing thread's PathSearch::SearchNode's, so
+		// any number of searches can run on a layer at the same time
 		unsigned int nodeNumber = -1u;
-		unsigned int heapIndex = -1u;
-
-		float fCost = 0.0f;
-		float gCost = 0.0f;
-		float hCost = 0.0f;
-
-		// points back to previous node in path
-		INode* prevNode = nullptr;
+		unsigned int nodeIndex = -1u;
 
 	#ifdef QTPFS_VIRTUAL_NODE_FUNCTIONS
 	};
@@ -145,12 +119,13 @@ namespace QTPFS {
 		bool Merge(NodeLayer& nl);
 
 		unsigned int GetMaxNumNeighbors() const;
-		unsigned int GetNeighbors(const std::vector<INode*>&, std::vector<INode*>&);
-		const std::vector<INode*>& GetNeighbors(const std::vector<INode*>&);
-		bool UpdateNeighborCache(const std::vector<INode*>& nodes);
-
-		void SetNeighborEdgeTransitionPoint(unsigned int ngbIdx, const float2& point) { netpoints[ngbIdx] = point; }
-		const float2& GetNeighborEdgeTransitionPoint(unsigned int ngbIdx) const { return netpoints[ngbIdx]; }
+		// the neighbor-cache lives in NodeLayer (see StoreNeighbors), at
+		// GetNeighborRange with QTPFS_MAX_NETPOINTS_PER_NODE_EDGE points
+		// per neighbor; returns the number of neighbors
+		unsigned int GetNeighbors(NodeLayer& nl);
+		unsigned int GetNeighborRange() const { return ngbRange; }
+		bool UpdateNeighborCache(NodeLayer& nl);
+		void FreeNeighborCache(NodeLayer& nl);
 
 		unsigned int xmin() const { return (_xminxmax  & 0xFFFF); }
 		unsigned int zmin() const { return (_zminzmax  & 0xFFFF); }
@@ -167,12 +142,10 @@ namespace QTPFS {
 		bool AllSquaresImpassable() const { return (moveCostAvg == QTPFS_POSITIVE_INFINITY); }
 
 		void SetMoveCost(float cost) { moveCostAvg = cost; }
-		void SetSearchState(unsigned int state) { searchState = state; }
 		void SetMagicNumber(unsigned int number) { currMagicNum = number; }
 
 		float GetSpeedMod() const { return speedModAvg; }
 		float GetMoveCost() const { return moveCostAvg; }
-		unsigned int GetSearchState() const { return searchState; }
 		unsigned int GetMagicNumber() const { return currMagicNum; }
 		unsigned int GetChildBaseIndex() const { return childBaseIndex; }
 
@@ -201,14 +174,14 @@ namespace QTPFS {
 		float speedModAvg =  0.0f;
 		float moveCostAvg = -1.0f;
 
-		unsigned int searchState = 0;
 		unsigned int currMagicNum = 0;
 		unsigned int prevMagicNum = -1u;
 
 		unsigned int childBaseIndex = -1u;
 
-		std::vector<INode*> neighbors;
-		std::vector<float2> netpoints;
+		unsigned int ngbRange = -1u;
+		unsigned int ngbRangeClass = 0;
+		unsigned int numNeighbors = 0;
 	};
 }
 
@@ -3,6 +3,8 @@
 #ifndef QTPFS_NODEHEAP_HDR
 #define QTPFS_NODEHEAP_HDR
 
+#include <algorithm>
+#include <cassert>
 #include <limits>
 #include <vector>
 #include "PathDefines.hpp"
@@ -291,7 +293,163 @@ namespace QTPFS {
 		size_t cur_idx; // index of first free (unused) slot
 		size_t max_idx; // index of last free (unused) slot
 	};
+
+
+
+	// four-ary min-heap that keeps each node's priority next to its pointer,
+	// so sifting compares within one or two cache-lines instead of touching
+	// the (scattered) nodes; nodes are moved into place rather than swapped
+	// and only have their heap-index written once per move
+	//
+	// NOTE:
+	//   priorities are snapshots, so resort() must be called whenever
+	//   the f-cost of a queued node changes (as with binary_heap)
+	template<class TNode> class quaternary_heap {
+	public:
+		quaternary_heap() { clear(); }
+		quaternary_heap(size_t n) { reserve(n); }
+		~quaternary_heap() { clear(); }
+
+		void push(TNode n) {
+			assert(n != NULL);
+
+			if (cur_idx == items.size())
+				items.resize(std::max(items.size() * 2, size_t(ARITY)));
+
+			cur_idx += 1;
+			sift_up(cur_idx - 1, {n->GetHeapPriority(), n});
+
+			#ifdef QTPFS_DEBUG_NODE_HEAP
+			check_heap_property(0);
+			#endif
+		}
+
+		void pop() {
+			assert(!empty());
+
+			items[0].node->SetHeapIndex(-1u);
+
+			// move the last node into the vacated root and let it sink
+			if ((cur_idx -= 1) > 0)
+				sift_down(0, items[cur_idx]);
+
+			#ifdef QTPFS_DEBUG_NODE_HEAP
+			check_heap_property(0);
+			#endif
+		}
+
+		TNode top() {
+			assert(!empty());
+			return items[0].node;
+		}
+
+		bool empty() const { return (size() == 0); }
+		size_t size() const { return cur_idx; }
+		size_t capacity() const { return items.size(); }
+
+		void clear() {
+			items.clear();
+			cur_idx = 0;
+		}
+
+		void reserve(size_t size) {
+			items.clear();
+			items.resize(size);
+			cur_idx = 0;
+		}
+
+		// acts like reserve(), but without re-allocating
+		void reset() { cur_idx = 0; }
+
+		void resort(TNode n) {
+			assert(n != NULL);
+			assert(valid_idx(n->GetHeapIndex()));
+
+			const size_t n_idx = n->GetHeapIndex();
+			const Item item = {n->GetHeapPriority(), n};
+
+			assert(items[n_idx].node == n);
+
+			if (n_idx > 0 && item.priority < items[parent_idx(n_idx)].priority) {
+				sift_up(n_idx, item);
+			} else {
+				sift_down(n_idx, item);
+			}
+
+			#ifdef QTPFS_DEBUG_NODE_HEAP
+			check_heap_property(0);
+			#endif
+		}
+
+		void check_heap_property(size_t idx) const {
+			#ifdef QTPFS_DEBUG_NODE_HEAP
+			for (size_t c_idx = child_idx(idx), i = 0; i < ARITY && valid_idx(c_idx + i); i++) {
+				assert(items[idx].priority <= items[c_idx + i].priority);
+				assert(items[c_idx + i].node->GetHeapIndex() == (c_idx + i));
+
+				check_heap_property(c_idx + i);
+			}
+			#endif
+		}
+
+	private:
+		struct Item {
+			float priority;
+			TNode node;
+		};
+
+		static constexpr size_t ARITY = 4;
+
+		size_t parent_idx(size_t n_idx) const { return ((n_idx - 1) / ARITY); }
+		size_t  child_idx(size_t n_idx) const { return ((n_idx * ARITY) + 1); }
+
+		bool valid_idx(size_t idx) const { return (idx < cur_idx); }
+
+		void place(size_t idx, const Item& item) {
+			items[idx] = item;
+			items[idx].node->SetHeapIndex(idx);
+		}
+
+		void sift_up(size_t c_idx, const Item item) {
+			while (c_idx > 0) {
+				const size_t p_idx = parent_idx(c_idx);
+
+				if (items[p_idx].priority <= item.priority)
+					break;
+
+				place(c_idx, items[p_idx]);
+				c_idx = p_idx;
+			}
+
+			place(c_idx, item);
+		}
+
+		void sift_down(size_t p_idx, const Item item) {
+			for (size_t c_idx = child_idx(p_idx); valid_idx(c_idx); c_idx = child_idx(p_idx)) {
+				const size_t c_end = std::min(c_idx + ARITY, cur_idx);
+
+				size_t m_idx = c_idx;
+
+				// pick the smallest child (first one on ties)
+				for (size_t i = c_idx + 1; i < c_end; i++) {
+					m_idx = (items[i].priority < items[m_idx].priority)? i: m_idx;
+				}
+
+				if (item.priority <= items[m_idx].priority)
+					break;
+
+				place(p_idx, items[m_idx]);
+				p_idx = m_idx;
+			}
+
+			place(p_idx, item);
+		}
+
+	private:
+		std::vector<Item> items;
+
+		size_t cur_idx; // index of first free (unused) slot
+	};
 }
 
 #endif
-
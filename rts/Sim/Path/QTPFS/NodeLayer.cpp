@@ -32,11 +32,56 @@ void QTPFS::NodeLayer::RegisterNode(INode* n) {
 	}
 }
 
+unsigned int QTPFS::NodeLayer::StoreNeighbors(
+	unsigned int range,
+	unsigned int& rangeClass,
+	const std::vector<INode*>& neighbors,
+	const std::vector<float2>& netpoints
+) {
+	assert(netpoints.size() == (neighbors.size() * QTPFS_MAX_NETPOINTS_PER_NODE_EDGE));
+
+	if (neighbors.empty()) {
+		FreeNeighborRange(range, rangeClass);
+		return -1u;
+	}
+
+	const unsigned int numNgbs = neighbors.size();
+
+	unsigned int ngbClass = 0;
+
+	// smallest power-of-two that fits
+	while ((1u << ngbClass) < numNgbs) {
+		ngbClass++;
+	}
+
+	assert(ngbClass < NUM_RANGE_CLASSES);
+
+	// keep the current range unless it is too small or four times too large
+	if (range == -1u || ngbClass > rangeClass || (ngbClass + 2) <= rangeClass) {
+		FreeNeighborRange(range, rangeClass);
+
+		if (!freeNgbRanges[rangeClass = ngbClass].empty()) {
+			range = freeNgbRanges[rangeClass].back();
+			freeNgbRanges[rangeClass].pop_back();
+		} else {
+			range = ngbNodes.size();
+
+			ngbNodes.resize(range + (1u << rangeClass), nullptr);
+			ngbPoints.resize((range + (1u << rangeClass)) * QTPFS_MAX_NETPOINTS_PER_NODE_EDGE);
+		}
+	}
+
+	std::copy(neighbors.begin(), neighbors.end(), ngbNodes.begin() + range);
+	std::copy(netpoints.begin(), netpoints.end(), ngbPoints.begin() + range * QTPFS_MAX_NETPOINTS_PER_NODE_EDGE);
+	return range;
+}
+
 void QTPFS::NodeLayer::Init(unsigned int layerNum) {
 	assert((QTPFS::NodeLayer::NUM_SPEEDMOD_BINS + 1) <= MaxSpeedBinTypeValue());
 
 	// pre-count the root
 	numLeafNodes = 1;
+	numNodeIndices = 0;
 	layerNumber = layerNum;
 
 	xsize = mapDims.mapx;
@@ -62,6 +107,13 @@ void QTPFS::NodeLayer::Init(unsigned int layerNum) {
 void QTPFS::NodeLayer::Clear() {
 	nodeGrid.clear();
 
+	ngbNodes.clear();
+	ngbPoints.clear();
+
+	for (std::vector<unsigned int>& freeRanges: freeNgbRanges) {
+		freeRanges.clear();
+	}
+
 	curSpeedMods.clear();
 	oldSpeedMods.clear();
 	oldSpeedBins.clear();
@@ -263,7 +315,7 @@ void QTPFS::NodeLayer::ExecNodeNeighborCacheUpdate(unsigned int currFrameNum, un
 				zspan = std::max(zspan, 1u);
 
 				n->SetMagicNumber(currMagicNum);
-				n->GetNeighbors(nodeGrid);
+				n->GetNeighbors(*this);
 			}
 
 			z += zspan;
@@ -285,7 +337,7 @@ void QTPFS::NodeLayer::ExecNodeNeighborCacheUpdate(unsigned int currFrameNum, un
 				zspan = std::max(zspan, 1u);
 
 				n->SetMagicNumber(currMagicNum);
-				n->GetNeighbors(nodeGrid);
+				n->GetNeighbors(*this);
 			}
 
 			z += zspan;
@@ -307,7 +359,7 @@ void QTPFS::NodeLayer::ExecNodeNeighborCacheUpdate(unsigned int currFrameNum, un
 				zspan = std::max(zspan, 1u);
 
 				n->SetMagicNumber(currMagicNum);
-				n->GetNeighbors(nodeGrid);
+				n->GetNeighbors(*this);
 			}
 
 			z += zspan;
@@ -329,7 +381,7 @@ void QTPFS::NodeLayer::ExecNodeNeighborCacheUpdate(unsigned int currFrameNum, un
 				zspan = std::max(zspan, 1u);
 
 				n->SetMagicNumber(currMagicNum);
-				n->GetNeighbors(nodeGrid);
+				n->GetNeighbors(*this);
 			}
 
 			z += zspan;
@@ -364,7 +416,7 @@ void QTPFS::NodeLayer::ExecNodeNeighborCacheUpdates(const SRectangle& ur, unsign
 			//   during initialization, currMagicNum == 0 which nodes start with already 
 			//   (does not matter because prevMagicNum == -1, so updates are not no-ops)
 			n->SetMagicNumber(currMagicNum);
-			n->UpdateNeighborCache(nodeGrid);
+			n->UpdateNeighborCache(*this);
 		}
 
 		z += zspan;
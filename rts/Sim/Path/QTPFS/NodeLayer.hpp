@@ -3,6 +3,7 @@
 #ifndef QTPFS_NODELAYER_HDR
 #define QTPFS_NODELAYER_HDR
 
+#include <algorithm>
 #include <limits>
 #include <vector>
 #include <deque>
@@ -76,6 +77,8 @@ namespace QTPFS {
 
 		INode* AllocRootNode(const INode* parent, unsigned int nn,  unsigned int x1, unsigned int z1, unsigned int x2, unsigned int z2) {
 			rootNode.Init(parent, nn, x1, z1, x2, z2);
+			rootNode.SetNodeIndex(0);
+			numNodeIndices = std::max(numNodeIndices, 1u);
 			return &rootNode;
 		}
 
@@ -89,8 +92,11 @@ namespace QTPFS {
 				poolNodes[idx / POOL_CHUNK_SIZE].resize(POOL_CHUNK_SIZE);
 
 			poolNodes[idx / POOL_CHUNK_SIZE][idx % POOL_CHUNK_SIZE].Init(parent, nn, x1, z1, x2, z2);
+			poolNodes[idx / POOL_CHUNK_SIZE][idx % POOL_CHUNK_SIZE].SetNodeIndex(idx + 1);
 			nodeIndcs.pop_back();
 
+			numNodeIndices = std::max(numNodeIndices, idx + 2);
+
 			return idx;
 		}
 
@@ -104,10 +110,37 @@ namespace QTPFS {
 
 		std::vector<INode*>& GetNodes() { return nodeGrid; }
 
+		// neighbor-caches of all leaf-nodes, packed into two arrays; each
+		// node owns a range of a power-of-two size-class (with the same
+		// number of transition-point blocks) which is recycled through
+		// per-class free-lists whenever nodes are split or merged
+		unsigned int StoreNeighbors(
+			unsigned int range,
+			unsigned int& rangeClass,
+			const std::vector<INode*>& neighbors,
+			const std::vector<float2>& netpoints
+		);
+		void FreeNeighborRange(unsigned int range, unsigned int rangeClass) {
+			if (range == -1u)
+				return;
+
+			freeNgbRanges[rangeClass].push_back(range);
+		}
+
+		INode* const* GetNeighbors(unsigned int range) const { return &ngbNodes[range]; }
+		const float2* GetNetpoints(unsigned int range) const { return &ngbPoints[range * QTPFS_MAX_NETPOINTS_PER_NODE_EDGE]; }
+
+		// scratch-space for QTNode::UpdateNeighborCache
+		std::vector<INode*>& GetTempNeighbors() { return tmpNgbNodes; }
+		std::vector<float2>& GetTempNetpoints() { return tmpNgbPoints; }
+
 		void RegisterNode(INode* n);
 
 		void SetNumLeafNodes(unsigned int n) { numLeafNodes = n; }
 		unsigned int GetNumLeafNodes() const { return numLeafNodes; }
+		// upper bound on INode::GetNodeIndex; the root is 0, pool-node i is i+1
+		// (pool-indices are handed out lowest-first, so this stays compact)
+		unsigned int GetNumNodeIndices() const { return numNodeIndices; }
 
 		float GetMaxRelSpeedMod() const { return maxRelSpeedMod; }
 		float GetAvgRelSpeedMod() const { return avgRelSpeedMod; }
@@ -126,6 +159,11 @@ namespace QTPFS {
 				memFootPrint += (poolNodes[i].size() * sizeof(QTNode));
 			}
 			memFootPrint += (nodeIndcs.size() * sizeof(decltype(nodeIndcs)::value_type));
+			memFootPrint += (ngbNodes.capacity() * sizeof(decltype(ngbNodes)::value_type));
+			memFootPrint += (ngbPoints.capacity() * sizeof(decltype(ngbPoints)::value_type));
+			for (size_t i = 0, n = NUM_RANGE_CLASSES; i < n; i++) {
+				memFootPrint += (freeNgbRanges[i].capacity() * sizeof(unsigned int));
+			}
 			return memFootPrint;
 		}
 
@@ -135,6 +173,13 @@ namespace QTPFS {
 		std::vector<QTNode> poolNodes[16];
 		std::vector<unsigned int> nodeIndcs;
 
+		std::vector<INode*> ngbNodes;
+		std::vector<float2> ngbPoints;
+		std::vector<unsigned int> freeNgbRanges[32];
+
+		std::vector<INode*> tmpNgbNodes;
+		std::vector<float2> tmpNgbPoints;
+
 		std::vector<SpeedModType> curSpeedMods;
 		std::vector<SpeedModType> oldSpeedMods;
 		std::vector<SpeedBinType> curSpeedBins;
@@ -150,6 +195,7 @@ namespace QTPFS {
 		static constexpr unsigned int NUM_POOL_CHUNKS = sizeof(poolNodes) / sizeof(poolNodes[0]);
 		static constexpr unsigned int POOL_TOTAL_SIZE = (1024 * 1024) / 2;
 		static constexpr unsigned int POOL_CHUNK_SIZE = POOL_TOTAL_SIZE / NUM_POOL_CHUNKS;
+		static constexpr unsigned int NUM_RANGE_CLASSES = sizeof(freeNgbRanges) / sizeof(freeNgbRanges[0]);
 
 		// NOTE:
 		//   we need a fixed range that does not become wider / narrower
@@ -161,6 +207,7 @@ namespace QTPFS {
 
 		unsigned int layerNumber = 0;
 		unsigned int numLeafNodes = 0;
+		unsigned int numNodeIndices = 0;
 		unsigned int updateCounter = 0;
 
 		unsigned int xsize = 0;
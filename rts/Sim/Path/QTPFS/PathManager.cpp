@@ -148,7 +148,7 @@ QTPFS::PathManager::~PathManager() {
 	numCurrExecutedSearches.clear();
 	numPrevExecutedSearches.clear();
 
-	PathSearch::FreeGlobalQueue();
+	PathSearch::FreeGlobalQueues();
 
 	#ifdef QTPFS_ENABLE_THREADED_UPDATE
 	// at this point the thread is waiting, so notify it
@@ -191,6 +191,9 @@ void QTPFS::PathManager::Load() {
 	numPathRequests   = 0;
 	maxNumLeafNodes   = 0;
 
+	numExecutedSearches = 0;
+	numSharedSearches   = 0;
+
 	nodeTrees.resize(moveDefHandler.GetNumMoveDefs(), nullptr);
 	nodeLayers.resize(moveDefHandler.GetNumMoveDefs());
 	pathCaches.resize(moveDefHandler.GetNumMoveDefs());
@@ -247,7 +250,7 @@ void QTPFS::PathManager::Load() {
 
 		{ SyncedUint tmp(pfsCheckSum); }
 
-		PathSearch::InitGlobalQueue(maxNumLeafNodes);
+		PathSearch::InitGlobalQueues(maxNumLeafNodes);
 	}
 
 	{
@@ -722,9 +725,11 @@ void QTPFS::PathManager::ThreadUpdate() {
 			ExecQueuedNodeLayerUpdates(pathTypeUpdate, !pathSearches[pathTypeUpdate].empty());
 			#endif
 
-			ExecuteQueuedSearches(pathTypeUpdate);
+			SelectQueuedSearches(pathTypeUpdate);
 		}
 
+		ExecuteQueuedSearches();
+
 		std::copy(numCurrExecutedSearches.begin(), numCurrExecutedSearches.end(), numPrevExecutedSearches.begin());
 
 		minPathTypeUpdate = (minPathTypeUpdate + numPathTypeUpdates);
@@ -747,88 +752,167 @@ void QTPFS::PathManager::ThreadUpdate() {
 
 
 
-void QTPFS::PathManager::ExecuteQueuedSearches(unsigned int pathType) {
+void QTPFS::PathManager::SelectQueuedSearches(unsigned int pathType) {
 	NodeLayer& nodeLayer = nodeLayers[pathType];
 	PathCache& pathCache = pathCaches[pathType];
 
-	std::vector<IPathSearch*>& searches = pathSearches[pathType];
-	std::vector<IPathSearch*>::iterator searchesIt = searches.begin();
+	// pending searches collected via RequestPath and QueueDeadPathSearches
+	PathSearchVect& searches = pathSearches[pathType];
+
+	const unsigned int batchSize = searchBatch.size();
+	unsigned int numKeptSearches = 0;
+
+	for (IPathSearch* search: searches) {
+		IPath* path = pathCache.GetTempPath(search->GetID());
+
+		assert(search != nullptr);
+		assert(path != nullptr);
+
+		// temp-path might have been removed already via
+		// DeletePath before we got a chance to process it
+		if (path->GetID() == 0) {
+			delete search;
+			continue;
+		}
+
+		assert(search->GetID() != 0);
+		assert(path->GetID() == search->GetID());
+
+		search->Initialize(&nodeLayer, &pathCache, path->GetSourcePoint(), path->GetTargetPoint(), MAP_RECTANGLE);
+		path->SetHash(search->GetHash(mapDims.mapx * mapDims.mapy, pathType));
 
-	if (!searches.empty()) {
-		// execute pending searches collected via
-		// RequestPath and QueueDeadPathSearches
-		while (searchesIt != searches.end()) {
-			if (ExecuteSearch(searches, searchesIt, nodeLayer, pathCache, pathType)) {
-				searchStateOffset += NODE_STATE_OFFSET;
+		#ifdef QTPFS_SEARCH_SHARED_PATHS
+		{
+			// an earlier search in this batch runs between the same nodes; copy
+			// its path (or its failure) when results are committed, provided
+			// the targets are close enough for PathSearch::SharedFinalize
+			const SharedPathMap::const_iterator sharedPathsIt = sharedPaths.find(path->GetHash());
+
+			if (sharedPathsIt != sharedPaths.end()) {
+				const float3& p0 = searchBatch[sharedPathsIt->second].path->GetTargetPoint();
+				const float3& p1 = path->GetTargetPoint();
+
+				if (p0.SqDistance(p1) < (SQUARE_SIZE * SQUARE_SIZE)) {
+					searchBatch.push_back({search, path, pathType, 0, sharedPathsIt->second, false});
+					continue;
+				}
 			}
 		}
-	}
-}
+		#endif
 
-bool QTPFS::PathManager::ExecuteSearch(
-	PathSearchVect& searches,
-	PathSearchVectIt& searchesIt,
-	NodeLayer& nodeLayer,
-	PathCache& pathCache,
-	unsigned int pathType
-) {
-	IPathSearch* search = *searchesIt;
-	IPath* path = pathCache.GetTempPath(search->GetID());
+		#ifdef QTPFS_LIMIT_TEAM_SEARCHES
+		{
+			const unsigned int numCurrSearches = numCurrExecutedSearches[search->GetTeam()];
+			const unsigned int numPrevSearches = numPrevExecutedSearches[search->GetTeam()];
 
-	assert(search != nullptr);
-	assert(path != nullptr);
+			// keep the search queued until the team is below its limit again
+			if ((numCurrSearches - numPrevSearches) >= MAX_TEAM_SEARCHES) {
+				searches[numKeptSearches++] = search;
+				continue;
+			}
 
-	const auto DeleteSearch = [](IPathSearch* s, PathSearchVect& v, PathSearchVectIt& it) {
-		// ordering of still-queued searches is not relevant
-		*it = v.back();
-		v.pop_back();
-		delete s;
-	};
+			numCurrExecutedSearches[search->GetTeam()] += 1;
+		}
+		#endif
 
-	// temp-path might have been removed already via
-	// DeletePath before we got a chance to process it
-	if (path->GetID() == 0) {
-		DeleteSearch(search, searches, searchesIt);
-		return false;
+		#ifdef QTPFS_SEARCH_SHARED_PATHS
+		sharedPaths[path->GetHash()] = searchBatch.size();
+		#endif
+
+		searchBatch.push_back({search, path, pathType, searchStateOffset, -1u, false});
+		searchStateOffset += NODE_STATE_OFFSET;
 	}
 
-	assert(search->GetID() != 0);
-	assert(path->GetID() == search->GetID());
+	searches.resize(numKeptSearches);
+
+	if (searchBatch.size() == batchSize)
+		return;
 
-	search->Initialize(&nodeLayer, &pathCache, path->GetSourcePoint(), path->GetTargetPoint(), MAP_RECTANGLE);
-	path->SetHash(search->GetHash(mapDims.mapx * mapDims.mapy, pathType));
+	searchBatchLayers.emplace_back(batchSize, searchBatch.size());
+}
 
+void QTPFS::PathManager::ExecuteQueuedSearches() {
 	{
-		#ifdef QTPFS_SEARCH_SHARED_PATHS
-		SharedPathMap::const_iterator sharedPathsIt = sharedPaths.find(path->GetHash());
+		SCOPED_TIMER("Sim::Path::Searches");
 
-		if (sharedPathsIt != sharedPaths.end()) {
-			if (search->SharedFinalize(sharedPathsIt->second, path)) {
-				DeleteSearch(search, searches, searchesIt);
-				return false;
+		#ifndef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
+		// node-states live in per-thread buffers and layers are read-only
+		// while searching, so any search can run on any thread (for_mt
+		// hands out items one at a time, which balances long searches)
+		for_mt(0, searchBatch.size(), [&](const int i) {
+			ExecuteSearch(searchBatch[i]);
+		});
+		#else
+		// GetNeighbors can rebuild a node's neighbor-cache in the layer's
+		// shared scratch-space, so keep all searches of a layer on one thread
+		for_mt(0, searchBatchLayers.size(), [&](const int i) {
+			for (int j = searchBatchLayers[i].x; j < searchBatchLayers[i].y; j++) {
+				ExecuteSearch(searchBatch[j]);
 			}
-		}
+		});
 		#endif
+	}
 
-		#ifdef QTPFS_LIMIT_TEAM_SEARCHES
-		const unsigned int numCurrSearches = numCurrExecutedSearches[search->GetTeam()];
-		const unsigned int numPrevSearches = numPrevExecutedSearches[search->GetTeam()];
+	numExecutedSearches = 0;
+	numSharedSearches = 0;
+
+	for (SearchBatchItem& item: searchBatch) {
+		FinalizeSearch(item);
+	}
+
+	searchBatch.clear();
+	searchBatchLayers.clear();
+}
+
+void QTPFS::PathManager::ExecuteSearch(SearchBatchItem& item) {
+	if (item.sharedItem != -1u)
+		return;
 
-		if ((numCurrSearches - numPrevSearches) >= MAX_TEAM_SEARCHES) {
-			++searchesIt; return false;
+	// trace the path before the next search on this thread overwrites
+	// the node-states; PathCache is only touched by FinalizeSearch
+	if ((item.haveResult = item.search->Execute(item.searchState, numTerrainChanges)))
+		item.search->Finalize(item.path);
+}
+
+void QTPFS::PathManager::FinalizeSearch(SearchBatchItem& item) {
+	IPathSearch* search = item.search;
+	IPath* path = item.path;
+
+	if (item.sharedItem != -1u) {
+		// the shared item precedes us, so its path is live by now (or deleted)
+		const SearchBatchItem& sharedItem = searchBatch[item.sharedItem];
+
+		// a search between the same nodes failed, so would this one
+		if (!sharedItem.haveResult) {
+			DeletePath(path->GetID());
+
+			numSharedSearches += 1;
+			delete search;
+			return;
+		}
+
+		if (search->SharedFinalize(sharedItem.path, path)) {
+			numSharedSearches += 1;
+			delete search;
+			return;
 		}
 
+		// shared path ended short of its target (partial search), so run
+		// our own; still serial here which keeps the state-offsets ordered
+		#ifdef QTPFS_LIMIT_TEAM_SEARCHES
 		numCurrExecutedSearches[search->GetTeam()] += 1;
 		#endif
+
+		item.searchState = searchStateOffset;
+		searchStateOffset += NODE_STATE_OFFSET;
+
+		if ((item.haveResult = search->Execute(item.searchState, numTerrainChanges)))
+			search->Finalize(path);
 	}
 
 	// removes path from temp-paths, adds it to live-paths
-	if (search->Execute(searchStateOffset, numTerrainChanges)) {
-		search->Finalize(path);
-
-		#ifdef QTPFS_SEARCH_SHARED_PATHS
-		sharedPaths[path->GetHash()] = path;
-		#endif
+	if (item.haveResult) {
+		pathCaches[item.pathType].AddLivePath(path);
 
 		#ifdef QTPFS_TRACE_PATH_SEARCHES
 		pathTraces[path->GetID()] = search->GetExecutionTrace();
@@ -837,8 +921,8 @@ bool QTPFS::PathManager::ExecuteSearch(
 		DeletePath(path->GetID());
 	}
 
-	DeleteSearch(search, searches, searchesIt);
-	return true;
+	numExecutedSearches += 1;
+	delete search;
 }
 
 void QTPFS::PathManager::QueueDeadPathSearches(unsigned int pathType) {
@@ -69,6 +69,7 @@ namespace QTPFS {
 		) const override;
 
 		int2 GetNumQueuedUpdates() const override;
+		int2 GetNumExecutedSearches() const override { return {int(numExecutedSearches), int(numSharedSearches)}; }
 
 
 		const NodeLayer& GetNodeLayer(unsigned int pathType) const { return nodeLayers[pathType]; }
@@ -93,8 +94,8 @@ namespace QTPFS {
 		typedef spring::unordered_map<unsigned int, unsigned int>::iterator PathTypeMapIt;
 		typedef spring::unordered_map<unsigned int, PathSearchTrace::Execution*> PathTraceMap;
 		typedef spring::unordered_map<unsigned int, PathSearchTrace::Execution*>::iterator PathTraceMapIt;
-		typedef spring::unordered_map<std::uint64_t, IPath*> SharedPathMap;
-		typedef spring::unordered_map<std::uint64_t, IPath*>::iterator SharedPathMapIt;
+		typedef spring::unordered_map<std::uint64_t, unsigned int> SharedPathMap;
+		typedef spring::unordered_map<std::uint64_t, unsigned int>::iterator SharedPathMapIt;
 
 		typedef std::vector<IPathSearch*> PathSearchVect;
 		typedef std::vector<IPathSearch*>::iterator PathSearchVectIt;
@@ -121,7 +122,8 @@ namespace QTPFS {
 		void ExecQueuedNodeLayerUpdates(unsigned int layerNum, bool flushQueue);
 		#endif
 
-		void ExecuteQueuedSearches(unsigned int pathType);
+		void SelectQueuedSearches(unsigned int pathType);
+		void ExecuteQueuedSearches();
 		void QueueDeadPathSearches(unsigned int pathType);
 
 		unsigned int QueueSearch(
@@ -134,13 +136,10 @@ namespace QTPFS {
 			const bool synced
 		);
 
-		bool ExecuteSearch(
-			PathSearchVect& searches,
-			PathSearchVectIt& searchesIt,
-			NodeLayer& nodeLayer,
-			PathCache& pathCache,
-			unsigned int pathType
-		);
+		struct SearchBatchItem;
+
+		void ExecuteSearch(SearchBatchItem& item);
+		void FinalizeSearch(SearchBatchItem& item);
 
 		bool IsFinalized() const { return (!nodeTrees.empty()); }
 
@@ -156,8 +155,30 @@ namespace QTPFS {
 		spring::unordered_map<unsigned int, unsigned int> pathTypes;
 		spring::unordered_map<unsigned int, PathSearchTrace::Execution*> pathTraces;
 
-		// maps "hashes" of executed searches to the found paths
-		spring::unordered_map<std::uint64_t, IPath*> sharedPaths;
+		struct SearchBatchItem {
+			IPathSearch* search;
+			IPath* path;
+
+			unsigned int pathType;
+
+			// offset passed to IPathSearch::Execute, assigned in queue-order
+			unsigned int searchState;
+			// index of the batch-item whose path this search copies, or -1u
+			unsigned int sharedItem;
+
+			bool haveResult;
+		};
+
+		// searches selected for execution during the current update, in
+		// order of path-type and then of queueing; items are executed on
+		// any thread and all results are committed serially in this order,
+		// which keeps the outcome independent of the threading
+		std::vector<SearchBatchItem> searchBatch;
+		// [begin, end) item-ranges per layer, see ExecuteQueuedSearches
+		std::vector<int2> searchBatchLayers;
+
+		// maps "hashes" of executed searches to their batch-items
+		SharedPathMap sharedPaths;
 
 		std::vector<unsigned int> numCurrExecutedSearches;
 		std::vector<unsigned int> numPrevExecutedSearches;
@@ -167,6 +188,8 @@ namespace QTPFS {
 
 		unsigned int searchStateOffset;
 		unsigned int numTerrainChanges;
+		unsigned int numExecutedSearches;
+		unsigned int numSharedSearches;
 		unsigned int numPathRequests;
 		unsigned int maxNumLeafNodes;
 
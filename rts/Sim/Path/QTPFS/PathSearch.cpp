@@ -1,5 +1,6 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <algorithm>
 #include <cassert>
 #include <limits>
 
@@ -14,8 +15,25 @@
 #endif
 
 #include "System/float3.h"
+#include "System/Threading/ThreadPool.h"
 
-QTPFS::binary_heap<QTPFS::INode*> QTPFS::PathSearch::openNodes;
+std::vector< QTPFS::quaternary_heap<QTPFS::SearchNode*> > QTPFS::PathSearch::openNodeQueues;
+std::vector< std::vector<QTPFS::SearchNode> > QTPFS::PathSearch::searchNodeBuffers;
+
+
+
+void QTPFS::PathSearch::InitGlobalQueues(unsigned int n) {
+	openNodeQueues.clear();
+	openNodeQueues.resize(ThreadPool::GetMaxThreads());
+	searchNodeBuffers.clear();
+	searchNodeBuffers.resize(ThreadPool::GetMaxThreads());
+
+	// the main thread's queue is sized for a search over every leaf-node;
+	// the workers' start out smaller and grow on demand (quaternary_heap::push)
+	for (size_t i = 0; i < openNodeQueues.size(); i++) {
+		openNodeQueues[i].reserve(std::max(1u, n >> (3 * (i != 0))));
+	}
+}
 
 
 
@@ -39,7 +57,7 @@ void QTPFS::PathSearch::Initialize(
 	tgtNode = nodeLayer->GetNode(tgtPoint.x / SQUARE_SIZE, tgtPoint.z / SQUARE_SIZE);
 	curNode = nullptr;
 	nxtNode = nullptr;
-	minNode = srcNode;
+	minNode = nullptr;
 }
 
 bool QTPFS::PathSearch::Execute(
@@ -49,6 +67,15 @@ bool QTPFS::PathSearch::Execute(
 	searchState = searchStateOffset; // starts at NODE_STATE_OFFSET
 	searchMagic = searchMagicNumber; // starts at numTerrainChanges
 
+	// any searches can execute concurrently, each thread has its own state
+	openNodes = &openNodeQueues[ThreadPool::GetThreadNum()];
+	searchNodes = &searchNodeBuffers[ThreadPool::GetThreadNum()];
+
+	// new entries are zeroed, which no search-state matches; must not grow
+	// after this point since the queue and back-pointers reference entries
+	if (searchNodes->size() < nodeLayer->GetNumNodeIndices())
+		searchNodes->resize(nodeLayer->GetNumNodeIndices());
+
 	haveFullPath = (srcNode == tgtNode);
 	havePartPath = false;
 
@@ -75,30 +102,27 @@ bool QTPFS::PathSearch::Execute(
 	// nodes can represent many terrain squares, some of which can still
 	// be passable and allow a unit to move within a node)
 	// NOTE: we need to make sure such paths do not have infinite cost!
-	if (srcNode->GetMoveCost() == QTPFS_POSITIVE_INFINITY)
-		srcNode->SetMoveCost(0.0f);
+	// (the node itself is shared with concurrent searches, so its cost
+	// is only substituted here rather than temporarily overwritten)
+	srcMoveCost = (srcNode->GetMoveCost() != QTPFS_POSITIVE_INFINITY)? srcNode->GetMoveCost(): 0.0f;
 
 	ResetState(srcNode);
-	UpdateNode(srcNode, nullptr, 0);
 
-	while (!openNodes.empty()) {
-		IterateNodes(nodeLayer->GetNodes());
+	while (!openNodes->empty()) {
+		IterateNodes();
 
 		#ifdef QTPFS_TRACE_PATH_SEARCHES
 		searchExec->AddIteration(searchIter);
 		searchIter.Clear();
 		#endif
 
-		haveFullPath = (curNode == tgtNode);
-		havePartPath = (minNode != srcNode);
+		haveFullPath = (curNode->node == tgtNode);
+		havePartPath = (minNode->node != srcNode);
 
 		if (haveFullPath)
-			openNodes.reset();
+			openNodes->reset();
 	}
 
-	if (srcNode->GetMoveCost() == 0.0f)
-		srcNode->SetMoveCost(QTPFS_POSITIVE_INFINITY);
-
 
 	#ifdef QTPFS_SUPPORT_PARTIAL_SEARCHES
 	// adjust the target-point if we only got a partial result
@@ -107,9 +131,9 @@ bool QTPFS::PathSearch::Execute(
 	//   units will end up spinning in-place over the last
 	//   waypoint (since "atGoal" can never become true)
 	if (!haveFullPath && havePartPath) {
-		tgtNode    = minNode;
-		tgtPoint.x = minNode->xmid() * SQUARE_SIZE;
-		tgtPoint.z = minNode->zmid() * SQUARE_SIZE;
+		tgtNode    = minNode->node;
+		tgtPoint.x = tgtNode->xmid() * SQUARE_SIZE;
+		tgtPoint.z = tgtNode->zmid() * SQUARE_SIZE;
 	}
 	#endif
 
@@ -136,63 +160,80 @@ void QTPFS::PathSearch::ResetState(INode* node) {
 		hCosts[i] = 0.0f;
 	}
 
-	openNodes.reset();
-	openNodes.push(node);
+	SearchNode* srcSearchNode = GetSearchNode(node);
+
+	srcSearchNode->node = node;
+	minNode = srcSearchNode;
+
+	UpdateNode(srcSearchNode, nullptr, 0);
+
+	openNodes->reset();
+	openNodes->push(srcSearchNode);
 }
 
-void QTPFS::PathSearch::UpdateNode(INode* nextNode, INode* prevNode, unsigned int netPointIdx) {
+void QTPFS::PathSearch::UpdateNode(SearchNode* nextNode, SearchNode* prevNode, unsigned int netPointIdx) {
 	// NOTE:
 	//   the heuristic must never over-estimate the distance,
 	//   but this is *impossible* to achieve on a non-regular
 	//   grid on which any node only has an average move-cost
 	//   associated with it --> paths will be "nearly optimal"
-	nextNode->SetPrevNode(prevNode);
+	nextNode->prevNode = prevNode;
 	nextNode->SetPathCosts(gCosts[netPointIdx], hCosts[netPointIdx]);
-	nextNode->SetSearchState(searchState | NODE_STATE_OPEN);
-	nextNode->SetNeighborEdgeTransitionPoint(0, netPoints[netPointIdx]);
+	nextNode->searchState = searchState | NODE_STATE_OPEN;
+	nextNode->entryPoint = netPoints[netPointIdx];
 }
 
-void QTPFS::PathSearch::IterateNodes(const std::vector<INode*>& allNodes) {
-	curNode = openNodes.top();
-	curNode->SetSearchState(searchState | NODE_STATE_CLOSED);
+void QTPFS::PathSearch::IterateNodes() {
+	curNode = openNodes->top();
+	curNode->searchState = searchState | NODE_STATE_CLOSED;
+
+	INode* node = curNode->node;
+
 	#ifdef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
 	// in the non-conservative case, this is done from
 	// NodeLayer::ExecNodeNeighborCacheUpdates instead
-	curNode->SetMagicNumber(searchMagic);
+	node->SetMagicNumber(searchMagic);
 	#endif
 
-	openNodes.pop();
-	openNodes.check_heap_property(0);
+	openNodes->pop();
+	openNodes->check_heap_property(0);
 
 	#ifdef QTPFS_TRACE_PATH_SEARCHES
-	searchIter.SetPoppedNodeIdx(curNode->zmin() * mapDims.mapx + curNode->xmin());
+	searchIter.SetPoppedNodeIdx(node->zmin() * mapDims.mapx + node->xmin());
 	#endif
 
-	if (curNode == tgtNode)
+	if (node == tgtNode)
 		return;
-	if (curNode->AllSquaresImpassable())
+	if (node != srcNode && node->AllSquaresImpassable())
 		return;
 
-	if (curNode->xmid() < searchRect.x1) return;
-	if (curNode->zmid() < searchRect.z1) return;
-	if (curNode->xmid() > searchRect.x2) return;
-	if (curNode->zmid() > searchRect.z2) return;
+	if (node->xmid() < searchRect.x1) return;
+	if (node->zmid() < searchRect.z1) return;
+	if (node->xmid() > searchRect.x2) return;
+	if (node->zmid() > searchRect.z2) return;
 
 	#ifdef QTPFS_SUPPORT_PARTIAL_SEARCHES
 	// remember the node with lowest h-cost in case the search fails to reach tgtNode
-	if (curNode->GetPathCost(NODE_PATH_COST_H) < minNode->GetPathCost(NODE_PATH_COST_H))
+	if (curNode->hCost < minNode->hCost)
 		minNode = curNode;
 	#endif
 
-	IterateNodeNeighbors(curNode->GetNeighbors(allNodes));
+	const unsigned int numNgbs = node->GetNeighbors(*nodeLayer);
+
+	if (numNgbs == 0)
+		return;
+
+	IterateNodeNeighbors(nodeLayer->GetNeighbors(node->GetNeighborRange()), nodeLayer->GetNetpoints(node->GetNeighborRange()), numNgbs);
 }
 
-void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes) {
+void QTPFS::PathSearch::IterateNodeNeighbors(INode* const* nxtNodes, const float2* nxtPoints, unsigned int numNxtNodes) {
 	// if curNode equals srcNode, this is just the original srcPoint
-	const float2& curPoint2 = curNode->GetNeighborEdgeTransitionPoint(0);
+	const float2& curPoint2 = curNode->entryPoint;
 	const float3  curPoint  = {curPoint2.x, 0.0f, curPoint2.y};
 
-	for (unsigned int i = 0; i < nxtNodes.size(); i++) {
+	const float curMoveCost = (curNode->node == srcNode)? srcMoveCost: curNode->node->GetMoveCost();
+
+	for (unsigned int i = 0; i < numNxtNodes; i++) {
 		// NOTE:
 		//   this uses the actual distance that edges of the final path will cover,
 		//   from <curPoint> (initialized to sourcePoint) to a position on the edge
@@ -210,14 +251,17 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 		//   in the first case we would explore many more nodes than necessary (CPU
 		//   nightmare), while in the second we would get low-quality paths (player
 		//   nightmare)
-		nxtNode = nxtNodes[i];
-
-		if (nxtNode->AllSquaresImpassable())
+		// an impassable srcNode is skipped here as well, it can never be improved upon
+		if (nxtNodes[i]->AllSquaresImpassable())
 			continue;
 
-		const bool isCurrent = (nxtNode->GetSearchState() >= searchState);
-		const bool isClosed = ((nxtNode->GetSearchState() & 1) == NODE_STATE_CLOSED);
-		const bool isTarget = (nxtNode == tgtNode);
+		nxtNode = GetSearchNode(nxtNodes[i]);
+
+		// buffers are shared by all searches of a thread (on any layer) and
+		// those do not necessarily run in state-offset order, hence the ==
+		const bool isCurrent = ((nxtNode->searchState & ~NODE_STATE_CLOSED) == searchState);
+		const bool isClosed = ((nxtNode->searchState & 1) == NODE_STATE_CLOSED);
+		const bool isTarget = (nxtNodes[i] == tgtNode);
 
 		unsigned int netPointIdx = 0;
 
@@ -228,16 +272,16 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 			// to be fancy (note that this is not always the best
 			// option, it causes local and global sub-optimalities
 			// which SmoothPath can only partially address)
-			netPoints[0] = curNode->GetNeighborEdgeTransitionPoint(1 + i);
+			netPoints[0] = nxtPoints[i];
 
 			// cannot use squared-distances because that will bias paths
 			// towards smaller nodes (eg. 1^2 + 1^2 + 1^2 + 1^2 != 4^2)
 			gDists[0] = curPoint.distance({netPoints[0].x, 0.0f, netPoints[0].y});
 			hDists[0] = tgtPoint.distance({netPoints[0].x, 0.0f, netPoints[0].y});
 			gCosts[0] =
-				curNode->GetPathCost(NODE_PATH_COST_G) +
-				curNode->GetMoveCost() * gDists[0] +
-				nxtNode->GetMoveCost() * hDists[0] * int(isTarget);
+				curNode->gCost +
+				curMoveCost * gDists[0] +
+				nxtNodes[i]->GetMoveCost() * hDists[0] * int(isTarget);
 			hCosts[0] = hDists[0] * hCostMult * int(!isTarget);
 		}
 		#else
@@ -248,14 +292,14 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 		// not handle; more points means a greater degree
 		// of non-cardinality (but gets expensive quickly)
 		for (unsigned int j = 0; j < QTPFS_MAX_NETPOINTS_PER_NODE_EDGE; j++) {
-			netPoints[j] = curNode->GetNeighborEdgeTransitionPoint(1 + i * QTPFS_MAX_NETPOINTS_PER_NODE_EDGE + j);
+			netPoints[j] = nxtPoints[i * QTPFS_MAX_NETPOINTS_PER_NODE_EDGE + j];
 
 			gDists[j] = curPoint.distance({netPoints[j].x, 0.0f, netPoints[j].y});
 			hDists[j] = tgtPoint.distance({netPoints[j].x, 0.0f, netPoints[j].y});
 			gCosts[j] =
-				curNode->GetPathCost(NODE_PATH_COST_G) +
-				curNode->GetMoveCost() * gDists[j] +
-				nxtNode->GetMoveCost() * hDists[j] * int(isTarget);
+				curNode->gCost +
+				curMoveCost * gDists[j] +
+				nxtNodes[i]->GetMoveCost() * hDists[j] * int(isTarget);
 			hCosts[j] = hDists[j] * hCostMult * int(!isTarget);
 
 			if ((gCosts[j] + hCosts[j]) < (gCosts[netPointIdx] + hCosts[netPointIdx])) {
@@ -265,21 +309,23 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 		#endif
 
 		if (!isCurrent) {
+			nxtNode->node = nxtNodes[i];
+
 			UpdateNode(nxtNode, curNode, netPointIdx);
 
-			openNodes.push(nxtNode);
-			openNodes.check_heap_property(0);
+			openNodes->push(nxtNode);
+			openNodes->check_heap_property(0);
 
 			#ifdef QTPFS_TRACE_PATH_SEARCHES
-			searchIter.AddPushedNodeIdx(nxtNode->zmin() * mapDims.mapx + nxtNode->xmin());
+			searchIter.AddPushedNodeIdx(nxtNodes[i]->zmin() * mapDims.mapx + nxtNodes[i]->xmin());
 			#endif
 
 			continue;
 		}
-		if (gCosts[netPointIdx] >= nxtNode->GetPathCost(NODE_PATH_COST_G))
+		if (gCosts[netPointIdx] >= nxtNode->gCost)
 			continue;
 		if (isClosed)
-			openNodes.push(nxtNode);
+			openNodes->push(nxtNode);
 
 		UpdateNode(nxtNode, curNode, netPointIdx);
 
@@ -287,8 +333,8 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 		// (changing the f-cost of an OPEN node messes up the
 		// queue's internal consistency; a pushed node remains
 		// OPEN until it gets popped)
-		openNodes.resort(nxtNode);
-		openNodes.check_heap_property(0);
+		openNodes->resort(nxtNode);
+		openNodes->check_heap_property(0);
 	}
 }
 
@@ -300,9 +346,6 @@ void QTPFS::PathSearch::Finalize(IPath* path) {
 	#endif
 
 	path->SetBoundingBox();
-
-	// path remains in live-cache until DeletePath is called
-	pathCache->AddLivePath(path);
 }
 
 void QTPFS::PathSearch::TracePath(IPath* path) {
@@ -310,13 +353,15 @@ void QTPFS::PathSearch::TracePath(IPath* path) {
 //	std::deque<float3>::const_iterator pointsIt;
 
 	if (srcNode != tgtNode) {
-		INode* tmpNode = tgtNode;
-		INode* prvNode = tmpNode->GetPrevNode();
+		const SearchNode* tmpNode = GetSearchNode(tgtNode);
+		const SearchNode* prvNode = tmpNode->prevNode;
 
 		float3 prvPoint = tgtPoint;
 
-		while ((prvNode != nullptr) && (tmpNode != srcNode)) {
-			const float2& tmpPoint2 = tmpNode->GetNeighborEdgeTransitionPoint(0);
+		// back-pointers of older searches are never followed, since the
+		// chain from tgtNode only covers nodes this search has reached
+		while ((prvNode != nullptr) && (tmpNode->node != srcNode)) {
+			const float2& tmpPoint2 = tmpNode->entryPoint;
 			const float3  tmpPoint  = {tmpPoint2.x, 0.0f, tmpPoint2.y};
 
 			assert(!math::isinf(tmpPoint.x) && !math::isinf(tmpPoint.z));
@@ -326,21 +371,14 @@ void QTPFS::PathSearch::TracePath(IPath* path) {
 			//   one exception: tgtPoint can legitimately coincide
 			//   with first transition-point, which we must ignore
 			assert(tmpNode != prvNode);
-			assert(tmpPoint != prvPoint || tmpNode == tgtNode);
+			assert(tmpPoint != prvPoint || tmpNode->node == tgtNode);
 
 			if (tmpPoint != prvPoint)
 				points.push_front(tmpPoint);
 
-			#ifndef QTPFS_SMOOTH_PATHS
-			// make sure the back-pointers can never become dangling
-			// (if smoothing IS enabled, we delay this until we reach
-			// SmoothPath() because we still need them there)
-			tmpNode->SetPrevNode(nullptr);
-			#endif
-
 			prvPoint = tmpPoint;
 			tmpNode = prvNode;
-			prvNode = tmpNode->GetPrevNode();
+			prvNode = tmpNode->prevNode;
 		}
 	}
 
@@ -366,7 +404,7 @@ void QTPFS::PathSearch::SmoothPath(IPath* path) const {
 	if (path->NumPoints() == 2)
 		return;
 
-	assert(srcNode->GetPrevNode() == NULL);
+	assert(GetSearchNode(srcNode)->prevNode == nullptr);
 
 	for (unsigned int k = 0; k < QTPFS_MAX_SMOOTHING_ITERATIONS; k++) {
 		if (!SmoothPathIter(path)) {
@@ -374,17 +412,6 @@ void QTPFS::PathSearch::SmoothPath(IPath* path) const {
 			break;
 		}
 	}
-
-	INode* n0 = tgtNode;
-	INode* n1 = tgtNode;
-
-	while (n1 != srcNode) {
-		n0 = n1;
-		n1 = n0->GetPrevNode();
-
-		// reset back-pointers
-		n0->SetPrevNode(NULL);
-	}
 }
 
 bool QTPFS::PathSearch::SmoothPathIter(IPath* path) const {
@@ -395,14 +422,17 @@ bool QTPFS::PathSearch::SmoothPathIter(IPath* path) const {
 	unsigned int ni = path->NumPoints();
 	unsigned int nm = 0;
 
-	INode* n0 = tgtNode;
-	INode* n1 = tgtNode;
+	const SearchNode* sn0 = GetSearchNode(tgtNode);
+	const SearchNode* sn1 = sn0;
 
-	while (n1 != srcNode) {
-		n0 = n1;
-		n1 = n0->GetPrevNode();
+	while (sn1->node != srcNode) {
+		sn0 = sn1;
+		sn1 = sn0->prevNode;
 		ni -= 1;
 
+		const INode* n0 = sn0->node;
+		const INode* n1 = sn1->node;
+
 		assert(n1->GetNeighborRelation(n0) != 0);
 		assert(n0->GetNeighborRelation(n1) != 0);
 		assert(ni < path->NumPoints());
@@ -65,12 +65,40 @@ namespace QTPFS {
 	}
 
 
+	// per-search state of an INode, kept in a buffer of the thread that
+	// executes the search (indexed by INode::GetNodeIndex) rather than in
+	// the node itself; entries belong to the search whose state-offset
+	// they carry and are otherwise stale, so buffers are never cleared
+	struct SearchNode {
+		void SetHeapIndex(unsigned int n) { heapIndex = n; }
+		unsigned int GetHeapIndex() const { return heapIndex; }
+		float GetHeapPriority() const { return fCost; }
+
+		void SetPathCosts(float g, float h) { fCost = g + h; gCost = g; hCost = h; }
+
+		INode* node;
+		// points back to previous node in path
+		SearchNode* prevNode;
+
+		// transition-point on the edge shared with prevNode
+		float2 entryPoint;
+
+		float fCost;
+		float gCost;
+		float hCost;
+
+		unsigned int searchState;
+		// NOTE:
+		//     storing the heap-index is an *UGLY* break of abstraction,
+		//     but the only way to keep the cost of resorting acceptable
+		unsigned int heapIndex;
+	};
+
+
 	// NOTE:
-	//     we could support "time-sliced" execution, but we would have
-	//     to isolate each query from modifying another's INode members
-	//     (*Cost, nodeState, etc.) --> memory-intensive
-	//     also, terrain changes could invalidate partial paths without
-	//     buffering the *entire* heightmap each frame --> not efficient
+	//     we could support "time-sliced" execution, but terrain changes
+	//     could invalidate partial paths without buffering the *entire*
+	//     heightmap each frame --> not efficient
 	// NOTE:
 	//     with time-sliced execution, {src,tgt,cur,nxt}Node can become
 	//     dangling
@@ -95,6 +123,8 @@ namespace QTPFS {
 			unsigned int searchStateOffset = 0,
 			unsigned int searchMagicNumber = 0
 		) = 0;
+		// traces the found path into <path>, which PathManager then moves
+		// from temp- to live-paths (unlike SharedFinalize, which does both)
 		virtual void Finalize(IPath* path) = 0;
 		virtual bool SharedFinalize(const IPath* srcPath, IPath* dstPath) { return false; }
 		virtual PathSearchTrace::Execution* GetExecutionTrace() { return NULL; }
@@ -123,16 +153,19 @@ namespace QTPFS {
 			, nodeLayer(NULL)
 			, pathCache(NULL)
 			, searchExec(NULL)
+			, openNodes(NULL)
+			, searchNodes(NULL)
 			, srcNode(NULL)
 			, tgtNode(NULL)
 			, curNode(NULL)
 			, nxtNode(NULL)
 			, minNode(NULL)
 			, hCostMult(0.0f)
+			, srcMoveCost(0.0f)
 			, haveFullPath(false)
 			, havePartPath(false)
 			{}
-		~PathSearch() { openNodes.reset(); }
+		~PathSearch() {}
 
 		void Initialize(
 			NodeLayer* layer,
@@ -151,36 +184,45 @@ namespace QTPFS {
 
 		const std::uint64_t GetHash(std::uint64_t N, std::uint32_t k) const;
 
-		static void InitGlobalQueue(unsigned int n) { openNodes.reserve(n); }
-		static void FreeGlobalQueue() { openNodes.clear(); }
+		static void InitGlobalQueues(unsigned int n);
+		static void FreeGlobalQueues() { openNodeQueues.clear(); searchNodeBuffers.clear(); }
 
 	private:
+		SearchNode* GetSearchNode(INode* node) const { return &(*searchNodes)[node->GetNodeIndex()]; }
+
 		void ResetState(INode* node);
-		void UpdateNode(INode* nextNode, INode* prevNode, unsigned int netPointIdx);
+		void UpdateNode(SearchNode* nextNode, SearchNode* prevNode, unsigned int netPointIdx);
 
-		void IterateNodes(const std::vector<INode*>& allNodes);
-		void IterateNodeNeighbors(const std::vector<INode*>& nxtNodes);
+		void IterateNodes();
+		void IterateNodeNeighbors(INode* const* nxtNodes, const float2* nxtPoints, unsigned int numNxtNodes);
 
 		void TracePath(IPath* path);
 		void SmoothPath(IPath* path) const;
 		bool SmoothPathIter(IPath* path) const;
 
-		// global queue: allocated once, re-used by all searches without clear()'s
-		// this relies on INode::operator< to sort the INode*'s by increasing f-cost
-		static binary_heap<INode*> openNodes;
+		// global queues and node-state buffers, one per ThreadPool thread:
+		// allocated once, re-used by all searches executing on that thread
+		// without clear()'s (buffers only grow to the largest layer's node
+		// index range)
+		static std::vector< quaternary_heap<SearchNode*> > openNodeQueues;
+		static std::vector< std::vector<SearchNode> > searchNodeBuffers;
 
 		NodeLayer* nodeLayer;
 		PathCache* pathCache;
 
 		// not used unless QTPFS_TRACE_PATH_SEARCHES is defined
 		PathSearchTrace::Execution* searchExec;
+
+		// queue and node-states of the thread running Execute
+		quaternary_heap<SearchNode*>* openNodes;
+		std::vector<SearchNode>* searchNodes;
 		PathSearchTrace::Iteration searchIter;
 
 		SRectangle searchRect;
 
 		INode *srcNode, *tgtNode;
-		INode *curNode, *nxtNode;
-		INode *minNode;
+		SearchNode *curNode, *nxtNode;
+		SearchNode *minNode;
 
 		float3 srcPoint;
 		float3 tgtPoint;
@@ -193,6 +235,8 @@ namespace QTPFS {
 		float hCosts[QTPFS_MAX_NETPOINTS_PER_NODE_EDGE];
 
 		float hCostMult;
+		// searches may start from an impassable node, whose cost counts as 0
+		float srcMoveCost;
 
 		bool haveFullPath;
 		bool havePartPath;
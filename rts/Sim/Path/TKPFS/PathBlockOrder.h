@@ -0,0 +1,83 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef TKPFS_PATHBLOCKORDER_H
+#define TKPFS_PATHBLOCKORDER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "System/type2.h"
+
+namespace TKPFS {
+
+/**
+ * Sorts the dirty blocks in <blocks> so the ones crossed by the most paths
+ * (blockDemand) are updated first.
+ *
+ * A block only computes its own +x, +z and -x+z vertices, and those read
+ * the offsets of the neighbours they lead to. A block therefore must never
+ * be updated before any of those neighbours that are dirty too, or its
+ * vertices keep pointing at their stale offsets (MapChanged queues blocks
+ * from upper to lower for the same reason). Every dirty block inherits the
+ * priority of its dirty -x, -z and +x-z neighbours, and blocks of equal
+ * priority are updated from upper to lower. Blocks that nobody asked for
+ * keep their original queue order.
+ *
+ * <blockPriority> is scratch space of mapDims.x * mapDims.y entries that
+ * must be zero on entry, and is zero again on return.
+ */
+static inline void SortBlocksByDemand(
+	std::vector<int2>& blocks,
+	std::vector<int2>& sortedBlocks,
+	std::vector<std::uint32_t>& blockPriority,
+	const std::vector<std::uint32_t>& blockDemand,
+	const int2 mapDims
+) {
+	// blocks whose vertices lead to the block at the origin
+	const int2 parentOffsets[] = {{-1, 0}, {-1, -1}, {0, -1}, {+1, -1}};
+
+	const auto BlockIdx = [&](const int2& pos) { return (pos.y * mapDims.x + pos.x); };
+
+	// zero marks blocks that are not dirty
+	for (const int2& pos: blocks) {
+		blockPriority[BlockIdx(pos)] = blockDemand[BlockIdx(pos)] + 1;
+	}
+
+	// parents always precede their children in (z, x) order
+	sortedBlocks.assign(blocks.begin(), blocks.end());
+	std::sort(sortedBlocks.begin(), sortedBlocks.end());
+
+	for (const int2& pos: sortedBlocks) {
+		std::uint32_t& priority = blockPriority[BlockIdx(pos)];
+
+		for (const int2& offset: parentOffsets) {
+			const int2 parentPos = pos + offset;
+
+			if ((unsigned)parentPos.x >= (unsigned)mapDims.x || (unsigned)parentPos.y >= (unsigned)mapDims.y)
+				continue;
+
+			priority = std::max(priority, blockPriority[BlockIdx(parentPos)]);
+		}
+	}
+
+	std::stable_sort(blocks.begin(), blocks.end(), [&](const int2& a, const int2& b) {
+		const std::uint32_t pa = blockPriority[BlockIdx(a)];
+		const std::uint32_t pb = blockPriority[BlockIdx(b)];
+
+		if (pa != pb)
+			return (pa > pb);
+		if (pa == 1)
+			return false;
+
+		return (b < a);
+	});
+
+	for (const int2& pos: blocks) {
+		blockPriority[BlockIdx(pos)] = 0;
+	}
+}
+
+}
+
+#endif
@@ -383,6 +383,120 @@ IPath::SearchResult CPathManager::ArrangePath(
 }
 
 
+
+// returns the low-res block of <startPos> if the request is far enough for
+// ArrangePath to only run the estimators (i.e. its result can be shared),
+// otherwise (-1, -1)
+int2 CPathManager::GetCoarseStartBlock(const MultiPath& path, const float3& startPos, const float3& goalPos) const
+{
+	const CPathFinderDef& pfDef = path.peDef;
+	const float heurGoalDist2D = pfDef.Heuristic(startPos.x / SQUARE_SIZE, startPos.z / SQUARE_SIZE, 1) + math::fabs(goalPos.y - startPos.y) / SQUARE_SIZE;
+
+	if (heurGoalDist2D <= std::max(MEDRES_SEARCH_DISTANCE, MAXRES_SEARCH_DISTANCE * modInfo.pfRawDistMult))
+		return {-1, -1};
+
+	const PathingState& lowResPS = pathingStates[PATH_LOW_RES];
+
+	return {int(startPos.x / lowResPS.BLOCK_PIXEL_SIZE), int(startPos.z / lowResPS.BLOCK_PIXEL_SIZE)};
+}
+
+std::uint64_t CPathManager::GetCoarsePathHash(const MultiPath& path, const int2 strtBlock) const
+{
+	const CPathFinderDef& pfDef = path.peDef;
+	const PathingState& lowResPS = pathingStates[PATH_LOW_RES];
+
+	// exact goal, goal-radius and any collisions are checked by ArrangeCoarsePath
+	std::uint64_t hash = pfDef.goalSquareZ * mapDims.mapx + pfDef.goalSquareX;
+
+	hash *= lowResPS.mapBlockCount;
+	hash += lowResPS.BlockPosToIdx(strtBlock);
+	hash *= moveDefHandler.GetNumMoveDefs();
+	hash += path.moveDef->pathType;
+
+	return ((hash << 1) | pfDef.synced);
+}
+
+// requests can arrive concurrently, so unlike in the default PFS the shared
+// search does not start from whichever request of a group came first but at
+// the block's own offset-square without an owner; the result then depends on
+// nothing but the key and stays deterministic
+bool CPathManager::ArrangeCoarsePath(MultiPath& path, const int2 strtBlock, float goalRadius, IPath::SearchResult& result)
+{
+	if (strtBlock.x < 0)
+		return false;
+
+	const std::uint64_t hash = GetCoarsePathHash(path, strtBlock);
+	const float3& goalPos = path.finalGoal;
+
+	const auto IsMatch = [&](const CoarsePath& cp) {
+		if (cp.strtBlock != strtBlock || cp.goalRadius != goalRadius)
+			return false;
+		if (cp.goalPos.x != goalPos.x || cp.goalPos.y != goalPos.y || cp.goalPos.z != goalPos.z)
+			return false;
+
+		return (cp.pathType == path.moveDef->pathType && cp.synced == path.peDef.synced);
+	};
+	const auto CopyPath = [&](const CoarsePath& cp) {
+		path.lowResPath = cp.lowResPath;
+		path.medResPath = cp.medResPath;
+
+		// leave the definition as ArrangePath would have for refinement
+		path.peDef.DisableConstraint(true);
+		path.peDef.AllowRawPathSearch(false);
+
+		result = cp.searchResult;
+	};
+
+	{
+		const std::lock_guard<std::mutex> lock(coarsePathsUpdate);
+		const auto iter = coarsePaths.find(hash);
+
+		if (iter != coarsePaths.end()) {
+			if (!IsMatch(iter->second))
+				return false;
+
+			CopyPath(iter->second);
+			return true;
+		}
+	}
+
+	const PathingState& lowResPS = pathingStates[PATH_LOW_RES];
+	const short2 strtSquare = lowResPS.blockStates.peNodeOffsets[path.moveDef->pathType][lowResPS.BlockPosToIdx(strtBlock)];
+
+	float3 strtPos = {strtSquare.x * SQUARE_SIZE * 1.0f, 0.0f, strtSquare.y * SQUARE_SIZE * 1.0f};
+	strtPos.y = CMoveMath::yLevel(*path.moveDef, strtPos);
+
+	MultiPath coarsePath = MultiPath(path.moveDef, strtPos, goalPos, goalRadius);
+	coarsePath.peDef.synced = path.peDef.synced;
+
+	// the offset-square may be close enough to the goal to warrant a max-res search
+	if (GetCoarseStartBlock(coarsePath, strtPos, goalPos).x < 0)
+		return false;
+
+	CoarsePath cp;
+	cp.searchResult = ArrangePath(&coarsePath, path.moveDef, strtPos, goalPos, nullptr);
+	cp.lowResPath = std::move(coarsePath.lowResPath);
+	cp.medResPath = std::move(coarsePath.medResPath);
+	cp.strtBlock = strtBlock;
+	cp.goalPos = goalPos;
+	cp.goalRadius = goalRadius;
+	cp.pathType = path.moveDef->pathType;
+	cp.synced = path.peDef.synced;
+
+	CopyPath(cp);
+
+	{
+		const std::lock_guard<std::mutex> lock(coarsePathsUpdate);
+
+		// another thread may have inserted the same (identical) result meanwhile
+		if (coarsePaths.find(hash) == coarsePaths.end())
+			coarsePaths[hash] = std::move(cp);
+	}
+
+	return true;
+}
+
+
 /*
 Request a new multipath, store the result and return a handle-id to it.
 */
@@ -424,8 +538,14 @@ unsigned int CPathManager::RequestPath(
 	// 	LOG("Goal Radius %f", goalRadius);
 	// }
 
-	const IPath::SearchResult result = ArrangePath(&newPath, moveDef, startPos, goalPos, caller);
-	//const IPath::SearchResult result = IPath::Error;
+	// requests of a group moving to the same goal share their estimator
+	// paths and differ only in the local refinement below
+	const int2 coarseBlock = GetCoarseStartBlock(newPath, startPos, goalPos);
+
+	IPath::SearchResult result = IPath::Error;
+
+	if (!ArrangeCoarsePath(newPath, coarseBlock, goalRadius, result))
+		result = ArrangePath(&newPath, moveDef, startPos, goalPos, caller);
 
 	// if (debugLoggingActive == ThreadPool::GetThreadNum()){
 
@@ -775,6 +895,7 @@ void CPathManager::TerrainChange(unsigned int x1, unsigned int z1, unsigned int
 	auto medResPE = &pathingStates[PATH_MED_RES];
 	auto lowResPE = &pathingStates[PATH_LOW_RES];
 
+	coarsePaths.clear();
 	medResPE->MapChanged(x1, z1, x2, z2);
 
 	// low-res PE will be informed via (medRes)PE::Update
@@ -795,13 +916,58 @@ void CPathManager::Update()
 	//pathFlowMap->Update();
 	pathHeatMap->Update();
 
+	coarsePaths.clear();
+
 	auto medResPE = &pathingStates[PATH_MED_RES];
 	auto lowResPE = &pathingStates[PATH_LOW_RES];
 
+	UpdateBlockDemand();
+
 	medResPE->Update();
 	lowResPE->Update();
 }
 
+// counts the live paths crossing each block of the estimators that have an
+// update backlog, their dirty blocks with the most paths are refreshed first
+void CPathManager::UpdateBlockDemand()
+{
+	PathingState* states[] = {&pathingStates[PATH_MED_RES], &pathingStates[PATH_LOW_RES]};
+
+	bool haveBacklog = false;
+
+	for (PathingState* ps: states) {
+		const bool backlog = ps->HasUpdateBacklog();
+
+		ps->ResetBlockDemand(backlog);
+		haveBacklog |= backlog;
+	}
+
+	if (!haveBacklog)
+		return;
+
+	// counts do not depend on the iteration order
+	std::uint32_t pathNum = 0;
+
+	for (const auto& pair: pathMap) {
+		const MultiPath& mp = pair.second;
+
+		// unsynced requests differ between clients
+		if (!mp.peDef.synced)
+			continue;
+
+		pathNum += 1;
+
+		for (PathingState* ps: states) {
+			if (!ps->useBlockDemand)
+				continue;
+
+			ps->AddBlockDemand(mp.lowResPath, pathNum);
+			ps->AddBlockDemand(mp.medResPath, pathNum);
+			ps->AddBlockDemand(mp.maxResPath, pathNum);
+		}
+	}
+}
+
 // used to deposit heat on the heat-map as a unit moves along its path
 void CPathManager::UpdatePath(const CSolidObject* owner, unsigned int pathID)
 {
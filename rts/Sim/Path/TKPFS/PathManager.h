@@ -99,6 +99,27 @@ public:
 		CSolidObject* caller;
 	};
 
+	/**
+	 * Estimator part of a long-distance request, shared for the rest of
+	 * the frame with requests of the same path-type that start in the
+	 * same low-res block and have the same goal (e.g. a group given one
+	 * move order); these only do their own local med- and max-res work.
+	 */
+	struct CoarsePath {
+		IPath::Path lowResPath;
+		IPath::Path medResPath;
+
+		IPath::SearchResult searchResult;
+
+		int2 strtBlock;
+		float3 goalPos;
+
+		float goalRadius;
+
+		int pathType;
+		bool synced;
+	};
+
 public:
 	CPathManager();
 	~CPathManager();
@@ -199,6 +220,11 @@ private:
 		CSolidObject* caller
 	) const;
 
+	int2 GetCoarseStartBlock(const MultiPath& path, const float3& startPos, const float3& goalPos) const;
+	std::uint64_t GetCoarsePathHash(const MultiPath& path, const int2 strtBlock) const;
+
+	bool ArrangeCoarsePath(MultiPath& path, const int2 strtBlock, float goalRadius, IPath::SearchResult& result);
+
 	MultiPath* GetMultiPath(int pathID) {return (const_cast<MultiPath*>(GetMultiPathConst(pathID))); }
 
 	// Used by MT code - a copy must be taken
@@ -238,6 +264,8 @@ private:
 	}
 
 
+	void UpdateBlockDemand();
+
 	static void FinalizePath(MultiPath* path, const float3 startPos, const float3 goalPos, const bool cantGetCloser);
 
 	void LowRes2MedRes(MultiPath& path, const float3& startPos, const CSolidObject* owner, bool synced) const;
@@ -251,6 +279,7 @@ private:
 
 private:
 	mutable std::mutex pathMapUpdate;
+	mutable std::mutex coarsePathsUpdate;
 
 
 	bool finalized = false;
@@ -259,6 +288,8 @@ private:
 	PathHeatMap* pathHeatMap;
 
 	spring::unordered_map<unsigned int, MultiPath> pathMap;
+	// cleared every frame and on terrain changes
+	spring::unordered_map<std::uint64_t, CoarsePath> coarsePaths;
 
 	unsigned int nextPathID;
 
@@ -15,6 +15,7 @@
 #include "Sim/Path/TKPFS/PathManager.h"
 
 struct TKPFSPathDrawer;
+class CPathCostsFile;
 
 namespace TKPFS {
 
@@ -63,6 +64,17 @@ public:
 
 	void UpdateVertexPathCosts(int blocksToUpdate);
 
+	// true if the queued blocks can not all be updated within one frame
+	bool HasUpdateBacklog() const;
+
+	/**
+	 * While there is a backlog, dirty blocks crossed by more (synced) live
+	 * paths are updated first; the demand is rebuilt by the manager every
+	 * frame via ResetBlockDemand and AddBlockDemand (once per path).
+	 */
+	void ResetBlockDemand(bool enable);
+	void AddBlockDemand(const IPath::Path& path, std::uint32_t pathNum);
+
 	/**
 	 * This is called whenever the ground structure of the map changes
 	 * (for example on explosions and new buildings).
@@ -138,8 +150,8 @@ private:
     void CalcVertexPathCosts(const MoveDef&, int2, unsigned int threadNum = 0);
     void CalcVertexPathCost(const MoveDef&, int2, unsigned int pathDir, unsigned int threadNum = 0);
 
-	bool ReadFile(const std::string& peFileName, const std::string& mapFileName);
-	bool WriteFile(const std::string& peFileName, const std::string& mapFileName);
+	std::string GetCacheFilePath(const std::string& peFileName, const std::string& mapFileName) const;
+	int2 ReadFile(CPathCostsFile& costsFile);
 
 private:
 	friend class TKPFS::CPathEstimator;
@@ -166,6 +178,7 @@ private:
     PathingState* nextPathState = nullptr;
 
     CPathCache* pathCache[2]; // [0] = !synced, [1] = synced
+    CPathCostsFile* pathCostsFile = nullptr; // only set while InitEstimator runs
 
     unsigned int mapBlockCount = 0;
     int2 mapDimensionsInBlocks = {0, 0};
@@ -188,6 +201,15 @@ private:
 	};
 
     std::vector<SingleBlock> consumedBlocks;
+
+	// number of live paths crossing each block, and the last path counted
+	std::vector<std::uint32_t> blockDemand;
+	std::vector<std::uint32_t> blockDemandPaths;
+	std::vector<int2> queuedBlocks;
+	std::vector<int2> sortedQueuedBlocks;
+	std::vector<std::uint32_t> blockPriority;
+
+	bool useBlockDemand = false;
 	std::vector<SOffsetBlock> offsetBlocksSortedByCost;
 
 	// int updatedBlocksDelayTimeout = (-1);
@@ -41,6 +41,7 @@
 
 CONFIG(int, MaxParticles).defaultValue(10000).headlessValue(0).minimumValue(0);
 CONFIG(int, MaxNanoParticles).defaultValue(2000).headlessValue(0).minimumValue(0);
+CONFIG(bool, MultiThreadedProjectileCollisions).defaultValue(true).safemodeValue(false).description("Gather projectile collision candidates on worker threads. Does not affect synced state, so it can differ between clients.");
 
 
 CR_BIND(CProjectileHandler, )
@@ -57,7 +58,10 @@ CR_REG_METADATA(CProjectileHandler, (
 	CR_MEMBER_UN(frameProjectileCounts),
 
 	CR_MEMBER(freeProjectileIDs),
-	CR_MEMBER(projectileMaps)
+	CR_MEMBER(projectileMaps),
+
+	CR_IGNORED(collisionCandidates),
+	CR_IGNORED(mtCollisions)
 ))
 
 
@@ -91,6 +95,7 @@ void CProjectileHandler::Init()
 
 	maxParticles     = configHandler->GetInt("MaxParticles");
 	maxNanoParticles = configHandler->GetInt("MaxNanoParticles");
+	mtCollisions     = configHandler->GetBool("MultiThreadedProjectileCollisions");
 
 	projMemPool.clear();
 	projMemPool.reserve(1024);
@@ -161,6 +166,9 @@ void CProjectileHandler::Kill()
 	projectileMaps[ true].clear();
 	projectileMaps[false].clear();
 
+	// holds pointers into the old simulation
+	collisionCandidates.clear();
+
 	CCollisionHandler::PrintStats();
 }
 
@@ -619,12 +627,48 @@ void CProjectileHandler::CheckShieldCollisions(
 	}
 }
 
+void CProjectileHandler::GatherCollisionCandidates(const ProjectileContainer& pc)
+{
+	if (collisionCandidates.size() < pc.size())
+		collisionCandidates.resize(pc.size());
+
+	const auto gatherCandidates = [&](int i) {
+		const CProjectile* p = pc[i];
+		CollisionCandidates& cc = collisionCandidates[i];
+
+		cc.units.clear();
+		cc.features.clear();
+		cc.repulsers.clear();
+
+		if ((cc.valid = (p->checkCol && !p->deleteMe))) {
+			cc.pos = p->pos;
+			cc.radius = p->speed.w + p->radius;
+
+			quadField.GetUnitsAndFeaturesColVol(cc.pos, cc.radius, cc.units, cc.features, &cc.repulsers);
+		}
+	};
+
+	if (mtCollisions) {
+		CQuadField::ReadOnlyScope qfScope;
+		for_mt_chunk(0, pc.size(), gatherCandidates);
+	} else {
+		for (size_t i = 0; i < pc.size(); ++i) {
+			gatherCandidates(i);
+		}
+	}
+}
+
 void CProjectileHandler::CheckUnitFeatureCollisions(ProjectileContainer& pc)
 {
-	static std::vector<CUnit*> tempUnits;
-	static std::vector<CFeature*> tempFeatures;
-	static std::vector<CPlasmaRepulser*> tempRepulsers;
+	// broad-phase for all projectiles up front (possibly threaded), such
+	// that the results do not depend on whether or how it was threaded
+	GatherCollisionCandidates(pc);
+
+	const size_t numGathered = pc.size();
+	const unsigned int numSolidChanges = quadField.GetNumSolidChanges();
 
+	// narrow-phase and Collision() callbacks, serially in container order
+	// NOTE: pc can grow while iterating, if a collision spawns projectiles
 	for (size_t i = 0; i < pc.size(); ++i) {
 		CProjectile* p = pc[i];
 
@@ -635,11 +679,28 @@ void CProjectileHandler::CheckUnitFeatureCollisions(ProjectileContainer& pc)
 		const float3 ppos1 = p->pos + p->speed;
 		// const float3 ppos1 = p->pos + p->dir * (p->speed.w + p->radius);
 
-		quadField.GetUnitsAndFeaturesColVol(p->pos, p->speed.w + p->radius, tempUnits, tempFeatures, &tempRepulsers);
+		if (i >= collisionCandidates.size())
+			collisionCandidates.resize(i + 1);
+
+		CollisionCandidates& cc = collisionCandidates[i];
+
+		// earlier collisions can run Lua callins which may move objects around
+		// (or the projectile itself), in which case the candidates are redone
+		const bool staleCands = (quadField.GetNumSolidChanges() != numSolidChanges);
+		const bool staleQuery = (!cc.valid || !cc.pos.same(p->pos) || cc.radius != (p->speed.w + p->radius));
+
+		if (i >= numGathered || staleCands || staleQuery) {
+			cc.units.clear();
+			cc.features.clear();
+			cc.repulsers.clear();
+
+			quadField.GetUnitsAndFeaturesColVol(p->pos, p->speed.w + p->radius, cc.units, cc.features, &cc.repulsers);
+		}
 
-		CheckShieldCollisions(p, tempRepulsers, ppos0, ppos1); tempRepulsers.clear();
-		CheckUnitCollisions(p, tempUnits, ppos0, ppos1); tempUnits.clear();
-		CheckFeatureCollisions(p, tempFeatures, ppos0, ppos1); tempFeatures.clear();
+		// resolution order is the same as when querying per projectile
+		CheckShieldCollisions(p, cc.repulsers, ppos0, ppos1);
+		CheckUnitCollisions(p, cc.units, ppos0, ppos1);
+		CheckFeatureCollisions(p, cc.features, ppos0, ppos1);
 	}
 }
 
@@ -47,6 +47,7 @@ public:
 	void CheckUnitCollisions(CProjectile*, std::vector<CUnit*>&, const float3, const float3);
 	void CheckFeatureCollisions(CProjectile*, std::vector<CFeature*>&, const float3, const float3);
 	void CheckShieldCollisions(CProjectile*, std::vector<CPlasmaRepulser*>&, const float3, const float3);
+	void GatherCollisionCandidates(const ProjectileContainer&);
 	void CheckUnitFeatureCollisions(ProjectileContainer&);
 	void CheckGroundCollisions(ProjectileContainer&);
 	void CheckCollisions();
@@ -113,6 +114,23 @@ private:
 	}
 
 private:
+	// broad-phase results for one projectile, see GatherCollisionCandidates
+	struct CollisionCandidates {
+		std::vector<CUnit*> units;
+		std::vector<CFeature*> features;
+		std::vector<CPlasmaRepulser*> repulsers;
+
+		// query parameters; <valid> is false if the projectile was skipped
+		float3 pos;
+		float radius = 0.0f;
+		bool valid = false;
+	};
+
+	// index-parallel to the container being checked; only grows
+	std::vector<CollisionCandidates> collisionCandidates;
+
+	bool mtCollisions = true;
+
 	// [0] := available unsynced projectile ID's
 	// [1] := available synced (weapon, piece) projectile ID's
 	std::vector<int> freeProjectileIDs[2];
@@ -53,6 +53,9 @@ CR_REG_METADATA(CUnitScript, (
 	CR_MEMBER(unit),
 	CR_MEMBER(busy),
 	CR_MEMBER(anims),
+	// always empty between frames
+	CR_IGNORED(doneAnims),
+	CR_IGNORED(ticked),
 
 	//Populated by children
 	CR_IGNORED(pieces),
@@ -77,6 +80,7 @@ CR_REG_METADATA_SUB(CUnitScript, AnimInfo,(
 CUnitScript::CUnitScript(CUnit* unit)
 	: unit(unit)
 	, busy(false)
+	, ticked(false)
 	, hasSetSFXOccupy(false)
 	, hasRockUnit(false)
 	, hasStartBuilding(false)
@@ -86,7 +90,7 @@ CUnitScript::CUnitScript(CUnit* unit)
 CUnitScript::~CUnitScript()
 {
 	// Remove us from possible animation ticking
-	if (!HaveAnimations())
+	if (!HaveAnimations() && !ticked)
 		return;
 
 	unitScriptEngine->RemoveInstance(this);
@@ -173,12 +177,21 @@ bool CUnitScript::DoSpin(float& cur, float dest, float& speed, float accel, int
 
 
 
-void CUnitScript::TickAnims(int tickRate, const TickAnimFunc& tickAnimFunc, AnimContainerType& liveAnims, AnimContainerType& doneAnims) {
+template<CUnitScript::AnimType type>
+void CUnitScript::TickAnims(int tickRate, AnimContainerType& liveAnims, AnimContainerType& doneAnims) {
 	for (size_t i = 0; i < liveAnims.size(); ) {
 		AnimInfo& ai = liveAnims[i];
 		LocalModelPiece& lmp = *pieces[ai.piece];
 
-		if ((ai.done |= (this->*tickAnimFunc)(tickRate, lmp, ai))) {
+		// resolved at compile-time, no call through a member-pointer per anim
+		switch (type) {
+			case ATurn: { ai.done |= TickTurnAnim(tickRate, lmp, ai); } break;
+			case ASpin: { ai.done |= TickSpinAnim(tickRate, lmp, ai); } break;
+			case AMove: { ai.done |= TickMoveAnim(tickRate, lmp, ai); } break;
+			default: {} break;
+		}
+
+		if (ai.done) {
 			if (ai.hasWaiting)
 				doneAnims.push_back(ai);
 
@@ -193,31 +206,38 @@ void CUnitScript::TickAnims(int tickRate, const TickAnimFunc& tickAnimFunc, Anim
 
 /**
  * @brief Called by the engine when we are registered as animating.
-          If we return false there are no active animations left.
+          Advances all animations and queues the finished ones that
+          have listeners waiting for them (see FinishAnims).
  * @param deltaTime int delta time to update
- * @return true if there are still active animations
  */
-bool CUnitScript::Tick(int deltaTime)
+void CUnitScript::TickAnims(int deltaTime)
 {
-	// vector of indexes of finished animations,
-	// so we can get rid of them in constant time
-	static AnimContainerType doneAnims[AMove + 1];
-	// tick-functions; these never change address
-	static constexpr TickAnimFunc tickAnimFuncs[AMove + 1] = {&CUnitScript::TickTurnAnim, &CUnitScript::TickSpinAnim, &CUnitScript::TickMoveAnim};
+	const int tickRate = 1000 / deltaTime;
 
-	for (int animType = ATurn; animType <= AMove; animType++) {
-		TickAnims(1000 / deltaTime, tickAnimFuncs[animType], anims[animType], doneAnims[animType]);
-	}
+	TickAnims<ATurn>(tickRate, anims[ATurn], doneAnims[ATurn]);
+	TickAnims<ASpin>(tickRate, anims[ASpin], doneAnims[ASpin]);
+	TickAnims<AMove>(tickRate, anims[AMove], doneAnims[AMove]);
 
-	// Tell listeners to unblock, and remove finished animations from the unit/script.
+	ticked = true;
+}
+
+/**
+ * @brief Tells listeners of animations finished by the last TickAnims to unblock.
+          If we return false there are no active animations left.
+ * @return true if there are still active animations
+ */
+bool CUnitScript::FinishAnims()
+{
 	for (int animType = ATurn; animType <= AMove; animType++) {
-		for (AnimInfo& ai: doneAnims[animType]) {
+		// NOTE: AnimFinished might result in new anims being added
+		for (const AnimInfo& ai: doneAnims[animType]) {
 			AnimFinished((AnimType) animType, ai.piece, ai.axis);
 		}
 
 		doneAnims[animType].clear();
 	}
 
+	ticked = false;
 	return (HaveAnimations());
 }
 
@@ -246,8 +266,9 @@ void CUnitScript::RemoveAnim(AnimType type, const AnimContainerTypeIt& animInfoI
 	anims[type].pop_back();
 
 	// If this was the last animation, remove from currently animating list
+	// (unless finished anims are still pending, the engine drops us after)
 	// FIXME: this could be done in a cleaner way
-	if (HaveAnimations())
+	if (HaveAnimations() || ticked)
 		return;
 
 	unitScriptEngine->RemoveInstance(this);
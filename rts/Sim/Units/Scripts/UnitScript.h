@@ -40,9 +40,10 @@ protected:
 	typedef std::vector<AnimInfo> AnimContainerType;
 	typedef AnimContainerType::iterator AnimContainerTypeIt;
 
-	typedef bool(CUnitScript::*TickAnimFunc)(int, LocalModelPiece&, AnimInfo&);
-
 	AnimContainerType anims[AMove + 1];
+	// finished anims with waiting listeners, between TickAnims and FinishAnims
+	AnimContainerType doneAnims[AMove + 1];
+	bool ticked;
 
 
 	bool hasSetSFXOccupy;
@@ -106,12 +107,18 @@ public:
 	      CUnit* GetUnit()       { return unit; }
 	const CUnit* GetUnit() const { return unit; }
 
-	bool Tick(int tickRate);
+	bool Tick(int deltaTime) { TickAnims(deltaTime); return (FinishAnims()); }
 	// note: must copy-and-set here (LMP dirty flag, etc)
 	bool TickMoveAnim(int tickRate, LocalModelPiece& lmp, AnimInfo& ai) { float3 pos = lmp.GetPosition(); const bool ret = MoveToward(pos[ai.axis], ai.dest, ai.speed / tickRate); lmp.SetPosition(pos); return ret; }
 	bool TickTurnAnim(int tickRate, LocalModelPiece& lmp, AnimInfo& ai) { float3 rot = lmp.GetRotation(); const bool ret = TurnToward(rot[ai.axis], ai.dest, ai.speed / tickRate); lmp.SetRotation(rot); return ret; }
 	bool TickSpinAnim(int tickRate, LocalModelPiece& lmp, AnimInfo& ai) { float3 rot = lmp.GetRotation(); const bool ret = DoSpin(rot[ai.axis], ai.dest, ai.speed, ai.accel, tickRate); lmp.SetRotation(rot); return ret; }
-	void TickAnims(int tickRate, const TickAnimFunc& tickAnimFunc, AnimContainerType& liveAnims, AnimContainerType& doneAnims);
+
+	// only touches this script's own pieces and anims, safe to run for different scripts in parallel
+	void TickAnims(int deltaTime);
+	template<AnimType type> void TickAnims(int tickRate, AnimContainerType& liveAnims, AnimContainerType& doneAnims);
+	// runs the listener callbacks for whatever TickAnims finished; must be called serially
+	bool FinishAnims();
+	bool WasTicked() const { return ticked; }
 
 	// animation, used by CCobThread
 	void Spin(int piece, int axis, float speed, float accel);
@@ -13,6 +13,8 @@
 #include "Sim/Units/UnitHandler.h"
 #include "System/ContainerUtil.h"
 #include "System/SafeUtil.h"
+#include "System/TimeProfiler.h"
+#include "System/Threading/ThreadPool.h"
 
 static CCobEngine gCobEngine;
 static CCobFileHandler gCobFileHandler;
@@ -118,11 +120,29 @@ void CUnitScriptEngine::Tick(int deltaTime)
 {
 	cobEngine->Tick(deltaTime);
 
-	// tick all (COB or LUS) script instances that have registered themselves as animating
+	// tick all (COB or LUS) script instances that have registered themselves as animating;
+	// this only moves each unit's own pieces so can be spread over threads, the callbacks
+	// for finished anims (which run script code) are then fired serially in unit order
+	// NOTE:
+	//   every unit's pieces have already moved when the first callback runs, whereas each
+	//   unit used to be ticked right before its own callbacks; anims that a callback starts
+	//   on a unit which was ticked already only begin to move in the next frame
+	{
+		SCOPED_TIMER("Sim::Script::Anims");
+
+		for_mt(0, animating.size(), [&](const int i) {
+			animating[i]->TickAnims(deltaTime);
+		});
+	}
+
 	for (size_t i = 0; i < animating.size(); ) {
 		currentScript = animating[i];
 
-		if (!currentScript->Tick(deltaTime)) {
+		// scripts that started animating due to a callback are ticked here instead
+		if (!currentScript->WasTicked())
+			currentScript->TickAnims(deltaTime);
+
+		if (!currentScript->FinishAnims()) {
 			animating[i] = animating.back();
 			animating.pop_back();
 			continue;
@@ -523,6 +523,16 @@ void CUnit::ForcedMove(const float3& newPos)
 
 
 
+void CUnit::Move(const float3& v, bool relative)
+{
+	CSolidObject::Move(v, relative);
+
+	// the packed positions of the exact quadfield queries must never lag
+	// behind (MovedUnit only runs when the unit may have changed quads)
+	quadField.MovedUnitData(this);
+}
+
+
 float3 CUnit::GetErrorVector(int argAllyTeam) const
 {
 	// false indicates LuaHandle without full read access
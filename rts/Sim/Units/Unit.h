@@ -108,6 +108,7 @@ public:
 	void Deactivate();
 
 	void ForcedMove(const float3& newPos);
+	void Move(const float3& v, bool relative) override;
 
 	void DeleteScript();
 	void EnableScriptMoveType();
@@ -11,11 +11,14 @@
 #include "UnitTypes/Factory.h"
 
 #include "CommandAI/BuilderCAI.h"
+#include "Game/GameHelper.h"
 #include "Sim/Misc/GlobalSynced.h"
+#include "Sim/Misc/QuadField.h"
 #include "Sim/Misc/TeamHandler.h"
 #include "Sim/MoveTypes/MoveType.h"
 #include "Sim/Path/IPathManager.h"
 #include "Sim/Weapons/Weapon.h"
+#include "System/Config/ConfigHandler.h"
 #include "System/EventHandler.h"
 #include "System/Log/ILog.h"
 #include "System/SpringMath.h"
@@ -26,6 +29,9 @@
 
 #include "Sim/Path/TKPFS/PathGlobal.h"
 
+CONFIG(bool, MultiThreadedMoveTypeUpdates).defaultValue(true).safemodeValue(false).description("Run the read-only part of unit MoveType updates on worker threads. Does not affect synced state, so it can differ between clients.");
+CONFIG(bool, MultiThreadedWeaponTargeting).defaultValue(true).safemodeValue(false).description("Pre-score weapon auto-target candidates on worker threads. Does not affect synced state, so it can differ between clients.");
+
 CR_BIND(CUnitHandler, )
 CR_REG_METADATA(CUnitHandler, (
 	CR_MEMBER(idPool),
@@ -43,7 +49,10 @@ CR_REG_METADATA(CUnitHandler, (
 	CR_MEMBER(maxUnits),
 	CR_MEMBER(maxUnitRadius),
 
-	CR_MEMBER(inUpdateCall)
+	CR_MEMBER(inUpdateCall),
+
+	CR_IGNORED(mtMoveTypeUpdates),
+	CR_IGNORED(mtWeaponTargeting)
 ))
 
 
@@ -100,6 +109,9 @@ void CUnitHandler::Init() {
 	{
 		activeSlowUpdateUnit = 0;
 		activeUpdateUnit = 0;
+
+		mtMoveTypeUpdates = configHandler->GetBool("MultiThreadedMoveTypeUpdates");
+		mtWeaponTargeting = configHandler->GetBool("MultiThreadedWeaponTargeting");
 	}
 	{
 		units.resize(maxUnits, nullptr);
@@ -304,6 +316,26 @@ void CUnitHandler::UpdateUnitMoveTypes()
 {
 	SCOPED_TIMER("Sim::Unit::MoveType");
 
+	// read-mostly pass; must produce the same results whether or not it
+	// runs in parallel, so that the config switch can not cause desyncs
+	// any work done here is only consumed by the serial pass below, which
+	// commits positions, QuadField changes and collisions in activeUnits
+	// order
+	if (mtMoveTypeUpdates) {
+		SCOPED_TIMER("Sim::Unit::MoveType::PreCollisionsMt");
+		CQuadField::ReadOnlyScope qfScope;
+
+		for_mt(0, activeUnits.size(), [this](const int i) {
+			activeUnits[i]->moveType->UpdatePreCollisionsMt();
+		});
+	} else {
+		SCOPED_TIMER("Sim::Unit::MoveType::PreCollisions");
+
+		for (CUnit* unit: activeUnits) {
+			unit->moveType->UpdatePreCollisionsMt();
+		}
+	}
+
 	for (activeUpdateUnit = 0; activeUpdateUnit < activeUnits.size(); ++activeUpdateUnit) {
 		CUnit* unit = activeUnits[activeUpdateUnit];
 		AMoveType* moveType = unit->moveType;
@@ -351,6 +383,11 @@ void CUnitHandler::SlowUpdateUnits()
 
 	activeSlowUpdateUnit = idxEnd;
 
+	{
+		SCOPED_TIMER("Sim::Unit::SlowUpdate::WeaponTargets");
+		helper->GenerateWeaponTargetsBatch(activeUnits, idxBeg, idxEnd, mtWeaponTargeting);
+	}
+
 	// stagger the SlowUpdate's
 	for (size_t i = idxBeg; i<idxEnd; ++i) {
 		CUnit* unit = activeUnits[i];
@@ -115,6 +115,11 @@ private:
 	float maxUnitRadius = 0.0f;
 
 	bool inUpdateCall = false;
+
+	///< whether MoveType pre-collision updates are spread over worker threads
+	bool mtMoveTypeUpdates = true;
+	///< whether weapon auto-target candidates are pre-scored on worker threads
+	bool mtWeaponTargeting = true;
 };
 
 extern CUnitHandler unitHandler;
@@ -565,6 +565,11 @@ bool CWeapon::AllowWeaponAutoTarget() const
 	if (checkAllowed >= 0)
 		return checkAllowed;
 
+	return (AllowWeaponAutoTargetDefault());
+}
+
+bool CWeapon::AllowWeaponAutoTargetDefault() const
+{
 	//FIXME these need to be merged
 	if (weaponDef->noAutoTarget || noAutoTarget)
 		return false;
@@ -83,6 +83,8 @@ public:
 	virtual void UpdateRange(const float val) { range = val; }
 
 	bool AutoTarget();
+	/// engine rules of AllowWeaponAutoTarget, without the Lua AllowWeaponTargetCheck override
+	bool AllowWeaponAutoTargetDefault() const;
 	void AimReady(const int value);
 	void Fire(const bool scriptCall);
 
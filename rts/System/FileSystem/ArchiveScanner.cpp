@@ -25,6 +25,8 @@
 #include "System/Threading/ThreadPool.h"
 #include "System/FileSystem/RapidHandler.h"
 #include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
+#include "System/Platform/byteorder.h"
 #include "System/Threading/SpringThreading.h"
 #include "System/UnorderedMap.hpp"
 
@@ -388,7 +390,7 @@ CArchiveScanner::CArchiveScanner()
 {
 	Clear();
 	// the "cache" dir is created in DataDirLocater
-	ReadCacheData(cachefile = FileSystem::EnsurePathSepAtEnd(FileSystem::GetCacheDir()) + IntToString(INTERNAL_VER, "ArchiveCache%i.lua"));
+	ReadCacheData(cachefile = FileSystem::EnsurePathSepAtEnd(FileSystem::GetCacheDir()) + IntToString(INTERNAL_VER, "ArchiveCache%i.bin"));
 	ScanAllDirs();
 }
 
@@ -432,7 +434,7 @@ void CArchiveScanner::Reload()
 
 	// ctor
 	Clear();
-	ReadCacheData(cachefile = FileSystem::EnsurePathSepAtEnd(FileSystem::GetCacheDir()) + IntToString(INTERNAL_VER, "ArchiveCache%i.lua"));
+	ReadCacheData(cachefile = FileSystem::EnsurePathSepAtEnd(FileSystem::GetCacheDir()) + IntToString(INTERNAL_VER, "ArchiveCache%i.bin"));
 	ScanAllDirs();
 }
 
@@ -463,6 +465,18 @@ void CArchiveScanner::ScanAllDirs()
 
 	ScanDirs(scanDirs);
 	WriteCacheData(GetFilepath());
+
+	LOG(
+		"[AS::%s] %u archives found, %u scanned; read-cache=%.1fms find=%.1fms check=%.1fms scan=%.1fms write-cache=%.1fms",
+		__func__,
+		scanTimings.numFound,
+		scanTimings.numScanned,
+		scanTimings.readCache,
+		scanTimings.findFiles,
+		scanTimings.checkCache,
+		scanTimings.scanArchives,
+		scanTimings.writeCache
+	);
 }
 
 
@@ -473,6 +487,8 @@ void CArchiveScanner::ScanDirs(const std::vector<std::string>& scanDirs)
 
 	isDirty = true;
 
+	const spring_time t0 = spring_gettime();
+
 	// scan for all archives
 	for (const std::string& dir: scanDirs) {
 		if (!FileSystem::DirExists(dir))
@@ -482,30 +498,80 @@ void CArchiveScanner::ScanDirs(const std::vector<std::string>& scanDirs)
 		ScanDir(dir, foundArchives);
 	}
 
-	// check for duplicates reached by links
-	//XXX too slow also ScanArchive() skips duplicates itself, too
-	/*for (auto it = foundArchives.begin(); it != foundArchives.end(); ++it) {
-		auto jt = it;
-		++jt;
-		while (jt != foundArchives.end()) {
-			std::string f1 = StringToLower(FileSystem::GetFilename(*it));
-			std::string f2 = StringToLower(FileSystem::GetFilename(*jt));
-			if ((f1 == f2) || FileSystem::ComparePaths(*it, *jt)) {
-				jt = foundArchives.erase(jt);
-			} else {
-				++jt;
-			}
-		}
-	}*/
+	const spring_time t1 = spring_gettime();
+
+	struct PendingArchive {
+		std::string fullName;
+		uint32_t modified;
+		uint64_t size;
+	};
 
-	// Create archiveInfos etc. if not in cache already
+	std::vector<PendingArchive> pendingArchives;
+	std::vector<ArchiveScanResult> scanResults;
+	spring::unordered_map<std::string, size_t> pendingArchivesIndex;
+
+	// determine which archives are not (validly) cached; this step
+	// modifies the cache so it has to happen in the order found
 	for (const std::string& archive: foundArchives) {
-		ScanArchive(archive, false);
-	#if !defined(DEDICATED) && !defined(UNITSYNC)
+		unsigned modifiedTime = 0;
+		uint64_t archiveSize = 0;
+
+		if (CheckCachedData(archive, modifiedTime, archiveSize, false))
+			continue;
+
+		const std::string& lcfn = StringToLower(FileSystem::GetFilename(archive));
+		const auto pendingIter = pendingArchivesIndex.find(lcfn);
+
+		// a second new archive of the same name; ScanArchive would have
+		// found the first one in archiveInfos already and rejected this
+		if (pendingIter != pendingArchivesIndex.end()) {
+			const std::string& pendingName = pendingArchives[pendingIter->second].fullName;
+
+			LOG_L(L_ERROR, "[AS::%s] found a \"%s\" already in \"%s\", ignoring.", __func__, archive.c_str(), pendingName.c_str());
+
+			if (baseContentArchives.find(lcfn) == baseContentArchives.end())
+				continue;
+
+			throw user_error(
+				std::string("duplicate base content detected:\n\t") + FileSystem::GetDirectory(pendingName) +
+				std::string("\n\t") + FileSystem::GetDirectory(archive) +
+				std::string("\nPlease fix your configuration/installation as this can cause desyncs!")
+			);
+		}
+
+		pendingArchivesIndex[lcfn] = pendingArchives.size();
+		pendingArchives.push_back({archive, modifiedTime, archiveSize});
+	}
+
+	const spring_time t2 = spring_gettime();
+
+	// open the new archives and parse their mod- and mapinfo's in parallel
+	// (checksums are computed lazily, on demand); nothing in here touches
+	// the cache so the results are merged afterwards, again in found order
+	scanResults.resize(pendingArchives.size());
+
+	for_mt(0, pendingArchives.size(), [&](const int i) {
+		const PendingArchive& pa = pendingArchives[i];
+
+		ScanArchiveData(pa.fullName, pa.modified, pa.size, false, scanResults[i]);
+
+		#if !defined(DEDICATED) && !defined(UNITSYNC)
 		Watchdog::ClearTimer(WDT_MAIN);
-	#endif
+		#endif
+	});
+
+	for (ArchiveScanResult& result: scanResults) {
+		AddScanResult(result);
 	}
 
+	const spring_time t3 = spring_gettime();
+
+	scanTimings.findFiles = (t1 - t0).toMilliSecsf();
+	scanTimings.checkCache = (t2 - t1).toMilliSecsf();
+	scanTimings.scanArchives = (t3 - t2).toMilliSecsf();
+	scanTimings.numFound = foundArchives.size();
+	scanTimings.numScanned = pendingArchives.size();
+
 	// Now we'll have to parse the replaces-stuff found in the mods
 	for (const auto& archiveInfo: archiveInfos) {
 		const std::string& lcOriginalName = StringToLower(archiveInfo.origName);
@@ -562,6 +628,25 @@ static void AddDependency(std::vector<std::string>& deps, const std::string& dep
 	spring::VectorInsertUnique(deps, dependency, true);
 }
 
+// directory archives report 0, their contents are covered by modifiedArchiveData
+static uint64_t GetArchiveFileSize(const std::string& fullName)
+{
+	struct stat info;
+
+	if (stat(fullName.c_str(), &info) != 0)
+		return 0;
+	if ((info.st_mode & S_IFREG) == 0)
+		return 0;
+
+	return info.st_size;
+}
+
+// entries converted from ArchiveCache.lua carry no size
+static bool SizeMatches(uint64_t size, uint64_t cachedSize)
+{
+	return (cachedSize == 0 || size == cachedSize);
+}
+
 bool CArchiveScanner::CheckCompression(const IArchive* ar, const std::string& fullName, std::string& error)
 {
 	if (!ar->CheckForSolid())
@@ -641,10 +726,11 @@ CArchiveScanner::BrokenArchive& CArchiveScanner::GetAddBrokenArchive(const std::
 void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 {
 	unsigned modifiedTime = 0;
+	uint64_t archiveSize = 0;
 
 	assert(!isInScan);
 
-	if (CheckCachedData(fullName, modifiedTime, doChecksum))
+	if (CheckCachedData(fullName, modifiedTime, archiveSize, doChecksum))
 		return;
 
 	isDirty = true;
@@ -659,6 +745,14 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 
 	const ScanScope scanScope(&isInScan);
 
+	ArchiveScanResult result;
+
+	ScanArchiveData(fullName, modifiedTime, archiveSize, doChecksum, result);
+	AddScanResult(result);
+}
+
+void CArchiveScanner::ScanArchiveData(const std::string& fullName, uint32_t modifiedTime, uint64_t archiveSize, bool doChecksum, ArchiveScanResult& result)
+{
 	const std::string& fname = FileSystem::GetFilename(fullName);
 	const std::string& fpath = FileSystem::GetDirectory(fullName);
 	const std::string& lcfn  = StringToLower(fname);
@@ -669,15 +763,17 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 		LOG_L(L_WARNING, "[AS::%s] unable to open archive \"%s\"", __func__, fullName.c_str());
 
 		// record it as broken, so we don't need to look inside everytime
-		BrokenArchive& ba = GetAddBrokenArchive(lcfn);
+		BrokenArchive& ba = result.brokenArchive;
 		ba.name = lcfn;
 		ba.path = fpath;
+		ba.size = archiveSize;
 		ba.modified = modifiedTime;
 		ba.updated = true;
 		ba.problem = "Unable to open archive";
 
 		// does not count as a scan
-		// numScannedArchives += 1;
+		result.broken = true;
+		result.counted = false;
 		return;
 	}
 
@@ -690,7 +786,7 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 	const bool hasMapInfo = ar->FileExists("mapinfo.lua");
 
 
-	ArchiveInfo ai;
+	ArchiveInfo& ai = result.archiveInfo;
 	ArchiveData& ad = ai.archiveData;
 
 	// execute the respective .lua, otherwise assume this archive is a map
@@ -713,15 +809,17 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 		LOG_L(L_WARNING, "[AS::%s] failed to scan \"%s\" (%s)", __func__, fullName.c_str(), error.c_str());
 
 		// mark archive as broken, so we don't need to look inside everytime
-		BrokenArchive& ba = GetAddBrokenArchive(lcfn);
+		BrokenArchive& ba = result.brokenArchive;
 		ba.name = lcfn;
 		ba.path = fpath;
+		ba.size = archiveSize;
 		ba.modified = modifiedTime;
 		ba.updated = true;
 		ba.problem = error;
 
 		// does count as a scan
-		numScannedArchives += 1;
+		result.broken = true;
+		result.counted = true;
 		return;
 	}
 
@@ -753,6 +851,7 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 	}
 
 	ai.path = fpath;
+	ai.size = archiveSize;
 	ai.modified = modifiedTime;
 
 	// Store modinfo.lua/mapinfo.lua modified timestamp for directory archives, as only they can change.
@@ -765,14 +864,26 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 	ai.updated = true;
 	ai.hashed = doChecksum && GetArchiveChecksum(fullName, ai);
 
-	archiveInfosIndex.insert(lcfn, archiveInfos.size());
-	archiveInfos.emplace_back(std::move(ai));
+	result.broken = false;
+	result.counted = true;
+}
 
-	numScannedArchives += 1;
+void CArchiveScanner::AddScanResult(ArchiveScanResult& result)
+{
+	numScannedArchives += result.counted;
+
+	if (result.broken) {
+		BrokenArchive& ba = GetAddBrokenArchive(result.brokenArchive.name);
+		ba = std::move(result.brokenArchive);
+		return;
+	}
+
+	archiveInfosIndex.insert(StringToLower(result.archiveInfo.origName), archiveInfos.size());
+	archiveInfos.emplace_back(std::move(result.archiveInfo));
 }
 
 
-bool CArchiveScanner::CheckCachedData(const std::string& fullName, unsigned& modified, bool doChecksum)
+bool CArchiveScanner::CheckCachedData(const std::string& fullName, unsigned& modified, uint64_t& size, bool doChecksum)
 {
 	// virtual archives do not exist on disk, and thus do not have a modification time
 	// they should still be scanned as normal archives so we only skip the cache-check
@@ -785,6 +896,8 @@ bool CArchiveScanner::CheckCachedData(const std::string& fullName, unsigned& mod
 	if ((modified = FileSystemAbstraction::GetFileModificationTime(fullName)) == 0)
 		return false;
 
+	size = GetArchiveFileSize(fullName);
+
 	const std::string& fileName      = FileSystem::GetFilename(fullName);
 	const std::string& filePath      = FileSystem::GetDirectory(fullName);
 	const std::string& fileNameLower = StringToLower(fileName);
@@ -797,7 +910,7 @@ bool CArchiveScanner::CheckCachedData(const std::string& fullName, unsigned& mod
 	if (baIter != brokenArchivesIndex.end()) {
 		BrokenArchive& ba = brokenArchives[baIter->second];
 
-		if (modified == ba.modified && filePath == ba.path)
+		if (modified == ba.modified && SizeMatches(size, ba.size) && filePath == ba.path)
 			return (ba.updated = true);
 	}
 
@@ -815,7 +928,7 @@ bool CArchiveScanner::CheckCachedData(const std::string& fullName, unsigned& mod
 	if (!ai.replaced.empty())
 		return true;
 
-	const bool haveValidCacheData = (modified == ai.modified && filePath == ai.path);
+	const bool haveValidCacheData = (modified == ai.modified && SizeMatches(size, ai.size) && filePath == ai.path);
 	// check if the archive data file (modinfo.lua/mapinfo.lua) has changed
 	const bool archiveDataChanged = (!ai.archiveDataPath.empty() && FileSystemAbstraction::GetFileModificationTime(ai.archiveDataPath) != ai.modifiedArchiveData);
 
@@ -976,6 +1089,19 @@ bool CArchiveScanner::GetArchiveChecksum(const std::string& archiveName, Archive
 void CArchiveScanner::ReadCacheData(const std::string& filename)
 {
 	std::lock_guard<decltype(scannerMutex)> lck(scannerMutex);
+
+	const spring_time t0 = spring_gettime();
+
+	if (!ReadBinaryCacheData(filename)) {
+		// no (valid) binary cache yet, convert the old one if present
+		ReadLuaCacheData(FileSystem::GetDirectory(filename) + IntToString(INTERNAL_VER, "ArchiveCache%i.lua"));
+	}
+
+	scanTimings.readCache = (spring_gettime() - t0).toMilliSecsf();
+}
+
+void CArchiveScanner::ReadLuaCacheData(const std::string& filename)
+{
 	if (!FileSystem::FileExists(filename)) {
 		LOG_L(L_INFO, "[AS::%s] ArchiveCache %s doesn't exist", __func__, filename.c_str());
 		return;
@@ -1050,25 +1176,258 @@ void CArchiveScanner::ReadCacheData(const std::string& filename)
 		ba.problem = curArchive.GetString("problem", "unknown");
 	}
 
-	isDirty = false;
+	// make sure the binary cache gets written
+	isDirty = true;
 }
 
-static inline void SafeStr(FILE* out, const char* prefix, const std::string& str)
+
+
+/*
+ * Binary ArchiveCache layout (all integers little-endian, strings are a
+ * uint32 length followed by as many bytes, no terminator):
+ *
+ *   char[8] magic, uint32 version, uint32 numArchives, uint32 numBroken
+ *   numArchives times:
+ *     string origName, path, replaced, archiveDataPath
+ *     uint64 size, uint32 modified, uint32 modifiedArchiveData
+ *     uint8[SHA_LEN] checksum
+ *     uint32 numInfoItems, then per item: string key, uint8 type, value
+ *     (string, int32, float32 or uint8 depending on type)
+ *     uint32 numDependencies, strings; uint32 numReplaces, strings
+ *   numBroken times:
+ *     string name, path, problem; uint64 size, uint32 modified
+ */
+static constexpr char BINARY_CACHE_MAGIC[8] = {'S', 'P', 'R', 'A', 'R', 'C', 'H', 'C'};
+
+class CacheWriter {
+public:
+	void Write(const void* p, size_t n) { buf.append(reinterpret_cast<const char*>(p), n); }
+
+	void WriteU8(uint8_t v) { Write(&v, sizeof(v)); }
+	void WriteU32(uint32_t v) { v = swabDWord(v); Write(&v, sizeof(v)); }
+	void WriteU64(uint64_t v) { v = swab64(v); Write(&v, sizeof(v)); }
+	void WriteFloat(float v) { v = swabFloat(v); Write(&v, sizeof(v)); }
+	void WriteStr(const std::string& s) { WriteU32(s.size()); Write(s.data(), s.size()); }
+	void WriteStrs(const std::vector<std::string>& v) {
+		WriteU32(v.size());
+
+		for (const std::string& s: v) {
+			WriteStr(s);
+		}
+	}
+
+	const std::string& GetBuffer() const { return buf; }
+
+private:
+	std::string buf;
+};
+
+class CacheReader {
+public:
+	CacheReader(const std::vector<uint8_t>& buf_): buf(buf_) {}
+
+	bool Read(void* p, size_t n) {
+		if ((good &= (n <= (buf.size() - pos))))
+			memcpy(p, &buf[pos], n);
+
+		pos += (n * good);
+		return good;
+	}
+
+	uint8_t ReadU8() { uint8_t v = 0; Read(&v, sizeof(v)); return v; }
+	uint32_t ReadU32() { uint32_t v = 0; Read(&v, sizeof(v)); return swabDWord(v); }
+	uint64_t ReadU64() { uint64_t v = 0; Read(&v, sizeof(v)); return swab64(v); }
+	float ReadFloat() { float v = 0.0f; Read(&v, sizeof(v)); return swabFloat(v); }
+	std::string ReadStr() {
+		const uint32_t n = ReadU32();
+
+		if (!(good &= (n <= (buf.size() - pos))))
+			return "";
+
+		pos += n;
+		return {reinterpret_cast<const char*>(&buf[pos - n]), n};
+	}
+	void ReadStrs(std::vector<std::string>& v) {
+		v.clear();
+
+		for (uint32_t i = 0, n = ReadU32(); i < n && good; i++) {
+			v.emplace_back(ReadStr());
+		}
+	}
+
+	bool Good() const { return good; }
+	void Fail() { good = false; }
+
+private:
+	const std::vector<uint8_t>& buf;
+
+	size_t pos = 0;
+	bool good = true;
+};
+
+
+bool CArchiveScanner::ReadBinaryCacheData(const std::string& filename)
 {
-	if (str.empty())
-		return;
+	std::vector<uint8_t> buf;
 
-	if ((str.find_first_of("\\\"") != std::string::npos) || (str.find_first_of('\n') != std::string::npos )) {
-		fprintf(out, "%s[[%s]],\n", prefix, str.c_str());
-	} else {
-		fprintf(out, "%s\"%s\",\n", prefix, str.c_str());
+	{
+		FILE* in = fopen(filename.c_str(), "rb");
+
+		if (in == nullptr)
+			return false;
+
+		fseek(in, 0, SEEK_END);
+		buf.resize(std::max(ftell(in), 0L));
+		fseek(in, 0, SEEK_SET);
+
+		const bool readAll = (fread(buf.data(), 1, buf.size(), in) == buf.size());
+
+		fclose(in);
+
+		if (!readAll)
+			return false;
+	}
+
+	CacheReader r(buf);
+
+	char magic[sizeof(BINARY_CACHE_MAGIC)];
+
+	if (!r.Read(magic, sizeof(magic)) || memcmp(magic, BINARY_CACHE_MAGIC, sizeof(magic)) != 0)
+		return false;
+	if (r.ReadU32() != INTERNAL_VER)
+		return false;
+
+	const uint32_t numArchives = r.ReadU32();
+	const uint32_t numBroken = r.ReadU32();
+
+	ArchiveInfo tmp; // used to compare against all-zero hash
+
+	for (uint32_t i = 0; i < numArchives && r.Good(); i++) {
+		const std::string& origName = r.ReadStr();
+
+		ArchiveInfo& ai = GetAddArchiveInfo(StringToLower(origName));
+		ArchiveData& ad = ai.archiveData;
+
+		ai.origName = origName;
+		ai.path = r.ReadStr();
+		ai.replaced = r.ReadStr();
+		ai.archiveDataPath = r.ReadStr();
+		ai.size = r.ReadU64();
+		ai.modified = r.ReadU32();
+		ai.modifiedArchiveData = r.ReadU32();
+
+		r.Read(ai.checksum, sizeof(ai.checksum));
+
+		ai.updated = false;
+		ai.hashed = (memcmp(ai.checksum, tmp.checksum, sha512::SHA_LEN) != 0);
+
+		for (uint32_t j = 0, n = r.ReadU32(); j < n && r.Good(); j++) {
+			const std::string& key = r.ReadStr();
+
+			switch (r.ReadU8()) {
+				case INFO_VALUE_TYPE_STRING : { ad.SetInfoItemValueString (key, r.ReadStr()       ); } break;
+				case INFO_VALUE_TYPE_INTEGER: { ad.SetInfoItemValueInteger(key, int(r.ReadU32())  ); } break;
+				case INFO_VALUE_TYPE_FLOAT  : { ad.SetInfoItemValueFloat  (key, r.ReadFloat()     ); } break;
+				case INFO_VALUE_TYPE_BOOL   : { ad.SetInfoItemValueBool   (key, r.ReadU8() != 0   ); } break;
+				default                     : { r.Fail();                                            } break;
+			}
+		}
+
+		r.ReadStrs(ad.GetDependencies());
+		r.ReadStrs(ad.GetReplaces());
+	}
+
+	for (uint32_t i = 0; i < numBroken && r.Good(); i++) {
+		const std::string& name = r.ReadStr();
+
+		BrokenArchive& ba = GetAddBrokenArchive(name);
+		ba.name = name;
+		ba.path = r.ReadStr();
+		ba.problem = r.ReadStr();
+		ba.size = r.ReadU64();
+		ba.modified = r.ReadU32();
+		ba.updated = false;
+	}
+
+	if (!r.Good()) {
+		LOG_L(L_ERROR, "[AS::%s] ArchiveCache %s is corrupt, rescanning all archives", __func__, filename.c_str());
+		Clear();
+		cachefile = filename;
+		return false;
 	}
+
+	isDirty = false;
+	return true;
 }
 
-void FilterDep(std::vector<std::string>& deps, const std::string& exclude)
+void CArchiveScanner::WriteBinaryCacheData(const std::string& filename)
 {
-	auto it = std::remove_if(deps.begin(), deps.end(), [&](const std::string& dep) { return (dep == exclude); });
-	deps.erase(it, deps.end());
+	CacheWriter w;
+
+	w.Write(BINARY_CACHE_MAGIC, sizeof(BINARY_CACHE_MAGIC));
+	w.WriteU32(INTERNAL_VER);
+	w.WriteU32(archiveInfos.size());
+	w.WriteU32(brokenArchives.size());
+
+	for (const ArchiveInfo& ai: archiveInfos) {
+		const ArchiveData& ad = ai.archiveData;
+
+		w.WriteStr(ai.origName);
+		w.WriteStr(ai.path);
+		w.WriteStr(ai.replaced);
+		w.WriteStr(ai.archiveDataPath);
+		w.WriteU64(ai.size);
+		w.WriteU32(ai.modified);
+		w.WriteU32(ai.modifiedArchiveData);
+		w.Write(ai.checksum, sizeof(ai.checksum));
+		w.WriteU32(ad.GetInfo().size());
+
+		for (const auto& ii: ad.GetInfo()) {
+			w.WriteStr(ii.second.key);
+			w.WriteU8(ii.second.valueType);
+
+			switch (ii.second.valueType) {
+				case INFO_VALUE_TYPE_STRING : { w.WriteStr(ii.second.valueTypeString);   } break;
+				case INFO_VALUE_TYPE_INTEGER: { w.WriteU32(ii.second.value.typeInteger); } break;
+				case INFO_VALUE_TYPE_FLOAT  : { w.WriteFloat(ii.second.value.typeFloat); } break;
+				case INFO_VALUE_TYPE_BOOL   : { w.WriteU8(ii.second.value.typeBool);     } break;
+			}
+		}
+
+		w.WriteStrs(ad.GetDependencies());
+		w.WriteStrs(ad.GetReplaces());
+	}
+
+	for (const BrokenArchive& ba: brokenArchives) {
+		w.WriteStr(ba.name);
+		w.WriteStr(ba.path);
+		w.WriteStr(ba.problem);
+		w.WriteU64(ba.size);
+		w.WriteU32(ba.modified);
+	}
+
+	// write to a temporary first so a crash can not leave a truncated cache behind
+	const std::string tmpname = filename + ".tmp";
+	const std::string& data = w.GetBuffer();
+
+	FILE* out = fopen(tmpname.c_str(), "wb");
+
+	if (out == nullptr) {
+		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, tmpname.c_str());
+		return;
+	}
+
+	const bool wroteAll = (fwrite(data.data(), 1, data.size(), out) == data.size());
+
+	if ((fclose(out) == EOF) || !wroteAll) {
+		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, tmpname.c_str());
+		return;
+	}
+
+	FileSystem::Remove(filename);
+
+	if (std::rename(tmpname.c_str(), filename.c_str()) != 0)
+		LOG_L(L_ERROR, "[AS::%s] failed to rename \"%s\" to \"%s\"!", __func__, tmpname.c_str(), filename.c_str());
 }
 
 void CArchiveScanner::WriteCacheData(const std::string& filename)
@@ -1077,11 +1436,7 @@ void CArchiveScanner::WriteCacheData(const std::string& filename)
 	if (!isDirty)
 		return;
 
-	FILE* out = fopen(filename.c_str(), "wt");
-	if (out == nullptr) {
-		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, filename.c_str());
-		return;
-	}
+	const spring_time t0 = spring_gettime();
 
 	// First delete all outdated information
 	{
@@ -1106,82 +1461,9 @@ void CArchiveScanner::WriteCacheData(const std::string& filename)
 		}
 	}
 
+	WriteBinaryCacheData(filename);
 
-	fprintf(out, "local archiveCache = {\n\n");
-	fprintf(out, "\tinternalver = %i,\n\n", INTERNAL_VER);
-	fprintf(out, "\tarchives = {  -- count = %u\n", unsigned(archiveInfos.size()));
-
-	for (const ArchiveInfo& arcInfo: archiveInfos) {
-		sha512::raw_digest rawDigest;
-		sha512::hex_digest hexDigest;
-
-		std::memcpy(rawDigest.data(), arcInfo.checksum, sha512::SHA_LEN);
-		sha512::dump_digest(rawDigest, hexDigest);
-
-		fprintf(out, "\t\t{\n");
-		SafeStr(out, "\t\t\tname = ",              arcInfo.origName);
-		SafeStr(out, "\t\t\tpath = ",              arcInfo.path);
-		fprintf(out, "\t\t\tmodified = \"%u\",\n", arcInfo.modified);
-		fprintf(out, "\t\t\tchecksum = \"%s\",\n", hexDigest.data());
-		SafeStr(out, "\t\t\treplaced = ",          arcInfo.replaced);
-
-		if (!arcInfo.archiveDataPath.empty()) {
-			SafeStr(out, "\t\t\tarchiveDataPath = ",              arcInfo.archiveDataPath);
-			fprintf(out, "\t\t\tmodifiedArchiveData = \"%u\",\n", arcInfo.modifiedArchiveData);
-		}
-
-		// mod info?
-		const ArchiveData& archData = arcInfo.archiveData;
-		if (!archData.GetName().empty()) {
-			fprintf(out, "\t\t\tarchivedata = {\n");
-
-			for (const auto& ii: archData.GetInfo()) {
-				if (ii.second.valueType == INFO_VALUE_TYPE_STRING) {
-					SafeStr(out, std::string("\t\t\t\t" + ii.first + " = ").c_str(), ii.second.valueTypeString);
-				} else {
-					fprintf(out, "\t\t\t\t%s = %s,\n", ii.first.c_str(), ii.second.GetValueAsString(false).c_str());
-				}
-			}
-
-			std::vector<std::string> deps = archData.GetDependencies();
-			if (archData.IsMap()) {
-				FilterDep(deps, GetMapHelperContentName());
-			} else if (archData.IsGame()) {
-				FilterDep(deps, GetSpringBaseContentName());
-			}
-
-			if (!deps.empty()) {
-				fprintf(out, "\t\t\t\tdepend = {\n");
-				for (const auto& dep: deps) {
-					SafeStr(out, "\t\t\t\t\t", dep);
-				}
-				fprintf(out, "\t\t\t\t},\n");
-			}
-			fprintf(out, "\t\t\t},\n");
-		}
-
-		fprintf(out, "\t\t},\n");
-	}
-
-	fprintf(out, "\t},\n\n"); // close 'archives'
-	fprintf(out, "\tbrokenArchives = {  -- count = %u\n", unsigned(brokenArchives.size()));
-
-	for (const BrokenArchive& ba: brokenArchives) {
-		fprintf(out, "\t\t{\n");
-		SafeStr(out, "\t\t\tname = ", ba.name);
-		SafeStr(out, "\t\t\tpath = ", ba.path);
-		fprintf(out, "\t\t\tmodified = \"%u\",\n", ba.modified);
-		SafeStr(out, "\t\t\tproblem = ", ba.problem);
-		fprintf(out, "\t\t},\n");
-	}
-
-	fprintf(out, "\t},\n"); // close 'brokenArchives'
-	fprintf(out, "}\n\n"); // close 'archiveCache'
-	fprintf(out, "return archiveCache\n");
-
-	if (fclose(out) == EOF)
-		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, filename.c_str());
-
+	scanTimings.writeCache = (spring_gettime() - t0).toMilliSecsf();
 	isDirty = false;
 }
 
@@ -169,6 +169,7 @@ private:
 
 		ArchiveData archiveData;
 
+		uint64_t size = 0;            // 0 for directory archives, or if unknown
 		uint32_t modified = 0;
 		uint32_t modifiedArchiveData = 0;
 		uint8_t checksum[sha512::SHA_LEN];
@@ -181,14 +182,36 @@ private:
 		std::string path;         // FileSystem::GetDirectory(origName)
 		std::string problem;
 
+		uint64_t size = 0;
 		uint32_t modified = 0;
 		bool updated = false;
 	};
+	struct ArchiveScanResult {
+		ArchiveInfo archiveInfo;
+		BrokenArchive brokenArchive;
+
+		bool broken = false;
+		bool counted = false; // whether this counts towards numScannedArchives
+	};
+	struct ScanTimings {
+		float readCache = 0.0f;
+		float findFiles = 0.0f;
+		float checkCache = 0.0f;
+		float scanArchives = 0.0f;
+		float writeCache = 0.0f;
+
+		uint32_t numFound = 0;
+		uint32_t numScanned = 0;
+	};
 
 private:
 	ArchiveInfo& GetAddArchiveInfo(const std::string& lcfn);
 	BrokenArchive& GetAddBrokenArchive(const std::string& lcfn);
 
+	/// reads an archive's info without touching any scanner state, may run on any thread
+	void ScanArchiveData(const std::string& fullName, uint32_t modified, uint64_t size, bool doChecksum, ArchiveScanResult& result);
+	void AddScanResult(ArchiveScanResult& result);
+
 	void ScanDirs(const std::vector<std::string>& dirs);
 	void ScanDir(const std::string& curPath, std::deque<std::string>& foundArchives);
 
@@ -205,6 +228,11 @@ private:
 	void ReadCacheData(const std::string& filename);
 	void WriteCacheData(const std::string& filename);
 
+	/// compact binary replacement for ArchiveCache.lua, read in one go
+	bool ReadBinaryCacheData(const std::string& filename);
+	void WriteBinaryCacheData(const std::string& filename);
+	void ReadLuaCacheData(const std::string& filename);
+
 	IFileFilter* CreateIgnoreFilter(IArchive* ar);
 
 	/**
@@ -213,7 +241,7 @@ private:
 	 */
 	bool GetArchiveChecksum(const std::string& filename, ArchiveInfo& archiveInfo);
 
-	bool CheckCachedData(const std::string& fullName, unsigned& modified, bool doChecksum);
+	bool CheckCachedData(const std::string& fullName, unsigned& modified, uint64_t& size, bool doChecksum);
 
 	/**
 	 * Returns a value > 0 if the file is rated as a meta-file.
@@ -245,6 +273,8 @@ private:
 
 	std::string cachefile;
 
+	ScanTimings scanTimings;
+
 	bool isDirty = false;
 	bool isInScan = false;
 };
@@ -0,0 +1,87 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "MemoryMappedFile.h"
+#include "System/Platform/Win/win32.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+CMemoryMappedFile::CMemoryMappedFile(const std::string& filePath)
+{
+	#ifdef _WIN32
+	fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		fileHandle = nullptr;
+		return;
+	}
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		Close();
+		return;
+	}
+
+	if ((mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr)) == nullptr) {
+		Close();
+		return;
+	}
+
+	if ((data = static_cast<const std::uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0))) == nullptr) {
+		Close();
+		return;
+	}
+
+	size = fileSize.QuadPart;
+
+	#else
+
+	const int fd = open(filePath.c_str(), O_RDONLY);
+
+	if (fd == -1)
+		return;
+
+	struct stat info;
+
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		void* ptr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (ptr != MAP_FAILED) {
+			data = static_cast<const std::uint8_t*>(ptr);
+			size = info.st_size;
+		}
+	}
+
+	// the mapping stays valid without the descriptor
+	close(fd);
+	#endif
+}
+
+void CMemoryMappedFile::Close()
+{
+	#ifdef _WIN32
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+	if (fileHandle != nullptr)
+		CloseHandle(fileHandle);
+
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+
+	#else
+
+	if (data != nullptr)
+		munmap(const_cast<std::uint8_t*>(data), size);
+	#endif
+
+	data = nullptr;
+	size = 0;
+}
@@ -0,0 +1,39 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _MEMORY_MAPPED_FILE_H
+#define _MEMORY_MAPPED_FILE_H
+
+#include <cinttypes>
+#include <string>
+
+/**
+ * Read-only view of a file on the real filesystem (not the VFS), mapped
+ * into memory so its contents can be used without reading them upfront.
+ */
+class CMemoryMappedFile
+{
+public:
+	CMemoryMappedFile(const std::string& filePath);
+	~CMemoryMappedFile() { Close(); }
+
+	CMemoryMappedFile(const CMemoryMappedFile&) = delete;
+	CMemoryMappedFile& operator = (const CMemoryMappedFile&) = delete;
+
+	void Close();
+
+	bool IsOpen() const { return (data != nullptr); }
+
+	const std::uint8_t* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+private:
+	const std::uint8_t* data = nullptr;
+	size_t size = 0;
+
+	#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+	#endif
+};
+
+#endif // _MEMORY_MAPPED_FILE_H
@@ -56,6 +56,7 @@ CONFIG(int, TeamHighlight)
 	.maximumValue(CTeamHighlight::HIGHLIGHT_LAST);
 
 CONFIG(bool, UseNetMessageSmoothingBuffer).defaultValue(true);
+CONFIG(bool, UseBatchedNetIO).defaultValue(true).description("Send and receive server datagrams in batches with sendmmsg/recvmmsg (Linux only).");
 
 CONFIG(bool, LuaWritableConfigFile).defaultValue(true);
 CONFIG(bool, VFSCacheArchiveFiles).defaultValue(true);
@@ -84,6 +85,8 @@ void GlobalConfig::Init()
 	if (linkIncomingMaxPacketRate > 0 && linkIncomingSustainedBandwidth <= 0)
 		linkIncomingSustainedBandwidth = linkIncomingPeakBandwidth = 1024 * 1024;
 
+	useBatchedNetIO = configHandler->GetBool("UseBatchedNetIO");
+
 	useNetMessageSmoothingBuffer = configHandler->GetBool("UseNetMessageSmoothingBuffer");
 	luaWritableConfigFile = configHandler->GetBool("LuaWritableConfigFile");
 	vfsCacheArchiveFiles = configHandler->GetBool("VFSCacheArchiveFiles");
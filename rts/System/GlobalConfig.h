@@ -82,6 +82,14 @@ public:
 	 */
 	int linkIncomingMaxWaitingPackets = 512;
 
+	/**
+	 * @brief useBatchedNetIO
+	 *
+	 * Whether the server socket should send and receive datagrams in batches
+	 * (sendmmsg/recvmmsg) where the platform supports it
+	 */
+	bool useBatchedNetIO = true;
+
 
 	/**
 	 * @brief useNetMessageSmoothingBuffer
@@ -100,6 +100,7 @@ void CGameStateCollector::Serialize(creg::ISerializer* s)
 	}
 	s->SerializeObjectInstance(&commandDescriptionCache, commandDescriptionCache.GetClass());
 	s->SerializeObjectInstance(eoh, eoh->GetClass());
+	LuaRulesParams::keyTable.Serialize(s);
 	std::unique_ptr<creg::IType> mapType = creg::DeduceType<decltype(CSplitLuaHandle::gameParams)>::Get();
 	mapType->Serialize(s, &CSplitLuaHandle::gameParams);
 }
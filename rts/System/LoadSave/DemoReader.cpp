@@ -15,6 +15,7 @@ CONFIG(bool, DisableDemoVersionCheck).defaultValue(false).description("Allow to
 #include "System/Log/ILog.h"
 #include "System/Net/RawPacket.h"
 
+#include <algorithm>
 #include <array>
 #include <climits>
 #include <stdexcept>
@@ -200,3 +201,67 @@ void CDemoReader::LoadStats()
 
 	playbackDemo->Seek(curPos);
 }
+
+
+bool CDemoReader::LoadFrameIndex()
+{
+	frameIndex.clear();
+
+	// no index if Spring crashed while writing the demo
+	if (fileHeader.demoStreamSize == 0)
+		return false;
+
+	const int curPos = playbackDemo->GetPos();
+	const int indexPos =
+		fileHeader.headerSize + fileHeader.scriptSize + fileHeader.demoStreamSize +
+		fileHeader.winningAllyTeamsSize + fileHeader.playerStatSize + fileHeader.teamStatSize;
+
+	DemoFrameIndexHeader indexHeader;
+
+	playbackDemo->Seek(indexPos);
+
+	if (playbackDemo->Read(reinterpret_cast<char*>(&indexHeader), sizeof(indexHeader)) == sizeof(indexHeader)) {
+		indexHeader.swab();
+
+		if (memcmp(indexHeader.magic, DEMOFILE_FRAME_INDEX_MAGIC, sizeof(indexHeader.magic)) == 0 && indexHeader.numEntries > 0) {
+			frameIndex.resize(indexHeader.numEntries);
+
+			if (playbackDemo->Read(reinterpret_cast<char*>(frameIndex.data()), frameIndex.size() * sizeof(DemoFrameIndexEntry)) != int(frameIndex.size() * sizeof(DemoFrameIndexEntry))) {
+				LOG_L(L_WARNING, "[DemoReader::%s] truncated frame index", __func__);
+				frameIndex.clear();
+			}
+
+			for (DemoFrameIndexEntry& entry: frameIndex) {
+				entry.swab();
+			}
+		}
+	}
+
+	playbackDemo->Seek(curPos);
+	return (!frameIndex.empty());
+}
+
+
+int CDemoReader::SeekToFrame(int frameNum, float curTime)
+{
+	// first entry after frameNum
+	const auto iter = std::upper_bound(frameIndex.begin(), frameIndex.end(), frameNum, [](int f, const DemoFrameIndexEntry& e) { return (f < e.frameNum); });
+
+	if (iter == frameIndex.begin())
+		return -1;
+
+	const DemoFrameIndexEntry& entry = *(iter - 1);
+
+	if (int(entry.streamOffset + sizeof(chunkHeader)) > fileHeader.demoStreamSize)
+		return -1;
+
+	playbackDemo->Seek(fileHeader.headerSize + fileHeader.scriptSize + entry.streamOffset);
+	playbackDemo->Read(reinterpret_cast<char*>(&chunkHeader), sizeof(chunkHeader));
+	chunkHeader.swab();
+
+	demoTimeOffset = curTime - chunkHeader.modGameTime - 0.1f;
+	nextDemoReadTime = curTime - 0.01f;
+	bytesRemaining = fileHeader.demoStreamSize - (entry.streamOffset + sizeof(chunkHeader));
+
+	return entry.frameNum;
+}
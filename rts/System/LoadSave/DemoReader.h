@@ -55,6 +55,21 @@ public:
 	/// Not needed for normal demo watching
 	void LoadStats();
 
+	/**
+	@brief Load the frame index (DemoFrameIndexHeader), if the demo has one
+	@return true when an index was found
+	*/
+	bool LoadFrameIndex();
+
+	/**
+	@brief Continue reading at the last indexed frame not after frameNum
+	@return The frame started by the next packet returned by GetData, or -1
+	        if the demo has no index or frameNum precedes its first entry
+	*/
+	int SeekToFrame(int frameNum, float curTime);
+
+	const std::vector<DemoFrameIndexEntry>& GetFrameIndex() const { return frameIndex; }
+
 private:
 	CFileHandler* playbackDemo;
 
@@ -70,6 +85,7 @@ private:
 	std::vector<PlayerStatistics> playerStats; // one stat per player
 	std::vector< std::vector<TeamStatistics> > teamStats; // many stats per team
 	std::vector<unsigned char> winningAllyTeams;
+	std::vector<DemoFrameIndexEntry> frameIndex;
 };
 
 #endif
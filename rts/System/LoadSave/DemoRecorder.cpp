@@ -2,11 +2,16 @@
 
 #include <cassert>
 #include <cerrno>
+#include <cstdio>
 #include <cstring>
+#include <atomic>
+#include <deque>
 #include <memory>
 
 #include "DemoRecorder.h"
 #include "Game/GameVersion.h"
+#include "Net/Protocol/BaseNetProtocol.h"
+#include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/TeamStatistics.h"
 #include "System/TimeUtil.h"
 #include "System/StringUtil.h"
@@ -14,7 +19,10 @@
 #include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/FileQueryFlags.h"
 #include "System/FileSystem/FileHandler.h"
+#include "System/SafeUtil.h"
+#include "System/Config/ConfigHandler.h"
 #include "System/Log/ILog.h"
+#include "System/Platform/Threading.h"
 #include "System/Threading/ThreadPool.h"
 
 #ifdef CreateDirectory
@@ -26,10 +34,244 @@
 #endif
 
 
-// server and client memory-streams
+CONFIG(int, DemoStreamInterval)
+	.defaultValue(0)
+	.minimumValue(0)
+	.description("If greater than 0, demos are compressed and written to disk in chunks of (at most) this many seconds of game-time while recording, instead of being kept in memory until the game ends.");
+
+
+// server and client memory-streams; hold only the current chunk when streaming
 static std::string demoStreams[2];
 static spring::mutex demoMutex;
 
+// chunks are also flushed when they grow this large, whatever their duration
+static constexpr size_t MAX_DEMO_CHUNK_SIZE = 4 * 1024 * 1024;
+
+// one frame-index entry per game-second
+static constexpr int DEMO_FRAME_INDEX_INTERVAL = GAME_SPEED;
+
+
+
+/**
+ * Appends the chunks of a streamed demo to its file from a background thread,
+ * each as a separate gzip member (see DemoChunkIndexEntry), then writes the
+ * chunk index. The header lives in a stored member of fixed size at the start
+ * of the file, so it can be overwritten once the final values are known.
+ */
+class CDemoStreamWriter
+{
+public:
+	CDemoStreamWriter(const std::string& fileName): fileName(fileName) {
+		if ((file = fopen(fileName.c_str(), "wb")) == nullptr)
+			return;
+
+		thread = spring::thread(&CDemoStreamWriter::Run, this);
+	}
+
+	~CDemoStreamWriter() {
+		if (thread.joinable())
+			thread.join();
+	}
+
+	bool IsValid() const { return (file != nullptr); }
+	/// true once a write has failed; later jobs (except JOB_FINISH) are dropped
+	bool HasFailed() const { return failed.load(); }
+
+	void WriteHeader(const DemoFileHeader& header) {
+		AddJob({JOB_HEADER, std::string(reinterpret_cast<const char*>(&header), sizeof(header))});
+	}
+	void WriteChunk(std::string&& data) {
+		AddJob({JOB_CHUNK, std::move(data)});
+	}
+	/// writes the index, closes the file and waits for the thread to exit
+	void Finish() {
+		AddJob({JOB_FINISH, {}});
+		thread.join();
+	}
+
+private:
+	enum JobType {
+		JOB_HEADER,
+		JOB_CHUNK,
+		JOB_FINISH,
+	};
+
+	struct Job {
+		JobType type;
+		std::string data;
+	};
+
+	void AddJob(Job&& job) {
+		if (file == nullptr)
+			return;
+		// still needs to reach the thread so Finish can join it
+		if (job.type != JOB_FINISH && HasFailed())
+			return;
+
+		{
+			std::lock_guard<spring::mutex> lock(jobMutex);
+			jobs.emplace_back(std::move(job));
+		}
+
+		jobCond.notify_one();
+	}
+
+	void Run() {
+		Threading::SetThreadName("demowriter");
+
+		while (true) {
+			Job job;
+
+			{
+				std::unique_lock<spring::mutex> lock(jobMutex);
+				jobCond.wait(lock, [&]() { return !jobs.empty(); });
+
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+
+			if (job.type == JOB_FINISH) {
+				if (!HasFailed())
+					WriteIndex();
+
+				fclose(file);
+				break;
+			}
+
+			if (HasFailed())
+				continue;
+
+			if (!(job.type == JOB_HEADER? WriteHeaderJob(job.data): WriteChunkJob(job.data)))
+				SetFailed();
+		}
+	}
+
+	void SetFailed() {
+		LOG_L(L_ERROR, "[DemoStreamWriter::%s] could not write to \"%s\" (%s), demo-streaming stopped", __func__, fileName.c_str(), strerror(errno));
+		failed.store(true);
+	}
+
+	bool WriteHeaderJob(const std::string& data) {
+		// header member is always the first one and always of the same size
+		const uint64_t endOffset = fileOffset;
+
+		if (fseek(file, 0, SEEK_SET) != 0)
+			return false;
+		if (!WriteStoredMember(data))
+			return false;
+		if (fseek(file, 0, SEEK_END) != 0)
+			return false;
+
+		fileOffset = std::max(endOffset, uint64_t(DEMOFILE_STORED_MEMBER_SIZE(sizeof(DemoFileHeader))));
+		return (fflush(file) == 0);
+	}
+
+	bool WriteChunkJob(const std::string& data) {
+		DemoChunkIndexEntry entry;
+		entry.fileOffset = fileOffset;
+		entry.dataOffset = dataOffset;
+		entry.dataSize = data.size();
+
+		if (!WriteDeflatedMember(data))
+			return false;
+
+		entry.swab();
+		chunkIndex.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+		dataOffset += data.size();
+		return (fflush(file) == 0);
+	}
+
+	void WriteIndex() {
+		DemoChunkIndexTrailer trailer;
+		memset(&trailer, 0, sizeof(trailer));
+		strcpy(trailer.magic, DEMOFILE_INDEX_MAGIC);
+		trailer.indexOffset = fileOffset;
+		trailer.numChunks = chunkIndex.size() / sizeof(DemoChunkIndexEntry);
+		trailer.swab();
+
+		if (!WriteDeflatedMember(chunkIndex))
+			return SetFailed();
+		if (!WriteStoredMember(std::string(reinterpret_cast<const char*>(&trailer), sizeof(trailer))))
+			return SetFailed();
+	}
+
+	// one deflate block of type 0, so the member size only depends on data.size()
+	bool WriteStoredMember(const std::string& data) {
+		assert(data.size() <= 0xFFFF);
+
+		const uint32_t crc = crc32(0, reinterpret_cast<const Bytef*>(data.data()), data.size());
+		const uint16_t len = data.size();
+		const uint16_t nlen = ~len;
+
+		unsigned char head[10 + 5] = {0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 0xff, 0x01};
+		unsigned char tail[8];
+
+		head[11] = len & 0xFF; head[12] = (len >> 8) & 0xFF;
+		head[13] = nlen & 0xFF; head[14] = (nlen >> 8) & 0xFF;
+
+		for (int i = 0; i < 4; i++) {
+			tail[i    ] = (crc         >> (i * 8)) & 0xFF;
+			tail[i + 4] = (data.size() >> (i * 8)) & 0xFF;
+		}
+
+		if (fwrite(head, sizeof(head), 1, file) != 1)
+			return false;
+		if (!data.empty() && fwrite(data.data(), data.size(), 1, file) != 1)
+			return false;
+		if (fwrite(tail, sizeof(tail), 1, file) != 1)
+			return false;
+
+		fileOffset += DEMOFILE_STORED_MEMBER_SIZE(data.size());
+		return true;
+	}
+
+	bool WriteDeflatedMember(const std::string& data) {
+		z_stream zs;
+		memset(&zs, 0, sizeof(zs));
+
+		// +16 selects a gzip wrapper
+		if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+			return false;
+
+		deflateBuffer.resize(deflateBound(&zs, data.size()));
+
+		zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+		zs.avail_in = data.size();
+		zs.next_out = deflateBuffer.data();
+		zs.avail_out = deflateBuffer.size();
+
+		// output fits by deflateBound, so a single call has to finish the stream
+		const bool deflated = (deflate(&zs, Z_FINISH) == Z_STREAM_END);
+		const bool written = deflated && (fwrite(deflateBuffer.data(), zs.total_out, 1, file) == 1);
+
+		if (written)
+			fileOffset += zs.total_out;
+
+		deflateEnd(&zs);
+		return written;
+	}
+
+private:
+	std::string fileName;
+	FILE* file = nullptr;
+
+	std::atomic<bool> failed = {false};
+
+	spring::thread thread;
+	spring::mutex jobMutex;
+	spring::condition_variable_any jobCond;
+
+	std::deque<Job> jobs;
+	std::vector<Bytef> deflateBuffer;
+
+	// serialized DemoChunkIndexEntry's
+	std::string chunkIndex;
+
+	uint64_t fileOffset = 0;
+	uint32_t dataOffset = sizeof(DemoFileHeader);
+};
+
+
 
 CDemoRecorder::CDemoRecorder(const std::string& mapName, const std::string& modName, bool serverDemo): isServerDemo(serverDemo)
 {
@@ -38,19 +280,33 @@ CDemoRecorder::CDemoRecorder(const std::string& mapName, const std::string& modN
 	SetStream();
 	SetName(mapName, modName);
 	SetFileHeader();
+
+	streamInterval = configHandler->GetInt("DemoStreamInterval");
+
+	if (streamInterval > 0) {
+		streamWriter = new CDemoStreamWriter(demoName);
+
+		if (!streamWriter->IsValid())
+			spring::SafeDelete(streamWriter);
+	}
+
 	WriteFileHeader(false);
 
+	if (streamWriter != nullptr)
+		return;
+
 	file = gzopen(demoName.c_str(), "wb9");
 }
 
 CDemoRecorder::~CDemoRecorder()
 {
-	if (file == nullptr)
+	if (!IsValid())
 		return;
 
 	WriteWinnerList();
 	WritePlayerStats();
 	WriteTeamStats();
+	WriteFrameIndex();
 	WriteFileHeader(true);
 	WriteDemoFile();
 }
@@ -76,8 +332,42 @@ void CDemoRecorder::SetFileHeader()
 	fileHeader.winningAllyTeamsSize = 0;
 }
 
+void CDemoRecorder::FlushDemoChunk()
+{
+	std::string& data = demoStreams[isServerDemo];
+
+	if (data.empty())
+		return;
+
+	streamWriter->WriteChunk(std::move(data));
+
+	data.clear();
+	data.reserve(1024 * 1024);
+}
+
 void CDemoRecorder::WriteDemoFile()
 {
+	if (streamWriter != nullptr) {
+		FlushDemoChunk();
+
+		LOG("[DemoRecorder::%s] finishing streamed %s-demo \"%s\"", __func__, (isServerDemo? "server": "client"), demoName.c_str());
+
+		// the last chunk might still be compressing, do not wait for it here
+		std::function<void(CDemoStreamWriter*)> func = [](CDemoStreamWriter* writer) {
+			writer->Finish();
+			delete writer;
+		};
+
+		#ifndef _WIN32
+		ThreadPool::AddExtJob(spring::thread(std::move(func), streamWriter));
+		#else
+		ThreadPool::AddExtJob(std::move(std::async(std::launch::async, std::move(func), streamWriter)));
+		#endif
+
+		streamWriter = nullptr;
+		return;
+	}
+
 	// zlib FAQ claims the lib is thread-safe, "however any library routines that zlib uses and
 	// any application-provided memory allocation routines must also be thread-safe. zlib's gz*
 	// functions use stdio library routines, and most of zlib's functions use the library memory
@@ -116,6 +406,22 @@ void CDemoRecorder::WriteSetupText(const std::string& text)
 
 void CDemoRecorder::SaveToDemo(const unsigned char* buf, const unsigned length, const float modGameTime)
 {
+	switch (buf[0]) {
+		case NETMSG_KEYFRAME: {
+			// keyframes carry their number, resync in case a packet went missing
+			memcpy(&frameNum, &buf[1], sizeof(frameNum));
+			frameNum = swabDWord(frameNum) - 1;
+		} // fall-through
+		case NETMSG_NEWFRAME: {
+			if (((++frameNum) % DEMO_FRAME_INDEX_INTERVAL) != 0)
+				break;
+
+			frameIndex.push_back({frameNum, static_cast<std::uint32_t>(fileHeader.demoStreamSize), modGameTime});
+		} break;
+		default: {
+		} break;
+	}
+
 	DemoStreamChunkHeader chunkHeader;
 
 	chunkHeader.modGameTime = modGameTime;
@@ -124,6 +430,16 @@ void CDemoRecorder::SaveToDemo(const unsigned char* buf, const unsigned length,
 	demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&chunkHeader), sizeof(chunkHeader));
 	demoStreams[isServerDemo].append(reinterpret_cast<const char*>(buf), length);
 	fileHeader.demoStreamSize += (length + sizeof(chunkHeader));
+
+	if (streamWriter == nullptr)
+		return;
+
+	// cut chunks only between packets, so each starts with a DemoStreamChunkHeader
+	if ((modGameTime - chunkStartTime) < streamInterval && demoStreams[isServerDemo].size() < MAX_DEMO_CHUNK_SIZE)
+		return;
+
+	FlushDemoChunk();
+	chunkStartTime = modGameTime;
 }
 
 void CDemoRecorder::SetName(const std::string& mapName, const std::string& modName)
@@ -229,6 +545,11 @@ unsigned int CDemoRecorder::WriteFileHeader(bool updateStreamLength)
 	// to little endian
 	tmpHeader.swab();
 
+	if (streamWriter != nullptr) {
+		streamWriter->WriteHeader(tmpHeader);
+		return (demoStreams[isServerDemo].size());
+	}
+
 	if (demoStreams[isServerDemo].empty()) {
 		demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&tmpHeader), sizeof(tmpHeader));
 	} else {
@@ -298,3 +619,24 @@ void CDemoRecorder::WriteTeamStats()
 
 	teamStats.clear();
 }
+
+/** @brief Write the frame index (DemoFrameIndexHeader) at the current position in the file. */
+void CDemoRecorder::WriteFrameIndex()
+{
+	DemoFrameIndexHeader indexHeader;
+
+	memset(&indexHeader, 0, sizeof(indexHeader));
+	strcpy(indexHeader.magic, DEMOFILE_FRAME_INDEX_MAGIC);
+	indexHeader.numEntries = frameIndex.size();
+	indexHeader.frameInterval = DEMO_FRAME_INDEX_INTERVAL;
+	indexHeader.swab();
+
+	demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&indexHeader), sizeof(indexHeader));
+
+	for (DemoFrameIndexEntry& entry: frameIndex) {
+		entry.swab();
+		demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+	}
+
+	frameIndex.clear();
+}
@@ -11,6 +11,7 @@
 #include "Game/Players/PlayerStatistics.h"
 #include "Sim/Misc/TeamStatistics.h"
 
+class CDemoStreamWriter;
 
 /**
  * @brief Used to record demos
@@ -33,18 +34,23 @@ public:
 		memset(&r.fileHeader, 0, sizeof(fileHeader));
 
 		std::swap(file, r.file);
+		std::swap(streamWriter, r.streamWriter);
+		std::swap(chunkStartTime, r.chunkStartTime);
+		std::swap(streamInterval, r.streamInterval);
 
 		std::swap(demoName, r.demoName);
 		std::swap(playerStats, r.playerStats);
 		std::swap(teamStats, r.teamStats);
 		std::swap(winningAllyTeams, r.winningAllyTeams);
+		std::swap(frameIndex, r.frameIndex);
+		std::swap(frameNum, r.frameNum);
 
 		std::swap(isServerDemo, r.isServerDemo);
 		return *this;
 	}
 
 
-	bool IsValid() const { return (file != nullptr); }
+	bool IsValid() const { return (file != nullptr || streamWriter != nullptr); }
 
 	void WriteSetupText(const std::string& text);
 	void SaveToDemo(const unsigned char* buf, const unsigned length, const float modGameTime);
@@ -68,14 +74,26 @@ private:
 	void WritePlayerStats();
 	void WriteTeamStats();
 	void WriteWinnerList();
+	void WriteFrameIndex();
 	void WriteDemoFile();
+	void FlushDemoChunk();
 
 private:
 	gzFile file = nullptr;
 
+	/// non-null iff the demo is streamed to disk in chunks while recording
+	CDemoStreamWriter* streamWriter = nullptr;
+
+	float chunkStartTime = 0.0f;
+	/// DemoStreamInterval, read once per demo
+	int streamInterval = 0;
+
 	std::vector<PlayerStatistics> playerStats;
 	std::vector< std::vector<TeamStatistics> > teamStats;
 	std::vector<unsigned char> winningAllyTeams;
+	std::vector<DemoFrameIndexEntry> frameIndex;
+
+	int frameNum = 0;
 
 	bool isServerDemo = false;
 };
@@ -40,6 +40,8 @@
  *         CTeam::Statistics for each team.
  *       - Array of all CTeam::Statistics (total number of items is the
  *         sum of the elements in the array of dwords).
+ *     - Frame index (optional, see DemoFrameIndexHeader)
+ *     - Chunk index (streamed demos only, see DemoChunkIndexTrailer)
  *
  * The header is designed to be extensible: it contains a version field and a
  * headerSize field to support this. The version field is a major version number
@@ -115,6 +117,104 @@ struct DemoStreamChunkHeader
 	}
 };
 
+/** The first 16 bytes of a DemoFrameIndexHeader. */
+#define DEMOFILE_FRAME_INDEX_MAGIC "spring frameidx"
+
+/**
+ * @brief Spring demo frame index header
+ *
+ * Directly follows the team statistics if present, i.e. it starts at offset
+ * headerSize + scriptSize + demoStreamSize + winningAllyTeamsSize +
+ * playerStatSize + teamStatSize of the decompressed data, and is followed by
+ * numEntries DemoFrameIndexEntry's sorted by frame. Lets readers jump to any
+ * (indexed) frame of the demo stream without parsing the packets before it.
+ */
+struct DemoFrameIndexHeader
+{
+	char magic[16];             ///< DEMOFILE_FRAME_INDEX_MAGIC
+	int numEntries;             ///< Number of DemoFrameIndexEntry's.
+	int frameInterval;          ///< Number of sim frames between entries.
+
+	/// Change structure from host endian to little endian or vice versa.
+	void swab() {
+		swabDWordInPlace(numEntries);
+		swabDWordInPlace(frameInterval);
+	}
+};
+
+/**
+ * @brief Spring demo frame index entry
+ *
+ * Marks the DemoStreamChunkHeader of the NETMSG_NEWFRAME or NETMSG_KEYFRAME
+ * packet that starts a sim frame.
+ */
+struct DemoFrameIndexEntry
+{
+	int frameNum;               ///< Frame started by the packet.
+	std::uint32_t streamOffset; ///< Offset of the packet's chunk header, relative to the start of the demo stream.
+	float modGameTime;          ///< Gametime at which the packet was written.
+
+	/// Change structure from host endian to little endian or vice versa.
+	void swab() {
+		swabDWordInPlace(frameNum);
+		swabDWordInPlace(streamOffset);
+		swabFloatInPlace(modGameTime);
+	}
+};
+
+/** The first 16 bytes of a DemoChunkIndexTrailer. */
+#define DEMOFILE_INDEX_MAGIC "spring demo idx"
+
+/**
+ * @brief Spring demo chunk index entry
+ *
+ * Streamed demos are written to disk while recording, as a sequence of
+ * concatenated gzip members: one holding only the DemoFileHeader, then one
+ * per chunk of data (startscript, demo stream and statistics), each of which
+ * can be decompressed on its own. Since zlib decompresses concatenated members
+ * as one stream, readers that do not know about the index see a regular demo
+ * with some trailing data after the team statistics.
+ */
+struct DemoChunkIndexEntry
+{
+	std::uint64_t fileOffset;   ///< Offset of the chunk's gzip member in the compressed file.
+	std::uint32_t dataOffset;   ///< Offset of the chunk's first byte in the decompressed data.
+	std::uint32_t dataSize;     ///< Decompressed size of the chunk.
+
+	/// Change structure from host endian to little endian or vice versa.
+	void swab() {
+		swab64InPlace(fileOffset);
+		swabDWordInPlace(dataOffset);
+		swabDWordInPlace(dataSize);
+	}
+};
+
+/**
+ * @brief Spring demo chunk index trailer
+ *
+ * Follows the numChunks DemoChunkIndexEntry's at the end of a streamed demo.
+ * The entries are written as one gzip member at indexOffset, the trailer as a
+ * final member of DEMOFILE_INDEX_TRAILER_SIZE bytes containing one uncompressed
+ * (stored) deflate block, so it can be found by seeking from the end of file.
+ */
+struct DemoChunkIndexTrailer
+{
+	char magic[16];             ///< DEMOFILE_INDEX_MAGIC
+	std::uint64_t indexOffset;  ///< Offset of the gzip member holding the entries.
+	std::uint32_t numChunks;    ///< Number of DemoChunkIndexEntry's.
+	std::uint32_t padding;
+
+	/// Change structure from host endian to little endian or vice versa.
+	void swab() {
+		swab64InPlace(indexOffset);
+		swabDWordInPlace(numChunks);
+	}
+};
+
 #pragma pack(pop)
 
+/** Size of a gzip member holding <size> bytes in one stored deflate block. */
+#define DEMOFILE_STORED_MEMBER_SIZE(size) (10 + 5 + (size) + 8)
+#define DEMOFILE_INDEX_TRAILER_SIZE DEMOFILE_STORED_MEMBER_SIZE(sizeof(DemoChunkIndexTrailer))
+
 #endif // DEMO_FILE_H
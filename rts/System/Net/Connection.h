@@ -64,6 +64,8 @@ public:
 	unsigned int GetDataReceived() const { return dataRecv; }
 	unsigned int GetNumQueuedPings() const { return numPings; }
 	virtual unsigned int GetPacketQueueSize() const { return 0; }
+	/// number of packets handed to SendData but not yet sent
+	virtual unsigned int GetOutgoingQueueSize() const { return 0; }
 
 	virtual std::string Statistics() const = 0;
 	virtual std::string GetFullAddress() const = 0;
@@ -0,0 +1,119 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "EventWaiter.h"
+#include "Socket.h"
+
+#include <atomic>
+
+#include <asio/post.hpp>
+
+
+namespace netcode {
+
+// shared with the completion handlers, which can outlive the waiter
+// (a cancelled wait still completes, with operation_aborted, later)
+struct EventWaiter::State {
+	// handlers only run on the thread calling Wait
+	void Wakeup() {
+		if (woken)
+			return;
+
+		wakeTime = spring_gettime();
+		woken = true;
+	}
+
+	std::atomic<bool> woken{false};
+	spring_time wakeTime;
+	std::vector<bool> armed; // one per socket, whether a read-wait is pending
+};
+
+
+EventWaiter::EventWaiter()
+	: state(std::make_shared<State>())
+	, timer(netservice)
+{
+}
+
+EventWaiter::~EventWaiter()
+{
+	RemoveSockets();
+	timer.cancel();
+}
+
+
+void EventWaiter::AddSocket(asio::ip::udp::socket* socket)
+{
+	sockets.push_back(socket);
+	state->armed.push_back(false);
+}
+
+void EventWaiter::RemoveSockets()
+{
+	for (asio::ip::udp::socket* socket: sockets) {
+		asio::error_code err;
+		socket->cancel(err);
+	}
+
+	// handlers of cancelled waits only clear their flag, never touch the socket
+	sockets.clear();
+	state->armed.clear();
+}
+
+
+spring_time EventWaiter::Wait(spring_time deadline)
+{
+	const spring_time waitTime = deadline - spring_gettime();
+
+	// the io_service stops whenever it runs out of work, e.g. in a poll()
+	netservice.restart();
+
+	for (size_t i = 0; i < sockets.size(); i++) {
+		if (state->armed[i])
+			continue;
+
+		state->armed[i] = true;
+
+		sockets[i]->async_wait(asio::ip::udp::socket::wait_read, [s = state, i](const asio::error_code& err) {
+			if (i < s->armed.size())
+				s->armed[i] = false;
+
+			if (!err)
+				s->Wakeup();
+		});
+	}
+
+	// collect what was already pending (datagrams, Wake's) before blocking
+	netservice.poll();
+
+	if (state->woken) {
+		state->woken = false;
+		return spring_notime;
+	}
+
+	// poll() stops the io_service if it found no work (no sockets added)
+	netservice.restart();
+
+	if (waitTime.toMicroSecsi() > 0) {
+		timer.expires_after(std::chrono::microseconds(waitTime.toMicroSecsi()));
+		timer.async_wait([s = state](const asio::error_code& err) {
+			if (!err)
+				s->Wakeup();
+		});
+
+		while (!state->woken)
+			netservice.run_one();
+	} else {
+		// deadline already passed, nothing more to wait for
+		state->Wakeup();
+	}
+
+	state->woken = false;
+	return state->wakeTime;
+}
+
+void EventWaiter::Wake()
+{
+	asio::post(netservice, [s = state]() { s->Wakeup(); });
+}
+
+}
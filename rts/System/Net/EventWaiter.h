@@ -0,0 +1,56 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _EVENT_WAITER_H
+#define _EVENT_WAITER_H
+
+#include <memory>
+#include <vector>
+
+#include <asio/ip/udp.hpp>
+#include <asio/steady_timer.hpp>
+
+#include "System/Misc/NonCopyable.h"
+#include "System/Misc/SpringTime.h"
+
+namespace netcode
+{
+
+/**
+ * @brief Lets a network thread sleep until there is something to do
+ * Blocks in Wait() until one of the watched sockets becomes readable,
+ * the given deadline passes, or another thread calls Wake(), instead
+ * of polling the sockets after a fixed sleep.
+ * Wait() must always be called from the same thread, Wake() from any.
+ */
+class EventWaiter : spring::noncopyable
+{
+public:
+	EventWaiter();
+	~EventWaiter();
+
+	/// sockets must outlive the waiter, or be removed by RemoveSockets first
+	void AddSocket(asio::ip::udp::socket* socket);
+	void RemoveSockets();
+
+	/**
+	 * @brief Block until a socket is readable, <deadline> or Wake()
+	 * Wakeups are never lost: a Wake() or datagram that arrives while the
+	 * caller is busy makes the next Wait() return immediately.
+	 * @return time the wakeup happened, or spring_notime if one was already
+	 *   pending on entry (it happened at some earlier, unknown time)
+	 */
+	spring_time Wait(spring_time deadline);
+	void Wake();
+
+private:
+	struct State;
+
+	std::shared_ptr<State> state;
+	std::vector<asio::ip::udp::socket*> sockets;
+
+	asio::steady_timer timer;
+};
+
+}
+
+#endif // _EVENT_WAITER_H
@@ -0,0 +1,198 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "UDPBatchIO.h"
+#include "Socket.h"
+#include "System/Log/ILog.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+	#include <sys/socket.h>
+	#include <cerrno>
+	#include <cstring>
+#endif
+
+
+namespace netcode
+{
+
+#ifdef __linux__
+// same errors CheckErrorCode ignores
+static bool CheckErrno(int err, const char* caller)
+{
+	if (err == EAGAIN || err == EWOULDBLOCK || err == ECONNREFUSED)
+		return false;
+
+	LOG_L(L_WARNING, "[UDPBatchIO::%s] network error %i: %s", caller, err, strerror(err));
+	return true;
+}
+#endif
+
+
+bool UDPBatchIO::IsSupported()
+{
+#ifdef __linux__
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+UDPBatchIO::UDPBatchIO(std::shared_ptr<asio::ip::udp::socket> socket_): socket(socket_)
+{
+	pending.reserve(BATCH_SIZE);
+	sendData.reserve(BATCH_SIZE * 1500);
+	recvData.resize(BATCH_SIZE * MAX_DATAGRAM_SIZE);
+}
+
+UDPBatchIO::~UDPBatchIO()
+{
+	Flush();
+}
+
+
+void UDPBatchIO::Send(const std::vector<std::uint8_t>& data, const asio::ip::udp::endpoint& addr)
+{
+	pending.push_back({sendData.size(), data.size(), addr});
+	sendData.insert(sendData.end(), data.begin(), data.end());
+
+	// keep the queue bounded, one full syscall worth is as good as it gets
+	if (!batching || pending.size() >= BATCH_SIZE)
+		Flush();
+}
+
+void UDPBatchIO::Flush()
+{
+	if (pending.empty())
+		return;
+
+#ifdef __linux__
+	mmsghdr msgs[BATCH_SIZE];
+	iovec iovs[BATCH_SIZE];
+
+	for (size_t i = 0, n = pending.size(); i < n; ) {
+		const size_t count = std::min(n - i, size_t(BATCH_SIZE));
+
+		memset(msgs, 0, sizeof(msgs[0]) * count);
+
+		for (size_t j = 0; j < count; j++) {
+			Datagram& dg = pending[i + j];
+
+			iovs[j].iov_base = &sendData[dg.offset];
+			iovs[j].iov_len = dg.size;
+
+			msgs[j].msg_hdr.msg_name = dg.addr.data();
+			msgs[j].msg_hdr.msg_namelen = dg.addr.size();
+			msgs[j].msg_hdr.msg_iov = &iovs[j];
+			msgs[j].msg_hdr.msg_iovlen = 1;
+		}
+
+		const int ret = sendmmsg(socket->native_handle(), msgs, count, MSG_DONTWAIT);
+
+		numSendCalls += 1;
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			// sendmmsg reports the error of the first datagram it could not send;
+			// drop that one (as a failed send_to would) and carry on with the rest
+			CheckErrno(errno, __func__);
+			i += 1;
+			continue;
+		}
+
+		numSent += ret;
+		i += ret;
+	}
+#else
+	for (const Datagram& dg: pending) {
+		asio::error_code err;
+		socket->send_to(asio::buffer(&sendData[dg.offset], dg.size), dg.addr, 0, err);
+
+		numSendCalls += 1;
+		numSent += (!CheckErrorCode(err));
+	}
+#endif
+
+	pending.clear();
+	sendData.clear();
+}
+
+
+size_t UDPBatchIO::Receive(const RecvFunc& func)
+{
+	size_t count = 0;
+
+#ifdef __linux__
+	mmsghdr msgs[BATCH_SIZE];
+	iovec iovs[BATCH_SIZE];
+	asio::ip::udp::endpoint addrs[BATCH_SIZE];
+
+	while (true) {
+		memset(msgs, 0, sizeof(msgs));
+
+		for (size_t j = 0; j < BATCH_SIZE; j++) {
+			iovs[j].iov_base = &recvData[j * MAX_DATAGRAM_SIZE];
+			iovs[j].iov_len = MAX_DATAGRAM_SIZE;
+
+			msgs[j].msg_hdr.msg_name = addrs[j].data();
+			msgs[j].msg_hdr.msg_namelen = addrs[j].capacity();
+			msgs[j].msg_hdr.msg_iov = &iovs[j];
+			msgs[j].msg_hdr.msg_iovlen = 1;
+		}
+
+		const int ret = recvmmsg(socket->native_handle(), msgs, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+
+		numRecvCalls += 1;
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			CheckErrno(errno, __func__);
+			break;
+		}
+
+		for (int j = 0; j < ret; j++) {
+			// truncated, would not pass the checksum anyway
+			if ((msgs[j].msg_hdr.msg_flags & MSG_TRUNC) != 0)
+				continue;
+
+			addrs[j].resize(msgs[j].msg_hdr.msg_namelen);
+			func(&recvData[j * MAX_DATAGRAM_SIZE], msgs[j].msg_len, addrs[j]);
+		}
+
+		numReceived += ret;
+		count += ret;
+
+		// socket drained
+		if (ret < int(BATCH_SIZE))
+			break;
+	}
+#else
+	size_t bytesAvailable = 0;
+
+	while ((bytesAvailable = socket->available()) > 0) {
+		asio::ip::udp::endpoint sender;
+		asio::error_code err;
+
+		const size_t bytesReceived = socket->receive_from(asio::buffer(recvData), sender, 0, err);
+
+		numRecvCalls += 1;
+
+		if (CheckErrorCode(err))
+			break;
+
+		func(recvData.data(), bytesReceived, sender);
+
+		numReceived += 1;
+		count += 1;
+	}
+#endif
+
+	return count;
+}
+
+}
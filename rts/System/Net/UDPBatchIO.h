@@ -0,0 +1,81 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _UDP_BATCH_IO_H
+#define _UDP_BATCH_IO_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <asio/ip/udp.hpp>
+
+#include "System/Misc/NonCopyable.h"
+
+namespace netcode
+{
+
+/**
+ * @brief Batched datagram I/O on a (shared) UDP socket
+ * Between BeginBatch() and EndBatch(), datagrams handed to Send() are
+ * queued and then written with as few sendmmsg calls as possible; outside
+ * of a batch they go out immediately. Receive() drains the socket with
+ * recvmmsg. On platforms without these calls, both fall back to one
+ * send_to / receive_from per datagram.
+ */
+class UDPBatchIO : spring::noncopyable
+{
+public:
+	/// datagrams per sendmmsg / recvmmsg call
+	static constexpr unsigned int BATCH_SIZE = 64;
+	/// larger incoming datagrams are dropped, same as UDPConnection's limit
+	static constexpr unsigned int MAX_DATAGRAM_SIZE = 4096;
+
+	typedef std::function<void(const std::uint8_t* data, size_t size, const asio::ip::udp::endpoint& sender)> RecvFunc;
+
+	/// true if the platform has sendmmsg / recvmmsg
+	static bool IsSupported();
+
+	UDPBatchIO(std::shared_ptr<asio::ip::udp::socket> socket);
+	~UDPBatchIO();
+
+	void BeginBatch() { batching = true; }
+	void EndBatch() { batching = false; Flush(); }
+
+	/// copies <data>, so the caller may reuse its buffer right away
+	void Send(const std::vector<std::uint8_t>& data, const asio::ip::udp::endpoint& addr);
+	void Flush();
+
+	/// calls <func> for each datagram waiting on the socket
+	size_t Receive(const RecvFunc& func);
+
+	size_t GetNumSent() const { return numSent; }
+	size_t GetNumSendCalls() const { return numSendCalls; }
+	size_t GetNumReceived() const { return numReceived; }
+	size_t GetNumRecvCalls() const { return numRecvCalls; }
+
+private:
+	struct Datagram {
+		size_t offset;
+		size_t size;
+		asio::ip::udp::endpoint addr;
+	};
+
+	std::shared_ptr<asio::ip::udp::socket> socket;
+
+	/// queued outgoing datagrams, payloads packed back to back in sendData
+	std::vector<Datagram> pending;
+	std::vector<std::uint8_t> sendData;
+	std::vector<std::uint8_t> recvData;
+
+	size_t numSent = 0;
+	size_t numSendCalls = 0;
+	size_t numReceived = 0;
+	size_t numRecvCalls = 0;
+
+	bool batching = false;
+};
+
+}
+
+#endif // _UDP_BATCH_IO_H
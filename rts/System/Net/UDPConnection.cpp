@@ -7,6 +7,7 @@
 
 #include "Socket.h"
 #include "ProtocolDef.h"
+#include "UDPBatchIO.h"
 #include "Exception.h"
 #include "Net/Protocol/BaseNetProtocol.h"
 #include "System/Config/ConfigHandler.h"
@@ -96,9 +97,10 @@ public:
 		pos += sizeof(t);
 	}
 
-	void Unpack(std::vector<std::uint8_t>& t, unsigned unpackLength) {
-		std::copy(data + pos, data + pos + unpackLength, std::back_inserter(t));
-		pos += unpackLength;
+	const unsigned char* Skip(unsigned skipLength) {
+		const unsigned char* ptr = data + pos;
+		pos += skipLength;
+		return ptr;
 	}
 
 	unsigned Remaining() const {
@@ -119,14 +121,14 @@ public:
 	}
 
 	template<typename T>
-	void Pack(T& t) {
+	void Pack(const T& t) {
 		const size_t pos = data.size();
 		data.resize(pos + sizeof(T));
 		*reinterpret_cast<T*>(&data[pos]) = t;
 	}
 
-	void Pack(std::vector<std::uint8_t>& _data) {
-		std::copy(_data.begin(), _data.end(), std::back_inserter(data));
+	void Pack(const std::uint8_t* _data, size_t size) {
+		data.insert(data.end(), _data, _data + size);
 	}
 
 private:
@@ -135,20 +137,22 @@ private:
 
 
 
-void Chunk::UpdateChecksum(CRC& crc) const {
+void ChunkRef::UpdateChecksum(CRC& crc) const {
 
 	crc << chunkNumber;
 	crc << (unsigned int)chunkSize;
 
-	if (!data.empty()) {
-		crc.Update(&data[0], data.size());
+	if (chunkSize > 0) {
+		crc.Update(data, chunkSize);
 	}
 }
 
 
 
-Packet::Packet(const unsigned char* data, unsigned length)
+void Packet::Parse(const unsigned char* data, unsigned length)
 {
+	Reset(-1, 0);
+
 	Unpacker buf(data, length);
 	buf.Unpack(lastContinuous);
 	buf.Unpack(nakType);
@@ -168,18 +172,18 @@ Packet::Packet(const unsigned char* data, unsigned length)
 		}
 	}
 
-	chunks.reserve(buf.Remaining() / Chunk::headerSize);
+	chunks.reserve(buf.Remaining() / ChunkRef::headerSize);
 
-	while (buf.Remaining() > Chunk::headerSize) {
-		ChunkPtr temp(new Chunk);
-		buf.Unpack(temp->chunkNumber);
-		buf.Unpack(temp->chunkSize);
+	while (buf.Remaining() > ChunkRef::headerSize) {
+		ChunkRef temp;
+		buf.Unpack(temp.chunkNumber);
+		buf.Unpack(temp.chunkSize);
 
 		// defective, ignore
-		if (buf.Remaining() < temp->chunkSize)
+		if (buf.Remaining() < temp.chunkSize)
 			break;
 
-		buf.Unpack(temp->data, temp->chunkSize);
+		temp.data = buf.Skip(temp.chunkSize);
 		chunks.push_back(temp);
 	}
 }
@@ -189,8 +193,8 @@ unsigned Packet::GetSize() const
 {
 	unsigned size = headerSize + naks.size();
 
-	for (auto chk = chunks.begin(); chk != chunks.end(); ++chk)
-		size += (*chk)->GetSize();
+	for (const ChunkRef& chk: chunks)
+		size += chk.GetSize();
 
 	return size;
 }
@@ -204,8 +208,8 @@ std::uint8_t Packet::GetChecksum() const
 	if (!naks.empty())
 		crc.Update(&naks[0], naks.size());
 
-	for (auto chk = chunks.begin(); chk != chunks.end(); ++chk)
-		(*chk)->UpdateChecksum(crc);
+	for (const ChunkRef& chk: chunks)
+		chk.UpdateChecksum(crc);
 
 	return (std::uint8_t)crc.GetDigest();
 }
@@ -219,22 +223,23 @@ void Packet::Serialize(std::vector<std::uint8_t>& data)
 	buf.Pack(lastContinuous);
 	buf.Pack(nakType);
 	buf.Pack(checksum);
-	buf.Pack(naks);
+	buf.Pack(naks.data(), naks.size());
 
-	for (auto ci = chunks.begin(); ci != chunks.end(); ++ci) {
-		buf.Pack((*ci)->chunkNumber);
-		buf.Pack((*ci)->chunkSize);
-		buf.Pack((*ci)->data);
+	for (const ChunkRef& chk: chunks) {
+		buf.Pack(chk.chunkNumber);
+		buf.Pack(chk.chunkSize);
+		buf.Pack(chk.data, chk.chunkSize);
 	}
 }
 
 
 
 
-UDPConnection::UDPConnection(std::shared_ptr<ip::udp::socket> netSocket, const ip::udp::endpoint& myAddr)
+UDPConnection::UDPConnection(std::shared_ptr<ip::udp::socket> netSocket, const ip::udp::endpoint& myAddr, std::shared_ptr<UDPBatchIO> netBatchIO)
 	: addr(myAddr)
 	, sharedSocket(true)
 	, mySocket(netSocket)
+	, batchIO(netBatchIO)
 {
 	Init();
 }
@@ -287,6 +292,9 @@ void UDPConnection::Init()
 	erasedResendChunks.clear();
 	erasedResendChunks.reserve(256);
 
+	outgoingChunks.Clear();
+	outgoingOffset = 0;
+
 	#ifdef ENABLE_DEBUG_STATS
 	sumDeltaFramePacketRecvTime = 0.0f;
 	minDeltaFramePacketRecvTime = 0.0f;
@@ -316,6 +324,8 @@ void UDPConnection::Init()
 
 	#ifndef UNIT_TEST
 	logMessages = configHandler->GetBool("UDPConnectionLogDebugMessages");
+	#else
+	logMessages = false;
 	#endif
 
 	netLossFactor = globalConfig.networkLossFactor;
@@ -330,17 +340,18 @@ void UDPConnection::ReconnectTo(CConnection& conn) {
 }
 
 void UDPConnection::CopyConnection(UDPConnection &conn) {
-	conn.InitConnection(addr, mySocket);
+	conn.InitConnection(addr, mySocket, batchIO);
 }
 
-void UDPConnection::InitConnection(ip::udp::endpoint address, std::shared_ptr<ip::udp::socket> socket) {
+void UDPConnection::InitConnection(ip::udp::endpoint address, std::shared_ptr<ip::udp::socket> socket, std::shared_ptr<UDPBatchIO> socketBatchIO) {
 	addr = address;
 	mySocket = socket;
+	batchIO = socketBatchIO;
 }
 
 UDPConnection::~UDPConnection()
 {
-	fragmentBuffer.Delete();
+	fragmentBuffer.clear();
 	waitingPackets.clear();
 
 	Flush(true);
@@ -459,10 +470,10 @@ void UDPConnection::Update()
 			if (bytesReceived < Packet::headerSize)
 				continue;
 
-			Packet data(&recvBuffer[0], bytesReceived);
+			recvPacket.Parse(&recvBuffer[0], bytesReceived);
 
 			if (IsUsingAddress(udpEndPoint))
-				ProcessRawPacket(data);
+				ProcessRawPacket(recvPacket);
 
 			// not likely, but make sure we do not get stuck here
 			if ((spring_gettime() - curTime) > spring_msecs(10)) {
@@ -479,7 +490,7 @@ void UDPConnection::UpdateWaitingPackets()
 {
 	const auto beg = waitingPackets.begin();
 	const auto end = waitingPackets.end();
-	const auto pos = std::remove_if(beg, end, [](const std::pair<int, RawPacket>& p) { return ((p.second).length == 0); });
+	const auto pos = std::remove_if(beg, end, [&](const Chunk& c) { return (c.chunkNumber <= lastInOrder); });
 
 	// erase processed packets
 	waitingPackets.erase(pos, end);
@@ -487,28 +498,21 @@ void UDPConnection::UpdateWaitingPackets()
 
 void UDPConnection::UpdateResendRequests()
 {
-	using P = decltype(resendRequested)::value_type;
-
-	const auto cmpPred = [](const P& a, const P& b) { return (a.first <  b.first); };
-	const auto dupPred = [](const P& a, const P& b) { return (a.first == b.first); };
-
 	// sort by chunk-number
-	std::sort(resendRequested.begin(), resendRequested.end(), cmpPred);
+	std::sort(resendRequested.begin(), resendRequested.end());
 
 	{
 		const auto beg = resendRequested.begin();
 		const auto end = resendRequested.end();
-		const auto iter = std::unique(beg, end, dupPred);
+		const auto iter = std::unique(beg, end);
 
 		// filter duplicates
 		resendRequested.erase(iter, end);
 	}
 
-	if (erasedResendChunks.empty())
-		return;
-
 	{
-		const auto pred = [&](const std::pair<std::int32_t, ChunkPtr>& p) { return (erasedResendChunks.find(p.first) != erasedResendChunks.end()); };
+		// acked chunks are no longer stored, so they can not be resent anyway
+		const auto pred = [&](std::int32_t n) { return (outgoingChunks.FindUnacked(n) == nullptr || erasedResendChunks.find(n) != erasedResendChunks.end()); };
 
 		const auto beg = resendRequested.begin();
 		const auto end = resendRequested.end();
@@ -542,7 +546,7 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 	}
 
 	if (incoming.lastContinuous < 0 && lastInOrder >= 0 &&
-		(unackedChunks.empty() || unackedChunks[0]->chunkNumber > 0)) {
+		(outgoingChunks.NumUnacked() == 0 || outgoingChunks.GetUnacked(0).chunkNumber > 0)) {
 		LOG_L(L_WARNING, "\t[%s] discarding superfluous reconnection attempt", __func__);
 		return;
 	}
@@ -551,18 +555,18 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 	AckChunks(incoming.lastContinuous);
 	UpdateResendRequests();
 
-	if (!unackedChunks.empty()) {
+	if (outgoingChunks.NumUnacked() > 0) {
 		const int nextCont = incoming.lastContinuous + 1;
-		const int unAckDiff = unackedChunks[0]->chunkNumber - nextCont;
+		const int unAckDiff = outgoingChunks.GetUnacked(0).chunkNumber - nextCont;
 
 		if (-256 <= unAckDiff && unAckDiff <= 256) {
 			if (incoming.nakType < 0) {
 				for (int i = 0; i != -incoming.nakType; ++i) {
 					const int unAckPos = i + unAckDiff;
 
-					if (unAckPos >= 0 && unAckPos < unackedChunks.size()) {
-						assert(unackedChunks[unAckPos]->chunkNumber == nextCont + i);
-						RequestResend(unackedChunks[unAckPos], true);
+					if (unAckPos >= 0 && unAckPos < outgoingChunks.NumUnacked()) {
+						assert(outgoingChunks.GetUnacked(unAckPos).chunkNumber == nextCont + i);
+						RequestResend(nextCont + i, true);
 					}
 				}
 			} else if (incoming.nakType > 0) {
@@ -574,15 +578,15 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 
 					while (unAckPos < (unAckDiff + incoming.naks[i])) {
 						// if there are gaps in the array, assume that further resends are not needed
-						if (unAckPos < unackedChunks.size())
-							erasedResendChunks.insert(unackedChunks[unAckPos]->chunkNumber);
+						if (unAckPos < outgoingChunks.NumUnacked())
+							erasedResendChunks.insert(outgoingChunks.GetUnacked(unAckPos).chunkNumber);
 
 						++unAckPos;
 					}
 
-					if (unAckPos < unackedChunks.size()) {
-						assert(unackedChunks[unAckPos]->chunkNumber == (nextCont + incoming.naks[i]));
-						RequestResend(unackedChunks[unAckPos], true);
+					if (unAckPos < outgoingChunks.NumUnacked()) {
+						assert(outgoingChunks.GetUnacked(unAckPos).chunkNumber == (nextCont + incoming.naks[i]));
+						RequestResend(outgoingChunks.GetUnacked(unAckPos).chunkNumber, true);
 					}
 
 					++unAckPos;
@@ -594,43 +598,34 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 	}
 
 
-	for (const std::shared_ptr<netcode::Chunk>& c: incoming.chunks) {
-		if ((lastInOrder >= c->chunkNumber) || incomingChunkNums.find(c->chunkNumber) != incomingChunkNums.end()) {
+	for (const ChunkRef& c: incoming.chunks) {
+		if ((lastInOrder >= c.chunkNumber) || incomingChunkNums.find(c.chunkNumber) != incomingChunkNums.end()) {
 			++droppedChunks;
 			continue;
 		}
 
-		waitingPackets.emplace_back(c->chunkNumber, std::move(RawPacket(&c->data[0], c->data.size())));
-		incomingChunkNums.insert(c->chunkNumber);
+		// copied out of the datagram, since it might have to wait for earlier chunks
+		waitingPackets.emplace_back();
+		waitingPackets.back().Assign(c.chunkNumber, c.data, c.chunkSize);
+		incomingChunkNums.insert(c.chunkNumber);
 	}
 
 
-	using P = decltype(waitingPackets)::value_type;
-
-	const auto cmpPred = [](const P& a, const P& b) { return (a.first < b.first); };
-	const auto binFind = [&](int cn) { return std::lower_bound(waitingPackets.begin(), waitingPackets.end(), P{cn, RawPacket{}}, cmpPred); };
-
-	std::sort(waitingPackets.begin(), waitingPackets.end(), cmpPred);
+	const auto cmpPred = [](const Chunk& a, const Chunk& b) { return (a.chunkNumber < b.chunkNumber); };
 
-	// process all in-order packets that we have waiting
-	for (auto wpi = binFind(lastInOrder + 1); wpi != waitingPackets.end() && wpi->first == (lastInOrder + 1); ++wpi) {
-		waitBuffer.clear();
+	// usually sorted already, chunks tend to arrive in order
+	if (!std::is_sorted(waitingPackets.begin(), waitingPackets.end(), cmpPred))
+		std::sort(waitingPackets.begin(), waitingPackets.end(), cmpPred);
 
-		if (fragmentBuffer.data != nullptr) {
-			// combine with fragment buffer (packet reassembly)
-			waitBuffer.resize(fragmentBuffer.length);
-			waitBuffer.assign(fragmentBuffer.data, fragmentBuffer.data + fragmentBuffer.length);
+	// process all in-order packets that we have waiting; all of them are newer
+	// than lastInOrder, so the next expected one can only be at the front
+	for (auto wpi = waitingPackets.begin(); wpi != waitingPackets.end() && wpi->chunkNumber == (lastInOrder + 1); ++wpi) {
+		// combine with fragment buffer (packet reassembly)
+		waitBuffer.swap(fragmentBuffer);
+		waitBuffer.insert(waitBuffer.end(), wpi->data, wpi->data + wpi->chunkSize);
+		fragmentBuffer.clear();
 
-			fragmentBuffer.Delete();
-		}
-
-		std::copy(wpi->second.data, wpi->second.data + wpi->second.length, std::back_inserter(waitBuffer));
-
-		incomingChunkNums.erase(wpi->first);
-		// waitingPackets.erase(wpi);
-
-		// mark as processed
-		(wpi->second).Delete();
+		incomingChunkNums.erase(wpi->chunkNumber);
 
 		// next expected chunk-number
 		lastInOrder++;
@@ -644,7 +639,7 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 
 			// this returns false for zero/invalid pktLength
 			if (ProtocolDef::GetInstance()->IsValidLength(pktLength, msgLength)) {
-				msgQueue.emplace_back(new RawPacket(bufp, pktLength));
+				msgQueue.emplace_back(std::make_shared<const RawPacket>(bufp, pktLength));
 				std::shared_ptr<const RawPacket>& msgPacket = msgQueue.back();
 
 				#ifdef ENABLE_DEBUG_STATS
@@ -677,7 +672,7 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 			} else {
 				if (pktLength >= 0) {
 					// partial packet in buffer
-					fragmentBuffer = std::move(RawPacket(bufp, msgLength));
+					fragmentBuffer.assign(bufp, bufp + msgLength);
 					break;
 				}
 
@@ -705,7 +700,8 @@ void UDPConnection::Flush(const bool forced)
 	// if the packet is tiny, reduce the send frequency further
 	const int requiredLength = ((200 >> netLossFactor) - spring_tomsecs(curTime - lastChunkCreatedTime)) / 10;
 
-	int outgoingLength = 0;
+	// part of the first packet may already be chunked
+	int outgoingLength = -int(outgoingOffset);
 
 	if (!waitMore) {
 		for (auto pi = outgoingData.begin(); (pi != outgoingData.end()) && (outgoingLength <= requiredLength); ++pi) {
@@ -730,29 +726,29 @@ void UDPConnection::Flush(const bool forced)
 			if (!outgoingData.empty() && sendMore) {
 				std::shared_ptr<const RawPacket>& packet = *(outgoingData.begin());
 
-				if (!partialPacket && !ProtocolDef::GetInstance()->IsValidPacket(packet->data, packet->length)) {
+				if (outgoingOffset == 0 && !ProtocolDef::GetInstance()->IsValidPacket(packet->data, packet->length)) {
 					LOG_L(L_ERROR,
 						"[UDPConnection::%s] discarding outgoing invalid packet: ID %d, LEN %d",
 						__func__, ((packet->length > 0) ? (int)packet->data[0] : -1), packet->length
 					);
 					outgoingData.pop_front();
 				} else {
-					const unsigned numBytes = std::min((unsigned)maxChunkSize - pos, packet->length);
+					const unsigned numBytes = std::min((unsigned)maxChunkSize - pos, packet->length - outgoingOffset);
 
 					assert(packet->length > 0);
-					memcpy(buffer + pos, packet->data, numBytes);
+					memcpy(buffer + pos, packet->data + outgoingOffset, numBytes);
 
 					pos += numBytes;
 					sentOverhead += Packet::headerSize;
 
 					outgoing.DataSent(numBytes, true);
 
-					if ((partialPacket = (numBytes != packet->length))) {
-						// partially transfered
-						packet.reset(new RawPacket(packet->data + numBytes, packet->length - numBytes));
+					if ((partialPacket = ((outgoingOffset += numBytes) != packet->length))) {
+						// partially transfered, rest goes into the next chunk
 					} else {
 						// full packet copied
 						outgoingData.pop_front();
+						outgoingOffset = 0;
 					}
 				}
 			}
@@ -835,11 +831,7 @@ void UDPConnection::SetMTU(unsigned mtu2)
 void UDPConnection::CreateChunk(const unsigned char* data, const unsigned length, const int packetNum)
 {
 	assert((length > 0) && (length < 255));
-	ChunkPtr buf(new Chunk);
-	buf->chunkNumber = packetNum;
-	buf->chunkSize = length;
-	std::copy(data, data + length, std::back_inserter(buf->data));
-	newChunks.push_back(buf);
+	outgoingChunks.Push(packetNum).Assign(packetNum, data, length);
 	lastChunkCreatedTime = spring_gettime();
 }
 
@@ -857,8 +849,8 @@ void UDPConnection::SendIfNecessary(bool flushed)
 	{
 		int packetNum = lastInOrder + 1;
 
-		for (const auto& pair: waitingPackets) {
-			const int diff = pair.first - packetNum;
+		for (const Chunk& chunk: waitingPackets) {
+			const int diff = chunk.chunkNumber - packetNum;
 
 			for (int i = 0; i < diff; ++i) {
 				droppedPackets.push_back(packetNum++);
@@ -890,20 +882,20 @@ void UDPConnection::SendIfNecessary(bool flushed)
 		}
 	}
 
-	if (!unackedChunks.empty() &&
+	if (outgoingChunks.NumUnacked() > 0 &&
 		(curTime - lastChunkCreatedTime) > unackTime &&
 		(curTime - lastUnackResentTime) > unackTime) {
 
 		// resend last packet if we didn't get an ack within reasonable time
 		// and don't plan sending out a new chunk either
-		if (newChunks.empty())
-			RequestResend(*unackedChunks.rbegin(), false);
+		if (outgoingChunks.NumNew() == 0)
+			RequestResend(outgoingChunks.GetUnacked(outgoingChunks.NumUnacked() - 1).chunkNumber, false);
 
 		lastUnackResentTime = curTime;
 	}
 
 
-	const bool flushSend = (flushed || !newChunks.empty());
+	const bool flushSend = (flushed || outgoingChunks.NumNew() > 0);
 	const bool otherSend = (UseMinLossFactor() && !resendRequested.empty());
 	const bool unackSend = (nak > 0) || (difTime > (unackTime * 0.5f));
 
@@ -911,7 +903,7 @@ void UDPConnection::SendIfNecessary(bool flushed)
 		return;
 
 	int maxResend = resendRequested.size();
-	int unackPrevSize = unackedChunks.size();
+	int unackPrevSize = outgoingChunks.NumUnacked();
 
 	decltype(resendRequested)::iterator resFwdIter = resendRequested.begin();
 	decltype(resendRequested)::iterator resMidIter;
@@ -919,9 +911,16 @@ void UDPConnection::SendIfNecessary(bool flushed)
 	decltype(resendRequested)::iterator resMidIterEnd;
 	decltype(resendRequested)::reverse_iterator resRevIter;
 
+	// all requests refer to unacked chunks, see UpdateResendRequests
+	const auto GetResendChunk = [&](std::int32_t chunkNumber) -> const Chunk& {
+		const Chunk* chunk = outgoingChunks.FindUnacked(chunkNumber);
+		assert(chunk != nullptr);
+		return *chunk;
+	};
+
 	// resend chunk size
 	const auto CalcResendSize = [&]() {
-		return ((UseMinLossFactor() || (rev == 0)) ? resFwdIter->second->GetSize() : ((rev == 1) ? resRevIter->second->GetSize() : resMidIter->second->GetSize()));
+		return GetResendChunk((UseMinLossFactor() || (rev == 0)) ? *resFwdIter : ((rev == 1) ? *resRevIter : *resMidIter)).GetSize();
 	};
 
 	if (!UseMinLossFactor()) {
@@ -938,22 +937,23 @@ void UDPConnection::SendIfNecessary(bool flushed)
 
 		std::advance(resMidIterStart, resMidStart);
 
-		if (resMidIterStart != resendRequested.end() && lastMidChunk < resMidIterStart->first)
-			lastMidChunk = resMidIterStart->first - 1;
+		if (resMidIterStart != resendRequested.end() && lastMidChunk < *resMidIterStart)
+			lastMidChunk = *resMidIterStart - 1;
 
 		std::advance(resMidIterEnd, -resMidEnd);
 
-		while (resMidIter != resendRequested.end() && resMidIter->first <= lastMidChunk) {
+		while (resMidIter != resendRequested.end() && *resMidIter <= lastMidChunk) {
 			++resMidIter;
 		}
 
-		if (resMidIter == resendRequested.end() || resMidIterEnd == resendRequested.end() || resMidIter->first >= resMidIterEnd->first)
+		if (resMidIter == resendRequested.end() || resMidIterEnd == resendRequested.end() || *resMidIter >= *resMidIterEnd)
 			resMidIter = resMidIterStart;
 	}
 
 
 	while (((outgoing.GetAverage() <= globalConfig.linkOutgoingBandwidth) || (globalConfig.linkOutgoingBandwidth <= 0))) {
-		Packet buf(lastInOrder, nak);
+		Packet& buf = sendPacket;
+		buf.Reset(lastInOrder, nak);
 
 		if (nak > 0) {
 			buf.naks.resize(nak);
@@ -972,7 +972,7 @@ void UDPConnection::SendIfNecessary(bool flushed)
 		while (true) {
 			// NB: if maxResend equals 0, then resendRequested is empty and iterators will be invalid
 			const bool canResend = (maxResend > 0) && ((buf.GetSize() + CalcResendSize()) <= mtu);
-			const bool canSendNew = !newChunks.empty() && ((buf.GetSize() + newChunks[0]->GetSize()) <= mtu);
+			const bool canSendNew = (outgoingChunks.NumNew() > 0) && ((buf.GetSize() + outgoingChunks.GetNew(0).GetSize()) <= mtu);
 
 			if (!canResend && !canSendNew)
 				break;
@@ -982,26 +982,26 @@ void UDPConnection::SendIfNecessary(bool flushed)
 
 			if (resend && canResend) {
 				if (UseMinLossFactor()) {
-					if (erasedResendChunks.find(resFwdIter->first) == erasedResendChunks.end())
-						buf.chunks.push_back(resFwdIter->second);
+					if (erasedResendChunks.find(*resFwdIter) == erasedResendChunks.end())
+						buf.chunks.push_back(GetResendChunk(*resFwdIter).GetRef());
 
-					erasedResendChunks.insert((resFwdIter++)->first);
+					erasedResendChunks.insert(*(resFwdIter++));
 				} else {
 					// on a lossy connection, just keep resending until it is acked
 					// alternate between sending from front, middle and back of requested
 					// chunks, since this improves performance on high latency connections
 					switch (rev) {
 						case 0: {
-							buf.chunks.push_back((resFwdIter++)->second);
+							buf.chunks.push_back(GetResendChunk(*(resFwdIter++)).GetRef());
 						} break;
 						case 1: {
-							buf.chunks.push_back((resRevIter++)->second);
+							buf.chunks.push_back(GetResendChunk(*(resRevIter++)).GetRef());
 						} break;
 						case 2:
 						case 3: {
-							buf.chunks.push_back(resMidIter->second);
+							buf.chunks.push_back(GetResendChunk(*resMidIter).GetRef());
 
-							lastMidChunk = resMidIter->first;
+							lastMidChunk = *resMidIter;
 
 							if ((++resMidIter) == resMidIterEnd)
 								resMidIter = resMidIterStart;
@@ -1016,9 +1016,8 @@ void UDPConnection::SendIfNecessary(bool flushed)
 
 				sent = true;
 			} else if (!resend && canSendNew) {
-				buf.chunks.push_back(newChunks[0]);
-				unackedChunks.push_back(newChunks[0]);
-				newChunks.pop_front();
+				buf.chunks.push_back(outgoingChunks.GetNew(0).GetRef());
+				outgoingChunks.MarkSent();
 				sent = true;
 			}
 		}
@@ -1028,7 +1027,7 @@ void UDPConnection::SendIfNecessary(bool flushed)
 
 		SendPacket(buf);
 
-		if (!sent || (maxResend == 0 && newChunks.empty()))
+		if (!sent || (maxResend == 0 && outgoingChunks.NumNew() == 0))
 			break;
 	}
 
@@ -1039,8 +1038,8 @@ void UDPConnection::SendIfNecessary(bool flushed)
 	}
 
 	// on a lossy connection chunks can be sent multiple times, see switch above
-	for (int i = unackPrevSize; i < unackedChunks.size(); ++i) {
-		RequestResend(unackedChunks[i], true);
+	for (int i = unackPrevSize; i < outgoingChunks.NumUnacked(); ++i) {
+		RequestResend(outgoingChunks.GetUnacked(i).chunkNumber, true);
 	}
 
 	UpdateResendRequests();
@@ -1057,7 +1056,12 @@ void UDPConnection::SendPacket(Packet& pkt)
 	asio::error_code err;
 
 	EMULATE_LATENCY( !EMULATE_PACKET_LOSS( LOSS_COUNTER ) ) {
-		mySocket->send_to(buffer(sendBuffer), addr, flags, err);
+		// errors are logged by the batcher, which may send this only later
+		if (batchIO != nullptr) {
+			batchIO->Send(sendBuffer, addr);
+		} else {
+			mySocket->send_to(buffer(sendBuffer), addr, flags, err);
+		}
 	}
 
 	if (CheckErrorCode(err))
@@ -1069,29 +1073,29 @@ void UDPConnection::SendPacket(Packet& pkt)
 
 void UDPConnection::AckChunks(int lastAck)
 {
-	while (!unackedChunks.empty() && (lastAck >= (*unackedChunks.begin())->chunkNumber)) {
-		unackedChunks.pop_front();
+	while (outgoingChunks.NumUnacked() > 0 && (lastAck >= outgoingChunks.GetUnacked(0).chunkNumber)) {
+		outgoingChunks.PopUnacked();
 	}
 
 	// resend requested and later acked, happens every now and then
 	for (size_t i = 0, n = resendRequested.size(); i < n; i++) {
-		if (lastAck < resendRequested[i].first)
+		if (lastAck < resendRequested[i])
 			break;
 
-		erasedResendChunks.insert(resendRequested[i].first);
+		erasedResendChunks.insert(resendRequested[i]);
 	}
 }
 
-void UDPConnection::RequestResend(ChunkPtr ptr, bool noSort)
+void UDPConnection::RequestResend(std::int32_t chunkNumber, bool noSort)
 {
-	resendRequested.emplace_back(ptr->chunkNumber, ptr);
+	resendRequested.push_back(chunkNumber);
 
 	if (noSort)
 		return;
 
 	// swap into position; duplicates are filtered out later
 	for (size_t i = resendRequested.size() - 1; i > 0; i--) {
-		if (resendRequested[i - 1].first < resendRequested[i].first)
+		if (resendRequested[i - 1] < resendRequested[i])
 			break;
 
 		std::swap(resendRequested[i - 1], resendRequested[i]);
@@ -4,6 +4,9 @@
 #define _UDP_CONNECTION_H
 
 #include <asio/ip/udp.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <memory>
 #include <deque>
 
@@ -16,6 +19,8 @@ class CRC;
 
 namespace netcode {
 
+class UDPBatchIO;
+
 // for reliability testing, introduce fake packet loss with a percentage probability
 #define NETWORK_TEST 0                        // in [0, 1] // enable network reliability testing mode
 #define PACKET_LOSS_FACTOR 50                 // in [0, 100)
@@ -26,44 +31,142 @@ namespace netcode {
 #define PACKET_MAX_LATENCY 1250               // in [milliseconds] maximum latency
 #define ENABLE_DEBUG_STATS
 
-class Chunk
+/**
+ * @brief Refers to a chunk stored elsewhere
+ * Either in a ChunkRing, or in the datagram it was received with.
+ */
+class ChunkRef
 {
 public:
-	unsigned GetSize() const { return (data.size() + headerSize); }
+	unsigned GetSize() const { return (chunkSize + headerSize); }
 	void UpdateChecksum(CRC& crc) const;
-	static constexpr unsigned maxSize = 254;
 	static constexpr unsigned headerSize = 5;
 	std::int32_t chunkNumber;
 	std::uint8_t chunkSize;
-	std::vector<std::uint8_t> data;
+	const std::uint8_t* data;
+};
+
+class Chunk
+{
+public:
+	void Assign(std::int32_t num, const std::uint8_t* buf, unsigned size) {
+		chunkNumber = num;
+		chunkSize = size;
+		std::memcpy(data, buf, size);
+	}
+
+	ChunkRef GetRef() const { return {chunkNumber, chunkSize, data}; }
+	unsigned GetSize() const { return (chunkSize + headerSize); }
+	static constexpr unsigned maxSize = 254;
+	static constexpr unsigned headerSize = ChunkRef::headerSize;
+	std::int32_t chunkNumber;
+	std::uint8_t chunkSize;
+	std::uint8_t data[maxSize];
+};
+
+
+/**
+ * @brief Outgoing chunks, stored in a ring indexed by chunk-number
+ * Chunks are numbered consecutively, sent in order and acked in order, so
+ * the ring holds the unacked chunks followed by those not sent yet. It only
+ * grows (by doubling) when full; once it is large enough for the connection,
+ * creating, sending and acking chunks never touches the heap.
+ */
+class ChunkRing
+{
+public:
+	void Clear() {
+		chunks.clear();
+		firstUnacked = 0;
+		firstNew = 0;
+		end = 0;
+	}
+
+	Chunk& Push(std::int32_t chunkNumber) {
+		assert(chunkNumber == end);
+
+		if ((end - firstUnacked) == std::int32_t(chunks.size()))
+			Grow();
+
+		return chunks[(end++) & (chunks.size() - 1)];
+	}
+
+	/// oldest new chunk becomes the newest unacked one
+	void MarkSent() { assert(NumNew() > 0); firstNew++; }
+	/// oldest unacked chunk is dropped
+	void PopUnacked() { assert(NumUnacked() > 0); firstUnacked++; }
+
+	size_t NumUnacked() const { return (firstNew - firstUnacked); }
+	size_t NumNew() const { return (end - firstNew); }
+
+	const Chunk& GetUnacked(size_t i) const { return chunks[(firstUnacked + i) & (chunks.size() - 1)]; }
+	const Chunk& GetNew(size_t i) const { return chunks[(firstNew + i) & (chunks.size() - 1)]; }
+
+	/// nullptr unless <chunkNumber> is sent but not yet acked
+	const Chunk* FindUnacked(std::int32_t chunkNumber) const {
+		if (chunkNumber < firstUnacked || chunkNumber >= firstNew)
+			return nullptr;
+
+		return &chunks[chunkNumber & (chunks.size() - 1)];
+	}
+
+private:
+	void Grow() {
+		std::vector<Chunk> newChunks(std::max(chunks.size() * 2, size_t(64)));
+
+		for (std::int32_t n = firstUnacked; n < end; n++) {
+			newChunks[n & (newChunks.size() - 1)] = chunks[n & (chunks.size() - 1)];
+		}
+
+		chunks.swap(newChunks);
+	}
+
+private:
+	/// power-of-two sized
+	std::vector<Chunk> chunks;
+
+	/// chunk-numbers of the first unacked, first new, and next to be created chunk
+	std::int32_t firstUnacked = 0;
+	std::int32_t firstNew = 0;
+	std::int32_t end = 0;
 };
-typedef std::shared_ptr<Chunk> ChunkPtr;
 
 
 class Packet
 {
 public:
 	static constexpr unsigned headerSize = 6;
-	Packet(const unsigned char* data, unsigned length);
-	Packet(int _lastCont, int _nakType) {
+	Packet() = default;
+	Packet(const unsigned char* data, unsigned length) { Parse(data, length); }
+	Packet(int _lastCont, int _nakType) { Reset(_lastCont, _nakType); }
+
+	/// reuses the naks and chunks buffers, so a long-lived Packet stops allocating
+	void Reset(int _lastCont, int _nakType) {
 		lastContinuous = _lastCont;
 		nakType = _nakType;
+		checksum = 0;
+
+		naks.clear();
+		chunks.clear();
 	}
 
+	/// chunks refer into <data> afterwards, which has to outlive them
+	void Parse(const unsigned char* data, unsigned length);
+
 	unsigned GetSize() const;
 
 	std::uint8_t GetChecksum() const;
 
 	void Serialize(std::vector<std::uint8_t>& data);
 
-	std::int32_t lastContinuous;
+	std::int32_t lastContinuous = -1;
 	/// if < 0, we lost -x packets since lastContinuous
 	/// if > 0, x = size of naks
-	std::int8_t nakType;
-	std::uint8_t checksum;
+	std::int8_t nakType = 0;
+	std::uint8_t checksum = 0;
 
 	std::vector<std::uint8_t> naks;
-	std::vector<ChunkPtr> chunks;
+	std::vector<ChunkRef> chunks;
 };
 
 
@@ -81,7 +184,7 @@ public:
 class UDPConnection : public CConnection
 {
 public:
-	UDPConnection(std::shared_ptr<asio::ip::udp::socket> netSocket, const asio::ip::udp::endpoint& myAddr);
+	UDPConnection(std::shared_ptr<asio::ip::udp::socket> netSocket, const asio::ip::udp::endpoint& myAddr, std::shared_ptr<UDPBatchIO> batchIO = nullptr);
 	UDPConnection(int sourceport, const std::string& address, const unsigned port);
 	UDPConnection(CConnection& conn);
 	~UDPConnection();
@@ -106,6 +209,7 @@ public:
 	bool NeedsReconnect() override;
 
 	unsigned int GetPacketQueueSize() const override { return msgQueue.size(); }
+	unsigned int GetOutgoingQueueSize() const override { return outgoingData.size(); }
 
 	std::string Statistics() const override;
 	std::string GetFullAddress() const override;
@@ -136,7 +240,8 @@ public:
 
 private:
 	void InitConnection(asio::ip::udp::endpoint address,
-			std::shared_ptr<asio::ip::udp::socket> socket);
+			std::shared_ptr<asio::ip::udp::socket> socket,
+			std::shared_ptr<UDPBatchIO> batchIO);
 
 	void CopyConnection(UDPConnection& conn);
 
@@ -149,7 +254,7 @@ private:
 	void SendIfNecessary(bool flushed);
 	void AckChunks(int lastAck);
 
-	void RequestResend(ChunkPtr ptr, bool noSort);
+	void RequestResend(std::int32_t chunkNumber, bool noSort);
 	void SendPacket(Packet& pkt);
 
 	void UpdateWaitingPackets();
@@ -185,18 +290,19 @@ private:
 
 	/// outgoing stuff (pure data without header) waiting to be sent
 	std::deque< std::shared_ptr<const RawPacket> > outgoingData;
-	/// packets we have received but not yet read
-	std::vector< std::pair<int, RawPacket> > waitingPackets;
+	/// bytes of outgoingData.front() already put into chunks
+	unsigned int outgoingOffset;
+
+	/// chunks we have received but not yet read, kept sorted by number
+	std::vector<Chunk> waitingPackets;
 	spring::unordered_set<int> incomingChunkNums;
 
 
-	/// Newly created and not yet sent
-	std::deque<ChunkPtr> newChunks;
-	/// packets the other side did not ack'ed until now
-	std::deque<ChunkPtr> unackedChunks;
+	/// packets the other side did not ack'ed until now, and those newly created and not yet sent
+	ChunkRing outgoingChunks;
 
-	/// Packets the other side missed
-	std::vector< std::pair<std::int32_t, ChunkPtr> > resendRequested;
+	/// chunk-numbers of the packets the other side missed, all refer to unacked chunks
+	std::vector<std::int32_t> resendRequested;
 	spring::unordered_set<std::int32_t> erasedResendChunks;
 
 	/// complete packets we received but did not yet consume
@@ -205,6 +311,12 @@ private:
 	std::vector<std::uint8_t> sendBuffer;
 	std::vector<std::uint8_t> recvBuffer;
 	std::vector<std::uint8_t> waitBuffer;
+	/// incomplete message from the last in-order chunk
+	std::vector<std::uint8_t> fragmentBuffer;
+
+	/// reused for every packet we send or receive on our own socket
+	Packet sendPacket;
+	Packet recvPacket;
 
 	std::vector<int> droppedPackets;
 
@@ -221,8 +333,9 @@ private:
 
 	/// Our socket
 	std::shared_ptr<asio::ip::udp::socket> mySocket;
+	/// batches our sends with those of the other connections on a shared socket, may be null
+	std::shared_ptr<UDPBatchIO> batchIO;
 
-	RawPacket fragmentBuffer;
 
 	// Traffic statistics and stuff
 	#ifdef ENABLE_DEBUG_STATS
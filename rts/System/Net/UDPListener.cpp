@@ -14,8 +14,10 @@
 
 
 #include "ProtocolDef.h"
+#include "UDPBatchIO.h"
 #include "UDPConnection.h"
 #include "Socket.h"
+#include "System/GlobalConfig.h"
 #include "System/Log/ILog.h"
 #include "System/Platform/errorhandler.h"
 #include "System/StringUtil.h" // for IntToString (header only)
@@ -36,6 +38,9 @@ UDPListener::UDPListener(int port, const std::string& ip): acceptNewConnections(
 	socket->non_blocking(true);
 	SetAcceptingConnections(true);
 
+	if (globalConfig.useBatchedNetIO && UDPBatchIO::IsSupported())
+		batchIO.reset(new UDPBatchIO(socket));
+
 	LOG("[%s] successfully bound socket on port %i", __func__, socket->local_endpoint().port());
 }
 
@@ -43,6 +48,15 @@ UDPListener::~UDPListener() {
 	for (const auto& p: dropMap) {
 		LOG("[%s] dropped %lu packets from unknown IP %s", __func__, (unsigned long) p.second, (p.first).c_str());
 	}
+
+	if (batchIO == nullptr)
+		return;
+
+	LOG(
+		"[%s] sent %lu datagrams in %lu calls, received %lu datagrams in %lu calls", __func__,
+		(unsigned long) batchIO->GetNumSent(), (unsigned long) batchIO->GetNumSendCalls(),
+		(unsigned long) batchIO->GetNumReceived(), (unsigned long) batchIO->GetNumRecvCalls()
+	);
 }
 
 
@@ -110,6 +124,32 @@ std::string UDPListener::TryBindSocket(int port, std::shared_ptr<asio::ip::udp::
 void UDPListener::Update() {
 	netservice.poll();
 
+	// everything the connections send in here goes out in as few syscalls as possible
+	if (batchIO != nullptr)
+		batchIO->BeginBatch();
+
+	ReceiveDatagrams();
+
+	for (auto i = connMap.cbegin(); i != connMap.cend(); ) {
+		if (i->second.expired()) {
+			LOG_L(L_DEBUG, "[UDPListener::%s] connection closed: [%s]:%i", __func__, i->first.address().to_string().c_str(), i->first.port());
+			i = connMap.erase(i);
+			continue;
+		}
+		i->second.lock()->Update();
+		++i;
+	}
+
+	if (batchIO != nullptr)
+		batchIO->EndBatch();
+}
+
+void UDPListener::ReceiveDatagrams() {
+	if (batchIO != nullptr) {
+		batchIO->Receive([this](const std::uint8_t* data, size_t size, const ip::udp::endpoint& sender) { ProcessDatagram(data, size, sender); });
+		return;
+	}
+
 	size_t bytesAvailable = 0;
 
 	while ((bytesAvailable = socket->available()) > 0) {
@@ -122,73 +162,68 @@ void UDPListener::Update() {
 
 		const size_t bytesReceived = socket->receive_from(asio::buffer(recvBuffer), udpEndPoint, msgFlags, err);
 
-		const auto ci = connMap.find(udpEndPoint);
-
-		// known connection but expired
-		if (ci != connMap.end() && ci->second.expired())
-			continue;
-
 		if (CheckErrorCode(err))
 			break;
 
-		if (bytesReceived < Packet::headerSize)
-			continue;
+		ProcessDatagram(&recvBuffer[0], bytesReceived, udpEndPoint);
+	}
+}
 
-		Packet data(&recvBuffer[0], bytesReceived);
+void UDPListener::ProcessDatagram(const std::uint8_t* rawData, size_t bytesReceived, const ip::udp::endpoint& udpEndPoint) {
+	const auto ci = connMap.find(udpEndPoint);
 
-		if (ci != connMap.end()) {
-			ci->second.lock()->ProcessRawPacket(data);
-			continue;
-		}
+	// known connection but expired
+	if (ci != connMap.end() && ci->second.expired())
+		return;
 
+	if (bytesReceived < Packet::headerSize)
+		return;
 
-		// unknown connection but still have the packet, maybe a new client wants to connect from sender's address
-		if (acceptNewConnections && data.lastContinuous == -1 && data.nakType == 0)	{
-			if (!data.chunks.empty() && (*data.chunks.begin())->chunkNumber == 0) {
-				std::shared_ptr<UDPConnection> incoming(new UDPConnection(socket, udpEndPoint));
-				waiting.push(incoming);
-				connMap[udpEndPoint] = incoming;
-				incoming->ProcessRawPacket(data);
-			}
+	Packet& data = recvPacket;
+	data.Parse(rawData, bytesReceived);
 
-			continue;
+	if (ci != connMap.end()) {
+		ci->second.lock()->ProcessRawPacket(data);
+		return;
+	}
+
+
+	// unknown connection but still have the packet, maybe a new client wants to connect from sender's address
+	if (acceptNewConnections && data.lastContinuous == -1 && data.nakType == 0)	{
+		if (!data.chunks.empty() && data.chunks[0].chunkNumber == 0) {
+			std::shared_ptr<UDPConnection> incoming(new UDPConnection(socket, udpEndPoint, batchIO));
+			waiting.push(incoming);
+			connMap[udpEndPoint] = incoming;
+			incoming->ProcessRawPacket(data);
 		}
 
+		return;
+	}
 
-		const asio::ip::address& senderAddr = udpEndPoint.address();
-		const std::string& senderIP = senderAddr.to_string();
 
-		if (dropMap.find(senderIP) == dropMap.end()) {
-			LOG_L(L_DEBUG, "[UDPListener::%s] dropping packet from unknown IP: [%s]:%i", __func__, senderIP.c_str(), udpEndPoint.port());
-			dropMap[senderIP] = 0;
-		} else {
-			dropMap[senderIP] += 1;
-		}
+	const asio::ip::address& senderAddr = udpEndPoint.address();
+	const std::string& senderIP = senderAddr.to_string();
 
-	#ifdef DEBUG
-		std::string conns;
-		for (auto it = connMap.cbegin(); it != connMap.cend(); ++it) {
-			conns += spring::format(" [%s]:%i;", it->first.address().to_string().c_str(),it->first.port());
-		}
-		LOG_L(L_DEBUG, "[UDPListener::%s] open connections: %s", __func__, conns.c_str());
-	#endif
+	if (dropMap.find(senderIP) == dropMap.end()) {
+		LOG_L(L_DEBUG, "[UDPListener::%s] dropping packet from unknown IP: [%s]:%i", __func__, senderIP.c_str(), udpEndPoint.port());
+		dropMap[senderIP] = 0;
+	} else {
+		dropMap[senderIP] += 1;
 	}
 
-	for (auto i = connMap.cbegin(); i != connMap.cend(); ) {
-		if (i->second.expired()) {
-			LOG_L(L_DEBUG, "[UDPListener::%s] connection closed: [%s]:%i", __func__, i->first.address().to_string().c_str(), i->first.port());
-			i = connMap.erase(i);
-			continue;
-		}
-		i->second.lock()->Update();
-		++i;
+#ifdef DEBUG
+	std::string conns;
+	for (auto it = connMap.cbegin(); it != connMap.cend(); ++it) {
+		conns += spring::format(" [%s]:%i;", it->first.address().to_string().c_str(),it->first.port());
 	}
+	LOG_L(L_DEBUG, "[UDPListener::%s] open connections: %s", __func__, conns.c_str());
+#endif
 }
 
 
 std::shared_ptr<UDPConnection> UDPListener::SpawnConnection(const std::string& ip, const unsigned port)
 {
-	std::shared_ptr<UDPConnection> newConn(new UDPConnection(socket, ip::udp::endpoint(WrapIP(ip), port)));
+	std::shared_ptr<UDPConnection> newConn(new UDPConnection(socket, ip::udp::endpoint(WrapIP(ip), port), batchIO));
 	connMap[newConn->GetEndpoint()] = newConn;
 	return newConn;
 }
@@ -3,6 +3,7 @@
 #ifndef _UDP_LISTENER_H
 #define _UDP_LISTENER_H
 
+#include "UDPConnection.h"
 #include "System/Misc/NonCopyable.h"
 #include <memory>
 #include <asio/ip/udp.hpp>
@@ -12,7 +13,7 @@
 
 namespace netcode
 {
-class UDPConnection;
+class UDPBatchIO;
 
 /**
  * @brief Class for handling Connections on an UDPSocket
@@ -75,6 +76,12 @@ public:
 	void RejectConnection() { waiting.pop(); }
 	void UpdateConnections(); // Updates connections when the endpoint has been reconnected
 
+	asio::ip::udp::socket* GetSocket() { return socket.get(); }
+
+private:
+	void ReceiveDatagrams();
+	void ProcessDatagram(const std::uint8_t* rawData, size_t bytesReceived, const asio::ip::udp::endpoint& udpEndPoint);
+
 private:
 	/**
 	 * @brief Do we accept packets from unknown sources?
@@ -84,8 +91,12 @@ private:
 
 	/// socket being listened on
 	std::shared_ptr<asio::ip::udp::socket> socket;
+	/// sendmmsg/recvmmsg batching for the socket, null if disabled or unsupported
+	std::shared_ptr<UDPBatchIO> batchIO;
 
 	std::vector<std::uint8_t> recvBuffer;
+	/// reused for every datagram, refers into it while being processed
+	Packet recvPacket;
 
 	/// all connections
 	std::map< asio::ip::udp::endpoint, std::weak_ptr<UDPConnection> > connMap;
@@ -29,6 +29,7 @@
 #include "aGui/Gui.h"
 #endif
 #include "ExternalAI/AILibraryManager.h"
+#include "Game/Benchmark.h"
 #include "Game/CameraHandler.h"
 #include "Game/ClientSetup.h"
 #include "Game/GameSetup.h"
@@ -140,6 +141,8 @@ DEFINE_string   (map,                                      "",    "Specify the m
 DEFINE_string   (menu,                                     "",    "Specify a lua menu archive to be used by spring");
 DEFINE_string   (name,                                     "",    "Set your player name");
 DEFINE_bool     (oldmenu,                                  false, "Start the old menu");
+DEFINE_string   (benchmark,                                "",    "Replay the given demo at maximum speed and write per-subsystem sim-timings to benchmark.json, then quit");
+DEFINE_int32_EX (profile_lag,        "profile-lag",        0,     "Record timer scopes of all threads and write a Chrome trace of every sim-frame slower than this many milliseconds");
 
 
 
@@ -455,6 +458,20 @@ void SpringApp::ParseCmdLine(int argc, char* argv[])
 	if (!FLAGS_write_dir.empty())
 		dataDirLocater.SetWriteDir(FLAGS_write_dir);
 
+	if (!FLAGS_benchmark.empty()) {
+		inputFile = FLAGS_benchmark;
+
+		// only special timers are recorded by a disabled profiler
+		profiler.SetEnabled(true);
+		CBenchmark::GetInstance().SetEnabled(true);
+		CBenchmark::GetInstance().SetDemoName(FileSystem::GetFilename(inputFile));
+	}
+
+	if (FLAGS_profile_lag > 0) {
+		CTimeTracer::GetInstance().SetLagThreshold(FLAGS_profile_lag);
+		CTimeTracer::GetInstance().SetEnabled(true);
+	}
+
 	if (FLAGS_gen_fontconfig) {
 		{
 			spring_clock::PushTickRate();
@@ -630,8 +647,12 @@ void SpringApp::Startup()
 	}
 
 	clientSetup->myPlayerName = configHandler->GetString("name");
+	clientSetup->benchmarkMode = CBenchmark::GetInstance().IsEnabled();
 	clientSetup->SanityCheck();
 
+	if (clientSetup->benchmarkMode && extension != "sdfz")
+		throw content_error("--benchmark requires a demo (.sdfz), got \"" + inputFile + "\"");
+
 	luaMenuController = new CLuaMenuController(FLAGS_menu);
 
 	// no argument (either game is given or show selectmenu)
@@ -6,9 +6,11 @@
 
 #include "System/SpringMath.h"
 #include "System/Exceptions.h"
-#include "System/Sync/FPUCheck.h"
 #include "System/Log/ILog.h"
-#include "Sim/Units/Scripts/CobInstance.h" // for TAANG2RAD (ugh)
+#ifndef UNIT_TEST
+	#include "System/Sync/FPUCheck.h"
+	#include "Sim/Units/Scripts/CobInstance.h" // for TAANG2RAD (ugh)
+#endif
 
 #undef far
 #undef near
@@ -17,7 +19,9 @@ float2 SpringMath::headingToVectorTable[NUM_HEADINGS];
 
 void SpringMath::Init()
 {
+#ifndef UNIT_TEST
 	good_fpu_init();
+#endif
 
 	for (int a = 0; a < NUM_HEADINGS; ++a) {
 		const float ang = (a - (NUM_HEADINGS / 2)) * math::TWOPI / NUM_HEADINGS;
@@ -61,6 +65,7 @@ void SpringMath::Init()
 
 
 
+#ifndef UNIT_TEST
 float3 GetVectorFromHAndPExact(const short int heading, const short int pitch)
 {
 	float3 ret;
@@ -71,6 +76,7 @@ float3 GetVectorFromHAndPExact(const short int heading, const short int pitch)
 	ret.z = math::cos(h) * math::cos(p);
 	return ret;
 }
+#endif
 
 float LinePointDist(const float3 l1, const float3 l2, const float3 p)
 {
@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <climits>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
 
 #include "System/TimeProfiler.h"
@@ -16,15 +18,24 @@
 
 using ProfileMutexType = spring::mutex; //spring::spinlock
 using HashNamMutexType = spring::mutex; //spring::spinlock
+using TraceMutexType = spring::mutex;
 
 static ProfileMutexType profileMutex;
 static HashNamMutexType hashToNameMutex;
+static TraceMutexType traceRingsMutex;
 static spring::unordered_map<unsigned, std::string> hashToName;
 static spring::unordered_map<unsigned, int> refCounters;
 
 static CGlobalUnsyncedRNG profileColorRNG;
 
 
+BasicTimer::BasicTimer(unsigned _nameHash)
+	: nameHash(_nameHash)
+	, startTime(spring_gettime())
+	, traced(CTimeTracer::GetInstance().BeginScope())
+{
+}
+
 spring_time BasicTimer::GetDuration() const
 {
 	return spring_difftime(spring_gettime(), startTime);
@@ -48,6 +59,9 @@ ScopedTimer::ScopedTimer(const unsigned _nameHash, bool _autoShowGraph, bool _sp
 
 ScopedTimer::~ScopedTimer()
 {
+	if (traced)
+		CTimeTracer::GetInstance().EndScope(nameHash, startTime);
+
 	// no avoiding a second lookup since iterators can be invalidated with unordered_map
 	auto iter = refCounters.find(nameHash);
 
@@ -99,6 +113,9 @@ ScopedMtTimer::ScopedMtTimer(unsigned _nameHash, bool _autoShowGraph)
 
 ScopedMtTimer::~ScopedMtTimer()
 {
+	if (traced)
+		CTimeTracer::GetInstance().EndScope(nameHash, startTime);
+
 	profiler.AddTime(nameHash, startTime, GetDuration(), autoShowGraph, false, true);
 }
 
@@ -334,6 +351,27 @@ const CTimeProfiler::TimeRecord& CTimeProfiler::GetTimeRecord(const char* name)
 	return (GetTimeRecordRaw(name));
 }
 
+void CTimeProfiler::GetTimeTotals(const char* prefix, std::vector< std::pair<std::string, spring_time> >& totals) const
+{
+	const size_t prefixLen = strlen(prefix);
+
+	std::lock_guard<ProfileMutexType> profileLock(profileMutex);
+	std::lock_guard<HashNamMutexType> hashNamLock(hashToNameMutex);
+
+	totals.clear();
+
+	for (const auto& profile: profiles) {
+		const auto iter = hashToName.find(profile.first);
+
+		if (iter == hashToName.end())
+			continue;
+		if (iter->second.compare(0, prefixLen, prefix) != 0)
+			continue;
+
+		totals.emplace_back(iter->second, profile.second.total);
+	}
+}
+
 
 void CTimeProfiler::AddTime(
 	const unsigned nameHash,
@@ -414,3 +452,185 @@ void CTimeProfiler::PrintProfilingInfo() const
 	}
 }
 
+
+
+//////////////////////////////////////////////////////////////////////
+// CTimeTracer
+//////////////////////////////////////////////////////////////////////
+
+struct CTimeTracer::ThreadRing {
+	static constexpr unsigned NUM_EVENTS = 1 << 15;
+
+	std::array<Event, NUM_EVENTS> events;
+
+	// total number of events ever written; only the owning thread stores
+	std::atomic<std::uint64_t> numEvents = {0};
+
+	unsigned depth = 0;
+	int poolThreadNum = 0;
+};
+
+thread_local CTimeTracer::ThreadRing* CTimeTracer::threadRing = nullptr;
+
+
+CTimeTracer::CTimeTracer() = default;
+CTimeTracer::~CTimeTracer() = default;
+
+CTimeTracer& CTimeTracer::GetInstance()
+{
+	static CTimeTracer tt;
+	return tt;
+}
+
+
+CTimeTracer::ThreadRing* CTimeTracer::GetThreadRing()
+{
+	if (threadRing != nullptr)
+		return threadRing;
+
+	std::lock_guard<TraceMutexType> lock(traceRingsMutex);
+
+	threadRings.emplace_back(new ThreadRing());
+	threadRing = threadRings.back().get();
+
+	#ifdef THREADPOOL
+	threadRing->poolThreadNum = ThreadPool::GetThreadNum();
+	#endif
+	return threadRing;
+}
+
+bool CTimeTracer::BeginScope()
+{
+	if (!IsEnabled())
+		return false;
+
+	GetThreadRing()->depth += 1;
+	return true;
+}
+
+void CTimeTracer::EndScope(unsigned nameHash, spring_time startTime)
+{
+	ThreadRing* ring = threadRing;
+
+	const std::uint64_t n = ring->numEvents.load(std::memory_order_relaxed);
+
+	ring->depth -= 1;
+	ring->events[n & (ThreadRing::NUM_EVENTS - 1)] = {startTime, spring_gettime(), nameHash, ring->depth};
+	ring->numEvents.store(n + 1, std::memory_order_release);
+}
+
+
+void CTimeTracer::CheckSimFrame(int frameNum, spring_time frameStartTime, spring_time frameEndTime)
+{
+	// at most one dump every ten seconds of game-time, a lagging game would otherwise flood the disk
+	constexpr int MIN_DUMP_INTERVAL = 10 * 30;
+
+	if (lagThreshold <= 0 || !IsEnabled())
+		return;
+	if ((frameEndTime - frameStartTime).toMilliSecsf() < lagThreshold)
+		return;
+	if (lastLagFrame >= 0 && (frameNum - lastLagFrame) < MIN_DUMP_INTERVAL)
+		return;
+
+	lastLagFrame = frameNum;
+
+	const std::string fileName = "profile-lag-" + std::to_string(frameNum) + ".json";
+	const int numEvents = WriteTrace(fileName, frameStartTime);
+
+	LOG_L(L_WARNING, "[TimeTracer::%s] sim-frame %d took %.1fms, wrote %d events to \"%s\"", __func__, frameNum, (frameEndTime - frameStartTime).toMilliSecsf(), numEvents, fileName.c_str());
+}
+
+
+int CTimeTracer::WriteTrace(const std::string& fileName, spring_time minTime) const
+{
+	FILE* file = fopen(fileName.c_str(), "w");
+
+	if (file == nullptr)
+		return -1;
+
+	spring::unordered_map<unsigned, std::string> names;
+	std::vector<Event> events;
+
+	const auto GetName = [&](unsigned nameHash) -> const std::string& {
+		const auto it = names.find(nameHash);
+
+		if (it != names.end())
+			return it->second;
+
+		std::string name;
+
+		{
+			std::lock_guard<HashNamMutexType> lock(hashToNameMutex);
+
+			const auto iter = hashToName.find(nameHash);
+
+			if (iter != hashToName.end())
+				name = iter->second;
+			else
+				name = "#" + std::to_string(nameHash);
+		}
+
+		// keep the JSON valid whatever a (Lua or AI) timer is called
+		std::replace(name.begin(), name.end(), '"', '\'');
+		std::replace(name.begin(), name.end(), '\\', '/');
+
+		return (names[nameHash] = std::move(name));
+	};
+
+	int numEvents = 0;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"ph\":\"M\",\"pid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"spring\"}}");
+
+	{
+		std::lock_guard<TraceMutexType> lock(traceRingsMutex);
+
+		for (size_t tid = 0; tid < threadRings.size(); tid++) {
+			const ThreadRing* ring = threadRings[tid].get();
+
+			constexpr std::uint64_t N = ThreadRing::NUM_EVENTS;
+
+			// copy without stopping the owner, then drop what it overwrote meanwhile
+			// (slot i is reused by event i+N, written while numEvents equals i+N)
+			const std::uint64_t n0 = ring->numEvents.load(std::memory_order_acquire);
+			const std::uint64_t i0 = (n0 > N)? (n0 - N): 0;
+
+			events.clear();
+
+			for (std::uint64_t i = i0; i < n0; i++) {
+				events.push_back(ring->events[i & (N - 1)]);
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			const std::uint64_t n1 = ring->numEvents.load(std::memory_order_relaxed);
+			const std::uint64_t i1 = (n1 >= N)? (n1 - N + 1): 0;
+
+			events.erase(events.begin(), events.begin() + std::min(std::max(i1, i0) - i0, std::uint64_t(events.size())));
+			events.erase(std::remove_if(events.begin(), events.end(), [&](const Event& e) { return (e.endTime < minTime); }), events.end());
+
+			// parents before their children
+			std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+				return ((a.startTime < b.startTime) || (!(b.startTime < a.startTime) && a.depth < b.depth));
+			});
+
+			fprintf(file, ",\n{\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":\"thread %u (pool %d)\"}}", unsigned(tid), unsigned(tid), ring->poolThreadNum);
+
+			for (const Event& e: events) {
+				fprintf(file, ",\n{\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":\"%s\",\"args\":{\"depth\":%u}}",
+					unsigned(tid),
+					e.startTime.toNanoSecsi() * 0.001,
+					(e.endTime - e.startTime).toNanoSecsi() * 0.001,
+					GetName(e.nameHash).c_str(),
+					e.depth
+				);
+			}
+
+			numEvents += events.size();
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return numEvents;
+}
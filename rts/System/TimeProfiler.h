@@ -8,6 +8,7 @@
 #include <deque>
 #include <vector>
 #include <array>
+#include <memory>
 
 #include "System/Misc/SpringTime.h"
 #include "System/Misc/NonCopyable.h"
@@ -31,13 +32,16 @@ class BasicTimer : public spring::noncopyable
 {
 public:
 	//BasicTimer(const spring_time time): nameHash(0), startTime(time) {}
-	BasicTimer(unsigned _nameHash) : nameHash(_nameHash), startTime(spring_gettime()) { }
+	BasicTimer(unsigned _nameHash);
 
 	spring_time GetDuration() const;
 
 protected:
 	const unsigned nameHash;
 	const spring_time startTime;
+
+	// whether CTimeTracer records this scope
+	const bool traced;
 };
 
 
@@ -135,6 +139,8 @@ public:
 	float GetTimePercentageRaw(const char* name) const { return (GetTimeRecordRaw(name).stats.y); }
 
 	const TimeRecord& GetTimeRecord(const char* name) const;
+	// accumulated time of every timer whose name starts with <prefix>
+	void GetTimeTotals(const char* prefix, std::vector< std::pair<std::string, spring_time> >& totals) const;
 	const TimeRecord& GetTimeRecordRaw(const char* name) const {
 		// do not default-create keys, breaks resorting
 		const auto it = profiles.find(hashString(name));
@@ -200,6 +206,63 @@ private:
 };
 
 
+/**
+ * @brief Per-thread timelines of (nested) timer scopes
+ *
+ * While enabled, every ScopedTimer and ScopedMtTimer leaving scope appends an
+ * event to a lock-free ring owned by its thread; the recent history of all
+ * threads can be written out as Chrome / Perfetto trace JSON. Independent of
+ * CTimeProfiler's enabled-state and of rendering, so also works headless.
+ */
+class CTimeTracer
+{
+public:
+	struct Event {
+		spring_time startTime;
+		spring_time endTime;
+
+		unsigned nameHash;
+		// number of traced scopes enclosing this one on the same thread
+		unsigned depth;
+	};
+
+	CTimeTracer();
+	~CTimeTracer();
+
+	static CTimeTracer& GetInstance();
+
+	void SetEnabled(bool b) { enabled.store(b); }
+	bool IsEnabled() const { return (enabled.load(std::memory_order_relaxed)); }
+
+	// sim-frames slower than this many milliseconds are written out, 0 disables
+	void SetLagThreshold(int msecs) { lagThreshold = msecs; }
+	int GetLagThreshold() const { return lagThreshold; }
+
+	bool BeginScope();
+	void EndScope(unsigned nameHash, spring_time startTime);
+
+	void CheckSimFrame(int frameNum, spring_time frameStartTime, spring_time frameEndTime);
+
+	// writes all events that ended at or after <minTime>, returns their number or -1
+	int WriteTrace(const std::string& fileName, spring_time minTime = spring_notime) const;
+
+private:
+	struct ThreadRing;
+
+	ThreadRing* GetThreadRing();
+
+private:
+	static thread_local ThreadRing* threadRing;
+
+	std::vector< std::unique_ptr<ThreadRing> > threadRings;
+
+	std::atomic<bool> enabled = {false};
+
+	int lagThreshold = 0;
+	int lastLagFrame = -1;
+};
+
+
 class TimerNameRegistrar : public spring::noncopyable
 {
 public:
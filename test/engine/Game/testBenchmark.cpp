@@ -0,0 +1,127 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Game/Benchmark.h"
+#include "System/TimeProfiler.h"
+#include "System/StringHash.h"
+#include "System/Misc/SpringTime.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+InitSpringTime ist;
+
+
+static constexpr int NUM_FRAMES = 100;
+
+
+struct TimerResult {
+	float mean = -1.0f;
+	float p50 = -1.0f;
+	float p90 = -1.0f;
+	float p99 = -1.0f;
+	float max = -1.0f;
+};
+
+static bool ReadTimer(const char* fileName, const char* timerName, TimerResult* result)
+{
+	std::ifstream ifs(fileName);
+	std::string line;
+
+	const std::string prefix = std::string("\t\t\"") + timerName + "\": ";
+
+	while (std::getline(ifs, line)) {
+		if (line.compare(0, prefix.size(), prefix) != 0)
+			continue;
+
+		const char* fmt = "{\"mean\": %f, \"p50\": %f, \"p90\": %f, \"p99\": %f, \"max\": %f}";
+		return (sscanf(line.c_str() + prefix.size(), fmt, &result->mean, &result->p50, &result->p90, &result->p99, &result->max) == 5);
+	}
+
+	return false;
+}
+
+static bool ReadValue(const char* fileName, const char* key, float* value)
+{
+	std::ifstream ifs(fileName);
+	std::string line;
+
+	const std::string prefix = std::string("\t\"") + key + "\": ";
+
+	while (std::getline(ifs, line)) {
+		if (line.compare(0, prefix.size(), prefix) == 0)
+			return (sscanf(line.c_str() + prefix.size(), "%f", value) == 1);
+	}
+
+	return false;
+}
+
+
+TEST_CASE("Benchmark")
+{
+	CBenchmark& benchmark = CBenchmark::GetInstance();
+
+	CTimeProfiler::RegisterTimer("Sim::Test::Steady");
+	CTimeProfiler::RegisterTimer("Sim::Test::Late");
+	CTimeProfiler::RegisterTimer("Misc::Test::Other");
+
+	profiler.SetEnabled(true);
+	benchmark.SetEnabled(true);
+	benchmark.SetDemoName("test \"demo\".sdfz");
+
+	// frame 0 only provides the baseline; "Steady" takes 2ms with a 20ms spike
+	// every tenth frame, "Late" 1ms but only from frame 50 on, "Other" is not
+	// a sim-timer
+	for (int f = 0; f <= NUM_FRAMES; f++) {
+		profiler.AddTime(hashString("Sim::Test::Steady"), spring_gettime(), spring_msecs(((f % 10) == 0)? 20: 2));
+		profiler.AddTime(hashString("Misc::Test::Other"), spring_gettime(), spring_msecs(5));
+
+		if (f >= 50)
+			profiler.AddTime(hashString("Sim::Test::Late"), spring_gettime(), spring_msecs(1));
+
+		benchmark.SimFrame(f, spring_msecs(f * 10), spring_msecs(f * 10 + 5));
+	}
+
+	CHECK(benchmark.GetNumFrames() == NUM_FRAMES);
+	REQUIRE(benchmark.WriteResults("testBenchmark.json"));
+
+	float numFrames = 0.0f;
+	float framesPerSecond = 0.0f;
+
+	CHECK(ReadValue("testBenchmark.json", "frames", &numFrames));
+	CHECK(ReadValue("testBenchmark.json", "framesPerSecond", &framesPerSecond));
+	CHECK(numFrames == NUM_FRAMES);
+	// first recorded frame starts at 10ms, the last one ends at 1005ms
+	CHECK(framesPerSecond == Approx(NUM_FRAMES / 0.995f).epsilon(0.001f));
+
+	TimerResult steady;
+	TimerResult late;
+	TimerResult other;
+
+	REQUIRE(ReadTimer("testBenchmark.json", "Sim::Test::Steady", &steady));
+	REQUIRE(ReadTimer("testBenchmark.json", "Sim::Test::Late", &late));
+	CHECK(!ReadTimer("testBenchmark.json", "Misc::Test::Other", &other));
+
+	CHECK(steady.mean == Approx(3.8f));
+	CHECK(steady.p50 == Approx(2.0f));
+	CHECK(steady.p90 == Approx(2.0f));
+	CHECK(steady.p99 == Approx(20.0f));
+	CHECK(steady.max == Approx(20.0f));
+
+	// zero in the 49 frames before it first ran
+	CHECK(late.mean == Approx(0.51f));
+	CHECK(late.p50 == Approx(1.0f));
+	CHECK(late.max == Approx(1.0f));
+
+	std::ifstream ifs("testBenchmark.json");
+	const std::string json((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+	CHECK(json.find("\"demo\": \"test \\\"demo\\\".sdfz\"") != std::string::npos);
+	CHECK(json.compare(json.size() - 5, 5, "\t}\n}\n") == 0);
+
+	std::remove("testBenchmark.json");
+}
@@ -0,0 +1,315 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Map/Ground.h"
+#include "Map/HeightBoundsPyramid.h"
+#include "Map/ReadMap.h"
+#include "Map/SMF/SMFFormat.h"
+#include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
+#include "System/SpringMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+InitSpringTime ist;
+
+// the remaining globals Ground.cpp links against; only the overload that
+// takes explicit height- and normal-maps is used here
+CReadMap* readMap = nullptr;
+MapDimensions mapDims;
+
+std::vector<float> CReadMap::originalHeightMap;
+CHeightBoundsPyramid CReadMap::heightBoundsPyramid;
+
+
+// used when SPRING_TEST_SMF does not point to a map
+static constexpr int SYNTH_MAP_SIZE = 1024;
+
+static constexpr int NUM_RAYS = 200000;
+static constexpr int NUM_CRATERS = 200;
+
+
+struct TestMap {
+	bool LoadSMF(const char* fileName) {
+		std::ifstream ifs(fileName, std::ios::binary);
+
+		if (!ifs)
+			return false;
+
+		// all header fields are 4 bytes wide, so the in-memory layout matches the file
+		SMFHeader header;
+		ifs.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		if (!ifs || std::strcmp(header.magic, "spring map file") != 0)
+			return false;
+
+		std::vector<std::uint16_t> words((header.mapx + 1) * (header.mapy + 1));
+
+		ifs.seekg(header.heightmapPtr);
+		ifs.read(reinterpret_cast<char*>(words.data()), words.size() * sizeof(words[0]));
+
+		if (!ifs)
+			return false;
+
+		// same conversion as SMFReadMap
+		const float mod = (header.maxHeight - header.minHeight) / 65536.0f;
+
+		Resize(header.mapx, header.mapy);
+
+		for (size_t i = 0; i < words.size(); i++) {
+			heights[i] = header.minHeight + words[i] * mod;
+		}
+
+		return true;
+	}
+
+	void MakeSynthetic() {
+		Resize(SYNTH_MAP_SIZE, SYNTH_MAP_SIZE);
+
+		// rolling hills with a few sheer cliffs, so that rays do get occluded
+		for (int z = 0; z <= sizeZ; z++) {
+			for (int x = 0; x <= sizeX; x++) {
+				float h = 150.0f * std::sin(x * 0.021f) * std::cos(z * 0.017f) + 60.0f * std::sin((x + z) * 0.07f);
+
+				if (((x / 96) + (z / 80)) % 5 == 0)
+					h += 300.0f;
+
+				heights[z * (sizeX + 1) + x] = h;
+			}
+		}
+	}
+
+	void Resize(int x, int z) {
+		sizeX = x;
+		sizeZ = z;
+
+		heights.resize((sizeX + 1) * (sizeZ + 1));
+		normals.resize(sizeX * sizeZ * 2);
+	}
+
+	// same face-normals as CReadMap::UpdateFaceNormals, for the (inclusive) square-rectangle
+	void UpdateNormals(int x1, int z1, int x2, int z2) {
+		for (int z = std::max(z1, 0); z <= std::min(z2, sizeZ - 1); z++) {
+			for (int x = std::max(x1, 0); x <= std::min(x2, sizeX - 1); x++) {
+				const float hTL = heights[(z    ) * (sizeX + 1) + x    ];
+				const float hTR = heights[(z    ) * (sizeX + 1) + x + 1];
+				const float hBL = heights[(z + 1) * (sizeX + 1) + x    ];
+				const float hBR = heights[(z + 1) * (sizeX + 1) + x + 1];
+
+				normals[(z * sizeX + x) * 2    ] = float3(-(hTR - hTL), SQUARE_SIZE, -(hBL - hTL)).Normalize();
+				normals[(z * sizeX + x) * 2 + 1] = float3(  hBL - hBR , SQUARE_SIZE,   hTR - hBR ).Normalize();
+			}
+		}
+	}
+
+	float GetMaxHeight() const { return *std::max_element(heights.begin(), heights.end()); }
+
+	int sizeX = 0;
+	int sizeZ = 0;
+
+	std::vector<float> heights;
+	std::vector<float3> normals;
+};
+
+
+struct Ray {
+	float3 from;
+	float3 to;
+};
+
+static std::vector<Ray> MakeRays(const TestMap& map, std::mt19937& rng)
+{
+	const float maxX = map.sizeX * SQUARE_SIZE;
+	const float maxZ = map.sizeZ * SQUARE_SIZE;
+
+	std::uniform_real_distribution<float> posXDist(-200.0f, maxX + 200.0f);
+	std::uniform_real_distribution<float> posZDist(-200.0f, maxZ + 200.0f);
+	std::uniform_real_distribution<float> hgtDist(0.0f, 400.0f);
+	std::uniform_real_distribution<float> angDist(0.0f, math::TWOPI);
+	std::uniform_real_distribution<float> lenDist(200.0f, 3000.0f);
+
+	const auto GroundHeight = [&](float x, float z) {
+		const int sx = Clamp(int(x / SQUARE_SIZE), 0, map.sizeX);
+		const int sz = Clamp(int(z / SQUARE_SIZE), 0, map.sizeZ);
+		return map.heights[sz * (map.sizeX + 1) + sx];
+	};
+
+	std::vector<Ray> rays;
+	rays.reserve(NUM_RAYS);
+
+	// mostly weapon-like shots between points above the ground, some from high
+	// up (aircraft) and a few straight down or perfectly axis-aligned
+	for (int i = 0; i < NUM_RAYS; i++) {
+		Ray r;
+
+		r.from.x = posXDist(rng);
+		r.from.z = posZDist(rng);
+		r.from.y = GroundHeight(r.from.x, r.from.z) + hgtDist(rng) + ((i % 10) == 0) * 1000.0f;
+
+		const float ang = angDist(rng);
+		const float len = lenDist(rng);
+
+		switch (i % 50) {
+			case  0: { r.to = r.from + float3(0.0f, -2000.0f, 0.0f); } break;
+			case  1: { r.to = r.from + float3(len, 0.0f, 0.0f); } break;
+			case  2: { r.to = r.from + float3(0.0f, 0.0f, -len); } break;
+			default: {
+				r.to.x = r.from.x + std::sin(ang) * len;
+				r.to.z = r.from.z + std::cos(ang) * len;
+				r.to.y = GroundHeight(r.to.x, r.to.z) + hgtDist(rng);
+			} break;
+		}
+
+		rays.push_back(r);
+	}
+
+	return rays;
+}
+
+static int CountMismatches(const TestMap& map, const CHeightBoundsPyramid& pyramid, const std::vector<Ray>& rays, int* numHits = nullptr)
+{
+	const float maxHeight = map.GetMaxHeight();
+
+	int numMismatches = 0;
+
+	for (const Ray& r: rays) {
+		const float a = CGround::LineGroundCol(r.from, r.to, map.heights.data(), map.normals.data(), nullptr, maxHeight, true);
+		const float b = CGround::LineGroundCol(r.from, r.to, map.heights.data(), map.normals.data(), &pyramid, maxHeight, true);
+
+		numMismatches += (std::memcmp(&a, &b, sizeof(float)) != 0);
+
+		if (numHits != nullptr)
+			*numHits += (a >= 0.0f);
+	}
+
+	return numMismatches;
+}
+
+
+TEST_CASE("LineGroundCol")
+{
+	TestMap map;
+
+	const char* smfName = std::getenv("SPRING_TEST_SMF");
+
+	if (smfName == nullptr || !map.LoadSMF(smfName)) {
+		LOG("[%s] SPRING_TEST_SMF not set or not a valid SMF, using a synthetic %dx%d map", __func__, SYNTH_MAP_SIZE, SYNTH_MAP_SIZE);
+		map.MakeSynthetic();
+	} else {
+		LOG("[%s] using heightmap of %s (%dx%d)", __func__, smfName, map.sizeX, map.sizeZ);
+	}
+
+	mapDims.mapx = map.sizeX;
+	mapDims.mapy = map.sizeZ;
+	mapDims.Initialize();
+
+	float3::maxxpos = map.sizeX * SQUARE_SIZE - 1;
+	float3::maxzpos = map.sizeZ * SQUARE_SIZE - 1;
+
+	map.UpdateNormals(0, 0, map.sizeX, map.sizeZ);
+
+	CHeightBoundsPyramid pyramid;
+	pyramid.Init({map.sizeX, map.sizeZ});
+	pyramid.Update(map.heights.data(), {0, 0, map.sizeX, map.sizeZ});
+
+	std::mt19937 rng(1234);
+
+	const std::vector<Ray> rays = MakeRays(map, rng);
+	const float maxHeight = map.GetMaxHeight();
+
+	// warm up, and check the results while at it
+	int numHits = 0;
+
+	CHECK(CountMismatches(map, pyramid, rays, &numHits) == 0);
+
+	// cells that were never updated must not let any ray skip them
+	{
+		CHeightBoundsPyramid unset;
+		unset.Init({map.sizeX, map.sizeZ});
+
+		CHECK(CountMismatches(map, unset, rays) == 0);
+	}
+
+	spring_time plainTime;
+	spring_time pyramidTime;
+
+	{
+		float plainSum = 0.0f;
+		float pyramidSum = 0.0f;
+
+		const spring_time t0 = spring_now();
+
+		for (const Ray& r: rays) {
+			plainSum += CGround::LineGroundCol(r.from, r.to, map.heights.data(), map.normals.data(), nullptr, maxHeight, true);
+		}
+
+		const spring_time t1 = spring_now();
+
+		for (const Ray& r: rays) {
+			pyramidSum += CGround::LineGroundCol(r.from, r.to, map.heights.data(), map.normals.data(), &pyramid, maxHeight, true);
+		}
+
+		const spring_time t2 = spring_now();
+
+		plainTime = t1 - t0;
+		pyramidTime = t2 - t1;
+
+		CHECK(plainSum == pyramidSum);
+	}
+
+	LOG("[%s] %d rays (%d hits): plain=%.2fms pyramid=%.2fms (%.2fx)", __func__, NUM_RAYS, numHits, plainTime.toMilliSecsf(), pyramidTime.toMilliSecsf(), plainTime.toMilliSecsf() / std::max(pyramidTime.toMilliSecsf(), 0.001f));
+
+	// dig and raise craters, updating the pyramid incrementally like
+	// CReadMap::UpdateHeightMapSynced does; must match a rebuilt one
+	std::uniform_int_distribution<int> sqxDist(0, map.sizeX);
+	std::uniform_int_distribution<int> sqzDist(0, map.sizeZ);
+	std::uniform_int_distribution<int> radDist(1, 12);
+	std::uniform_real_distribution<float> depthDist(-80.0f, 80.0f);
+
+	for (int n = 0; n < NUM_CRATERS; n++) {
+		const int cx = sqxDist(rng);
+		const int cz = sqzDist(rng);
+		const int r = radDist(rng);
+		const float d = depthDist(rng);
+
+		const SRectangle rect = {std::max(cx - r, 0), std::max(cz - r, 0), std::min(cx + r, map.sizeX), std::min(cz + r, map.sizeZ)};
+
+		for (int z = rect.z1; z <= rect.z2; z++) {
+			for (int x = rect.x1; x <= rect.x2; x++) {
+				map.heights[z * (map.sizeX + 1) + x] += d;
+			}
+		}
+
+		map.UpdateNormals(rect.x1 - 1, rect.z1 - 1, rect.x2 + 1, rect.z2 + 1);
+		pyramid.Update(map.heights.data(), {rect.x1 - 1, rect.z1 - 1, rect.x2 + 1, rect.z2 + 1});
+	}
+
+	CHeightBoundsPyramid rebuilt;
+	rebuilt.Init({map.sizeX, map.sizeZ});
+	rebuilt.Update(map.heights.data(), {0, 0, map.sizeX, map.sizeZ});
+
+	int numDiffCells = 0;
+
+	for (int level = 0; level < pyramid.GetNumLevels(); level++) {
+		for (int z = 0; z < pyramid.GetLevelSize(level).y; z++) {
+			for (int x = 0; x < pyramid.GetLevelSize(level).x; x++) {
+				const float2& a = pyramid.GetBounds(level, x, z);
+				const float2& b = rebuilt.GetBounds(level, x, z);
+
+				numDiffCells += (a.x != b.x || a.y != b.y);
+			}
+		}
+	}
+
+	CHECK(numDiffCells == 0);
+	CHECK(CountMismatches(map, pyramid, rays) == 0);
+}
@@ -0,0 +1,75 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Net/PacketCache.h"
+
+#include <random>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+
+static void TestCache(bool spillToFile)
+{
+	std::mt19937 rng(spillToFile? 4567: 7654);
+	std::uniform_int_distribution<int> lenDist(1, 300);
+	std::uniform_int_distribution<int> byteDist(0, 15); // compressible, like real traffic
+
+	std::vector< std::vector<uint8_t> > expected;
+
+	CPacketCache cache;
+	cache.Init(spillToFile);
+
+	// enough for several sealed segments plus a partial tail
+	while (cache.GetRawSize() < (CPacketCache::SEGMENT_SIZE * 5 + CPacketCache::SEGMENT_SIZE / 3)) {
+		std::vector<uint8_t> data(lenDist(rng));
+
+		for (uint8_t& b: data)
+			b = byteDist(rng);
+
+		cache.Append(netcode::RawPacket(data.data(), data.size()));
+		expected.emplace_back(std::move(data));
+	}
+
+	CHECK(cache.NumSegments() == 5);
+	CHECK(cache.NumPackets() == expected.size());
+	CHECK(cache.GetStoredSize() < cache.GetRawSize());
+
+	std::vector<uint8_t> buffer;
+	size_t numPackets = 0;
+	size_t numMismatches = 0;
+
+	// replay the way CGameServer does, segment by segment up to and including the tail
+	for (size_t i = 0; i <= cache.NumSegments(); i++) {
+		const std::vector<uint8_t>* segment = cache.GetSegment(i, buffer);
+
+		REQUIRE(segment != nullptr);
+
+		CPacketCache::ForEachPacket(*segment, [&](std::shared_ptr<const netcode::RawPacket> packet) {
+			const std::vector<uint8_t>& ref = expected[numPackets++];
+
+			numMismatches += (packet->length != ref.size() || !std::equal(ref.begin(), ref.end(), packet->data));
+		});
+	}
+
+	CHECK(cache.GetSegment(cache.NumSegments() + 1, buffer) == nullptr);
+	CHECK(numPackets == expected.size());
+	CHECK(numMismatches == 0);
+
+	cache.Clear();
+
+	CHECK(cache.NumSegments() == 0);
+	CHECK(cache.NumPackets() == 0);
+	CHECK(cache.GetSegment(0, buffer)->empty());
+}
+
+
+TEST_CASE("PacketCacheMemory")
+{
+	TestCache(false);
+}
+
+TEST_CASE("PacketCacheSpilled")
+{
+	TestCache(true);
+}
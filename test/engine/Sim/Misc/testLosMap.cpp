@@ -0,0 +1,246 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Misc/LosMap.h"
+#include "Map/ReadMap.h"
+#include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
+#include "System/SpringMath.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+InitSpringTime ist;
+
+MapDimensions mapDims;
+
+
+// radar-like setup: 8192x8192 elmos, mip-level 2, 2000..4000 elmo ranges
+static constexpr int MAP_SIZE = 1024;
+static constexpr int MIP_LEVEL = 2;
+static constexpr int LOS_SIZE = MAP_SIZE >> MIP_LEVEL;
+static constexpr int NUM_UNITS = 1000;
+static constexpr int NUM_FRAMES = 30;
+static constexpr int CRATERS_PER_FRAME = 4;
+
+
+struct LosWorld {
+	LosWorld(const std::vector<float>& ctrHeights, const std::vector<float>& mipHeights, bool incremental) {
+		losMap.Init({LOS_SIZE, LOS_SIZE}, {MAP_SIZE, MAP_SIZE}, ctrHeights.data(), mipHeights.data(), false, incremental);
+	}
+
+	void Add(SLosInstance& li) {
+		losMap.PrepareRaycast(&li);
+		losMap.AddRaycast(&li, 1);
+	}
+	void Recalc(SLosInstance& li) {
+		losMap.AddRaycast(&li, -1);
+		li.squares.clear();
+		Add(li);
+	}
+
+	CLosMap losMap;
+	std::vector<SLosInstance> instances;
+};
+
+
+TEST_CASE("IncrementalLosRaycast")
+{
+	mapDims.mapx = MAP_SIZE;
+	mapDims.mapy = MAP_SIZE;
+
+	std::mt19937 rng(2468);
+	std::uniform_real_distribution<float> posDist(-16.0f, LOS_SIZE + 16.0f);
+	std::uniform_int_distribution<int> radDist(2000 / (SQUARE_SIZE << MIP_LEVEL), 4000 / (SQUARE_SIZE << MIP_LEVEL));
+	std::uniform_int_distribution<int> craterDist(1, 4);
+
+	// rolling hills, so that rays do get occluded
+	std::vector<float> ctrHeights(MAP_SIZE * MAP_SIZE);
+	std::vector<float> mipHeights(LOS_SIZE * LOS_SIZE);
+
+	for (int y = 0; y < MAP_SIZE; y++) {
+		for (int x = 0; x < MAP_SIZE; x++) {
+			ctrHeights[y * MAP_SIZE + x] = 150.0f * std::sin(x * 0.021f) * std::cos(y * 0.017f) + 60.0f * std::sin((x + y) * 0.07f);
+		}
+	}
+	for (int y = 0; y < LOS_SIZE; y++) {
+		for (int x = 0; x < LOS_SIZE; x++) {
+			mipHeights[y * LOS_SIZE + x] = ctrHeights[(y << MIP_LEVEL) * MAP_SIZE + (x << MIP_LEVEL)];
+		}
+	}
+
+	LosWorld fullWorld(ctrHeights, mipHeights, false);
+	LosWorld incrWorld(ctrHeights, mipHeights, true);
+
+	for (int i = 0; i < NUM_UNITS; i++) {
+		SLosInstance li(i);
+		li.allyteam = 0;
+		li.radius = radDist(rng);
+		li.basePos = int2(posDist(rng), posDist(rng));
+		li.baseHeight = 250.0f;
+
+		fullWorld.instances.push_back(li);
+		incrWorld.instances.push_back(li);
+	}
+
+	spring_time fullTime;
+	spring_time incrTime;
+
+	{
+		const spring_time t0 = spring_now();
+
+		for (SLosInstance& li: fullWorld.instances) {
+			fullWorld.Add(li);
+		}
+
+		const spring_time t1 = spring_now();
+
+		for (SLosInstance& li: incrWorld.instances) {
+			incrWorld.Add(li);
+		}
+
+		const spring_time t2 = spring_now();
+
+		LOG("[%s] initial cast: full=%.2fms incremental=%.2fms", __func__, (t1 - t0).toMilliSecsf(), (t2 - t1).toMilliSecsf());
+	}
+
+	std::vector<int> recalcs;
+
+	for (int frame = 0; frame < NUM_FRAMES; frame++) {
+		recalcs.clear();
+
+		// dig some craters, then relos everything they touch (as ILosType::UpdateHeightMapSynced does)
+		for (int n = 0; n < CRATERS_PER_FRAME; n++) {
+			const int2 c = int2(posDist(rng), posDist(rng));
+			const int r = craterDist(rng);
+
+			const SRectangle rect(c.x - r, c.y - r, c.x + r + 1, c.y + r + 1);
+
+			for (int y = std::max(rect.y1, 0); y < std::min(rect.y2, LOS_SIZE); y++) {
+				for (int x = std::max(rect.x1, 0); x < std::min(rect.x2, LOS_SIZE); x++) {
+					mipHeights[y * LOS_SIZE + x] -= 20.0f;
+				}
+			}
+
+			for (size_t i = 0; i < NUM_UNITS; i++) {
+				SLosInstance& li = incrWorld.instances[i];
+
+				const SRectangle losBox(li.basePos.x - li.radius, li.basePos.y - li.radius, li.basePos.x + li.radius + 1, li.basePos.y + li.radius + 1);
+
+				if (!losBox.CheckOverlap(rect))
+					continue;
+
+				li.AddDirtyRect(rect);
+				recalcs.push_back(i);
+			}
+		}
+
+		std::sort(recalcs.begin(), recalcs.end());
+		recalcs.erase(std::unique(recalcs.begin(), recalcs.end()), recalcs.end());
+
+		const spring_time t0 = spring_now();
+
+		for (const int i: recalcs) {
+			fullWorld.Recalc(fullWorld.instances[i]);
+		}
+
+		const spring_time t1 = spring_now();
+
+		for (const int i: recalcs) {
+			incrWorld.Recalc(incrWorld.instances[i]);
+		}
+
+		const spring_time t2 = spring_now();
+
+		fullTime += (t1 - t0);
+		incrTime += (t2 - t1);
+	}
+
+	LOG("[%s] %d units, %d frames: full=%.3fms/frame incremental=%.3fms/frame", __func__, NUM_UNITS, NUM_FRAMES, fullTime.toMilliSecsf() / NUM_FRAMES, incrTime.toMilliSecsf() / NUM_FRAMES);
+
+	// both must have produced exactly the same sight
+	int numDiffInstances = 0;
+	int numDiffSquares = 0;
+
+	for (int i = 0; i < NUM_UNITS; i++) {
+		const auto& a = fullWorld.instances[i].squares;
+		const auto& b = incrWorld.instances[i].squares;
+
+		const auto rleEq = [](const SLosInstance::RLE& p, const SLosInstance::RLE& q) { return (p.start == q.start && p.length == q.length); };
+
+		numDiffInstances += (a.size() != b.size() || !std::equal(a.begin(), a.end(), b.begin(), rleEq));
+	}
+	for (int y = 0; y < LOS_SIZE; y++) {
+		for (int x = 0; x < LOS_SIZE; x++) {
+			numDiffSquares += (fullWorld.losMap.At({x, y}) != incrWorld.losMap.At({x, y}));
+		}
+	}
+
+	CHECK(numDiffInstances == 0);
+	CHECK(numDiffSquares == 0);
+}
+
+
+TEST_CASE("LosMapSpanAdd")
+{
+	static constexpr int SIZE = 67; // not a multiple of any SIMD width
+
+	std::mt19937 rng(1357);
+	std::uniform_int_distribution<int> lenDist(0, 3 * SIZE);
+	std::uniform_int_distribution<int> gapDist(0, 40);
+
+	std::vector<float> heights(SIZE * SIZE, 0.0f);
+	std::vector<int> expected(SIZE * SIZE, 0);
+	std::vector<SLosInstance> instances;
+
+	CLosMap losMap;
+	losMap.Init({SIZE, SIZE}, {SIZE, SIZE}, heights.data(), heights.data(), false);
+
+	// random spans of every length and alignment, as RLE-encoded instances
+	for (int i = 0; i < 200; i++) {
+		SLosInstance li(i);
+
+		for (int start = gapDist(rng); start < (SIZE * SIZE); ) {
+			const int length = std::min(lenDist(rng) + 1, SIZE * SIZE - start);
+
+			li.squares.push_back({start, static_cast<unsigned>(length)});
+
+			for (int idx = start; idx < (start + length); idx++) {
+				expected[idx] += 1;
+			}
+
+			start += (length + 1 + gapDist(rng) * 10);
+		}
+
+		losMap.AddRaycast(&li, 1);
+		instances.push_back(li);
+	}
+
+	int numDiffSquares = 0;
+
+	for (int y = 0; y < SIZE; y++) {
+		for (int x = 0; x < SIZE; x++) {
+			numDiffSquares += (losMap.At({x, y}) != expected[y * SIZE + x]);
+		}
+	}
+
+	CHECK(numDiffSquares == 0);
+
+	// removal must restore an empty map
+	for (SLosInstance& li: instances) {
+		losMap.AddRaycast(&li, -1);
+	}
+
+	numDiffSquares = 0;
+
+	for (int y = 0; y < SIZE; y++) {
+		for (int x = 0; x < SIZE; x++) {
+			numDiffSquares += (losMap.At({x, y}) != 0);
+		}
+	}
+
+	CHECK(numDiffSquares == 0);
+}
@@ -0,0 +1,285 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Sim/Misc/QuadFieldSoA.h"
+#include "System/float3.h"
+#include "System/bitops.h"
+#include "System/TimeProfiler.h"
+#include "System/Misc/SpringTime.h"
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+InitSpringTime ist;
+
+
+// stand-in for CUnit; only the members read by CQuadField's exact filters
+struct TestObject {
+	float3 pos;
+	float radius;
+	int tempNum;
+	std::vector<int> quads;
+	char pad[2048]; // keep objects roughly as far apart in memory as real units
+};
+
+struct TestQuad {
+	std::vector<TestObject*> objects;
+	QuadFieldSoA objectData;
+};
+
+struct TestQuery {
+	float3 pos;
+	float radius;
+	bool spherical;
+};
+
+
+static constexpr int MAP_SIZE = 8192;
+static constexpr int QUAD_SIZE = 128;
+static constexpr int NUM_QUADS = MAP_SIZE / QUAD_SIZE;
+static constexpr int NUM_OBJECTS = 10000;
+static constexpr int NUM_QUERIES = 100000;
+
+
+static void GetQuads(std::vector<int>& quads, const float3& pos, float radius)
+{
+	const int minX = std::max(int((pos.x - radius) / QUAD_SIZE), 0);
+	const int minZ = std::max(int((pos.z - radius) / QUAD_SIZE), 0);
+	const int maxX = std::min(int((pos.x + radius) / QUAD_SIZE), NUM_QUADS - 1);
+	const int maxZ = std::min(int((pos.z + radius) / QUAD_SIZE), NUM_QUADS - 1);
+
+	quads.clear();
+
+	for (int z = minZ; z <= maxZ; z++) {
+		for (int x = minX; x <= maxX; x++) {
+			quads.push_back(z * NUM_QUADS + x);
+		}
+	}
+}
+
+// both mirror CQuadField::GetUnitsExact, and run the same filters as its two backends
+static void QueryAoS(const std::vector<TestQuad>& quads, const std::vector<int>& qidxs, const TestQuery& q, int tempNum, std::vector<TestObject*>& res)
+{
+	res.clear();
+
+	const auto AddObject = [&](TestObject* o) {
+		if (o->tempNum == tempNum)
+			return;
+
+		o->tempNum = tempNum;
+		res.push_back(o);
+	};
+
+	for (const int qi: qidxs) {
+		QuadFieldSoA::ForEachInSphereScalar(quads[qi].objects, q.pos, q.radius, q.spherical, AddObject);
+	}
+}
+
+static void QuerySoA(const std::vector<TestQuad>& quads, const std::vector<int>& qidxs, const TestQuery& q, int tempNum, std::vector<TestObject*>& res)
+{
+	res.clear();
+
+	const auto AddObject = [&](TestObject* o) {
+		if (o->tempNum == tempNum)
+			return;
+
+		o->tempNum = tempNum;
+		res.push_back(o);
+	};
+
+	for (const int qi: qidxs) {
+		quads[qi].objectData.ForEachInSphere(quads[qi].objects, q.pos, q.radius, q.spherical, AddObject);
+	}
+}
+
+// mirrors CUnit::Move, which refreshes the packed copy but not the quads
+static void MoveObject(std::vector<TestQuad>& quads, TestObject* o, const float3& dv, bool refresh)
+{
+	o->pos += dv;
+
+	if (!refresh)
+		return;
+
+	for (const int qi: o->quads) {
+		CHECK(quads[qi].objectData.Refresh(quads[qi].objects, o));
+	}
+}
+
+static void AddObjects(std::vector<TestQuad>& quads, std::vector<std::unique_ptr<TestObject>>& objects)
+{
+	for (const auto& o: objects) {
+		GetQuads(o->quads, o->pos, o->radius);
+
+		for (const int qi: o->quads) {
+			quads[qi].objects.push_back(o.get());
+			quads[qi].objectData.PushBack(o->pos, o->radius);
+		}
+	}
+}
+
+static int CountDifferingQueries(const std::vector<TestQuad>& quads, const std::vector<TestQuery>& queries, int& tempNum)
+{
+	std::vector<TestObject*> resAoS;
+	std::vector<TestObject*> resSoA;
+	std::vector<int> qidxs;
+
+	int numDiffs = 0;
+
+	for (const TestQuery& q: queries) {
+		GetQuads(qidxs, q.pos, q.radius);
+		QueryAoS(quads, qidxs, q, ++tempNum, resAoS);
+		QuerySoA(quads, qidxs, q, ++tempNum, resSoA);
+
+		numDiffs += (resAoS != resSoA);
+	}
+
+	return numDiffs;
+}
+
+
+
+TEST_CASE("QuadFieldSoA")
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> posDist(0.0f, MAP_SIZE);
+	std::uniform_real_distribution<float> hgtDist(-100.0f, 500.0f);
+	std::uniform_real_distribution<float> radDist(8.0f, 64.0f);
+
+	std::vector<std::unique_ptr<TestObject>> objects;
+	std::vector<TestQuad> quads(NUM_QUADS * NUM_QUADS);
+	std::vector<TestQuery> queries;
+	std::vector<int> qidxs;
+
+	// cluster half of the objects in one corner, as armies tend to be
+	for (int i = 0; i < NUM_OBJECTS; i++) {
+		const float s = (i & 1)? 1.0f: 0.125f;
+
+		objects.emplace_back(new TestObject{{posDist(rng) * s, hgtDist(rng), posDist(rng) * s}, radDist(rng), 0, {}, {}});
+	}
+
+	// allocation order is not spatial order in a real game either
+	std::shuffle(objects.begin(), objects.end(), rng);
+
+	AddObjects(quads, objects);
+
+	// query mix: mostly small (collision/avoidance), some mid (weapon range), few large (explosions, AoE)
+	for (int i = 0; i < NUM_QUERIES; i++) {
+		const float s = (i & 1)? 1.0f: 0.125f;
+		const float r[] = {32.0f, 32.0f, 32.0f, 48.0f, 64.0f, 64.0f, 96.0f, 128.0f, 32.0f, 32.0f, 48.0f, 64.0f, 96.0f, 256.0f, 400.0f, 32.0f};
+
+		queries.push_back({{posDist(rng) * s, hgtDist(rng), posDist(rng) * s}, ((i & 255) == 0)? 1000.0f: r[i & 15], (i % 3) != 0});
+	}
+
+	std::vector<TestObject*> resAoS;
+	std::vector<TestObject*> resSoA;
+
+	size_t numAoS = 0;
+	size_t numSoA = 0;
+	int tempNum = 0;
+
+	{
+		ScopedOnceTimer timer("QuadField::AoS");
+
+		for (const TestQuery& q: queries) {
+			GetQuads(qidxs, q.pos, q.radius);
+			QueryAoS(quads, qidxs, q, ++tempNum, resAoS);
+			numAoS += resAoS.size();
+		}
+	}
+	{
+		ScopedOnceTimer timer("QuadField::SoA");
+
+		for (const TestQuery& q: queries) {
+			GetQuads(qidxs, q.pos, q.radius);
+			QuerySoA(quads, qidxs, q, ++tempNum, resSoA);
+			numSoA += resSoA.size();
+		}
+	}
+
+	CHECK(numAoS == numSoA);
+
+	// both backends must return the same objects in the same order
+	for (const TestQuery& q: queries) {
+		GetQuads(qidxs, q.pos, q.radius);
+		QueryAoS(quads, qidxs, q, ++tempNum, resAoS);
+		QuerySoA(quads, qidxs, q, ++tempNum, resSoA);
+
+		if (resAoS != resSoA) {
+			FAIL("AoS and SoA results differ");
+			break;
+		}
+	}
+
+	// swap-with-back erasure must keep pointers and packed data index-parallel
+	for (TestQuad& quad: quads) {
+		for (size_t i = 0; i < quad.objects.size(); ) {
+			if ((quad.objects[i]->tempNum & 1) == 0) {
+				i++;
+				continue;
+			}
+
+			quad.objects[i] = quad.objects.back();
+			quad.objects.pop_back();
+			quad.objectData.Erase(i);
+		}
+
+		REQUIRE(quad.objects.size() == quad.objectData.Size());
+	}
+
+	for (const TestQuery& q: queries) {
+		GetQuads(qidxs, q.pos, q.radius);
+		QueryAoS(quads, qidxs, q, ++tempNum, resAoS);
+		QuerySoA(quads, qidxs, q, ++tempNum, resSoA);
+
+		if (resAoS != resSoA) {
+			FAIL("AoS and SoA results differ after erasure");
+			break;
+		}
+	}
+}
+
+
+TEST_CASE("QuadFieldSoAMovedObjects")
+{
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> posDist(0.0f, MAP_SIZE);
+	std::uniform_real_distribution<float> radDist(8.0f, 64.0f);
+	std::uniform_real_distribution<float> stepDist(-12.0f, 12.0f);
+
+	std::vector<std::unique_ptr<TestObject>> objects;
+	std::vector<TestQuad> quads(NUM_QUADS * NUM_QUADS);
+	std::vector<TestQuery> queries;
+
+	// dense enough for most small queries to hit something
+	for (int i = 0; i < NUM_OBJECTS; i++) {
+		objects.emplace_back(new TestObject{{posDist(rng) * 0.25f, 0.0f, posDist(rng) * 0.25f}, radDist(rng), 0, {}, {}});
+	}
+	for (int i = 0; i < NUM_QUERIES / 10; i++) {
+		queries.push_back({{posDist(rng) * 0.25f, 0.0f, posDist(rng) * 0.25f}, 48.0f, (i & 1) != 0});
+	}
+
+	AddObjects(quads, objects);
+
+	int tempNum = 0;
+
+	// units move every frame, but only change quads (MovedUnit) at SlowUpdate
+	// cadence; the packed copy has to follow every move regardless
+	for (int frame = 0; frame < 16; frame++) {
+		for (const auto& o: objects) {
+			MoveObject(quads, o.get(), {stepDist(rng), 0.0f, stepDist(rng)}, true);
+		}
+
+		CHECK(CountDifferingQueries(quads, queries, tempNum) == 0);
+	}
+
+	// sanity-check the test itself: a stale copy does make the backends disagree
+	for (const auto& o: objects) {
+		MoveObject(quads, o.get(), {stepDist(rng), 0.0f, stepDist(rng)}, false);
+	}
+
+	CHECK(CountDifferingQueries(quads, queries, tempNum) != 0);
+}
@@ -0,0 +1,280 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Misc/QuadField.h"
+#include "System/float3.h"
+#include "System/SpringMath.h"
+#include "System/Misc/SpringTime.h"
+#include "System/Platform/Threading.h"
+#include "System/Threading/ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <random>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+
+struct do_once {
+	do_once() { Threading::DetectCores(); } // make GetMaxThreads() work
+};
+
+InitSpringTime ist;
+do_once doonce;
+
+
+// in heightmap squares; gives 64x64 quads
+static constexpr int WIDTH  = 1024;
+static constexpr int HEIGHT = 1024;
+static constexpr int NUM_RAYS = 4096;
+static constexpr int NUM_RUNS = 200;
+
+static constexpr int NUM_CIRCLES = 4096;
+static constexpr int NUM_OBJECTS = 8192;
+
+struct Ray {
+	float3 start;
+	float3 dir;
+	float length;
+};
+
+struct Circle {
+	float3 pos;
+	float radius;
+};
+
+
+TEST_CASE("QueryVectorCache")
+{
+	QueryVectorCache<int> cache;
+
+	std::vector<int>* a = cache.ReserveVector();
+	std::vector<int>* b = cache.ReserveVector();
+	std::vector<int>* c = cache.ReserveVector();
+
+	CHECK(a != b);
+	CHECK(b != c);
+	CHECK(a != c);
+
+	// a released slot is handed out again, the others stay taken
+	cache.ReleaseVector(b);
+	CHECK(cache.ReserveVector() == b);
+
+	cache.ReleaseAll();
+	CHECK(cache.ReserveVector() == a);
+	CHECK(cache.ReserveVector(2) == c);
+}
+
+
+TEST_CASE("QuadFieldConcurrentQueries")
+{
+	ThreadPool::SetMaximumThreadCount();
+
+	quadField.Init(int2(WIDTH, HEIGHT), CQuadField::BASE_QUAD_SIZE);
+
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> unitDist(0.0f, 1.0f);
+
+	std::vector<Ray> rays(NUM_RAYS);
+	std::vector< std::vector<int> > expected(NUM_RAYS);
+
+	for (Ray& ray: rays) {
+		ray.start = {unitDist(rng) * WIDTH * SQUARE_SIZE, 0.0f, unitDist(rng) * HEIGHT * SQUARE_SIZE};
+		ray.dir = float3(unitDist(rng) - 0.5f, 0.0f, unitDist(rng) - 0.5f).SafeNormalize();
+		ray.length = unitDist(rng) * (WIDTH + HEIGHT) * SQUARE_SIZE * 0.125f;
+	}
+
+	// serial reference results
+	for (int i = 0; i < NUM_RAYS; i++) {
+		QuadFieldQuery qfQuery;
+		quadField.GetQuadsOnRay(qfQuery, rays[i].start, rays[i].dir, rays[i].length);
+		expected[i] = *qfQuery.quads;
+	}
+
+	std::atomic<int> numMismatches = {0};
+	std::atomic<int> numQueries = {0};
+
+	{
+		CQuadField::ReadOnlyScope qfScope;
+
+		for (int n = 0; n < NUM_RUNS; n++) {
+			for_mt(0, NUM_RAYS, [&](const int i) {
+				const Ray& ray = rays[i];
+				const Ray& rev = rays[NUM_RAYS - 1 - i];
+
+				// keep several vectors of the same pool reserved at once
+				QuadFieldQuery qfQueryA;
+				QuadFieldQuery qfQueryB;
+
+				quadField.GetQuadsOnRay(qfQueryA, ray.start, ray.dir, ray.length);
+				quadField.GetQuadsOnRay(qfQueryB, rev.start, rev.dir, rev.length);
+
+				{
+					QuadFieldQuery qfQueryC;
+					quadField.GetQuadsOnRay(qfQueryC, ray.start, ray.dir, ray.length);
+					numMismatches += (*qfQueryC.quads != *qfQueryA.quads);
+				}
+
+				numMismatches += (*qfQueryA.quads != expected[i]);
+				numMismatches += (*qfQueryB.quads != expected[NUM_RAYS - 1 - i]);
+				numQueries += 3;
+			});
+		}
+	}
+
+	CHECK(numQueries == (NUM_RUNS * NUM_RAYS * 3));
+	CHECK(numMismatches == 0);
+	CHECK_FALSE(quadField.InReadOnlyMode());
+
+	quadField.Kill();
+	ThreadPool::SetThreadCount(0);
+}
+
+
+TEST_CASE("QuadFieldConcurrentMtQueries")
+{
+	ThreadPool::SetMaximumThreadCount();
+
+	quadField.Init(int2(WIDTH, HEIGHT), CQuadField::BASE_QUAD_SIZE);
+
+	float3::maxxpos = WIDTH * SQUARE_SIZE - 1.0f;
+	float3::maxzpos = HEIGHT * SQUARE_SIZE - 1.0f;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unitDist(0.0f, 1.0f);
+
+	std::vector<Circle> circles(NUM_CIRCLES);
+	std::vector< std::vector<int> > expected(NUM_CIRCLES);
+
+	for (Circle& circle: circles) {
+		circle.pos = {unitDist(rng) * WIDTH * SQUARE_SIZE, 0.0f, unitDist(rng) * HEIGHT * SQUARE_SIZE};
+		circle.radius = unitDist(rng) * CQuadField::BASE_QUAD_SIZE * 4.0f;
+	}
+
+	// serial reference results, from the pooled query
+	for (int i = 0; i < NUM_CIRCLES; i++) {
+		QuadFieldQuery qfQuery;
+		quadField.GetQuads(qfQuery, circles[i].pos, circles[i].radius);
+		expected[i] = *qfQuery.quads;
+	}
+
+	std::atomic<int> numMismatches = {0};
+	std::atomic<int> numQueries = {0};
+
+	// caller-owned result vectors, one per thread as in MoveType pre-passes
+	std::array<std::vector<int>, ThreadPool::MAX_THREADS> threadQuads;
+
+	for (int n = 0; n < NUM_RUNS / 4; n++) {
+		// the *Mt variants need no ReadOnlyScope
+		for_mt(0, NUM_CIRCLES, [&](const int i) {
+			std::vector<int>& quads = threadQuads[ThreadPool::GetThreadNum()];
+
+			quadField.GetQuadsMt(quads, circles[i].pos, circles[i].radius);
+
+			numMismatches += (quads != expected[i]);
+			numQueries += 1;
+		});
+
+		// the pooled variant under a ReadOnlyScope, mixed with *Mt calls
+		CQuadField::ReadOnlyScope qfScope;
+
+		for_mt(0, NUM_CIRCLES, [&](const int i) {
+			std::vector<int>& quads = threadQuads[ThreadPool::GetThreadNum()];
+
+			QuadFieldQuery qfQuery;
+			quadField.GetQuads(qfQuery, circles[i].pos, circles[i].radius);
+			quadField.GetQuadsMt(quads, circles[NUM_CIRCLES - 1 - i].pos, circles[NUM_CIRCLES - 1 - i].radius);
+
+			numMismatches += (*qfQuery.quads != expected[i]);
+			numMismatches += (quads != expected[NUM_CIRCLES - 1 - i]);
+			numQueries += 2;
+		});
+	}
+
+	CHECK(numQueries == ((NUM_RUNS / 4) * NUM_CIRCLES * 3));
+	CHECK(numMismatches == 0);
+	CHECK_FALSE(quadField.InReadOnlyMode());
+
+	quadField.Kill();
+	ThreadPool::SetThreadCount(0);
+}
+
+
+TEST_CASE("QueryObjectStampsConcurrentDedup")
+{
+	ThreadPool::SetMaximumThreadCount();
+
+	// objects overlapping several quads are listed in each of them; a query
+	// over a set of quads must report every object once, in order of first
+	// appearance, just like the tempNum-based serial queries do
+	static constexpr int NUM_QUADS = 256;
+	static constexpr int QUADS_PER_QUERY = 9;
+
+	std::mt19937 rng(5678);
+	std::uniform_int_distribution<int> quadDist(0, NUM_QUADS - 1);
+	std::uniform_int_distribution<int> spanDist(1, 4);
+
+	std::vector< std::vector<int> > quadObjects(NUM_QUADS);
+	std::vector< std::array<int, QUADS_PER_QUERY> > queries(NUM_CIRCLES);
+	std::vector< std::vector<int> > expected(NUM_CIRCLES);
+
+	for (int id = 0; id < NUM_OBJECTS; id++) {
+		const int firstQuad = quadDist(rng);
+		const int numQuads = spanDist(rng);
+
+		for (int q = 0; q < numQuads; q++) {
+			quadObjects[(firstQuad + q) % NUM_QUADS].push_back(id);
+		}
+	}
+
+	for (int i = 0; i < NUM_CIRCLES; i++) {
+		for (int& qi: queries[i]) {
+			qi = quadDist(rng);
+		}
+
+		for (const int qi: queries[i]) {
+			for (const int id: quadObjects[qi]) {
+				if (std::find(expected[i].begin(), expected[i].end(), id) != expected[i].end())
+					continue;
+
+				expected[i].push_back(id);
+			}
+		}
+	}
+
+	struct ThreadState {
+		QueryObjectStamps stamps;
+		std::vector<int> found;
+		int curStamp = 0;
+	};
+
+	std::array<ThreadState, ThreadPool::MAX_THREADS> threadStates;
+	std::atomic<int> numMismatches = {0};
+
+	for (int n = 0; n < NUM_RUNS / 4; n++) {
+		for_mt(0, NUM_CIRCLES, [&](const int i) {
+			ThreadState& state = threadStates[ThreadPool::GetThreadNum()];
+
+			const int stamp = ++state.curStamp;
+
+			state.found.clear();
+
+			for (const int qi: queries[i]) {
+				for (const int id: quadObjects[qi]) {
+					if (state.stamps.Visited(id, stamp))
+						continue;
+
+					state.found.push_back(id);
+				}
+			}
+
+			numMismatches += (state.found != expected[i]);
+		});
+	}
+
+	CHECK(numMismatches == 0);
+
+	ThreadPool::SetThreadCount(0);
+}
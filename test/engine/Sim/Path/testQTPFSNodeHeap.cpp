@@ -0,0 +1,125 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Path/QTPFS/NodeHeap.hpp"
+
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+
+struct TestNode {
+	void SetHeapIndex(unsigned int n) { heapIndex = n; }
+	unsigned int GetHeapIndex() const { return heapIndex; }
+	float GetHeapPriority() const { return priority; }
+
+	float priority = 0.0f;
+	unsigned int heapIndex = -1u;
+};
+
+typedef std::set< std::pair<float, const TestNode*> > ReferenceQueue;
+
+
+static void CheckTop(QTPFS::quaternary_heap<TestNode*>& heap, const ReferenceQueue& queue)
+{
+	REQUIRE(heap.size() == queue.size());
+
+	if (queue.empty())
+		return;
+
+	// ties can be broken either way, only the priority has to match
+	CHECK(heap.top()->GetHeapPriority() == queue.begin()->first);
+	CHECK(heap.top()->GetHeapIndex() == 0);
+}
+
+
+TEST_CASE("QuaternaryHeapRandomized")
+{
+	static constexpr unsigned int NUM_NODES = 2000;
+	static constexpr unsigned int NUM_ROUNDS = 20;
+	static constexpr unsigned int NUM_OPS = 10000;
+
+	std::mt19937 rng(12345);
+	std::uniform_real_distribution<float> prioDist(0.0f, 1000.0f);
+	std::uniform_int_distribution<unsigned int> nodeDist(0, NUM_NODES - 1);
+	std::uniform_int_distribution<unsigned int> opDist(0, 99);
+
+	std::vector<TestNode> nodes(NUM_NODES);
+
+	// small initial capacity, so push() also has to grow the heap
+	QTPFS::quaternary_heap<TestNode*> heap(4);
+	ReferenceQueue queue;
+
+	for (unsigned int round = 0; round < NUM_ROUNDS; round++) {
+		for (unsigned int op = 0; op < NUM_OPS; op++) {
+			TestNode* node = &nodes[nodeDist(rng)];
+
+			const unsigned int opType = opDist(rng);
+			const bool isQueued = (node->GetHeapIndex() != -1u);
+
+			if (opType < 45) {
+				// push, or change the priority of a queued node (both directions)
+				if (isQueued)
+					queue.erase({node->priority, node});
+
+				// coarse priorities also exercise ties
+				node->priority = float(int(prioDist(rng)) / 8);
+				queue.insert({node->priority, node});
+
+				if (isQueued) {
+					heap.resort(node);
+				} else {
+					heap.push(node);
+				}
+			} else if (!queue.empty()) {
+				TestNode* top = heap.top();
+
+				CHECK(top->GetHeapPriority() == queue.begin()->first);
+				CHECK(queue.erase({top->priority, top}) == 1);
+
+				heap.pop();
+
+				CHECK(top->GetHeapIndex() == -1u);
+			}
+
+			CheckTop(heap, queue);
+		}
+
+		// every queued node must know its own position
+		for (const TestNode& node: nodes) {
+			if (node.GetHeapIndex() == -1u)
+				continue;
+
+			CHECK(node.GetHeapIndex() < heap.size());
+			CHECK(queue.find({node.priority, &node}) != queue.end());
+		}
+
+		// drain in order every other round, reset the rest (as searches do)
+		if ((round & 1) == 0) {
+			float prevPriority = -1.0f;
+
+			while (!heap.empty()) {
+				TestNode* top = heap.top();
+
+				CHECK(top->GetHeapPriority() >= prevPriority);
+				CHECK(queue.erase({top->priority, top}) == 1);
+
+				prevPriority = top->GetHeapPriority();
+				heap.pop();
+			}
+
+			CHECK(queue.empty());
+		} else {
+			heap.reset();
+			queue.clear();
+
+			// reset() leaves stale heap-indices behind, the owner clears them
+			for (TestNode& node: nodes) {
+				node.SetHeapIndex(-1u);
+			}
+		}
+	}
+}
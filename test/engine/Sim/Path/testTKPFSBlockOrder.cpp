@@ -0,0 +1,209 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Path/TKPFS/PathBlockOrder.h"
+
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+
+// a miniature PathingState: every block has an offset that depends on its
+// terrain, and +x, +x+z, +z and -x+z vertices that depend on the offsets of
+// both of their end blocks
+struct TestPathingState {
+	static constexpr int NUM_DIRS = 4;
+
+	TestPathingState(int2 dims)
+		: mapDims(dims)
+		, terrain(dims.x * dims.y, 0)
+		, offsets(dims.x * dims.y, 0)
+		, vertexCosts(dims.x * dims.y * NUM_DIRS, 0)
+		, blockDemand(dims.x * dims.y, 0)
+		, blockPriority(dims.x * dims.y, 0)
+		, obsolete(dims.x * dims.y, false)
+	{}
+
+	int BlockIdx(const int2& pos) const { return (pos.y * mapDims.x + pos.x); }
+
+	std::int64_t CalcOffset(const int2& pos) const { return (terrain[BlockIdx(pos)] * 131 + BlockIdx(pos)); }
+
+	void CalcVertexCosts(const int2& pos) {
+		const int2 childOffsets[NUM_DIRS] = {{+1, 0}, {+1, +1}, {0, +1}, {-1, +1}};
+
+		for (int dir = 0; dir < NUM_DIRS; dir++) {
+			const int2 childPos = pos + childOffsets[dir];
+			std::int64_t& cost = vertexCosts[BlockIdx(pos) * NUM_DIRS + dir];
+
+			if ((unsigned)childPos.x >= (unsigned)mapDims.x || (unsigned)childPos.y >= (unsigned)mapDims.y) {
+				cost = -1;
+				continue;
+			}
+
+			cost = offsets[BlockIdx(pos)] * 1000003 + offsets[BlockIdx(childPos)];
+		}
+	}
+
+	void FullRecompute() {
+		for (int z = 0; z < mapDims.y; z++) {
+			for (int x = 0; x < mapDims.x; x++) {
+				offsets[BlockIdx({x, z})] = CalcOffset({x, z});
+			}
+		}
+		for (int z = 0; z < mapDims.y; z++) {
+			for (int x = 0; x < mapDims.x; x++) {
+				CalcVertexCosts({x, z});
+			}
+		}
+	}
+
+	// same marking (with a one-block border) and order as PathingState::MapChanged
+	void MapChanged(int x1, int z1, int x2, int z2) {
+		const int lowerX = std::max(x1 - 1, 0);
+		const int upperX = std::min(x2 + 1, mapDims.x - 1);
+		const int lowerZ = std::max(z1 - 1, 0);
+		const int upperZ = std::min(z2 + 1, mapDims.y - 1);
+
+		for (int z = upperZ; z >= lowerZ; z--) {
+			for (int x = upperX; x >= lowerX; x--) {
+				if (obsolete[BlockIdx({x, z})])
+					continue;
+
+				obsolete[BlockIdx({x, z})] = true;
+				updatedBlocks.emplace_back(x, z);
+			}
+		}
+	}
+
+	// same steps as PathingState::UpdateVertexPathCosts
+	void UpdateVertexCosts(unsigned int blocksToUpdate) {
+		if (updatedBlocks.size() > blocksToUpdate) {
+			queuedBlocks.clear();
+
+			for (const int2& pos: updatedBlocks) {
+				if (obsolete[BlockIdx(pos)])
+					queuedBlocks.push_back(pos);
+			}
+
+			TKPFS::SortBlocksByDemand(queuedBlocks, sortedQueuedBlocks, blockPriority, blockDemand, mapDims);
+			updatedBlocks.assign(queuedBlocks.begin(), queuedBlocks.end());
+		}
+
+		consumedBlocks.clear();
+
+		while (!updatedBlocks.empty() && consumedBlocks.size() < blocksToUpdate) {
+			const int2 pos = updatedBlocks.front();
+
+			updatedBlocks.pop_front();
+
+			if (!obsolete[BlockIdx(pos)])
+				continue;
+
+			consumedBlocks.push_back(pos);
+			obsolete[BlockIdx(pos)] = false;
+		}
+
+		for (const int2& pos: consumedBlocks) {
+			offsets[BlockIdx(pos)] = CalcOffset(pos);
+		}
+		for (const int2& pos: consumedBlocks) {
+			CalcVertexCosts(pos);
+		}
+	}
+
+	int2 mapDims;
+
+	std::vector<std::int64_t> terrain;
+	std::vector<std::int64_t> offsets;
+	std::vector<std::int64_t> vertexCosts;
+	std::vector<std::uint32_t> blockDemand;
+	std::vector<std::uint32_t> blockPriority;
+	std::vector<bool> obsolete;
+
+	std::deque<int2> updatedBlocks;
+	std::vector<int2> queuedBlocks;
+	std::vector<int2> sortedQueuedBlocks;
+	std::vector<int2> consumedBlocks;
+};
+
+
+TEST_CASE("SortBlocksByDemandKeepsVertexCostsConsistent")
+{
+	static constexpr int NUM_ROUNDS = 200;
+	static constexpr unsigned int BLOCKS_PER_UPDATE = 6;
+
+	const int2 mapDims = {24, 20};
+
+	std::mt19937 rng(4321);
+	std::uniform_int_distribution<int> xDist(0, mapDims.x - 1);
+	std::uniform_int_distribution<int> zDist(0, mapDims.y - 1);
+	std::uniform_int_distribution<int> sizeDist(0, 3);
+	std::uniform_int_distribution<int> demandDist(0, 9);
+
+	TestPathingState state(mapDims);
+	TestPathingState reference(mapDims);
+
+	state.FullRecompute();
+
+	for (int round = 0; round < NUM_ROUNDS; round++) {
+		// change the terrain of a random rectangle
+		const int x1 = xDist(rng);
+		const int z1 = zDist(rng);
+		const int x2 = std::min(x1 + sizeDist(rng), mapDims.x - 1);
+		const int z2 = std::min(z1 + sizeDist(rng), mapDims.y - 1);
+
+		for (int z = z1; z <= z2; z++) {
+			for (int x = x1; x <= x2; x++) {
+				state.terrain[state.BlockIdx({x, z})] += 1 + (round & 3);
+			}
+		}
+
+		state.MapChanged(x1, z1, x2, z2);
+
+		// paths come and go, so the demand changes between updates
+		for (std::uint32_t& demand: state.blockDemand) {
+			demand = (demandDist(rng) < 2) * demandDist(rng);
+		}
+
+		state.UpdateVertexCosts(BLOCKS_PER_UPDATE);
+	}
+
+	while (!state.updatedBlocks.empty()) {
+		state.UpdateVertexCosts(BLOCKS_PER_UPDATE);
+	}
+
+	reference.terrain = state.terrain;
+	reference.FullRecompute();
+
+	CHECK(state.offsets == reference.offsets);
+	CHECK(state.vertexCosts == reference.vertexCosts);
+
+	for (const std::uint32_t priority: state.blockPriority) {
+		CHECK(priority == 0);
+	}
+}
+
+
+TEST_CASE("SortBlocksByDemandOrder")
+{
+	const int2 mapDims = {4, 4};
+
+	std::vector<std::uint32_t> blockDemand(mapDims.x * mapDims.y, 0);
+	std::vector<std::uint32_t> blockPriority(mapDims.x * mapDims.y, 0);
+	std::vector<int2> sortedBlocks;
+
+	// (1, 1) is in demand; its dirty +x and +z neighbours have to come first,
+	// the unrelated blocks keep their queue order behind them
+	std::vector<int2> blocks = {{3, 3}, {0, 0}, {1, 1}, {3, 0}, {1, 2}, {2, 1}};
+
+	blockDemand[1 * mapDims.x + 1] = 5;
+
+	TKPFS::SortBlocksByDemand(blocks, sortedBlocks, blockPriority, blockDemand, mapDims);
+
+	const std::vector<int2> expected = {{1, 2}, {2, 1}, {1, 1}, {3, 3}, {0, 0}, {3, 0}};
+
+	CHECK(blocks == expected);
+}
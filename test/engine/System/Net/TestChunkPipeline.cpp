@@ -0,0 +1,286 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Net/Protocol/BaseNetProtocol.h"
+#include "System/GlobalConfig.h"
+#include "System/Net/LoopbackConnection.h"
+#include "System/Net/Socket.h"
+#include "System/Net/UDPConnection.h"
+#include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <random>
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+InitSpringTime ist;
+
+
+// count every heap allocation made by the process
+static std::atomic<size_t> numAllocs = {0};
+
+void* operator new(size_t size)
+{
+	numAllocs += 1;
+
+	if (void* p = std::malloc((size > 0)? size: 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+
+static constexpr int NUM_WARMUP_ROUNDS = 200;
+static constexpr int NUM_ROUNDS = 2000;
+
+// per round: a burst of tiny frame messages and one that spans several chunks
+static constexpr int NUM_SMALL_MSGS = 8;
+static constexpr int LARGE_MSG_SIZE = 600;
+
+
+struct PipelineStats {
+	size_t numMsgs = 0;
+	size_t numBytes = 0;
+	size_t numAllocs = 0;
+	std::clock_t cpuTime = 0;
+
+	void Log(const char* name) const {
+		const float cpuSecs = cpuTime * 1.0f / CLOCKS_PER_SEC;
+		const float megaBytes = numBytes / (1024.0f * 1024.0f);
+
+		LOG("[%s] %lu messages (%.2fMB): %.3f allocations per message, %.2fms CPU per MB",
+			name, (unsigned long) numMsgs, megaBytes, numAllocs * 1.0f / numMsgs, cpuSecs * 1000.0f / megaBytes);
+	}
+};
+
+template<typename SendFunc, typename RecvFunc>
+static PipelineStats RunPipeline(const SendFunc& sendRound, const RecvFunc& recvRound)
+{
+	PipelineStats stats;
+
+	for (int i = 0; i < NUM_WARMUP_ROUNDS; i++) {
+		sendRound();
+		recvRound(stats);
+	}
+
+	stats = {};
+
+	const size_t numAllocs0 = numAllocs;
+	const std::clock_t cpuTime0 = std::clock();
+
+	for (int i = 0; i < NUM_ROUNDS; i++) {
+		sendRound();
+		recvRound(stats);
+	}
+
+	stats.cpuTime = std::clock() - cpuTime0;
+	stats.numAllocs = numAllocs - numAllocs0;
+	return stats;
+}
+
+
+TEST_CASE("ChunkPipeline")
+{
+	// the pipeline is measured, not the link
+	globalConfig.linkOutgoingBandwidth = 0;
+
+	const std::shared_ptr<const netcode::RawPacket> smallMsg = CBaseNetProtocol::Get().SendNewFrame();
+	const std::shared_ptr<const netcode::RawPacket> largeMsg = CBaseNetProtocol::Get().SendLuaMsg(0, 0, 0, std::vector<std::uint8_t>(LARGE_MSG_SIZE, 0x5A));
+
+	const size_t numMsgsPerRound = NUM_SMALL_MSGS + 1;
+	const size_t numBytesPerRound = NUM_SMALL_MSGS * smallMsg->length + largeMsg->length;
+
+	const auto SendRound = [&](netcode::CConnection& conn) {
+		for (int j = 0; j < NUM_SMALL_MSGS; j++) {
+			conn.SendData(smallMsg);
+		}
+
+		conn.SendData(largeMsg);
+	};
+	const auto RecvAll = [&](netcode::CConnection& conn, PipelineStats& stats) {
+		for (std::shared_ptr<const netcode::RawPacket> msg; (msg = conn.GetData()) != nullptr; ) {
+			stats.numMsgs += 1;
+			stats.numBytes += msg->length;
+		}
+	};
+
+	// baseline: the CConnection interface itself, without any chunking
+	{
+		netcode::CLoopbackConnection loopConn;
+
+		const PipelineStats stats = RunPipeline(
+			[&]() { SendRound(loopConn); },
+			[&](PipelineStats& s) { RecvAll(loopConn, s); }
+		);
+
+		stats.Log("Loopback");
+		CHECK(stats.numMsgs == (NUM_ROUNDS * numMsgsPerRound));
+	}
+
+	// a sender and a receiver on their own sockets, acking every round; the
+	// receiver also talks back once per round (like clients echoing frames),
+	// otherwise packets from a side that never got a chunk look like rejoins
+	{
+		netcode::UDPConnection sender(11115, "127.0.0.1", 11116);
+		netcode::UDPConnection receiver(11116, "127.0.0.1", 11115);
+
+		sender.Unmute();
+		receiver.Unmute();
+
+		const PipelineStats stats = RunPipeline(
+			[&]() {
+				SendRound(sender);
+				sender.Flush(true);
+			},
+			[&](PipelineStats& s) {
+				PipelineStats echoStats;
+
+				receiver.Update();
+				RecvAll(receiver, s);
+				receiver.SendData(smallMsg);
+				receiver.Flush(true);
+				sender.Update();
+				RecvAll(sender, echoStats);
+			}
+		);
+
+		stats.Log("UDPConnection");
+
+		CHECK(stats.numMsgs == (NUM_ROUNDS * numMsgsPerRound));
+		CHECK(stats.numBytes == (NUM_ROUNDS * numBytesPerRound));
+
+		// only delivering the received messages (and echoes) may allocate, as
+		// RawPacket plus shared_ptr; chunking, acks and resends must not
+		CHECK((stats.numAllocs * 1.0f / stats.numMsgs) <= 2.5f);
+	}
+}
+
+
+// forwards datagrams between two ports, dropping and reordering some
+class LossyProxy {
+public:
+	LossyProxy(int port, int portA, int portB)
+		: socket(netcode::netservice, asio::ip::udp::endpoint(asio::ip::address_v4::loopback(), port))
+		, addrA(asio::ip::address_v4::loopback(), portA)
+		, addrB(asio::ip::address_v4::loopback(), portB)
+		, buffer(4096)
+		, rng(9876)
+	{
+		socket.non_blocking(true);
+	}
+
+	void Pump() {
+		asio::ip::udp::endpoint sender;
+		asio::error_code err;
+
+		while (socket.available() > 0) {
+			const size_t size = socket.receive_from(asio::buffer(buffer), sender, 0, err);
+
+			if (err)
+				break;
+
+			const asio::ip::udp::endpoint& target = (sender == addrA)? addrB: addrA;
+			const unsigned int r = rng() % 100;
+
+			// drop 10%, hold back another 10% until the next datagram has gone out
+			if (r < 10)
+				continue;
+
+			if (r < 20 && held.empty()) {
+				held.assign(buffer.begin(), buffer.begin() + size);
+				heldTarget = target;
+				continue;
+			}
+
+			socket.send_to(asio::buffer(buffer.data(), size), target);
+
+			if (!held.empty()) {
+				socket.send_to(asio::buffer(held), heldTarget);
+				held.clear();
+			}
+		}
+	}
+
+private:
+	asio::ip::udp::socket socket;
+	asio::ip::udp::endpoint addrA;
+	asio::ip::udp::endpoint addrB;
+	asio::ip::udp::endpoint heldTarget;
+
+	std::vector<std::uint8_t> buffer;
+	std::vector<std::uint8_t> held;
+
+	std::mt19937 rng;
+};
+
+
+TEST_CASE("ChunkPipelineLossy")
+{
+	globalConfig.linkOutgoingBandwidth = 0;
+
+	static constexpr int NUM_MSGS = 300;
+
+	// sequence numbers in the payload, message sizes spanning up to five chunks
+	std::vector< std::shared_ptr<const netcode::RawPacket> > msgs;
+
+	for (int i = 0; i < NUM_MSGS; i++) {
+		std::vector<std::uint8_t> payload(1 + (i * 37) % 1200, std::uint8_t(i));
+		std::memcpy(payload.data(), &i, std::min(payload.size(), sizeof(i)));
+		msgs.push_back(CBaseNetProtocol::Get().SendLuaMsg(0, 0, 0, payload));
+	}
+
+	for (const int lossFactor: {netcode::UDPConnection::MIN_LOSS_FACTOR, netcode::UDPConnection::MAX_LOSS_FACTOR}) {
+		LossyProxy proxy(11117, 11115, 11116);
+
+		netcode::UDPConnection sender(11115, "127.0.0.1", 11117);
+		netcode::UDPConnection receiver(11116, "127.0.0.1", 11117);
+
+		sender.SetLossFactor(lossFactor);
+		receiver.SetLossFactor(lossFactor);
+		sender.Unmute();
+		receiver.Unmute();
+
+		int numSent = 0;
+		int numReceived = 0;
+		int numCorrupted = 0;
+
+		const spring_time t0 = spring_gettime();
+
+		while (numReceived < NUM_MSGS && (spring_gettime() - t0) < spring_secs(20)) {
+			for (int j = 0; j < 3 && numSent < NUM_MSGS; j++) {
+				sender.SendData(msgs[numSent++]);
+			}
+
+			sender.Update();
+			proxy.Pump();
+			receiver.Update();
+
+			for (std::shared_ptr<const netcode::RawPacket> msg; (msg = receiver.GetData()) != nullptr; numReceived++) {
+				const netcode::RawPacket* ref = msgs[numReceived].get();
+				numCorrupted += (msg->length != ref->length || std::memcmp(msg->data, ref->data, ref->length) != 0);
+			}
+
+			receiver.SendData(CBaseNetProtocol::Get().SendNewFrame());
+			receiver.Update();
+			proxy.Pump();
+			sender.Update();
+
+			while (sender.GetData() != nullptr);
+
+			spring_sleep(spring_msecs(2));
+		}
+
+		LOG("[%s] loss-factor %d: %d of %d messages after %.2fs\n%s", __func__, lossFactor, numReceived, NUM_MSGS, (spring_gettime() - t0).toSecsf(), sender.Statistics().c_str());
+
+		CHECK(numReceived == NUM_MSGS);
+		CHECK(numCorrupted == 0);
+	}
+}
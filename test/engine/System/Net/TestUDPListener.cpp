@@ -1,6 +1,13 @@
 
 #include "System/Net/UDPListener.h"
+#include "System/Net/EventWaiter.h"
+#include "System/Net/UDPBatchIO.h"
+#include "System/Net/Socket.h"
 #include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
+#include "System/Threading/SpringThreading.h"
+
+#include <cstring>
 
 
 #define CATCH_CONFIG_MAIN
@@ -89,3 +96,172 @@ TEST_CASE("TryBindSocket")
 	t.TestPort(-1, false);
 }
 
+
+
+InitSpringTime ist;
+
+TEST_CASE("EventWaiter")
+{
+	std::shared_ptr<asio::ip::udp::socket> socket;
+
+	REQUIRE(netcode::UDPListener::TryBindSocket(11112, socket, "127.0.0.1").empty());
+
+	netcode::EventWaiter waiter;
+	waiter.AddSocket(socket.get());
+
+	// nothing happens, deadline must be honored
+	{
+		const spring_time t0 = spring_gettime();
+		waiter.Wait(t0 + spring_msecs(50));
+		CHECK((spring_gettime() - t0).toMilliSecsi() >= 49);
+	}
+
+	// a wakeup issued before Wait must not be lost, and is reported as pending
+	{
+		waiter.Wake();
+
+		const spring_time t0 = spring_gettime();
+		CHECK(!waiter.Wait(t0 + spring_msecs(5000)).isTime());
+		CHECK((spring_gettime() - t0).toMilliSecsi() < 1000);
+	}
+
+	// wakeup from another thread, stamped when it happened
+	{
+		const spring_time t0 = spring_gettime();
+		spring::thread waker([&]() { spring_sleep(spring_msecs(20)); waiter.Wake(); });
+		const spring_time wakeTime = waiter.Wait(t0 + spring_msecs(5000));
+		waker.join();
+		CHECK((spring_gettime() - t0).toMilliSecsi() < 1000);
+		CHECK(wakeTime.isTime());
+		CHECK((wakeTime - t0).toMilliSecsi() >= 19);
+		CHECK(wakeTime <= spring_gettime());
+	}
+
+	// an incoming datagram
+	{
+		asio::ip::udp::socket sender(netcode::netservice, asio::ip::udp::endpoint(asio::ip::udp::v4(), 0));
+		const unsigned char data[4] = {1, 2, 3, 4};
+
+		const spring_time t0 = spring_gettime();
+		sender.send_to(asio::buffer(data), socket->local_endpoint());
+		waiter.Wait(t0 + spring_msecs(5000));
+		CHECK((spring_gettime() - t0).toMilliSecsi() < 1000);
+
+		// drain it, then wait for the timeout again
+		std::vector<unsigned char> buf(16);
+		asio::ip::udp::endpoint from;
+		CHECK(socket->receive_from(asio::buffer(buf), from) == sizeof(data));
+
+		const spring_time t1 = spring_gettime();
+		waiter.Wait(t1 + spring_msecs(50));
+		CHECK((spring_gettime() - t1).toMilliSecsi() >= 49);
+	}
+
+	waiter.RemoveSockets();
+}
+
+
+
+TEST_CASE("UDPBatchIOThroughput")
+{
+	// small enough per round to never overflow the default receive buffer
+	static constexpr int NUM_ROUNDS = 500;
+	static constexpr int NUM_PER_ROUND = 128;
+	static constexpr int DATAGRAM_SIZE = 200;
+
+	std::shared_ptr<asio::ip::udp::socket> recvSocket;
+	std::shared_ptr<asio::ip::udp::socket> sendSocket;
+
+	REQUIRE(netcode::UDPListener::TryBindSocket(11113, recvSocket, "127.0.0.1").empty());
+	REQUIRE(netcode::UDPListener::TryBindSocket(11114, sendSocket, "127.0.0.1").empty());
+
+	recvSocket->non_blocking(true);
+	sendSocket->non_blocking(true);
+
+	const asio::ip::udp::endpoint recvAddr = recvSocket->local_endpoint();
+	const asio::ip::udp::endpoint sendAddr = sendSocket->local_endpoint();
+
+	std::vector<std::uint8_t> sendBuffer(DATAGRAM_SIZE, 0xAB);
+	std::vector<std::uint8_t> recvBuffer(netcode::UDPBatchIO::MAX_DATAGRAM_SIZE);
+
+	int numReceived = 0;
+	int numMisordered = 0;
+
+	// datagrams carry their sequence number, loopback preserves order
+	const auto CheckDatagram = [&](const std::uint8_t* data, size_t size, const asio::ip::udp::endpoint& sender) {
+		int seqNum = -1;
+		std::memcpy(&seqNum, data, sizeof(seqNum));
+
+		numMisordered += (seqNum != numReceived || size != DATAGRAM_SIZE || sender != sendAddr);
+		numReceived += 1;
+	};
+
+	// one send_to / receive_from per datagram, as UDPConnection and UDPListener do without batching
+	{
+		numReceived = 0;
+		numMisordered = 0;
+
+		const spring_time t0 = spring_gettime();
+
+		for (int r = 0, seqNum = 0; r < NUM_ROUNDS; r++) {
+			for (int i = 0; i < NUM_PER_ROUND; i++, seqNum++) {
+				std::memcpy(sendBuffer.data(), &seqNum, sizeof(seqNum));
+				sendSocket->send_to(asio::buffer(sendBuffer), recvAddr);
+			}
+
+			while (recvSocket->available() > 0) {
+				asio::ip::udp::endpoint sender;
+				const size_t size = recvSocket->receive_from(asio::buffer(recvBuffer), sender);
+				CheckDatagram(recvBuffer.data(), size, sender);
+			}
+		}
+
+		const float secs = (spring_gettime() - t0).toSecsf();
+
+		LOG("[%s] plain: %d datagrams in %.3fs (%.0f/s)", __func__, numReceived, secs, numReceived / std::max(secs, 0.001f));
+
+		CHECK(numReceived == (NUM_ROUNDS * NUM_PER_ROUND));
+		CHECK(numMisordered == 0);
+	}
+
+	{
+		netcode::UDPBatchIO sendIO(sendSocket);
+		netcode::UDPBatchIO recvIO(recvSocket);
+
+		numReceived = 0;
+		numMisordered = 0;
+
+		const spring_time t0 = spring_gettime();
+
+		for (int r = 0, seqNum = 0; r < NUM_ROUNDS; r++) {
+			sendIO.BeginBatch();
+
+			for (int i = 0; i < NUM_PER_ROUND; i++, seqNum++) {
+				std::memcpy(sendBuffer.data(), &seqNum, sizeof(seqNum));
+				sendIO.Send(sendBuffer, recvAddr);
+			}
+
+			sendIO.EndBatch();
+			recvIO.Receive(CheckDatagram);
+		}
+
+		const float secs = (spring_gettime() - t0).toSecsf();
+
+		LOG("[%s] batched: %d datagrams in %.3fs (%.0f/s), %lu send calls, %lu receive calls", __func__,
+			numReceived, secs, numReceived / std::max(secs, 0.001f),
+			(unsigned long) sendIO.GetNumSendCalls(), (unsigned long) recvIO.GetNumRecvCalls());
+
+		CHECK(numReceived == (NUM_ROUNDS * NUM_PER_ROUND));
+		CHECK(numMisordered == 0);
+		CHECK(sendIO.GetNumSent() == size_t(NUM_ROUNDS * NUM_PER_ROUND));
+
+		if (netcode::UDPBatchIO::IsSupported()) {
+			CHECK(sendIO.GetNumSendCalls() == size_t(NUM_ROUNDS * NUM_PER_ROUND / netcode::UDPBatchIO::BATCH_SIZE));
+			CHECK(recvIO.GetNumRecvCalls() < sendIO.GetNumSendCalls() * 2);
+		}
+
+		// outside of a batch, nothing is held back
+		sendIO.Send(sendBuffer, recvAddr);
+		CHECK(recvIO.Receive([](const std::uint8_t*, size_t, const asio::ip::udp::endpoint&) {}) == 1);
+	}
+}
@@ -0,0 +1,176 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "System/TimeProfiler.h"
+#include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+InitSpringTime ist;
+
+
+static constexpr int NUM_THREADS = 4;
+// enough to wrap each thread's ring a few times over
+static constexpr int NUM_SCOPES_PER_THREAD = 100000;
+
+
+struct TraceEvent {
+	unsigned tid;
+	double ts;
+	double dur;
+	char name[64];
+	unsigned depth;
+};
+
+static std::vector<TraceEvent> ReadTrace(const char* fileName, bool* wellFormed)
+{
+	std::ifstream ifs(fileName);
+	std::vector<TraceEvent> events;
+	std::string line;
+	std::string last;
+
+	while (std::getline(ifs, line)) {
+		TraceEvent e;
+
+		if (sscanf(line.c_str(), "{\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%lf,\"dur\":%lf,\"name\":\"%63[^\"]\",\"args\":{\"depth\":%u}}", &e.tid, &e.ts, &e.dur, e.name, &e.depth) == 5)
+			events.push_back(e);
+
+		last = line;
+	}
+
+	*wellFormed = (last == "]}");
+	return events;
+}
+
+
+TEST_CASE("TimeTracerNesting")
+{
+	CTimeTracer& tracer = CTimeTracer::GetInstance();
+
+	tracer.SetEnabled(true);
+
+	{
+		SCOPED_TIMER("Test::Outer");
+
+		for (int i = 0; i < 10; i++) {
+			SCOPED_TIMER("Test::Inner");
+			{
+				SCOPED_TIMER("Test::Leaf");
+			}
+		}
+	}
+
+	tracer.SetEnabled(false);
+
+	CHECK(tracer.WriteTrace("testTimeTracer.json") == 21);
+
+	bool wellFormed = false;
+	const std::vector<TraceEvent> events = ReadTrace("testTimeTracer.json", &wellFormed);
+
+	CHECK(wellFormed);
+	REQUIRE(events.size() == 21);
+
+	// sorted by start-time, so each parent is followed by its children
+	CHECK(std::strcmp(events[0].name, "Test::Outer") == 0);
+	CHECK(events[0].depth == 0);
+
+	for (int i = 0; i < 10; i++) {
+		const TraceEvent& inner = events[1 + i * 2];
+		const TraceEvent& leaf = events[2 + i * 2];
+
+		CHECK(std::strcmp(inner.name, "Test::Inner") == 0);
+		CHECK(std::strcmp(leaf.name, "Test::Leaf") == 0);
+		CHECK(inner.depth == 1);
+		CHECK(leaf.depth == 2);
+
+		// children lie within their parents
+		CHECK(inner.ts >= events[0].ts);
+		CHECK(leaf.ts >= inner.ts);
+		CHECK((leaf.ts + leaf.dur) <= (inner.ts + inner.dur));
+		CHECK((inner.ts + inner.dur) <= (events[0].ts + events[0].dur));
+	}
+
+	std::remove("testTimeTracer.json");
+}
+
+
+TEST_CASE("TimeTracerThreads")
+{
+	CTimeTracer& tracer = CTimeTracer::GetInstance();
+
+	CTimeProfiler::RegisterTimer("Test::Task");
+	CTimeProfiler::RegisterTimer("Test::SubTask");
+
+	std::atomic<int> numRunning = {NUM_THREADS};
+	std::vector<std::thread> threads;
+
+	// leaves out the events of the previous test
+	const spring_time startTime = spring_gettime();
+
+	tracer.SetEnabled(true);
+
+	for (int t = 0; t < NUM_THREADS; t++) {
+		threads.emplace_back([&]() {
+			for (int i = 0; i < NUM_SCOPES_PER_THREAD; i++) {
+				SCOPED_MT_TIMER("Test::Task");
+				{
+					SCOPED_MT_TIMER("Test::SubTask");
+				}
+			}
+
+			numRunning -= 1;
+		});
+	}
+
+	// dump while the rings are being overwritten; whatever makes it into the
+	// trace has to be intact
+	int numDumps = 0;
+	int numEvents = 0;
+	int numBadEvents = 0;
+
+	do {
+		tracer.WriteTrace("testTimeTracerMT.json", startTime);
+
+		bool wellFormed = false;
+		const std::vector<TraceEvent> events = ReadTrace("testTimeTracerMT.json", &wellFormed);
+
+		numDumps += 1;
+		numEvents += events.size();
+		numBadEvents += (!wellFormed);
+
+		for (const TraceEvent& e: events) {
+			if (std::strcmp(e.name, "Test::Task") == 0) {
+				numBadEvents += (e.depth != 0);
+				continue;
+			}
+			if (std::strcmp(e.name, "Test::SubTask") == 0) {
+				numBadEvents += (e.depth != 1);
+				continue;
+			}
+
+			numBadEvents += 1;
+		}
+	} while (numRunning > 0);
+
+	for (std::thread& t: threads) {
+		t.join();
+	}
+
+	tracer.SetEnabled(false);
+
+	LOG("[%s] %d dumps with %d events while %d threads were tracing", __func__, numDumps, numEvents, NUM_THREADS);
+
+	CHECK(numEvents > 0);
+	CHECK(numBadEvents == 0);
+
+	std::remove("testTimeTracerMT.json");
+}
@@ -32,6 +32,7 @@ no console output (you still could use this.exe > z.tzt though).
 	DEFINE_bool  (teamstats,    false, "Print teamstats");
 	DEFINE_int32 (team,         -1,    "Select team");
 	DEFINE_string(teamsstatcsv, "",    "Write teamstats in a csv file");
+	DEFINE_int32 (frame,        -1,    "Start the traffic dump at this frame (uses the demo's frame index)");
 
 
 void TrafficDump(CDemoReader& reader, bool trafficStats);
@@ -196,6 +197,14 @@ void TrafficDump(CDemoReader& reader, bool trafficStats)
 	InitCommandNames();
 	std::vector<unsigned> trafficCounter(NETMSG_LAST, 0);
 	int frame = -1;
+	if (FLAGS_frame >= 0)
+	{
+		const int startFrame = reader.LoadFrameIndex()? reader.SeekToFrame(FLAGS_frame, 0.0f): -1;
+		if (startFrame < 0)
+			std::cout << "No frame index entry for frame " << FLAGS_frame << ", dumping from the start" << std::endl;
+		else
+			frame = startFrame - 1;
+	}
 	int cmdId = 0;
 	while (!reader.ReachedEnd())
 	{
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# compares the benchmark.json written by "engine-headless --benchmark <demo>"
+# against a stored baseline and exits non-zero on any regression beyond the
+# tolerance; see the benchmark-headless target in rts/builds/headless
+#
+# usage: ./compare_benchmark.py [--tolerance 10] [--min-time 0.05] benchmark.json baseline.json
+#        ./compare_benchmark.py --update benchmark.json baseline.json
+import argparse
+import json
+import shutil
+import sys
+
+# per-frame statistics compared for every sim-timer (max is too noisy)
+TIMER_STATS = ["mean", "p90", "p99"]
+
+parser = argparse.ArgumentParser(description="Compare engine benchmark results against a baseline")
+parser.add_argument("current", help="benchmark.json of the run to check")
+parser.add_argument("baseline", help="benchmark.json of the reference run")
+parser.add_argument("--tolerance", type=float, default=10.0, help="allowed slowdown or growth in percent (default: 10)")
+parser.add_argument("--min-time", type=float, default=0.05, help="ignore timers taking fewer msecs per frame on average in both runs (default: 0.05)")
+parser.add_argument("--update", action="store_true", help="replace the baseline with the current results")
+args = parser.parse_args()
+
+if args.update:
+	shutil.copyfile(args.current, args.baseline)
+	print("updated baseline %s" % args.baseline)
+	sys.exit(0)
+
+try:
+	with open(args.baseline) as f:
+		baseline = json.load(f)
+except IOError:
+	print("no baseline at %s, create one with --update" % args.baseline)
+	sys.exit(2)
+
+with open(args.current) as f:
+	current = json.load(f)
+
+# a different frame-count means another demo or a desync, timings would not be comparable
+if current["demo"] != baseline["demo"] or current["frames"] != baseline["frames"]:
+	print("results are not comparable: %s (%d frames) vs. baseline %s (%d frames)" % (current["demo"], current["frames"], baseline["demo"], baseline["frames"]))
+	sys.exit(2)
+
+factor = 1.0 + args.tolerance * 0.01
+regressions = []
+improvements = []
+
+def compare(name, cur, ref, lowerIsBetter=True):
+	if ref <= 0.0:
+		return
+
+	ratio = (cur / ref) if lowerIsBetter else (ref / max(cur, 1e-9))
+	line = "%-48s %12.4f -> %12.4f (%+.1f%%)" % (name, ref, cur, (cur / ref - 1.0) * 100.0)
+
+	if ratio > factor:
+		regressions.append(line)
+	elif ratio < (1.0 / factor):
+		improvements.append(line)
+
+compare("framesPerSecond", current["framesPerSecond"], baseline["framesPerSecond"], False)
+compare("peakRSSBytes", current["peakRSSBytes"], baseline["peakRSSBytes"])
+
+for timer in sorted(set(current["timers"]) | set(baseline["timers"])):
+	cur = current["timers"].get(timer)
+	ref = baseline["timers"].get(timer)
+
+	if cur is None or ref is None:
+		print("%-48s only in %s" % (timer, "baseline" if cur is None else "current results"))
+		continue
+
+	if max(cur["mean"], ref["mean"]) < args.min_time:
+		continue
+
+	for stat in TIMER_STATS:
+		compare("%s.%s" % (timer, stat), cur[stat], ref[stat])
+
+print("%s: %d frames at %.2f fps (baseline %.2f fps), tolerance %.1f%%" % (current["demo"], current["frames"], current["framesPerSecond"], baseline["framesPerSecond"], args.tolerance))
+
+if improvements:
+	print("\nimprovements:")
+	for line in improvements:
+		print("\t" + line)
+
+if regressions:
+	print("\nregressions:")
+	for line in regressions:
+		print("\t" + line)
+	sys.exit(1)
+
+sys.exit(0)